@@ -0,0 +1,75 @@
+#include "IndexAllocator.hpp"
+#include "Support/Views.hpp"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <random>
+
+using namespace ren;
+
+namespace {
+
+constexpr u32 NUM_INDICES = 100'000;
+
+/// Allocates NUM_INDICES indices and then frees them in allocation order.
+void BM_IndexAllocatorAllocateFree(benchmark::State &state) {
+  IndexAllocator allocator;
+  Vector<u32> indices(NUM_INDICES);
+  for (auto _ : state) {
+    for (u32 &idx : indices) {
+      idx = allocator.allocate();
+    }
+    benchmark::DoNotOptimize(indices.data());
+    for (u32 idx : indices) {
+      allocator.free(idx);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_INDICES);
+}
+
+/// Keeps NUM_INDICES indices allocated and repeatedly frees and reallocates
+/// them in random order, as descriptors of resources with different
+/// lifetimes are.
+void BM_IndexAllocatorChurn(benchmark::State &state) {
+  IndexAllocator allocator;
+  Vector<u32> indices(NUM_INDICES);
+  for (u32 &idx : indices) {
+    idx = allocator.allocate();
+  }
+  std::mt19937 rng(0);
+  std::ranges::shuffle(indices, rng);
+  for (auto _ : state) {
+    for (u32 &idx : indices) {
+      allocator.free(idx);
+      idx = allocator.allocate();
+    }
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_INDICES);
+}
+
+/// Claims NUM_INDICES fixed indices in random order and then frees them.
+void BM_IndexAllocatorAllocateFixed(benchmark::State &state) {
+  IndexAllocator allocator;
+  Vector<u32> indices = range<u32>(1, NUM_INDICES + 1) |
+                        std::ranges::to<Vector<u32>>();
+  std::mt19937 rng(0);
+  std::ranges::shuffle(indices, rng);
+  for (auto _ : state) {
+    for (u32 idx : indices) {
+      benchmark::DoNotOptimize(allocator.allocate(idx));
+    }
+    for (u32 idx : indices) {
+      allocator.free(idx);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_INDICES);
+}
+
+} // namespace
+
+BENCHMARK(BM_IndexAllocatorAllocateFree);
+BENCHMARK(BM_IndexAllocatorChurn);
+BENCHMARK(BM_IndexAllocatorAllocateFixed);
@@ -0,0 +1,116 @@
+#include "RenderGraph.hpp"
+#include "RgTestDevice.hpp"
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+using namespace ren;
+
+namespace {
+
+auto create_textures(RgPersistent &rgp, u32 num_passes) -> Vector<RgTextureId> {
+  Vector<RgTextureId> textures;
+  for (u32 i : range(num_passes)) {
+    textures.push_back(rgp.create_texture({
+        .name = fmt::format("texture{}", i),
+        .format = VK_FORMAT_R16G16B16A16_SFLOAT,
+        .width = 1920,
+        .height = 1080,
+    }));
+  }
+  return textures;
+}
+
+/// Builds a chain of compute passes. Each pass reads the texture written by
+/// the previous pass, reads the buffer written two passes before it and
+/// writes a texture and a buffer of its own. Textures are sampled or loaded
+/// from depending on the frame's parity if the structure should change.
+void build_graph(RgTestDevice &device, RgPersistent &rgp,
+                 Span<const RgTextureId> textures, u64 frame = 0,
+                 bool change_structure = false) {
+  TextureState read_state = CS_SAMPLE_TEXTURE;
+  if (change_structure and frame % 2) {
+    read_state = CS_READ_TEXTURE;
+  }
+  device.begin_frame();
+  RgBuilder rgb(rgp);
+  RgTextureId prev_texture;
+  std::array<RgUntypedBufferId, 2> prev_buffers = {};
+  for (usize i : range(textures.size())) {
+    RgPassBuilder pass = rgb.create_pass({.name = "pass"});
+    if (prev_texture) {
+      (void)pass.read_texture(prev_texture, read_state);
+    }
+    if (prev_buffers[1]) {
+      (void)pass.read_buffer(prev_buffers[1], CS_READ_BUFFER);
+    }
+    RgUntypedBufferId buffer =
+        rgb.create_buffer({.name = "buffer", .size = 64});
+    std::tie(buffer, std::ignore) =
+        pass.write_buffer("buffer#1", buffer, CS_WRITE_BUFFER);
+    std::tie(prev_texture, std::ignore) =
+        pass.write_texture("texture#1", textures[i], CS_WRITE_TEXTURE);
+    pass.set_callback([](Renderer &, const RgRuntime &, CommandRecorder &) {});
+    prev_buffers = {buffer, prev_buffers[0]};
+  }
+  rgb.set_output_texture(prev_texture);
+  rgb.set_output_buffer(prev_buffers[0]);
+  benchmark::DoNotOptimize(rgb.build());
+}
+
+/// Measures how long it takes to build a graph whose structure is the same
+/// as in the previous frame, which is the common case. The first argument is
+/// the number of passes.
+void BM_BuildRenderGraph(benchmark::State &state) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  Vector<RgTextureId> textures = create_textures(rgp, state.range(0));
+  build_graph(device, rgp, textures);
+  for (auto _ : state) {
+    build_graph(device, rgp, textures);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// Measures how long it takes to build a graph whose structure is different
+/// from the previous frame's, so its barriers have to be placed again.
+void BM_RebuildRenderGraph(benchmark::State &state) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  Vector<RgTextureId> textures = create_textures(rgp, state.range(0));
+  u64 frame = 0;
+  // Let texture usage flags settle.
+  build_graph(device, rgp, textures, frame++, true);
+  build_graph(device, rgp, textures, frame++, true);
+  for (auto _ : state) {
+    build_graph(device, rgp, textures, frame++, true);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/// Measures how long it takes to build a graph for the first time, including
+/// allocation of its textures and placement of its barriers.
+void BM_CompileRenderGraph(benchmark::State &state) {
+  for (auto _ : state) {
+    RgTestDevice device;
+    RgPersistent rgp(device);
+    Vector<RgTextureId> textures = create_textures(rgp, state.range(0));
+    build_graph(device, rgp, textures);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(BM_BuildRenderGraph)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RebuildRenderGraph)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_CompileRenderGraph)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000)
+    ->Unit(benchmark::kMicrosecond);
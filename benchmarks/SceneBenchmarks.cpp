@@ -0,0 +1,240 @@
+#include "Scene.hpp"
+#include "Support/Views.hpp"
+#include "ren/ren.hpp"
+
+#include <benchmark/benchmark.h>
+#include <numbers>
+
+using namespace ren;
+
+namespace {
+
+struct SphereMesh {
+  Vector<glm::vec3> positions;
+  Vector<glm::vec3> normals;
+  Vector<unsigned> indices;
+};
+
+/// UV sphere of radius 1 with 2 * num_rings segments around its axis.
+auto make_sphere(u32 num_rings) -> SphereMesh {
+  SphereMesh sphere;
+  u32 num_segments = 2 * num_rings;
+  for (u32 r : range(num_rings + 1)) {
+    float theta = std::numbers::pi_v<float> * r / num_rings;
+    for (u32 s : range(num_segments + 1)) {
+      float phi = 2.0f * std::numbers::pi_v<float> * s / num_segments;
+      glm::vec3 p = {
+          std::sin(theta) * std::cos(phi),
+          std::sin(theta) * std::sin(phi),
+          std::cos(theta),
+      };
+      sphere.positions.push_back(p);
+      sphere.normals.push_back(p);
+    }
+  }
+  for (u32 r : range(num_rings)) {
+    for (u32 s : range(num_segments)) {
+      unsigned a = r * (num_segments + 1) + s;
+      unsigned b = a + num_segments + 1;
+      sphere.indices.append(std::array{a, b, a + 1, a + 1, b, b + 1});
+    }
+  }
+  return sphere;
+}
+
+struct SceneContext {
+  std::unique_ptr<IRenderer> renderer;
+  std::unique_ptr<ISwapchain> swapchain;
+  std::unique_ptr<IScene> scene;
+};
+
+/// Creates a 16x16 grid of spheres that is num_layers deep along the camera's
+/// view direction, so most of them are hidden behind the front layers.
+auto create_dense_scene(u32 num_layers) -> expected<SceneContext> {
+  SceneContext ctx;
+  auto renderer = create_renderer({});
+  if (!renderer) {
+    return std::unexpected(renderer.error());
+  }
+  ctx.renderer = std::move(*renderer);
+  auto swapchain = create_offscreen_swapchain(*ctx.renderer, {});
+  if (!swapchain) {
+    return std::unexpected(swapchain.error());
+  }
+  ctx.swapchain = std::move(*swapchain);
+  auto scene = ctx.renderer->create_scene(*ctx.swapchain);
+  if (!scene) {
+    return std::unexpected(scene.error());
+  }
+  ctx.scene = std::move(*scene);
+  IScene &scene_ref = *ctx.scene;
+
+  SphereMesh sphere = make_sphere(16);
+  expected<MeshId> mesh = scene_ref.create_mesh({
+      .positions = sphere.positions,
+      .normals = sphere.normals,
+      .indices = sphere.indices,
+  });
+  expected<MaterialId> material = scene_ref.create_material({
+      .metallic_factor = 0.0f,
+      .roughness_factor = 0.5f,
+  });
+  if (!mesh or !material) {
+    return std::unexpected(Error::Runtime);
+  }
+
+  constexpr u32 GRID_SIZE = 16;
+  constexpr float SPACING = 1.5f;
+  u32 num_instances = GRID_SIZE * GRID_SIZE * num_layers;
+  Vector<MeshInstanceCreateInfo> create_info(num_instances,
+                                             {
+                                                 .mesh = *mesh,
+                                                 .material = *material,
+                                             });
+  Vector<MeshInstanceId> mesh_instances(num_instances);
+  Vector<glm::mat4x3> transforms;
+  for (u32 x : range(num_layers)) {
+    for (u32 y : range(GRID_SIZE)) {
+      for (u32 z : range(GRID_SIZE)) {
+        glm::mat4x3 transform(1.0f);
+        transform[3] = {
+            x * SPACING,
+            (y - GRID_SIZE / 2.0f) * SPACING,
+            (z - GRID_SIZE / 2.0f) * SPACING,
+        };
+        transforms.push_back(transform);
+      }
+    }
+  }
+  if (!scene_ref.create_mesh_instances(create_info, mesh_instances)) {
+    return std::unexpected(Error::Runtime);
+  }
+  scene_ref.set_mesh_instance_transforms(mesh_instances, transforms);
+
+  if (!scene_ref.create_directional_light({})) {
+    return std::unexpected(Error::Runtime);
+  }
+
+  expected<CameraId> camera = scene_ref.create_camera();
+  if (!camera) {
+    return std::unexpected(camera.error());
+  }
+  scene_ref.set_camera(*camera);
+  scene_ref.set_camera_perspective_projection(*camera, {});
+  scene_ref.set_camera_transform(
+      *camera, {.position = {-0.5f * GRID_SIZE * SPACING, 0.0f, 0.0f}});
+
+  return ctx;
+}
+
+enum class OpaqueMode {
+  Forward,
+  ForwardEarlyZ,
+  /// Depth prepass that only draws instances that covered at least 1% of the
+  /// screen in the previous frame.
+  ForwardOccluderEarlyZ,
+  VisibilityBuffer,
+};
+
+/// Measures GPU frame time of a dense scene. The first argument is the number
+/// of layers of spheres behind each other.
+void BM_DenseScene(benchmark::State &state, OpaqueMode mode) {
+  expected<SceneContext> ctx = create_dense_scene(state.range(0));
+  if (!ctx) {
+    state.SkipWithError("Failed to create scene");
+    return;
+  }
+  IScene &scene = *ctx->scene;
+
+  SceneGraphicsSettings &settings =
+      static_cast<Scene &>(scene).get_settings();
+  settings.early_z = mode == OpaqueMode::ForwardEarlyZ or
+                     mode == OpaqueMode::ForwardOccluderEarlyZ;
+  settings.early_z_min_occluder_screen_area =
+      mode == OpaqueMode::ForwardOccluderEarlyZ ? 0.01f : 0.0f;
+  settings.visibility_buffer = mode == OpaqueMode::VisibilityBuffer;
+
+  // Let uploads finish and timestamps become available.
+  constexpr u32 NUM_WARMUP_FRAMES = 8;
+  for (u32 i = 0; i < NUM_WARMUP_FRAMES; ++i) {
+    if (!scene.draw()) {
+      state.SkipWithError("Failed to draw frame");
+      return;
+    }
+  }
+
+  for (auto _ : state) {
+    if (!scene.draw()) {
+      state.SkipWithError("Failed to draw frame");
+      return;
+    }
+    FrameStatistics stats = scene.get_frame_statistics();
+    if (stats.gpu_frame_time_ms == 0.0f) {
+      state.SkipWithError("GPU timestamps are not supported");
+      return;
+    }
+    state.SetIterationTime(stats.gpu_frame_time_ms / 1000.0);
+  }
+}
+
+/// Measures how long it takes to record a dense scene's render graph on the
+/// CPU. The first argument is the number of layers of spheres and the second
+/// one is the number of recording threads, including the main one.
+void BM_RecordDenseScene(benchmark::State &state) {
+  expected<SceneContext> ctx = create_dense_scene(state.range(0));
+  if (!ctx) {
+    state.SkipWithError("Failed to create scene");
+    return;
+  }
+  IScene &scene = *ctx->scene;
+
+  SceneGraphicsSettings &settings =
+      static_cast<Scene &>(scene).get_settings();
+  settings.num_recording_threads = state.range(1);
+
+  constexpr u32 NUM_WARMUP_FRAMES = 8;
+  for (u32 i = 0; i < NUM_WARMUP_FRAMES; ++i) {
+    if (!scene.draw()) {
+      state.SkipWithError("Failed to draw frame");
+      return;
+    }
+  }
+
+  for (auto _ : state) {
+    if (!scene.draw()) {
+      state.SkipWithError("Failed to draw frame");
+      return;
+    }
+    FrameStatistics stats = scene.get_frame_statistics();
+    state.SetIterationTime(stats.cpu_record_time_ms / 1000.0);
+  }
+}
+
+} // namespace
+
+BENCHMARK(BM_RecordDenseScene)
+    ->ArgsProduct({{16, 64}, {1, 4, 8}})
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DenseScene, Forward, OpaqueMode::Forward)
+    ->RangeMultiplier(4)
+    ->Range(1, 64)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DenseScene, ForwardEarlyZ, OpaqueMode::ForwardEarlyZ)
+    ->RangeMultiplier(4)
+    ->Range(1, 64)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DenseScene, ForwardOccluderEarlyZ,
+                  OpaqueMode::ForwardOccluderEarlyZ)
+    ->RangeMultiplier(4)
+    ->Range(1, 64)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DenseScene, VisibilityBuffer,
+                  OpaqueMode::VisibilityBuffer)
+    ->RangeMultiplier(4)
+    ->Range(1, 64)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
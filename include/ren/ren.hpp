@@ -1,8 +1,11 @@
 #pragma once
+#include <array>
 #include <expected>
+#include <functional>
 #include <glm/glm.hpp>
 #include <memory>
 #include <span>
+#include <string>
 
 namespace ren {
 
@@ -81,6 +84,24 @@ struct ISwapchain {
                                       unsigned height) -> expected<void> = 0;
 };
 
+/// Offscreen swapchain description.
+struct OffscreenSwapchainCreateInfo {
+  unsigned width = 1280;
+  unsigned height = 720;
+  /// Number of images in the ring that frames are rendered to.
+  unsigned num_images = 3;
+  /// Minimum time between presents in seconds. 0 doesn't limit the frame
+  /// rate.
+  float frame_time = 0.0f;
+};
+
+/// Creates a swapchain that renders to a ring of offscreen images instead of a
+/// window surface. Presenting only waits for the frame to be rendered.
+[[nodiscard]] auto
+create_offscreen_swapchain(IRenderer &renderer,
+                           const OffscreenSwapchainCreateInfo &create_info)
+    -> expected<std::unique_ptr<ISwapchain>>;
+
 /// Camera perspective projection descriptor.
 struct CameraPerspectiveProjectionDesc {
   /// Horizontal field-of-view in radians.
@@ -239,6 +260,9 @@ struct MeshInstanceCreateInfo {
   MeshId mesh;
   /// The material that will be used to render this mesh instance
   MaterialId material;
+  /// Always render this mesh instance in the depth prepass, regardless of its
+  /// screen area
+  bool occluder = false;
 };
 
 /// Directional light descriptor
@@ -251,6 +275,130 @@ struct DirectionalLightDesc {
   glm::vec3 origin = {0.0f, 0.0f, 1.0f};
 };
 
+/// GPU timings of a render graph pass.
+struct PassStatistics {
+  /// Pass name. Empty if render graph debug features are disabled.
+  const char *name = "";
+  /// Time in milliseconds between the start and the end of the pass on the
+  /// GPU.
+  float gpu_time_ms = 0.0f;
+};
+
+/// Timings of a frame.
+struct FrameStatistics {
+  /// Time in milliseconds that it took to build the render graph.
+  float cpu_build_time_ms = 0.0f;
+  /// Time in milliseconds that it took to record and submit the render graph.
+  float cpu_record_time_ms = 0.0f;
+  /// Time in milliseconds that draw() took.
+  float cpu_frame_time_ms = 0.0f;
+  /// Time in milliseconds between the start of the first pass and the end of
+  /// the last pass on the GPU, or 0 if the GPU doesn't support timestamps.
+  float gpu_frame_time_ms = 0.0f;
+  /// Timings of passes that recorded GPU commands, in execution order. Empty
+  /// if the GPU doesn't support timestamps.
+  std::span<const PassStatistics> passes;
+  /// Number of descriptors written for the frame. Descriptors of render graph
+  /// textures are reused across frames, so this is close to 0 unless textures
+  /// are (re)created.
+  unsigned num_descriptor_writes = 0;
+  /// Bytes allocated for the frame from the bump allocators that upload data
+  /// and back transient render graph buffers.
+  size_t num_bump_bytes_used = 0;
+  /// Bytes lost to alignment padding and partially filled blocks.
+  size_t num_bump_bytes_wasted = 0;
+  /// Total size of bump allocator blocks. Blocks grow with demand and are
+  /// trimmed after demand stays low for a while.
+  size_t num_bump_bytes_reserved = 0;
+  unsigned num_bump_blocks = 0;
+};
+
+/// Subsystem that GPU memory is allocated for.
+enum class MemoryOwner {
+  /// Memory that doesn't belong to any of the other owners, like frame capture
+  /// readback buffers.
+  Other,
+  /// Vertex and index data of meshes.
+  MeshData,
+  /// Images created with create_image().
+  Images,
+  /// Render targets, render graph buffers and the memory that transient render
+  /// graph textures are placed in.
+  RenderGraph,
+  /// Staging memory that data is uploaded through.
+  Upload,
+  /// Mesh, mesh instance, material and light buffers that shaders read.
+  GpuScene,
+};
+constexpr size_t NUM_MEMORY_OWNERS = 6;
+
+/// Usage of a memory heap of the adapter.
+struct MemoryHeapStatistics {
+  /// Whether the heap is in video memory.
+  bool device_local = false;
+  /// Bytes that this process has allocated from the heap.
+  size_t usage = 0;
+  /// Bytes that this process can allocate from the heap before allocations
+  /// start to fail or hurt performance. Estimated if the adapter doesn't
+  /// support VK_EXT_memory_budget.
+  size_t budget = 0;
+};
+
+/// GPU memory usage.
+struct MemoryStatistics {
+  /// Bytes allocated by each owner, indexed by MemoryOwner.
+  std::array<size_t, NUM_MEMORY_OWNERS> owners = {};
+  std::span<const MemoryHeapStatistics> heaps;
+};
+
+/// Pixel format of captured frames.
+enum class FrameCaptureFormat {
+  /// sRGB-encoded RGBA, 4 bytes per pixel.
+  RGBA8,
+  /// BT.709 limited range planar YUV with 2x2 chroma subsampling (I420).
+  YUV420,
+};
+
+/// Plane of a captured frame.
+struct CapturedFramePlane {
+  std::span<const std::byte> data;
+  /// Distance in bytes between rows.
+  unsigned stride = 0;
+};
+
+/// Frame that has been read back from the GPU.
+struct CapturedFrame {
+  FrameCaptureFormat format = {};
+  unsigned width = 0;
+  unsigned height = 0;
+  /// One plane for RGBA8 frames, or Y, U and V planes for YUV420 frames. The
+  /// rows of the Y plane are padded to a multiple of 8 pixels and its height to
+  /// a multiple of 2.
+  std::span<const CapturedFramePlane> planes;
+};
+
+/// Frame capture description.
+struct FrameCaptureDesc {
+  FrameCaptureFormat format = FrameCaptureFormat::RGBA8;
+  /// Called from draw() with each frame once its GPU work has completed, which
+  /// is the number of frames in flight later. The frame's data is only valid
+  /// during the call. Capture is disabled if the callback is empty.
+  std::function<void(const CapturedFrame &)> callback;
+};
+
+/// Render graph export description. Files are written for the next frame
+/// that is drawn. Empty paths are skipped.
+struct RenderGraphExportDesc {
+  /// Graphviz DOT file with the frame's passes, the buffers and textures that
+  /// they use and the barriers that are placed between them. Written from
+  /// draw().
+  std::string dot_path;
+  /// Chrome trace event JSON file with the frame's CPU build and record times
+  /// and GPU pass timings. Written from draw() once the frame's GPU work has
+  /// completed.
+  std::string trace_path;
+};
+
 struct IScene {
   virtual ~IScene() = default;
 
@@ -320,6 +468,28 @@ struct IScene {
                                      const DirectionalLightDesc &desc) = 0;
 
   [[nodiscard]] virtual auto draw() -> expected<void> = 0;
+
+  /// Returns timings of the last frame whose GPU work has completed. GPU
+  /// timings are read back without waiting, so they lag behind by the number
+  /// of frames in flight. The returned pass statistics are valid until the next
+  /// call to draw().
+  [[nodiscard]] virtual auto get_frame_statistics() const
+      -> FrameStatistics = 0;
+
+  /// Returns GPU memory usage and heap budgets as of the start of the current
+  /// frame. The returned heap statistics are valid until the next call to
+  /// draw().
+  [[nodiscard]] virtual auto get_memory_statistics() const
+      -> MemoryStatistics = 0;
+
+  /// Copies the final image of every frame that is drawn from now on into
+  /// host memory without stalling, and passes it to a callback.
+  virtual void set_frame_capture(FrameCaptureDesc desc) = 0;
+
+  /// Exports the render graph of the next frame. Export can also be requested
+  /// with the REN_RG_EXPORT_DOT and REN_RG_EXPORT_TRACE environment variables,
+  /// in which case the frame is selected with REN_RG_EXPORT_FRAME.
+  virtual void export_render_graph(RenderGraphExportDesc desc) = 0;
 };
 
 } // namespace ren
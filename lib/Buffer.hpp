@@ -4,6 +4,7 @@
 #include "Support/GenIndex.hpp"
 #include "Support/Hash.hpp"
 #include "Support/StdDef.hpp"
+#include "ren/ren.hpp"
 
 #include <vk_mem_alloc.h>
 
@@ -25,6 +26,10 @@ struct BufferCreateInfo {
     usize size = 0;
     usize count;
   };
+  /// Share the buffer between the graphics and the async compute queue.
+  /// Otherwise, it belongs to the queue family that uses it first.
+  bool concurrent = false;
+  MemoryOwner owner = MemoryOwner::Other;
 };
 
 struct Buffer {
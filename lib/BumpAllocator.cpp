@@ -1,8 +1,74 @@
 #include "BumpAllocator.hpp"
 #include "CommandRecorder.hpp"
+#include "ResourceArena.hpp"
 
 namespace ren {
 
+namespace detail {
+
+auto DeviceBumpAllocationPolicy::create_block(Renderer &renderer,
+                                              ResourceArena &arena,
+                                              usize size) -> Block {
+  Handle<Buffer> buffer =
+      arena
+          .create_buffer({
+              .name = "DeviceBumpAllocator block",
+              .heap = BufferHeap::Static,
+              .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                       VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+              .size = size,
+              // Render graph buffers are used on both queues.
+              .concurrent = true,
+              .owner = MemoryOwner::RenderGraph,
+          })
+          .buffer;
+  return {
+      .ptr = renderer.get_buffer_device_ptr<std::byte>(buffer),
+      .buffer = buffer,
+  };
+}
+
+void DeviceBumpAllocationPolicy::destroy_block(ResourceArena &arena,
+                                               const Block &block) {
+  arena.destroy(block.buffer);
+}
+
+auto UploadBumpAllocationPolicy::create_block(Renderer &renderer,
+                                              ResourceArena &arena,
+                                              usize size) -> Block {
+  Handle<Buffer> buffer =
+      arena
+          .create_buffer({
+              .name = "UploadBumpAllocator block",
+              .heap = BufferHeap::Staging,
+              .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                       VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+              .size = size,
+              // Render graph buffers are used on both queues.
+              .concurrent = true,
+              .owner = MemoryOwner::Upload,
+          })
+          .buffer;
+  return {
+      .host_ptr = renderer.map_buffer<std::byte>(buffer),
+      .device_ptr = renderer.get_buffer_device_ptr<std::byte>(buffer),
+      .buffer = buffer,
+  };
+}
+
+void UploadBumpAllocationPolicy::destroy_block(ResourceArena &arena,
+                                               const Block &block) {
+  arena.destroy(block.buffer);
+}
+
+} // namespace detail
+
 void DeviceBumpAllocator::reset(CommandRecorder &rec) {
   Base::reset();
   rec.pipeline_barrier({{
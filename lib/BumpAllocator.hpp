@@ -1,12 +1,18 @@
 #pragma once
 #include "Buffer.hpp"
-#include "ResourceArena.hpp"
+#include "RendererResourceLock.hpp"
 #include "Support/Math.hpp"
+#include "Support/Vector.hpp"
 #include "glsl/DevicePtr.h"
 
+#include <algorithm>
+#include <bit>
+
 namespace ren {
 
 class CommandRecorder;
+class Renderer;
+class ResourceArena;
 
 namespace detail {
 
@@ -15,11 +21,36 @@ public:
   template <typename T = std::byte>
   using Allocation = Policy::template Allocation<T>;
 
+  /// Regular blocks don't grow past this size unless the initial block size is
+  /// larger. Allocations that don't fit into a block of this size get a
+  /// dedicated block.
+  static constexpr usize MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  /// Number of resets after which blocks that were not used are destroyed.
+  /// Regular blocks are only destroyed from the end, so a block that is
+  /// followed by a block that is still used is kept. Must be larger than the
+  /// number of frames in flight, since blocks are destroyed immediately and the
+  /// GPU might still be reading them otherwise.
+  static constexpr u32 TRIM_LATENCY = 64;
+
+  struct Statistics {
+    /// Bytes allocated since the last reset.
+    usize num_bytes_used = 0;
+    /// Bytes lost to alignment padding, to the unused tails of blocks and to
+    /// blocks that were skipped because they were too small since the last
+    /// reset.
+    usize num_bytes_wasted = 0;
+    /// Total size of all blocks.
+    usize num_bytes_reserved = 0;
+    u32 num_blocks = 0;
+    u32 num_dedicated_blocks = 0;
+  };
+
   BumpAllocator(Renderer &renderer, ResourceArena &arena, usize block_size) {
     m_renderer = &renderer;
     m_arena = &arena;
     m_block_size = block_size;
-    reset();
+    m_max_block_size = std::max(block_size, MAX_BLOCK_SIZE);
   }
 
   BumpAllocator(const BumpAllocator &) = delete;
@@ -33,51 +64,174 @@ public:
     m_renderer = other.m_renderer;
     m_arena = other.m_arena;
     m_blocks = std::move(other.m_blocks);
+    m_dedicated_blocks = std::move(other.m_dedicated_blocks);
     m_block_size = other.m_block_size;
+    m_max_block_size = other.m_max_block_size;
     m_block = other.m_block;
     m_block_offset = other.m_block_offset;
-    other.reset();
+    m_block_end = other.m_block_end;
+    m_frame = other.m_frame;
+    m_num_bytes_used = other.m_num_bytes_used;
+    m_num_bytes_wasted = other.m_num_bytes_wasted;
+    other.m_blocks.clear();
+    other.m_dedicated_blocks.clear();
+    other.m_block = -1;
+    other.m_block_offset = 0;
+    other.m_block_end = 0;
     return *this;
   }
 
   template <typename T = std::byte>
   auto allocate(usize count) -> Allocation<T> {
-    m_block_offset = pad(m_block_offset, alignof(T));
-    m_block_offset = pad(m_block_offset, Policy::ALIGNMENT);
     usize size = count * sizeof(T);
     ren_assert(size > 0);
-    ren_assert(size <= m_block_size);
 
-    [[unlikely]] if (m_block_offset + size > m_block_size) {
+    [[unlikely]] if (size > m_max_block_size) {
+      return allocate_dedicated<T>(count);
+    }
+
+    usize offset = pad(m_block_offset, alignof(T));
+    offset = pad(offset, Policy::ALIGNMENT);
+
+    [[unlikely]] if (offset + size > m_block_end) {
+      m_num_bytes_wasted += m_block_end - m_block_offset;
+      // Block sizes never decrease, so skip blocks that are too small. They
+      // stay unused until the next reset.
       m_block += 1;
+      while (m_block < m_blocks.size() and m_blocks[m_block].size < size) {
+        m_num_bytes_wasted += m_blocks[m_block].size;
+        m_block += 1;
+      }
       [[unlikely]] if (m_block == m_blocks.size()) {
-        m_blocks.push_back(
-            Policy::create_block(*m_renderer, *m_arena, m_block_size));
+        usize block_size = m_block_size;
+        if (not m_blocks.empty()) {
+          block_size = std::min(m_blocks.back().size * 2, m_max_block_size);
+        }
+        block_size = std::max(block_size,
+                              std::min(std::bit_ceil(size), m_max_block_size));
+        ExclusiveRendererResourceLock lock;
+        m_blocks.push_back({
+            .block = Policy::create_block(*m_renderer, *m_arena, block_size),
+            .size = block_size,
+        });
       }
+      m_blocks[m_block].frame = m_frame;
       m_block_offset = 0;
+      m_block_end = m_blocks[m_block].size;
+      offset = 0;
     }
 
-    Allocation<T> allocation =
-        Policy::template allocate<T>(m_blocks[m_block], m_block_offset, count);
+    Allocation<T> allocation = Policy::template allocate<T>(
+        m_blocks[m_block].block, offset, count);
 
-    m_block_offset += size;
+    m_num_bytes_wasted += offset - m_block_offset;
+    m_num_bytes_used += size;
+    m_block_offset = offset + size;
 
     return allocation;
   }
 
+  /// Makes all memory available for allocation again. Blocks that were not
+  /// used for TRIM_LATENCY resets are destroyed.
   void reset() {
+    m_frame++;
     m_block = -1;
-    m_block_offset = m_block_size;
+    m_block_offset = 0;
+    m_block_end = 0;
+    m_num_bytes_used = 0;
+    m_num_bytes_wasted = 0;
+
+    auto is_stale = [&](const BlockInfo &block) {
+      return block.frame + TRIM_LATENCY <= m_frame;
+    };
+
+    [[unlikely]] if (not m_blocks.empty() and is_stale(m_blocks.back())) {
+      ExclusiveRendererResourceLock lock;
+      while (not m_blocks.empty() and is_stale(m_blocks.back())) {
+        Policy::destroy_block(*m_arena, m_blocks.back().block);
+        m_blocks.pop_back();
+      }
+    }
+
+    [[unlikely]] if (not m_dedicated_blocks.empty()) {
+      ExclusiveRendererResourceLock lock;
+      for (usize i = 0; i < m_dedicated_blocks.size();) {
+        if (is_stale(m_dedicated_blocks[i])) {
+          Policy::destroy_block(*m_arena, m_dedicated_blocks[i].block);
+          m_dedicated_blocks[i] = m_dedicated_blocks.back();
+          m_dedicated_blocks.pop_back();
+        } else {
+          i++;
+        }
+      }
+    }
+  }
+
+  auto get_statistics() const -> Statistics {
+    Statistics stats = {
+        .num_bytes_used = m_num_bytes_used,
+        .num_bytes_wasted = m_num_bytes_wasted,
+        .num_blocks = u32(m_blocks.size()),
+        .num_dedicated_blocks = u32(m_dedicated_blocks.size()),
+    };
+    for (const BlockInfo &block : m_blocks) {
+      stats.num_bytes_reserved += block.size;
+    }
+    for (const BlockInfo &block : m_dedicated_blocks) {
+      stats.num_bytes_reserved += block.size;
+    }
+    return stats;
+  }
+
+private:
+  /// Allocates a whole block for a single allocation. Dedicated blocks are
+  /// reused after a reset if they are large enough, so large uploads that
+  /// repeat every frame don't create a buffer every frame.
+  template <typename T> auto allocate_dedicated(usize count) -> Allocation<T> {
+    usize size = count * sizeof(T);
+    m_num_bytes_used += size;
+    BlockInfo *best = nullptr;
+    for (BlockInfo &block : m_dedicated_blocks) {
+      if (block.frame != m_frame and block.size >= size and
+          (not best or block.size < best->size)) {
+        best = &block;
+      }
+    }
+    if (not best) {
+      ExclusiveRendererResourceLock lock;
+      best = &m_dedicated_blocks.emplace_back(BlockInfo{
+          .block = Policy::create_block(*m_renderer, *m_arena, size),
+          .size = size,
+      });
+    }
+    best->frame = m_frame;
+    m_num_bytes_wasted += best->size - size;
+    return Policy::template allocate<T>(best->block, 0, count);
   }
 
 private:
   using Block = Policy::Block;
+
+  struct BlockInfo {
+    Block block;
+    usize size = 0;
+    /// Last reset during which the block was used.
+    u64 frame = 0;
+  };
+
   Renderer *m_renderer = nullptr;
   ResourceArena *m_arena = nullptr;
-  SmallVector<Block, 1> m_blocks;
+  /// Regular blocks, in order of non-decreasing size.
+  SmallVector<BlockInfo, 1> m_blocks;
+  Vector<BlockInfo> m_dedicated_blocks;
   usize m_block_size = 0;
-  usize m_block = 0;
+  usize m_max_block_size = 0;
+  usize m_block = -1;
   usize m_block_offset = 0;
+  usize m_block_end = 0;
+  u64 m_frame = 0;
+  usize m_num_bytes_used = 0;
+  usize m_num_bytes_wasted = 0;
 };
 
 struct DeviceBumpAllocationPolicy {
@@ -89,25 +243,9 @@ struct DeviceBumpAllocationPolicy {
   };
 
   static auto create_block(Renderer &renderer, ResourceArena &arena,
-                           usize size) -> Block {
-    Handle<Buffer> buffer =
-        arena
-            .create_buffer({
-                .name = "DeviceBumpAllocator block",
-                .heap = BufferHeap::Static,
-                .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
-                         VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
-                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                .size = size,
-            })
-            .buffer;
-    return {
-        .ptr = renderer.get_buffer_device_ptr<std::byte>(buffer),
-        .buffer = buffer,
-    };
-  };
+                           usize size) -> Block;
+
+  static void destroy_block(ResourceArena &arena, const Block &block);
 
   template <typename T> struct Allocation {
     DevicePtr<T> ptr;
@@ -146,26 +284,9 @@ struct UploadBumpAllocationPolicy {
   };
 
   static auto create_block(Renderer &renderer, ResourceArena &arena,
-                           usize size) -> Block {
-    Handle<Buffer> buffer =
-        arena
-            .create_buffer({
-                .name = "UploadBumpAllocator block",
-                .heap = BufferHeap::Staging,
-                .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
-                         VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
-                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                .size = size,
-            })
-            .buffer;
-    return {
-        .host_ptr = renderer.map_buffer<std::byte>(buffer),
-        .device_ptr = renderer.get_buffer_device_ptr<std::byte>(buffer),
-        .buffer = buffer,
-    };
-  };
+                           usize size) -> Block;
+
+  static void destroy_block(ResourceArena &arena, const Block &block);
 
   template <typename T>
   static auto allocate(const Block &block, usize offset,
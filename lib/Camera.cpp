@@ -60,4 +60,14 @@ auto get_projection_view_matrix(const Camera &camera,
   return get_projection_matrix(camera, viewport) * get_view_matrix(camera);
 }
 
+auto get_homogeneous_eye_position(const Camera &camera) -> glm::vec4 {
+  switch (camera.proj) {
+  case CameraProjection::Perspective:
+    return glm::vec4(camera.position, 1.0f);
+  case CameraProjection::Orthograpic:
+    return glm::vec4(-glm::normalize(camera.forward), 0.0f);
+  }
+  std::unreachable();
+}
+
 } // namespace ren
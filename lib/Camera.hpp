@@ -35,4 +35,8 @@ glm::mat4 get_projection_matrix(const Camera &camera, glm::uvec2 viewport);
 auto get_projection_view_matrix(const Camera &camera,
                                 glm::uvec2 viewport) -> glm::mat4;
 
+/// Returns the camera's position for perspective projection or the direction
+/// towards the camera with w = 0 for orthographic projection.
+auto get_homogeneous_eye_position(const Camera &camera) -> glm::vec4;
+
 } // namespace ren
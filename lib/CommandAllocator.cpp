@@ -1,76 +1,197 @@
 #include "CommandAllocator.hpp"
 #include "Renderer.hpp"
 #include "Support/Errors.hpp"
+#include "Support/Span.hpp"
+#include "Support/Views.hpp"
 
 namespace ren {
 
-CommandAllocator::CommandAllocator(Renderer &renderer) {
-  m_renderer = &renderer;
+namespace {
+
+auto create_command_pool(Renderer &renderer,
+                         unsigned queue_family) -> VkCommandPool {
   VkCommandPoolCreateInfo pool_info = {
       .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
       .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-      .queueFamilyIndex = m_renderer->get_graphics_queue_family(),
+      .queueFamilyIndex = queue_family,
   };
-  throw_if_failed(vkCreateCommandPool(m_renderer->get_device(), &pool_info,
-                                      nullptr, &m_pool),
-                  "Vulkan: Failed to create command pool");
+  VkCommandPool pool;
+  throw_if_failed(
+      vkCreateCommandPool(renderer.get_device(), &pool_info, nullptr, &pool),
+      "Vulkan: Failed to create command pool");
+  return pool;
+}
+
+} // namespace
+
+CommandAllocator::CommandAllocator(Renderer &renderer) {
+  m_renderer = &renderer;
+  m_graphics_pool.pool = create_command_pool(
+      *m_renderer, m_renderer->get_graphics_queue_family());
+  if (m_renderer->has_async_compute()) {
+    m_compute_pool.pool = create_command_pool(
+        *m_renderer, m_renderer->get_compute_queue_family());
+  }
 }
 
 CommandAllocator::CommandAllocator(CommandAllocator &&other) noexcept
     : m_renderer(other.m_renderer),
-      m_pool(std::exchange(other.m_pool, nullptr)),
-      m_cmd_buffers(std::move(other.m_cmd_buffers)),
-      m_allocated_count(std::exchange(other.m_allocated_count, 0)) {}
+      m_graphics_pool(std::exchange(other.m_graphics_pool, {})),
+      m_compute_pool(std::exchange(other.m_compute_pool, {})),
+      m_events(std::move(other.m_events)),
+      m_allocated_event_count(std::exchange(other.m_allocated_event_count, 0)),
+      m_query_pools(std::move(other.m_query_pools)) {}
 
 CommandAllocator &
 CommandAllocator::operator=(CommandAllocator &&other) noexcept {
   destroy();
   m_renderer = other.m_renderer;
-  m_pool = other.m_pool;
-  other.m_pool = nullptr;
-  m_cmd_buffers = std::move(other.m_cmd_buffers);
-  m_allocated_count = other.m_allocated_count;
-  other.m_allocated_count = 0;
+  m_graphics_pool = std::exchange(other.m_graphics_pool, {});
+  m_compute_pool = std::exchange(other.m_compute_pool, {});
+  m_events = std::move(other.m_events);
+  m_allocated_event_count = other.m_allocated_event_count;
+  other.m_allocated_event_count = 0;
+  m_query_pools = std::move(other.m_query_pools);
   return *this;
 }
 
 void CommandAllocator::destroy() {
-  if (m_pool) {
+  if (m_graphics_pool.pool) {
     m_renderer->wait_idle();
-    if (not m_cmd_buffers.empty()) {
-      vkFreeCommandBuffers(m_renderer->get_device(), m_pool,
-                           m_cmd_buffers.size(), m_cmd_buffers.data());
+    for (Pool *pool : {&m_graphics_pool, &m_compute_pool}) {
+      if (!pool->pool) {
+        continue;
+      }
+      if (not pool->cmd_buffers.empty()) {
+        vkFreeCommandBuffers(m_renderer->get_device(), pool->pool,
+                             pool->cmd_buffers.size(),
+                             pool->cmd_buffers.data());
+      }
+      vkDestroyCommandPool(m_renderer->get_device(), pool->pool, nullptr);
+    }
+    for (VkEvent event : m_events) {
+      vkDestroyEvent(m_renderer->get_device(), event, nullptr);
+    }
+    for (const QueryPool &pool : m_query_pools) {
+      vkDestroyQueryPool(m_renderer->get_device(), pool.pool, nullptr);
     }
-    vkDestroyCommandPool(m_renderer->get_device(), m_pool, nullptr);
   }
 }
 
 CommandAllocator::~CommandAllocator() { destroy(); }
 
-VkCommandBuffer CommandAllocator::allocate() {
-  [[unlikely]] if (m_allocated_count == m_cmd_buffers.size()) {
-    auto old_capacity = m_cmd_buffers.size();
+VkCommandBuffer CommandAllocator::allocate(Pool &pool) {
+  [[unlikely]] if (pool.allocated_count == pool.cmd_buffers.size()) {
+    auto old_capacity = pool.cmd_buffers.size();
     auto new_capacity = std::max<size_t>(2 * old_capacity, 1);
-    m_cmd_buffers.resize(new_capacity);
+    pool.cmd_buffers.resize(new_capacity);
     uint32_t alloc_count = new_capacity - old_capacity;
     VkCommandBufferAllocateInfo alloc_info = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = m_pool,
+        .commandPool = pool.pool,
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = alloc_count,
     };
     throw_if_failed(
         vkAllocateCommandBuffers(m_renderer->get_device(), &alloc_info,
-                                 m_cmd_buffers.data() + old_capacity),
+                                 pool.cmd_buffers.data() + old_capacity),
         "Vulkan: Failed to allocate command buffers");
   }
-  return m_cmd_buffers[m_allocated_count++];
+  return pool.cmd_buffers[pool.allocated_count++];
+}
+
+VkCommandBuffer CommandAllocator::allocate() {
+  return allocate(m_graphics_pool);
+}
+
+VkCommandBuffer CommandAllocator::allocate_compute() {
+  ren_assert(m_compute_pool.pool);
+  return allocate(m_compute_pool);
+}
+
+VkEvent CommandAllocator::allocate_event() {
+  [[unlikely]] if (m_allocated_event_count == m_events.size()) {
+    VkEventCreateInfo event_info = {
+        .sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO,
+    };
+    VkEvent event;
+    throw_if_failed(vkCreateEvent(m_renderer->get_device(), &event_info,
+                                  nullptr, &event),
+                    "Vulkan: Failed to create event");
+    m_events.push_back(event);
+  }
+  return m_events[m_allocated_event_count++];
+}
+
+auto CommandAllocator::allocate_timestamp_queries(u32 count)
+    -> TimestampQueries {
+  for (QueryPool &pool : m_query_pools) {
+    if (pool.capacity - pool.allocated_count >= count) {
+      u32 base = pool.allocated_count;
+      pool.allocated_count += count;
+      return {.pool = pool.pool, .base = base, .count = count};
+    }
+  }
+  u32 capacity = 64;
+  if (not m_query_pools.empty()) {
+    capacity = 2 * m_query_pools.back().capacity;
+  }
+  capacity = std::max(capacity, count);
+  VkQueryPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = capacity,
+  };
+  VkQueryPool pool;
+  throw_if_failed(
+      vkCreateQueryPool(m_renderer->get_device(), &pool_info, nullptr, &pool),
+      "Vulkan: Failed to create query pool");
+  vkResetQueryPool(m_renderer->get_device(), pool, 0, capacity);
+  m_query_pools.push_back({
+      .pool = pool,
+      .capacity = capacity,
+      .allocated_count = count,
+  });
+  return {.pool = pool, .count = count};
+}
+
+void CommandAllocator::read_timestamp_queries(
+    const TimestampQueries &queries, Span<TimestampQueryResult> results) const {
+  ren_assert(results.size() == queries.count);
+  if (queries.count == 0) {
+    return;
+  }
+  VkResult result = vkGetQueryPoolResults(
+      m_renderer->get_device(), queries.pool, queries.base, queries.count,
+      results.size_bytes(), results.data(), sizeof(TimestampQueryResult),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (result != VK_NOT_READY) {
+    throw_if_failed(result, "Vulkan: Failed to get query pool results");
+  }
 }
 
 void CommandAllocator::reset() {
-  throw_if_failed(vkResetCommandPool(m_renderer->get_device(), m_pool, 0),
-                  "Vulkan: Failed to reset command pool");
-  m_allocated_count = 0;
+  for (Pool *pool : {&m_graphics_pool, &m_compute_pool}) {
+    if (!pool->pool) {
+      continue;
+    }
+    throw_if_failed(
+        vkResetCommandPool(m_renderer->get_device(), pool->pool, 0),
+        "Vulkan: Failed to reset command pool");
+    pool->allocated_count = 0;
+  }
+  for (VkEvent event : Span(m_events).subspan(0, m_allocated_event_count)) {
+    throw_if_failed(vkResetEvent(m_renderer->get_device(), event),
+                    "Vulkan: Failed to reset event");
+  }
+  m_allocated_event_count = 0;
+  for (QueryPool &pool : m_query_pools) {
+    if (pool.allocated_count > 0) {
+      vkResetQueryPool(m_renderer->get_device(), pool.pool, 0,
+                       pool.allocated_count);
+      pool.allocated_count = 0;
+    }
+  }
 }
 
 } // namespace ren
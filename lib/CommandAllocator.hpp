@@ -1,4 +1,5 @@
 #pragma once
+#include "Support/Span.hpp"
 #include "Support/Vector.hpp"
 
 #include <vulkan/vulkan.h>
@@ -7,15 +8,47 @@ namespace ren {
 
 class Renderer;
 
+/// Range of timestamp queries in a query pool.
+struct TimestampQueries {
+  VkQueryPool pool = nullptr;
+  u32 base = 0;
+  u32 count = 0;
+};
+
+/// Timestamp query result in the layout of VK_QUERY_RESULT_WITH_AVAILABILITY.
+struct TimestampQueryResult {
+  u64 timestamp = 0;
+  /// Non-zero if the timestamp was written.
+  u64 availability = 0;
+};
+
 class CommandAllocator {
+  struct Pool {
+    VkCommandPool pool = nullptr;
+    Vector<VkCommandBuffer> cmd_buffers;
+    unsigned allocated_count = 0;
+  };
+
   Renderer *m_renderer = nullptr;
-  VkCommandPool m_pool = nullptr;
-  Vector<VkCommandBuffer> m_cmd_buffers;
-  unsigned m_allocated_count = 0;
+  Pool m_graphics_pool;
+  /// Pool of the async compute queue if the renderer has one.
+  Pool m_compute_pool;
+  Vector<VkEvent> m_events;
+  unsigned m_allocated_event_count = 0;
+
+  struct QueryPool {
+    VkQueryPool pool = nullptr;
+    u32 capacity = 0;
+    u32 allocated_count = 0;
+  };
+
+  Vector<QueryPool> m_query_pools;
 
 private:
   void destroy();
 
+  auto allocate(Pool &pool) -> VkCommandBuffer;
+
 public:
   explicit CommandAllocator(Renderer &renderer);
   CommandAllocator(const CommandAllocator &) = delete;
@@ -26,6 +59,18 @@ public:
 
   auto allocate() -> VkCommandBuffer;
 
+  auto allocate_compute() -> VkCommandBuffer;
+
+  auto allocate_event() -> VkEvent;
+
+  auto allocate_timestamp_queries(u32 count) -> TimestampQueries;
+
+  /// Reads timestamps from queries that were allocated since the last reset.
+  /// Must only be called after all commands that write them have completed.
+  /// Queries that weren't written have zero availability.
+  void read_timestamp_queries(const TimestampQueries &queries,
+                              Span<TimestampQueryResult> results) const;
+
   void reset();
 };
 
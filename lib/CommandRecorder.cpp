@@ -215,6 +215,27 @@ void CommandRecorder::pipeline_barrier(
   pipeline_barrier(dependency);
 }
 
+void CommandRecorder::set_event(VkEvent event,
+                                const VkDependencyInfo &dependency_info) {
+  vkCmdSetEvent2(m_cmd_buffer, event, &dependency_info);
+}
+
+void CommandRecorder::wait_events(
+    TempSpan<const VkEvent> events,
+    TempSpan<const VkDependencyInfo> dependency_infos) {
+  ren_assert(events.size() == dependency_infos.size());
+  if (events.empty()) {
+    return;
+  }
+  vkCmdWaitEvents2(m_cmd_buffer, events.size(), events.data(),
+                   dependency_infos.data());
+}
+
+void CommandRecorder::write_timestamp(VkPipelineStageFlags2 stage,
+                                      VkQueryPool pool, u32 query) {
+  vkCmdWriteTimestamp2(m_cmd_buffer, stage, pool, query);
+}
+
 auto CommandRecorder::render_pass(const RenderPassBeginInfo &&begin_info)
     -> RenderPass {
   return RenderPass(*m_renderer, m_cmd_buffer, std::move(begin_info));
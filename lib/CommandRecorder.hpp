@@ -151,6 +151,14 @@ public:
   void pipeline_barrier(TempSpan<const VkMemoryBarrier2> barriers,
                         TempSpan<const VkImageMemoryBarrier2> image_barriers);
 
+  void set_event(VkEvent event, const VkDependencyInfo &dependency_info);
+
+  void wait_events(TempSpan<const VkEvent> events,
+                   TempSpan<const VkDependencyInfo> dependency_infos);
+
+  void write_timestamp(VkPipelineStageFlags2 stage, VkQueryPool pool,
+                       u32 query);
+
   auto debug_region(const char *label) -> DebugRegion;
 };
 
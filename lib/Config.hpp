@@ -12,6 +12,7 @@ namespace ren {
 constexpr VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
 constexpr VkFormat SDR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
 constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+constexpr VkFormat VISIBILITY_BUFFER_FORMAT = VK_FORMAT_R32G32_UINT;
 constexpr usize MAX_COLOR_ATTACHMENTS = 8;
 
 constexpr usize DESCRIPTOR_TYPE_COUNT = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1;
@@ -0,0 +1,364 @@
+#include "CpuCulling.hpp"
+#include "Support/Assert.hpp"
+#include "Support/Math.hpp"
+#include "Support/Views.hpp"
+#include "glsl/InstanceCullingAndLODPass.h"
+#include "glsl/MeshletCullingPass.h"
+
+#include <bit>
+#include <thread>
+
+#if defined(__SSE2__) or defined(_M_X64) or defined(_M_AMD64)
+#define REN_CPU_CULLING_SSE2 1
+#include <emmintrin.h>
+#else
+#define REN_CPU_CULLING_SSE2 0
+#endif
+
+namespace ren {
+
+namespace {
+
+using MeshletBuckets = std::array<Vector<glsl::MeshletCullData>,
+                                  glsl::NUM_MESHLET_CULLING_BUCKETS>;
+
+struct CpuCullingWorkerResult {
+  MeshletBuckets meshlet_buckets;
+  Vector<glsl::DrawIndexedIndirectCommand> commands;
+  CpuCullingStatistics statistics;
+};
+
+auto get_num_threads(u32 num_threads, usize num_items) -> u32 {
+  if (num_threads == 0) {
+    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  // Don't spawn threads for tiny chunks.
+  constexpr usize MIN_CHUNK_SIZE = 256;
+  usize max_num_threads = std::max<usize>(num_items / MIN_CHUNK_SIZE, 1);
+  return u32(std::min<usize>(num_threads, max_num_threads));
+}
+
+/// Splits [0, num_items) into num_threads contiguous chunks and calls
+/// cb(thread, begin, end) for each of them.
+template <typename F>
+void parallel_for(u32 num_threads, usize num_items, const F &cb) {
+  if (num_threads <= 1) {
+    cb(0, 0, num_items);
+    return;
+  }
+  Vector<std::jthread> workers;
+  workers.reserve(num_threads - 1);
+  usize chunk_size = ceil_div(num_items, usize(num_threads));
+  for (u32 t : range<u32>(1, num_threads)) {
+    usize begin = std::min(t * chunk_size, num_items);
+    usize end = std::min(begin + chunk_size, num_items);
+    workers.emplace_back([&cb, t, begin, end] { cb(t, begin, end); });
+  }
+  cb(0, 0, std::min(chunk_size, num_items));
+}
+
+constexpr u32 CULLING_SIMD_WIDTH = 4;
+
+/// Bounding boxes that are frustum culled together, one per SIMD lane, and
+/// the matrices that project them to clip space.
+struct CullingBatch {
+  std::array<glm::mat4, CULLING_SIMD_WIDTH> pvms;
+  std::array<glsl::PositionBoundingBox, CULLING_SIMD_WIDTH> bbs;
+  u32 size = 0;
+};
+
+/// Returns a mask with bit i set if bounding box i of the batch is outside of
+/// the view volume. Same as glsl::cull_cs_bb(glsl::project_bb_to_cs(...)) for
+/// each box, including the order of floating point operations.
+auto cull_batch(const CullingBatch &batch) -> u32 {
+  if (batch.size == 0) {
+    return 0;
+  }
+#if REN_CPU_CULLING_SSE2
+  // Unused lanes repeat the first box and are masked out at the end.
+  auto load = [&](auto get) {
+    alignas(16) std::array<float, CULLING_SIMD_WIDTH> values;
+    for (u32 i : range(CULLING_SIMD_WIDTH)) {
+      values[i] = get(i < batch.size ? i : 0);
+    }
+    return _mm_load_ps(values.data());
+  };
+
+  __m128 m[4][4];
+  for (int c : range(4)) {
+    for (int r : range(4)) {
+      m[c][r] = load([&](u32 i) { return batch.pvms[i][c][r]; });
+    }
+  }
+
+  __m128 bb_min[3];
+  __m128 bb_size[3];
+  for (int k : range(3)) {
+    bb_min[k] =
+        load([&](u32 i) { return float(batch.bbs[i].min.position[k]); });
+    __m128 bb_max =
+        load([&](u32 i) { return float(batch.bbs[i].max.position[k]); });
+    bb_size[k] = _mm_sub_ps(bb_max, bb_min[k]);
+  }
+
+  // p[0] = pvm * vec4(bb.min, 1), summed in the same order as GLM does.
+  std::array<std::array<__m128, 4>, 8> p;
+  for (int r : range(4)) {
+    p[0][r] = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(m[0][r], bb_min[0]),
+                   _mm_mul_ps(m[1][r], bb_min[1])),
+        _mm_add_ps(_mm_mul_ps(m[2][r], bb_min[2]), m[3][r]));
+    __m128 px = _mm_mul_ps(m[0][r], bb_size[0]);
+    __m128 py = _mm_mul_ps(m[1][r], bb_size[1]);
+    __m128 pz = _mm_mul_ps(m[2][r], bb_size[2]);
+    p[1][r] = _mm_add_ps(p[0][r], px);
+    p[2][r] = _mm_add_ps(p[1][r], py);
+    p[3][r] = _mm_add_ps(p[0][r], py);
+    p[4][r] = _mm_add_ps(p[0][r], pz);
+    p[5][r] = _mm_add_ps(p[1][r], pz);
+    p[6][r] = _mm_add_ps(p[2][r], pz);
+    p[7][r] = _mm_add_ps(p[3][r], pz);
+  }
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 left = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  __m128 right = left;
+  __m128 bottom = left;
+  __m128 top = left;
+  __m128 behind_far = left;
+  __m128 before_near = left;
+  for (const std::array<__m128, 4> &corner : p) {
+    __m128 w = corner[3];
+    __m128 neg_w = _mm_xor_ps(w, sign);
+    left = _mm_and_ps(left, _mm_cmplt_ps(corner[0], neg_w));
+    right = _mm_and_ps(right, _mm_cmpgt_ps(corner[0], w));
+    bottom = _mm_and_ps(bottom, _mm_cmplt_ps(corner[1], neg_w));
+    top = _mm_and_ps(top, _mm_cmpgt_ps(corner[1], w));
+    behind_far = _mm_and_ps(behind_far, _mm_cmplt_ps(corner[2], zero));
+    before_near = _mm_and_ps(before_near, _mm_cmpgt_ps(corner[2], w));
+  }
+  __m128 culled = _mm_or_ps(_mm_or_ps(_mm_or_ps(left, right),
+                                      _mm_or_ps(bottom, top)),
+                            _mm_or_ps(behind_far, before_near));
+  return u32(_mm_movemask_ps(culled)) & ((1u << batch.size) - 1);
+#else
+  u32 mask = 0;
+  for (u32 i : range(batch.size)) {
+    if (glsl::cull_cs_bb(
+            glsl::project_bb_to_cs(batch.pvms[i], batch.bbs[i]))) {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+void cull_instances(const CpuCullingConfig &cfg,
+                    Span<const CpuCullingMesh> meshes,
+                    Span<const glm::mat4x3> transform_matrices,
+                    Span<const u32> instance_meshes,
+                    Span<const u32> instance_mesh_instances,
+                    CpuCullingWorkerResult &result) {
+  const bool frustum_culling =
+      cfg.instance_feature_mask & glsl::INSTANCE_CULLING_AND_LOD_FRUSTUM_BIT;
+  const bool lod_selection = cfg.instance_feature_mask &
+                             glsl::INSTANCE_CULLING_AND_LOD_LOD_SELECTION_BIT;
+
+  usize num_instances = instance_meshes.size();
+  for (usize base = 0; base < num_instances; base += CULLING_SIMD_WIDTH) {
+    CullingBatch batch;
+    batch.size = u32(std::min<usize>(CULLING_SIMD_WIDTH, num_instances - base));
+    for (u32 i : range(batch.size)) {
+      batch.pvms[i] =
+          cfg.proj_view *
+          glm::mat4(transform_matrices[instance_mesh_instances[base + i]]);
+      batch.bbs[i] = meshes[instance_meshes[base + i]].mesh.bb;
+    }
+
+    u32 culled = frustum_culling ? cull_batch(batch) : 0;
+
+    for (u32 i : range(batch.size)) {
+      result.statistics.num_instances++;
+      if (culled & (1 << i)) {
+        result.statistics.num_culled_instances++;
+        continue;
+      }
+      u32 mesh_index = instance_meshes[base + i];
+      u32 mesh_instance = instance_mesh_instances[base + i];
+      const glsl::Mesh &mesh = meshes[mesh_index].mesh;
+
+      // Frustum culling is already done, so this only selects the LOD.
+      i32 l = glsl::cull_and_select_lod(batch.pvms[i], mesh, false,
+                                        lod_selection,
+                                        cfg.lod_triangle_density);
+      l = glm::clamp(l - cfg.lod_bias, 0, i32(mesh.num_lods - 1));
+      const glsl::MeshLOD &lod = mesh.lods[l];
+
+      u32 base_meshlet = lod.base_meshlet;
+      u32 num_meshlets = lod.num_meshlets;
+      while (num_meshlets != 0) {
+        u32 bucket = std::countr_zero(num_meshlets);
+        u32 bucket_stride = 1 << bucket;
+        result.meshlet_buckets[bucket].push_back({
+            .mesh = mesh_index,
+            .mesh_instance = mesh_instance,
+            .base_meshlet = base_meshlet,
+        });
+        base_meshlet += bucket_stride;
+        num_meshlets &= ~bucket_stride;
+      }
+    }
+  }
+}
+
+void cull_meshlets(const CpuCullingConfig &cfg,
+                   Span<const CpuCullingMesh> meshes,
+                   Span<const glm::mat4x3> transform_matrices, u32 bucket,
+                   Span<const glsl::MeshletCullData> bucket_cull_data,
+                   CpuCullingWorkerResult &result) {
+  const bool cone_culling =
+      cfg.meshlet_feature_mask & glsl::MESHLET_CULLING_CONE_BIT;
+  const bool frustum_culling =
+      cfg.meshlet_feature_mask & glsl::MESHLET_CULLING_FRUSTUM_BIT;
+  const u32 bucket_stride = 1 << bucket;
+
+  // Meshlets of all entries in the bucket are culled in one stream, so that
+  // small buckets still fill all SIMD lanes.
+  CullingBatch batch;
+  std::array<const glsl::Meshlet *, CULLING_SIMD_WIDTH> batch_meshlets;
+  std::array<u32, CULLING_SIMD_WIDTH> batch_mesh_instances;
+
+  auto flush_batch = [&] {
+    u32 culled = frustum_culling ? cull_batch(batch) : 0;
+    for (u32 i : range(batch.size)) {
+      const glsl::Meshlet &meshlet = *batch_meshlets[i];
+      u32 mesh_instance = batch_mesh_instances[i];
+      result.statistics.num_meshlets++;
+      if ((culled & (1 << i)) or
+          glsl::cull_meshlet(transform_matrices[mesh_instance], cfg.proj_view,
+                             cfg.eye, meshlet, cone_culling, false)) {
+        result.statistics.num_culled_meshlets++;
+        continue;
+      }
+      result.statistics.num_triangles += meshlet.num_triangles;
+      result.commands.push_back({
+          .num_indices = meshlet.num_triangles * 3,
+          .num_instances = 1,
+          .base_index = meshlet.base_triangle,
+          .base_vertex = meshlet.base_index,
+          .base_instance = mesh_instance,
+      });
+    }
+    batch.size = 0;
+  };
+
+  for (const glsl::MeshletCullData &cull_data : bucket_cull_data) {
+    const CpuCullingMesh &mesh = meshes[cull_data.mesh];
+    glm::mat4 pvm = cfg.proj_view *
+                    glm::mat4(transform_matrices[cull_data.mesh_instance]);
+    for (u32 offset : range(bucket_stride)) {
+      const glsl::Meshlet &meshlet =
+          mesh.meshlets[cull_data.base_meshlet + offset];
+      batch.pvms[batch.size] = pvm;
+      batch.bbs[batch.size] = meshlet.bb;
+      batch_meshlets[batch.size] = &meshlet;
+      batch_mesh_instances[batch.size] = cull_data.mesh_instance;
+      batch.size++;
+      if (batch.size == CULLING_SIMD_WIDTH) {
+        flush_batch();
+      }
+    }
+  }
+  flush_batch();
+}
+
+void merge_statistics(CpuCullingStatistics &dst,
+                      const CpuCullingStatistics &src) {
+  dst.num_instances += src.num_instances;
+  dst.num_culled_instances += src.num_culled_instances;
+  dst.num_meshlets += src.num_meshlets;
+  dst.num_culled_meshlets += src.num_culled_meshlets;
+  dst.num_triangles += src.num_triangles;
+}
+
+} // namespace
+
+auto cpu_cull(const CpuCullingConfig &cfg, Span<const CpuCullingMesh> meshes,
+              Span<const glm::mat4x3> transform_matrices,
+              const CpuCullingInstances &instances) -> CpuCullingResult {
+  ren_assert(instances.meshes.size() == instances.mesh_instances.size());
+  usize num_instances = instances.meshes.size();
+
+  CpuCullingResult result;
+
+  {
+    u32 num_threads = get_num_threads(cfg.num_threads, num_instances);
+    SmallVector<CpuCullingWorkerResult, 1> workers(num_threads);
+    parallel_for(num_threads, num_instances,
+                 [&](u32 t, usize begin, usize end) {
+                   cull_instances(
+                       cfg, meshes, transform_matrices,
+                       instances.meshes.subspan(begin, end - begin),
+                       instances.mesh_instances.subspan(begin, end - begin),
+                       workers[t]);
+                 });
+    // Concatenate in thread order so that the result is deterministic.
+    for (const CpuCullingWorkerResult &worker : workers) {
+      for (u32 bucket : range(glsl::NUM_MESHLET_CULLING_BUCKETS)) {
+        result.meshlet_buckets[bucket].append(worker.meshlet_buckets[bucket]);
+      }
+      merge_statistics(result.statistics, worker.statistics);
+    }
+  }
+
+  // MeshPass reserves space for buckets based on the number of meshlets in
+  // the highest LOD of each instance.
+  u32 num_draw_meshlets = 0;
+  for (u32 mesh : instances.meshes) {
+    num_draw_meshlets += meshes[mesh].mesh.lods[0].num_meshlets;
+  }
+
+  u32 buckets_size = 0;
+  for (u32 bucket : range(glsl::NUM_MESHLET_CULLING_BUCKETS)) {
+    u32 bucket_size = result.meshlet_buckets[bucket].size();
+    u32 bucket_capacity = glsl::get_meshlet_culling_bucket_size(
+        u32(num_instances), num_draw_meshlets, bucket);
+    ren_assert(bucket_size <= bucket_capacity);
+    u32 bucket_stride = 1 << bucket;
+    result.meshlet_bucket_offsets[bucket] = buckets_size;
+    result.meshlet_bucket_commands[bucket] = {
+        .x = ceil_div(bucket_size * bucket_stride,
+                      glsl::MESHLET_CULLING_THREADS),
+        .y = 1,
+        .z = 1,
+    };
+    buckets_size += bucket_capacity;
+  }
+
+  for (u32 bucket : range(glsl::NUM_MESHLET_CULLING_BUCKETS)) {
+    Span<const glsl::MeshletCullData> bucket_cull_data =
+        result.meshlet_buckets[bucket];
+    u32 num_threads = get_num_threads(
+        cfg.num_threads, bucket_cull_data.size() * (usize(1) << bucket));
+    num_threads = u32(std::min<usize>(num_threads, bucket_cull_data.size()));
+    if (num_threads == 0) {
+      continue;
+    }
+    SmallVector<CpuCullingWorkerResult, 1> workers(num_threads);
+    parallel_for(num_threads, bucket_cull_data.size(),
+                 [&](u32 t, usize begin, usize end) {
+                   cull_meshlets(cfg, meshes, transform_matrices, bucket,
+                                 bucket_cull_data.subspan(begin, end - begin),
+                                 workers[t]);
+                 });
+    for (const CpuCullingWorkerResult &worker : workers) {
+      result.commands.append(worker.commands);
+      merge_statistics(result.statistics, worker.statistics);
+    }
+  }
+
+  return result;
+}
+
+} // namespace ren
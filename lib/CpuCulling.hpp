@@ -0,0 +1,75 @@
+#pragma once
+#include "Support/Span.hpp"
+#include "Support/StdDef.hpp"
+#include "Support/Vector.hpp"
+#include "glsl/Culling.h"
+#include "glsl/Indirect.h"
+
+#include <array>
+
+namespace ren {
+
+/// Host copy of the data that culling reads from a mesh. Device pointers in
+/// `mesh` are ignored.
+struct CpuCullingMesh {
+  glsl::Mesh mesh = {};
+  Span<const glsl::Meshlet> meshlets;
+};
+
+/// Instance data in structure-of-arrays layout. Both arrays have one element
+/// per instance.
+struct CpuCullingInstances {
+  /// Index of each instance's mesh
+  Span<const u32> meshes;
+  /// Index of each instance's transform matrix
+  Span<const u32> mesh_instances;
+};
+
+struct CpuCullingConfig {
+  /// Combination of INSTANCE_CULLING_AND_LOD_*_BIT flags
+  u32 instance_feature_mask = 0;
+  /// Combination of MESHLET_CULLING_*_BIT flags
+  u32 meshlet_feature_mask = 0;
+  glm::mat4 proj_view = glm::mat4(1.0f);
+  /// Eye position in homogeneous coordinates
+  glm::vec4 eye = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  float lod_triangle_density = 0.0f;
+  i32 lod_bias = 0;
+  /// Number of worker threads, 0 to use all hardware threads
+  u32 num_threads = 1;
+};
+
+struct CpuCullingStatistics {
+  u32 num_instances = 0;
+  u32 num_culled_instances = 0;
+  u32 num_meshlets = 0;
+  u32 num_culled_meshlets = 0;
+  u32 num_triangles = 0;
+};
+
+struct CpuCullingResult {
+  std::array<Vector<glsl::MeshletCullData>, glsl::NUM_MESHLET_CULLING_BUCKETS>
+      meshlet_buckets;
+  std::array<glsl::DispatchIndirectCommand,
+             glsl::NUM_MESHLET_CULLING_BUCKETS>
+      meshlet_bucket_commands = {};
+  /// Offsets of buckets in the meshlet cull data buffer. These are the same
+  /// as in MeshPass and only depend on the number of instances and the number
+  /// of meshlets in their highest LODs.
+  std::array<u32, glsl::NUM_MESHLET_CULLING_BUCKETS> meshlet_bucket_offsets =
+      {};
+  /// Draw commands in bucket order. The GPU emits the same set of commands,
+  /// but in an unspecified order.
+  Vector<glsl::DrawIndexedIndirectCommand> commands;
+  CpuCullingStatistics statistics;
+};
+
+/// Host reference implementation of InstanceCullingAndLOD.comp followed by
+/// MeshletCulling.comp. Instances are split into contiguous chunks between
+/// worker threads and each thread frustum culls 4 bounding boxes at a time
+/// with SIMD. Results don't depend on the number of threads.
+auto cpu_cull(const CpuCullingConfig &cfg, Span<const CpuCullingMesh> meshes,
+              Span<const glm::mat4x3> transform_matrices,
+              const CpuCullingInstances &instances) -> CpuCullingResult;
+
+} // namespace ren
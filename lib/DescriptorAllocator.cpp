@@ -1,5 +1,6 @@
 #include "DescriptorAllocator.hpp"
 #include "Renderer.hpp"
+#include "Support/Views.hpp"
 
 namespace ren {
 
@@ -24,15 +25,7 @@ auto DescriptorAllocator::allocate_sampler(
   VkDescriptorImageInfo image = {
       .sampler = renderer.get_sampler(sampler).handle,
   };
-  renderer.write_descriptor_sets({{
-      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-      .dstSet = m_set,
-      .dstBinding = glsl::SAMPLERS_SLOT,
-      .dstArrayElement = index,
-      .descriptorCount = 1,
-      .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
-      .pImageInfo = &image,
-  }});
+  write(glsl::SAMPLERS_SLOT, index, VK_DESCRIPTOR_TYPE_SAMPLER, image);
 
   return glsl::SamplerState(index);
 };
@@ -49,15 +42,7 @@ auto DescriptorAllocator::try_allocate_sampler(
   VkDescriptorImageInfo image = {
       .sampler = renderer.get_sampler(sampler).handle,
   };
-  renderer.write_descriptor_sets({{
-      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-      .dstSet = m_set,
-      .dstBinding = glsl::SAMPLERS_SLOT,
-      .dstArrayElement = index,
-      .descriptorCount = 1,
-      .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
-      .pImageInfo = &image,
-  }});
+  write(glsl::SAMPLERS_SLOT, index, VK_DESCRIPTOR_TYPE_SAMPLER, image);
 
   return id;
 };
@@ -83,15 +68,7 @@ auto DescriptorAllocator::allocate_texture(
       .imageView = renderer.getVkImageView(view),
       .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
   };
-  renderer.write_descriptor_sets({{
-      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-      .dstSet = m_set,
-      .dstBinding = glsl::TEXTURES_SLOT,
-      .dstArrayElement = index,
-      .descriptorCount = 1,
-      .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-      .pImageInfo = &image,
-  }});
+  write(glsl::TEXTURES_SLOT, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, image);
 
   return glsl::Texture(index);
 };
@@ -111,15 +88,8 @@ auto DescriptorAllocator::allocate_sampled_texture(
       .imageView = renderer.getVkImageView(view),
       .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
   };
-  renderer.write_descriptor_sets({{
-      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-      .dstSet = m_set,
-      .dstBinding = glsl::SAMPLED_TEXTURES_SLOT,
-      .dstArrayElement = index,
-      .descriptorCount = 1,
-      .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-      .pImageInfo = &image,
-  }});
+  write(glsl::SAMPLED_TEXTURES_SLOT, index,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image);
 
   return glsl::SampledTexture(index);
 };
@@ -137,15 +107,8 @@ auto DescriptorAllocator::allocate_storage_texture(
       .imageView = renderer.getVkImageView(view),
       .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
   };
-  renderer.write_descriptor_sets({{
-      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-      .dstSet = m_set,
-      .dstBinding = glsl::STORAGE_TEXTURES_SLOT,
-      .dstArrayElement = index,
-      .descriptorCount = 1,
-      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-      .pImageInfo = &image,
-  }});
+  write(glsl::STORAGE_TEXTURES_SLOT, index, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        image);
 
   return glsl::RWStorageTexture(index);
 };
@@ -154,6 +117,35 @@ void DescriptorAllocator::free_storage_texture(glsl::RWStorageTexture texture) {
   m_storage_textures.free(unsigned(texture));
 }
 
+void DescriptorAllocator::write(u32 binding, u32 index, VkDescriptorType type,
+                                const VkDescriptorImageInfo &image) {
+  m_images.push_back(image);
+  m_writes.push_back({
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = m_set,
+      .dstBinding = binding,
+      .dstArrayElement = index,
+      .descriptorCount = 1,
+      .descriptorType = type,
+  });
+}
+
+auto DescriptorAllocator::flush(Renderer &renderer) -> u32 {
+  ren_assert(m_writes.size() == m_images.size());
+  u32 num_writes = m_writes.size();
+  if (num_writes == 0) {
+    return 0;
+  }
+  // Image infos might have been reallocated, so patch pointers to them in.
+  for (usize i : range(m_writes.size())) {
+    m_writes[i].pImageInfo = &m_images[i];
+  }
+  renderer.write_descriptor_sets(m_writes);
+  m_writes.clear();
+  m_images.clear();
+  return num_writes;
+}
+
 DescriptorAllocatorScope::DescriptorAllocatorScope(DescriptorAllocator &alloc) {
   m_alloc = &alloc;
 }
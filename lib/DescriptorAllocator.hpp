@@ -1,6 +1,7 @@
 #pragma once
-#include "FreeListAllocator.hpp"
+#include "IndexAllocator.hpp"
 #include "Support/GenIndex.hpp"
+#include "Support/Vector.hpp"
 #include "glsl/Texture.h"
 
 #include <vulkan/vulkan.h>
@@ -16,10 +17,13 @@ struct TextureView;
 class DescriptorAllocator {
   VkDescriptorSet m_set = nullptr;
   Handle<DescriptorSetLayout> m_layout;
-  FreeListAllocator m_samplers;
-  FreeListAllocator m_textures;
-  FreeListAllocator m_sampled_textures;
-  FreeListAllocator m_storage_textures;
+  IndexAllocator m_samplers;
+  IndexAllocator m_textures;
+  IndexAllocator m_sampled_textures;
+  IndexAllocator m_storage_textures;
+  /// Descriptor writes that are deferred until the next flush.
+  Vector<VkWriteDescriptorSet> m_writes;
+  Vector<VkDescriptorImageInfo> m_images;
 
 public:
   DescriptorAllocator(VkDescriptorSet set, Handle<DescriptorSetLayout> layout);
@@ -54,6 +58,15 @@ public:
       -> glsl::RWStorageTexture;
 
   void free_storage_texture(glsl::RWStorageTexture texture);
+
+  /// Writes descriptors that were allocated since the last flush with a single
+  /// update. Must be called before they are used on the GPU. Returns the
+  /// number of descriptors that were written.
+  auto flush(Renderer &renderer) -> u32;
+
+private:
+  void write(u32 binding, u32 index, VkDescriptorType type,
+             const VkDescriptorImageInfo &image);
 };
 
 class DescriptorAllocatorScope {
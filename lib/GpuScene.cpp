@@ -1,4 +1,5 @@
 #include "GpuScene.hpp"
+#include "ResourceArena.hpp"
 #include "glsl/Lighting.h"
 #include "glsl/Material.h"
 #include "glsl/Mesh.h"
@@ -15,6 +16,7 @@ auto init_gpu_scene(ResourceArena &arena) -> GpuScene {
                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
       .count = MAX_NUM_MESHES,
+      .owner = MemoryOwner::GpuScene,
   })};
   gpu_scene.mesh_instances = {arena.create_buffer<glsl::MeshInstance>({
       .name = "Scene mesh instances",
@@ -23,6 +25,7 @@ auto init_gpu_scene(ResourceArena &arena) -> GpuScene {
                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
       .count = MAX_NUM_MESH_INSTANCES,
+      .owner = MemoryOwner::GpuScene,
   })};
   gpu_scene.materials = {arena.create_buffer<glsl::Material>({
       .name = "Scene materials",
@@ -31,6 +34,7 @@ auto init_gpu_scene(ResourceArena &arena) -> GpuScene {
                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
       .count = MAX_NUM_MATERIALS,
+      .owner = MemoryOwner::GpuScene,
   })};
   gpu_scene.directional_lights = {arena.create_buffer<glsl::DirectionalLight>({
       .name = "Scene directional lights",
@@ -39,6 +43,7 @@ auto init_gpu_scene(ResourceArena &arena) -> GpuScene {
                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
       .count = MAX_NUM_DIRECTIONAL_LIGHTS,
+      .owner = MemoryOwner::GpuScene,
   })};
   return gpu_scene;
 }
@@ -5,6 +5,8 @@
 
 namespace ren {
 
+class ResourceArena;
+
 namespace glsl {
 struct Mesh;
 struct Material;
@@ -28,6 +30,8 @@ struct RgGpuScene {
   RgBufferId<glm::mat3> normal_matrices;
   RgBufferId<glsl::Material> materials;
   RgBufferId<glsl::DirectionalLight> directional_lights;
+  /// Screen area of each mesh instance in the previous frame.
+  RgBufferId<float> mesh_instance_screen_areas;
 };
 
 } // namespace ren
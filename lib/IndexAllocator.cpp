@@ -0,0 +1,75 @@
+#include "IndexAllocator.hpp"
+#include "Support/Assert.hpp"
+
+#include <bit>
+
+namespace ren {
+
+namespace {
+
+constexpr u32 BITS = 64;
+
+constexpr auto bit(u32 idx) -> u64 { return u64(1) << (idx % BITS); }
+
+} // namespace
+
+auto IndexAllocator::allocate() -> u32 {
+  if (!m_root) {
+    grow(m_leaves.size() + 1);
+  }
+  u32 node = std::countr_zero(m_root);
+  u32 leaf = node * BITS + std::countr_zero(m_nodes[node]);
+  u32 idx = leaf * BITS + std::countr_zero(m_leaves[leaf]);
+  set_allocated(idx);
+  return idx;
+}
+
+auto IndexAllocator::allocate(u32 idx) -> u32 {
+  ren_assert(idx <= MAX_INDEX);
+  grow(idx / BITS + 1);
+  if (!(m_leaves[idx / BITS] & bit(idx))) {
+    return 0;
+  }
+  set_allocated(idx);
+  return idx;
+}
+
+void IndexAllocator::free(u32 idx) {
+  ren_assert(idx);
+  u32 leaf = idx / BITS;
+  u32 node = leaf / BITS;
+  ren_assert(leaf < m_leaves.size());
+  ren_assert(!(m_leaves[leaf] & bit(idx)));
+  m_leaves[leaf] |= bit(idx);
+  m_nodes[node] |= bit(leaf);
+  m_root |= bit(node);
+}
+
+void IndexAllocator::grow(u32 num_leaves) {
+  ren_assert(num_leaves <= BITS * BITS);
+  while (m_leaves.size() < num_leaves) {
+    u32 leaf = m_leaves.size();
+    u32 node = leaf / BITS;
+    // Reserve index 0.
+    m_leaves.push_back(leaf == 0 ? ~bit(0) : ~u64(0));
+    if (node == m_nodes.size()) {
+      m_nodes.push_back(0);
+    }
+    m_nodes[node] |= bit(leaf);
+    m_root |= bit(node);
+  }
+}
+
+void IndexAllocator::set_allocated(u32 idx) {
+  u32 leaf = idx / BITS;
+  u32 node = leaf / BITS;
+  m_leaves[leaf] &= ~bit(idx);
+  if (!m_leaves[leaf]) {
+    m_nodes[node] &= ~bit(leaf);
+    if (!m_nodes[node]) {
+      m_root &= ~bit(node);
+    }
+  }
+}
+
+} // namespace ren
@@ -0,0 +1,37 @@
+#pragma once
+#include "Support/StdDef.hpp"
+#include "Support/Vector.hpp"
+
+namespace ren {
+
+/// Allocates indices from a 3-level bitmap. Each level tracks which words of
+/// the level below have free bits, so allocating the lowest free index and
+/// freeing an index take a constant number of word operations. Index 0 is
+/// never allocated.
+class IndexAllocator {
+public:
+  static constexpr u32 MAX_INDEX = 64 * 64 * 64 - 1;
+
+  /// Returns the lowest free index.
+  auto allocate() -> u32;
+
+  /// Returns the index if it was free, or 0 otherwise.
+  auto allocate(u32 idx) -> u32;
+
+  void free(u32 idx);
+
+private:
+  void grow(u32 num_leaves);
+
+  void set_allocated(u32 idx);
+
+private:
+  /// Bit i of leaf j is set if index 64 * j + i is free.
+  Vector<u64> m_leaves;
+  /// Bit i of node j is set if leaf 64 * j + i has free indices.
+  Vector<u64> m_nodes;
+  /// Bit i is set if node i has free indices.
+  u64 m_root = 0;
+};
+
+} // namespace ren
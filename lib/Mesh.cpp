@@ -11,8 +11,10 @@ auto create_index_pool(ResourceArena &arena) -> IndexPool {
                          .name = "Mesh vertex indices pool",
                          .heap = BufferHeap::Static,
                          .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                  VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                  VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                          .size = sizeof(u8) * pool.num_free_indices,
+                         .owner = MemoryOwner::MeshData,
                      })
                      .buffer;
 
@@ -48,6 +48,7 @@ auto create_index_pool(ResourceArena &arena) -> IndexPool;
 struct MeshInstance {
   Handle<Mesh> mesh;
   Handle<Material> material;
+  bool occluder = false;
 };
 
 } // namespace ren
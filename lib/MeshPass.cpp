@@ -6,6 +6,7 @@
 #include "glsl/InstanceCullingAndLODPass.h"
 #include "glsl/MeshletCullingPass.h"
 #include "glsl/OpaquePass.h"
+#include "glsl/VisibilityBufferPass.h"
 
 #include <fmt/format.h>
 
@@ -21,15 +22,37 @@ MeshPassClass::Instance::Instance(MeshPassClass &cls,
   m_color_attachment_ops = begin_info.color_attachment_ops;
   m_class->m_color_attachment_names = begin_info.color_attachment_names;
 
-  m_depth_attachment = begin_info.depth_attachment;
-  m_depth_attachment_ops = begin_info.depth_attachment_ops;
-  m_class->m_depth_attachment_name = begin_info.depth_attachment_name;
-
   m_pipelines = begin_info.pipelines;
 
   m_scene = begin_info.scene;
-  m_camera = begin_info.camera;
-  m_viewport = begin_info.viewport;
+
+  ren_assert(begin_info.extra_views.size() < glsl::MAX_NUM_CULLING_VIEWS);
+  ren_assert_msg(begin_info.extra_views.empty() or m_color_attachments.empty(),
+                 "Extra views are only supported for depth-only passes");
+  m_views.push_back({
+      .camera = begin_info.camera,
+      .viewport = begin_info.viewport,
+      .depth_attachment = begin_info.depth_attachment,
+      .depth_attachment_ops = begin_info.depth_attachment_ops,
+  });
+  m_class->m_depth_attachment_names.clear();
+  m_class->m_depth_attachment_names.push_back(
+      String(begin_info.depth_attachment_name));
+  for (const MeshPassView &view : begin_info.extra_views) {
+    m_views.push_back({
+        .camera = view.camera,
+        .viewport = view.viewport,
+        .depth_attachment = view.depth_attachment,
+        .depth_attachment_ops = begin_info.depth_attachment_ops,
+    });
+    m_class->m_depth_attachment_names.push_back(
+        String(view.depth_attachment_name));
+  }
+
+  ren_assert(not(begin_info.occluders_only and begin_info.write_screen_areas));
+  m_occluders_only = begin_info.occluders_only;
+  m_min_occluder_screen_area = begin_info.min_occluder_screen_area;
+  m_write_screen_areas = begin_info.write_screen_areas;
 
   m_gpu_scene = begin_info.gpu_scene;
 
@@ -39,50 +62,58 @@ MeshPassClass::Instance::Instance(MeshPassClass &cls,
 void MeshPassClass::Instance::Instance::record_culling(
     RgBuilder &rgb, const CullingConfig &cfg) {
   u32 num_instances = cfg.draw->instances.size();
+  u32 num_views = m_views.size();
 
   u32 buckets_size = 0;
   std::array<u32, glsl::NUM_MESHLET_CULLING_BUCKETS> bucket_offsets;
   for (u32 bucket : range(glsl::NUM_MESHLET_CULLING_BUCKETS)) {
     bucket_offsets[bucket] = buckets_size;
-    u32 bucket_stride = 1 << bucket;
-    u32 bucket_size =
-        std::min(num_instances, cfg.draw->num_meshlets / bucket_stride);
-    buckets_size += bucket_size;
+    buckets_size += glsl::get_meshlet_culling_bucket_size(
+        num_instances, cfg.draw->num_meshlets, bucket);
   }
 
   auto meshlet_bucket_commands =
       rgb.create_buffer<glsl::DispatchIndirectCommand>({
           .heap = BufferHeap::Static,
-          .size = glsl::NUM_MESHLET_CULLING_BUCKETS,
+          .size = num_views * glsl::NUM_MESHLET_CULLING_BUCKETS,
       });
 
   auto meshlet_bucket_sizes = rgb.create_buffer<u32>({
       .heap = BufferHeap::Static,
-      .size = glsl::NUM_MESHLET_CULLING_BUCKETS,
+      .size = num_views * glsl::NUM_MESHLET_CULLING_BUCKETS,
   });
 
   auto meshlet_cull_data = rgb.create_buffer<glsl::MeshletCullData>({
       .heap = BufferHeap::Static,
-      .size = buckets_size,
+      .size = num_views * buckets_size,
   });
 
+  // A view can't draw more meshlets than there are in the highest LOD of all
+  // of its instances.
+  u32 num_view_commands = cfg.draw->num_meshlets;
   *cfg.commands = rgb.create_buffer<glsl::DrawIndexedIndirectCommand>({
       .heap = BufferHeap::Static,
-      .size = usize(m_scene->settings.num_draw_meshlets),
+      .size = num_views * num_view_commands,
   });
 
-  *cfg.command_count = rgb.create_buffer<u32>({.heap = BufferHeap::Static});
+  *cfg.command_count = rgb.create_buffer<u32>({
+      .heap = BufferHeap::Static,
+      .size = num_views,
+  });
 
   {
     auto pass = rgb.create_pass(
         {.name = fmt::format("{}-init-culling", m_class->m_pass_name)});
 
     struct {
-      RgUntypedBufferToken meshlet_bucket_commands;
+      RgBufferToken<glsl::DispatchIndirectCommand> meshlet_bucket_commands;
       RgUntypedBufferToken meshlet_bucket_sizes;
       RgUntypedBufferToken meshlet_draw_command_count;
+      u32 num_views;
     } rcs;
 
+    rcs.num_views = num_views;
+
     std::tie(meshlet_bucket_commands, rcs.meshlet_bucket_commands) =
         pass.write_buffer("init-meshlet-bucket-commands",
                           meshlet_bucket_commands, TRANSFER_DST_BUFFER);
@@ -102,7 +133,13 @@ void MeshPassClass::Instance::Instance::record_culling(
           commands;
       std::ranges::fill(commands,
                         glsl::DispatchIndirectCommand{.x = 0, .y = 1, .z = 1});
-      cmd.update_buffer(rg.get_buffer(rcs.meshlet_bucket_commands), commands);
+      for (u32 view : range(rcs.num_views)) {
+        cmd.update_buffer(
+            BufferView(rg.get_buffer(rcs.meshlet_bucket_commands)
+                           .slice(view * glsl::NUM_MESHLET_CULLING_BUCKETS,
+                                  glsl::NUM_MESHLET_CULLING_BUCKETS)),
+            commands);
+      }
 
       cmd.fill_buffer(rg.get_buffer(rcs.meshlet_bucket_sizes), 0);
 
@@ -125,6 +162,7 @@ void MeshPassClass::Instance::Instance::record_culling(
       RgBufferToken<glsl::DispatchIndirectCommand> meshlet_bucket_commands;
       RgBufferToken<u32> meshlet_bucket_sizes;
       RgBufferToken<glsl::MeshletCullData> meshlet_cull_data;
+      RgBufferToken<float> screen_areas;
     } rcs;
 
     rcs.pipeline = m_pipelines->instance_culling_and_lod;
@@ -152,6 +190,16 @@ void MeshPassClass::Instance::Instance::record_culling(
     std::tie(meshlet_cull_data, rcs.meshlet_cull_data) = pass.write_buffer(
         "meshlet-cull-data", meshlet_cull_data, CS_WRITE_BUFFER);
 
+    if (m_occluders_only) {
+      rcs.screen_areas = pass.read_buffer(
+          m_gpu_scene.mesh_instance_screen_areas, CS_READ_BUFFER);
+    } else if (m_write_screen_areas) {
+      std::tie(m_gpu_scene.mesh_instance_screen_areas, rcs.screen_areas) =
+          pass.write_buffer("mesh-instance-screen-areas",
+                            m_gpu_scene.mesh_instance_screen_areas,
+                            CS_WRITE_BUFFER);
+    }
+
     const SceneGraphicsSettings &settings = m_scene->settings;
 
     u32 feature_mask = 0;
@@ -161,9 +209,12 @@ void MeshPassClass::Instance::Instance::record_culling(
     if (settings.lod_selection) {
       feature_mask |= glsl::INSTANCE_CULLING_AND_LOD_LOD_SELECTION_BIT;
     }
-    float num_viewport_triangles =
-        m_viewport.x * m_viewport.y / settings.lod_triangle_pixels;
-    float lod_triangle_density = num_viewport_triangles / 4.0f;
+    if (m_occluders_only) {
+      feature_mask |= glsl::INSTANCE_CULLING_AND_LOD_OCCLUDERS_BIT;
+    }
+    if (m_write_screen_areas) {
+      feature_mask |= glsl::INSTANCE_CULLING_AND_LOD_WRITE_SCREEN_AREAS_BIT;
+    }
     i32 lod_bias = settings.lod_bias;
 
     auto [uniforms, uniforms_ptr, _2] =
@@ -172,11 +223,21 @@ void MeshPassClass::Instance::Instance::record_culling(
     *uniforms = {
         .feature_mask = feature_mask,
         .num_instances = num_instances,
-        .proj_view = get_projection_view_matrix(m_camera, m_viewport),
-        .lod_triangle_density = lod_triangle_density,
+        .num_views = num_views,
         .lod_bias = lod_bias,
+        .min_occluder_screen_area = m_min_occluder_screen_area,
         .meshlet_bucket_offsets = bucket_offsets,
+        .meshlet_cull_data_view_stride = buckets_size,
     };
+    for (u32 v : range(num_views)) {
+      const View &view = m_views[v];
+      float num_viewport_triangles =
+          view.viewport.x * view.viewport.y / settings.lod_triangle_pixels;
+      uniforms->views[v] = {
+          .proj_view = get_projection_view_matrix(view.camera, view.viewport),
+          .lod_triangle_density = num_viewport_triangles / 4.0f,
+      };
+    }
     rcs.uniforms = uniforms_ptr;
 
     pass.set_compute_callback([rcs](Renderer &, const RgRuntime &rg,
@@ -195,6 +256,9 @@ void MeshPassClass::Instance::Instance::record_culling(
           .meshlet_bucket_sizes =
               rg.get_buffer_device_ptr(rcs.meshlet_bucket_sizes),
           .meshlet_cull_data = rg.get_buffer_device_ptr(rcs.meshlet_cull_data),
+          .screen_areas = rcs.screen_areas
+                              ? rg.get_buffer_device_ptr(rcs.screen_areas)
+                              : DevicePtr<float>(),
       });
       cmd.dispatch_threads(rcs.num_instances,
                            glsl::INSTANCE_CULLING_AND_LOD_THREADS);
@@ -216,8 +280,10 @@ void MeshPassClass::Instance::Instance::record_culling(
       RgBufferToken<u32> meshlet_draw_command_count;
       u32 feature_mask;
       std::array<u32, glsl::NUM_MESHLET_CULLING_BUCKETS> bucket_offsets;
-      glm::vec3 eye;
-      glm::mat4 proj_view;
+      u32 cull_data_view_stride;
+      u32 num_view_commands;
+      StaticVector<glm::vec4, glsl::MAX_NUM_CULLING_VIEWS> eyes;
+      StaticVector<glm::mat4, glsl::MAX_NUM_CULLING_VIEWS> proj_views;
     } rcs;
 
     rcs.pipeline = m_pipelines->meshlet_culling;
@@ -253,74 +319,92 @@ void MeshPassClass::Instance::Instance::record_culling(
     }
 
     rcs.bucket_offsets = bucket_offsets;
-    rcs.eye = m_camera.position;
-    rcs.proj_view = get_projection_view_matrix(m_camera, m_viewport);
-
-    pass.set_compute_callback(
-        [rcs](Renderer &, const RgRuntime &rg, ComputePass &pass) {
-          pass.bind_compute_pipeline(rcs.pipeline);
-          for (u32 bucket : range(glsl::NUM_MESHLET_CULLING_BUCKETS)) {
-            pass.set_push_constants(glsl::MeshletCullingPassArgs{
-                .meshes = rg.get_buffer_device_ptr(rcs.meshes),
-                .transform_matrices =
-                    rg.get_buffer_device_ptr(rcs.transform_matrices),
-                .bucket_cull_data =
-                    rg.get_buffer_device_ptr(rcs.meshlet_cull_data) +
-                    rcs.bucket_offsets[bucket],
-                .bucket_size =
-                    rg.get_buffer_device_ptr(rcs.meshlet_bucket_sizes) + bucket,
-                .commands = rg.get_buffer_device_ptr(rcs.meshlet_draw_commands),
-                .num_commands =
-                    rg.get_buffer_device_ptr(rcs.meshlet_draw_command_count),
-                .feature_mask = rcs.feature_mask,
-                .bucket = bucket,
-                .eye = rcs.eye,
-                .proj_view = rcs.proj_view,
-            });
-            pass.dispatch_indirect(
-                rg.get_buffer(rcs.meshlet_bucket_commands).slice(bucket));
-          }
-        });
+    rcs.cull_data_view_stride = buckets_size;
+    rcs.num_view_commands = num_view_commands;
+    for (const View &view : m_views) {
+      rcs.eyes.push_back(get_homogeneous_eye_position(view.camera));
+      rcs.proj_views.push_back(
+          get_projection_view_matrix(view.camera, view.viewport));
+    }
+
+    pass.set_compute_callback([rcs](Renderer &, const RgRuntime &rg,
+                                    ComputePass &pass) {
+      pass.bind_compute_pipeline(rcs.pipeline);
+      for (u32 view : range<u32>(rcs.proj_views.size())) {
+        for (u32 bucket : range(glsl::NUM_MESHLET_CULLING_BUCKETS)) {
+          u32 view_bucket = view * glsl::NUM_MESHLET_CULLING_BUCKETS + bucket;
+          pass.set_push_constants(glsl::MeshletCullingPassArgs{
+              .meshes = rg.get_buffer_device_ptr(rcs.meshes),
+              .transform_matrices =
+                  rg.get_buffer_device_ptr(rcs.transform_matrices),
+              .bucket_cull_data =
+                  rg.get_buffer_device_ptr(rcs.meshlet_cull_data) +
+                  view * rcs.cull_data_view_stride + rcs.bucket_offsets[bucket],
+              .bucket_size =
+                  rg.get_buffer_device_ptr(rcs.meshlet_bucket_sizes) +
+                  view_bucket,
+              .commands = rg.get_buffer_device_ptr(rcs.meshlet_draw_commands) +
+                          view * rcs.num_view_commands,
+              .num_commands =
+                  rg.get_buffer_device_ptr(rcs.meshlet_draw_command_count) +
+                  view,
+              .feature_mask = rcs.feature_mask,
+              .bucket = bucket,
+              .eye = rcs.eyes[view],
+              .proj_view = rcs.proj_views[view],
+          });
+          pass.dispatch_indirect(
+              rg.get_buffer(rcs.meshlet_bucket_commands).slice(view_bucket, 1));
+        }
+      }
+    });
   }
 }
 
+void MeshPassClass::Instance::add_to_batch(
+    Batches &batches, Handle<GraphicsPipeline> pipeline,
+    Handle<MeshInstance> handle, const MeshInstance &mesh_instance) const {
+  const Mesh &mesh = m_scene->meshes.get(mesh_instance.mesh);
+  BatchDesc batch = {
+      .pipeline = pipeline,
+      .index_buffer = m_scene->index_pools[mesh.index_pool].indices,
+  };
+  auto it = batches.find(batch);
+  [[unlikely]] if (it == batches.end()) {
+    it = batches.insert(it, batch, {});
+  }
+  u32 num_meshlets = mesh.lods[0].num_meshlets;
+  auto &batch_draws = it->second;
+  [[unlikely]] if (batch_draws.empty()) { batch_draws.emplace_back(); }
+  BatchDraw *draw = &batch_draws.back();
+  [[unlikely]] if (draw->instances.size() == m_scene->settings.draw_size or
+                   draw->num_meshlets + num_meshlets >
+                       m_scene->settings.num_draw_meshlets) {
+    draw = &batch_draws.emplace_back();
+  }
+  draw->num_meshlets += num_meshlets;
+  draw->instances.push_back({
+      .mesh = mesh_instance.mesh,
+      .mesh_instance = handle,
+      .flags = mesh_instance.occluder ? glsl::INSTANCE_CULL_OCCLUDER_BIT : 0,
+  });
+}
+
 DepthOnlyMeshPassClass::Instance::Instance(DepthOnlyMeshPassClass &cls,
                                            const BeginInfo &begin_info)
     : MeshPassClass::Instance::Instance(cls, begin_info.base) {}
 
 void DepthOnlyMeshPassClass::Instance::Instance::build_batches(
     Batches &batches) {
-  Handle<GraphicsPipeline> pipeline = m_pipelines->early_z_pass;
-
   for (const auto &[h, mesh_instance] : m_scene->mesh_instances) {
-    const Mesh &mesh = m_scene->meshes.get(mesh_instance.mesh);
-    BatchDesc batch = {
-        .pipeline = pipeline,
-        .index_buffer = m_scene->index_pools[mesh.index_pool].indices,
-    };
-    auto it = batches.find(batch);
-    [[unlikely]] if (it == batches.end()) {
-      it = batches.insert(it, batch, {});
-    }
-    u32 num_meshlets = mesh.lods[0].num_meshlets;
-    auto &batch_draws = it->second;
-    [[unlikely]] if (batch_draws.empty()) { batch_draws.emplace_back(); }
-    BatchDraw *draw = &batch_draws.back();
-    [[unlikely]] if (draw->instances.size() == m_scene->settings.draw_size or
-                     draw->num_meshlets + num_meshlets >
-                         m_scene->settings.num_draw_meshlets) {
-      draw = &batch_draws.emplace_back();
-    }
-    draw->num_meshlets += num_meshlets;
-    draw->instances.push_back({
-        .mesh = mesh_instance.mesh,
-        .mesh_instance = h,
-    });
+    add_to_batch(batches, m_pipelines->early_z_pass, h, mesh_instance);
   }
 }
 
 auto DepthOnlyMeshPassClass::Instance::get_render_pass_resources(
-    RgPassBuilder &pass) -> RenderPassResources {
+    RgPassBuilder &pass, const RenderPassConfig &cfg) -> RenderPassResources {
+  const View &view = m_views[cfg.view];
+
   RenderPassResources rcs;
 
   rcs.meshes = pass.read_buffer(m_gpu_scene.meshes, VS_READ_BUFFER);
@@ -328,7 +412,7 @@ auto DepthOnlyMeshPassClass::Instance::get_render_pass_resources(
       pass.read_buffer(m_gpu_scene.mesh_instances, VS_READ_BUFFER);
   rcs.transform_matrices =
       pass.read_buffer(m_gpu_scene.transform_matrices, VS_READ_BUFFER);
-  rcs.proj_view = get_projection_view_matrix(m_camera, m_viewport);
+  rcs.proj_view = get_projection_view_matrix(view.camera, view.viewport);
 
   return rcs;
 }
@@ -344,11 +428,69 @@ void DepthOnlyMeshPassClass::Instance::bind_render_pass_resources(
   });
 }
 
+VisibilityBufferMeshPassClass::Instance::Instance(
+    VisibilityBufferMeshPassClass &cls, const BeginInfo &begin_info)
+    : MeshPassClass::Instance::Instance(cls, begin_info.base) {
+  ren_assert(m_views.size() == 1);
+  m_draws = begin_info.draws;
+  m_draws->clear();
+}
+
+void VisibilityBufferMeshPassClass::Instance::build_batches(
+    Batches &batches) {
+  for (const auto &[h, mesh_instance] : m_scene->mesh_instances) {
+    add_to_batch(batches, m_pipelines->visibility_buffer_pass, h,
+                 mesh_instance);
+  }
+}
+
+auto VisibilityBufferMeshPassClass::Instance::get_render_pass_resources(
+    RgPassBuilder &pass, const RenderPassConfig &cfg) -> RenderPassResources {
+  const View &view = m_views[cfg.view];
+
+  RenderPassResources rcs;
+
+  rcs.meshes = pass.read_buffer(m_gpu_scene.meshes, VS_READ_BUFFER);
+  rcs.mesh_instances =
+      pass.read_buffer(m_gpu_scene.mesh_instances, VS_READ_BUFFER);
+  rcs.transform_matrices =
+      pass.read_buffer(m_gpu_scene.transform_matrices, VS_READ_BUFFER);
+  rcs.proj_view = get_projection_view_matrix(view.camera, view.viewport);
+  rcs.draw = cfg.draw;
+
+  ren_assert(cfg.draw == m_draws->size());
+  m_draws->push_back({
+      .commands = cfg.commands,
+      .base_command = cfg.view * cfg.num_commands,
+      .indices = cfg.batch->index_buffer,
+  });
+
+  return rcs;
+}
+
+void VisibilityBufferMeshPassClass::Instance::bind_render_pass_resources(
+    const RgRuntime &rg, RenderPass &render_pass,
+    const RenderPassResources &rcs) {
+  render_pass.set_push_constants(glsl::VisibilityBufferPassArgs{
+      .meshes = rg.get_buffer_device_ptr(rcs.meshes),
+      .mesh_instances = rg.get_buffer_device_ptr(rcs.mesh_instances),
+      .transform_matrices = rg.get_buffer_device_ptr(rcs.transform_matrices),
+      .proj_view = rcs.proj_view,
+      .draw = rcs.draw,
+  });
+}
+
 OpaqueMeshPassClass::Instance::Instance(OpaqueMeshPassClass &cls,
                                         const BeginInfo &begin_info)
     : MeshPassClass::Instance::Instance(cls, begin_info.base) {
   m_exposure = begin_info.exposure;
   m_exposure_temporal_layer = begin_info.exposure_temporal_layer;
+  ren_assert(begin_info.shadow_maps.size() ==
+             begin_info.shadow_proj_views.size());
+  m_shadow_maps = begin_info.shadow_maps;
+  m_shadow_proj_views = begin_info.shadow_proj_views;
+  m_shadow_map_sampler = begin_info.shadow_map_sampler;
+  m_shadowed_directional_light = begin_info.shadowed_directional_light;
 }
 
 void OpaqueMeshPassClass::Instance::build_batches(Batches &batches) {
@@ -367,33 +509,16 @@ void OpaqueMeshPassClass::Instance::build_batches(Batches &batches) {
       attributes |= MeshAttribute::Color;
     }
 
-    BatchDesc batch = {
-        .pipeline = m_pipelines->opaque_pass[i32(attributes.get())],
-        .index_buffer = m_scene->index_pools[mesh.index_pool].indices,
-    };
-    auto it = batches.find(batch);
-    [[unlikely]] if (it == batches.end()) {
-      it = batches.insert(it, batch, {});
-    }
-    u32 num_meshlets = mesh.lods[0].num_meshlets;
-    auto &batch_draws = it->second;
-    [[unlikely]] if (batch_draws.empty()) { batch_draws.emplace_back(); }
-    BatchDraw *draw = &batch_draws.back();
-    [[unlikely]] if (draw->instances.size() == m_scene->settings.draw_size or
-                     draw->num_meshlets + num_meshlets >
-                         m_scene->settings.num_draw_meshlets) {
-      draw = &batch_draws.emplace_back();
-    }
-    draw->num_meshlets += num_meshlets;
-    draw->instances.push_back({
-        .mesh = mesh_instance.mesh,
-        .mesh_instance = h,
-    });
+    add_to_batch(batches, m_pipelines->opaque_pass[i32(attributes.get())], h,
+                 mesh_instance);
   }
 }
 
 auto OpaqueMeshPassClass::Instance::get_render_pass_resources(
-    RgPassBuilder &pass) const -> RenderPassResources {
+    RgPassBuilder &pass, const RenderPassConfig &cfg) const
+    -> RenderPassResources {
+  const View &view = m_views[cfg.view];
+
   RenderPassResources rcs;
 
   rcs.meshes = pass.read_buffer(m_gpu_scene.meshes, VS_READ_BUFFER);
@@ -408,10 +533,16 @@ auto OpaqueMeshPassClass::Instance::get_render_pass_resources(
       pass.read_buffer(m_gpu_scene.directional_lights, FS_READ_BUFFER);
   rcs.exposure =
       pass.read_texture(m_exposure, FS_READ_TEXTURE, m_exposure_temporal_layer);
+  for (RgTextureId shadow_map : m_shadow_maps) {
+    rcs.shadow_maps.push_back(pass.read_texture(shadow_map, FS_SAMPLE_TEXTURE,
+                                                m_shadow_map_sampler));
+  }
+  rcs.shadow_proj_views = m_shadow_proj_views;
 
-  rcs.proj_view = get_projection_view_matrix(m_camera, m_viewport);
-  rcs.eye = m_camera.position;
+  rcs.proj_view = get_projection_view_matrix(view.camera, view.viewport);
+  rcs.eye = view.camera.position;
   rcs.num_directional_lights = m_scene->directional_lights.size();
+  rcs.shadowed_directional_light = m_shadowed_directional_light;
 
   return rcs;
 };
@@ -428,7 +559,14 @@ void OpaqueMeshPassClass::Instance::bind_render_pass_resources(
       .transform_matrices = rg.get_buffer_device_ptr(rcs.transform_matrices),
       .normal_matrices = rg.get_buffer_device_ptr(rcs.normal_matrices),
       .proj_view = rcs.proj_view,
+      .num_shadow_cascades = u32(rcs.shadow_maps.size()),
+      .shadowed_directional_light = rcs.shadowed_directional_light,
   };
+  for (usize i : range(rcs.shadow_maps.size())) {
+    uniforms_host_ptr->shadow_proj_views[i] = rcs.shadow_proj_views[i];
+    uniforms_host_ptr->shadow_maps[i] = glsl::SampledTexture2D(
+        rg.get_sampled_texture_descriptor(rcs.shadow_maps[i]));
+  }
   render_pass.set_push_constants(glsl::OpaquePassArgs{
       .ub = uniforms_device_ptr,
       .materials = rg.get_buffer_device_ptr(rcs.materials),
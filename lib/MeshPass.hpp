@@ -9,8 +9,12 @@
 #include "RenderGraph.hpp"
 #include "Renderer.hpp"
 #include "Support/NotNull.hpp"
+#include "Support/Views.hpp"
 #include "glsl/Culling.h"
 #include "glsl/Indirect.h"
+#include "glsl/Lighting.h"
+
+#include <fmt/format.h>
 
 namespace ren {
 
@@ -48,7 +52,15 @@ protected:
 
   String m_pass_name;
   StaticVector<String, 8> m_color_attachment_names;
-  String m_depth_attachment_name;
+  StaticVector<String, glsl::MAX_NUM_CULLING_VIEWS> m_depth_attachment_names;
+};
+
+/// Additional view that is culled together with the main view of a mesh pass.
+struct MeshPassView {
+  Camera camera;
+  glm::uvec2 viewport = {};
+  NotNull<RgTextureId *> depth_attachment;
+  StringView depth_attachment_name;
 };
 
 struct MeshPassClass::BeginInfo {
@@ -68,6 +80,19 @@ struct MeshPassClass::BeginInfo {
   Camera camera;
   glm::uvec2 viewport = {};
 
+  /// Extra views share instance culling with the main view and are rendered
+  /// with the same depth attachment operations. Only supported for passes
+  /// without color attachments.
+  TempSpan<const MeshPassView> extra_views;
+
+  /// Only draw flagged occluders and instances that covered at least
+  /// min_occluder_screen_area of the screen in the previous frame.
+  bool occluders_only = false;
+  float min_occluder_screen_area = 0.0f;
+  /// Store each instance's screen area in the main view for the next frame's
+  /// occluder-only passes.
+  bool write_screen_areas = false;
+
   RgGpuScene gpu_scene;
 
   NotNull<UploadBumpAllocator *> upload_allocator;
@@ -95,6 +120,7 @@ protected:
       num_draws += draws.size();
     }
 
+    u32 draw_index = 0;
     for (const auto &[batch, draws] : batches) {
       for (const BatchDraw &draw : draws) {
         RgBufferId<glsl::DrawIndexedIndirectCommand> commands;
@@ -104,11 +130,31 @@ protected:
                                      .commands = &commands,
                                      .command_count = &command_count,
                                  });
-        self.record_render_pass(rgb, batch, commands, command_count);
+        for (u32 view : range<u32>(self.m_views.size())) {
+          self.record_render_pass(rgb, RenderPassConfig{
+                                           .batch = &batch,
+                                           .draw = draw_index,
+                                           .view = view,
+                                           .num_commands = draw.num_meshlets,
+                                           .commands = commands,
+                                           .command_count = command_count,
+                                       });
+        }
+        draw_index++;
       }
     }
   };
 
+  struct View {
+    Camera camera;
+    glm::uvec2 viewport = {};
+    RgTextureId *depth_attachment = nullptr;
+    DepthAttachmentOperations depth_attachment_ops;
+  };
+
+  /// Culling writes commands and command counts for all views into the same
+  /// buffers. View i's commands start at i * draw->num_meshlets and its count
+  /// is at index i.
   struct CullingConfig {
     NotNull<const BatchDraw *> draw;
     NotNull<RgBufferId<glsl::DrawIndexedIndirectCommand> *> commands;
@@ -117,11 +163,33 @@ protected:
 
   void record_culling(RgBuilder &rgb, const CullingConfig &cfg);
 
+  /// Adds a mesh instance to the last draw of the batch that uses the given
+  /// pipeline and the instance's index buffer, or to a new draw if the last
+  /// one is full.
+  void add_to_batch(Batches &batches, Handle<GraphicsPipeline> pipeline,
+                    Handle<MeshInstance> handle,
+                    const MeshInstance &mesh_instance) const;
+
+  struct RenderPassConfig {
+    NotNull<const BatchDesc *> batch;
+    /// Index of the draw in the order in which draws are recorded.
+    u32 draw = 0;
+    u32 view = 0;
+    u32 num_commands = 0;
+    RgBufferId<glsl::DrawIndexedIndirectCommand> commands;
+    RgBufferId<u32> command_count;
+  };
+
   template <typename Self>
   void record_render_pass(this Self &self, RgBuilder &rgb,
-                          const BatchDesc &batch, RgUntypedBufferId commands,
-                          RgUntypedBufferId command_count) {
-    auto pass = rgb.create_pass({.name = self.m_class->m_pass_name});
+                          const RenderPassConfig &cfg) {
+    View &view = self.m_views[cfg.view];
+
+    auto pass = rgb.create_pass({
+        .name = self.m_views.size() == 1
+                    ? self.m_class->m_pass_name
+                    : fmt::format("{}-{}", self.m_class->m_pass_name, cfg.view),
+    });
 
     for (usize i = 0; i < self.m_color_attachments.size(); ++i) {
       NotNull<RgTextureId *> color_attachment = self.m_color_attachments[i];
@@ -134,42 +202,48 @@ protected:
       ops.load = VK_ATTACHMENT_LOAD_OP_LOAD;
     }
 
-    if (*self.m_depth_attachment) {
-      if (self.m_depth_attachment_ops.store == VK_ATTACHMENT_STORE_OP_NONE) {
-        pass.read_depth_attachment(*self.m_depth_attachment);
+    if (*view.depth_attachment) {
+      if (view.depth_attachment_ops.store == VK_ATTACHMENT_STORE_OP_NONE) {
+        pass.read_depth_attachment(*view.depth_attachment);
       } else {
-        std::tie(*self.m_depth_attachment, std::ignore) =
-            pass.write_depth_attachment(self.m_class->m_depth_attachment_name,
-                                        *self.m_depth_attachment,
-                                        self.m_depth_attachment_ops);
-        self.m_depth_attachment_ops.load = VK_ATTACHMENT_LOAD_OP_LOAD;
+        std::tie(*view.depth_attachment, std::ignore) =
+            pass.write_depth_attachment(
+                self.m_class->m_depth_attachment_names[cfg.view],
+                *view.depth_attachment, view.depth_attachment_ops);
+        view.depth_attachment_ops.load = VK_ATTACHMENT_LOAD_OP_LOAD;
       }
     }
 
     struct {
       Handle<GraphicsPipeline> pipeline;
       Handle<Buffer> indices;
-      RgUntypedBufferToken commands;
-      RgUntypedBufferToken command_count;
+      RgBufferToken<glsl::DrawIndexedIndirectCommand> commands;
+      RgBufferToken<u32> command_count;
+      u32 view;
+      u32 num_commands;
       typename Self::RenderPassResources ext;
     } rcs;
 
-    rcs.pipeline = batch.pipeline;
-    rcs.indices = batch.index_buffer;
+    rcs.pipeline = cfg.batch->pipeline;
+    rcs.indices = cfg.batch->index_buffer;
 
-    rcs.commands = pass.read_buffer(commands, INDIRECT_COMMAND_SRC_BUFFER);
+    rcs.commands = pass.read_buffer(cfg.commands, INDIRECT_COMMAND_SRC_BUFFER);
     rcs.command_count =
-        pass.read_buffer(command_count, INDIRECT_COMMAND_SRC_BUFFER);
+        pass.read_buffer(cfg.command_count, INDIRECT_COMMAND_SRC_BUFFER);
+    rcs.view = cfg.view;
+    rcs.num_commands = cfg.num_commands;
 
-    rcs.ext = self.get_render_pass_resources(pass);
+    rcs.ext = self.get_render_pass_resources(pass, cfg);
 
     pass.set_graphics_callback([rcs](Renderer &, const RgRuntime &rg,
                                      RenderPass &render_pass) {
       render_pass.bind_graphics_pipeline(rcs.pipeline);
       render_pass.bind_index_buffer(rcs.indices, VK_INDEX_TYPE_UINT8_EXT);
       Self::bind_render_pass_resources(rg, render_pass, rcs.ext);
-      render_pass.draw_indexed_indirect_count(rg.get_buffer(rcs.commands),
-                                              rg.get_buffer(rcs.command_count));
+      render_pass.draw_indexed_indirect_count(
+          BufferView(rg.get_buffer(rcs.commands)
+                         .slice(rcs.view * rcs.num_commands, rcs.num_commands)),
+          BufferView(rg.get_buffer(rcs.command_count).slice(rcs.view, 1)));
     });
   }
 
@@ -179,8 +253,12 @@ protected:
   const Pipelines *m_pipelines = nullptr;
 
   const SceneData *m_scene = nullptr;
-  Camera m_camera;
-  glm::uvec2 m_viewport = {};
+  /// The first view is the pass's main view.
+  StaticVector<View, glsl::MAX_NUM_CULLING_VIEWS> m_views;
+
+  bool m_occluders_only = false;
+  float m_min_occluder_screen_area = 0.0f;
+  bool m_write_screen_areas = false;
 
   RgGpuScene m_gpu_scene;
 
@@ -188,9 +266,6 @@ protected:
 
   StaticVector<NotNull<RgTextureId *>, 8> m_color_attachments;
   StaticVector<ColorAttachmentOperations, 8> m_color_attachment_ops;
-
-  RgTextureId *m_depth_attachment = nullptr;
-  DepthAttachmentOperations m_depth_attachment_ops;
 };
 
 class DepthOnlyMeshPassClass : public MeshPassClass {
@@ -220,11 +295,63 @@ private:
     glm::mat4 proj_view;
   };
 
-  auto get_render_pass_resources(RgPassBuilder &pass) -> RenderPassResources;
+  auto get_render_pass_resources(RgPassBuilder &pass,
+                                 const RenderPassConfig &cfg)
+      -> RenderPassResources;
+
+  static void bind_render_pass_resources(const RgRuntime &rg,
+                                         RenderPass &render_pass,
+                                         const RenderPassResources &rcs);
+};
+
+class VisibilityBufferMeshPassClass : public MeshPassClass {
+public:
+  struct BeginInfo;
+
+private:
+  friend class MeshPassClass;
+  class Instance;
+};
+
+/// Draw commands and index pool of a visibility buffer pass draw. Visibility
+/// buffer texels reference draws by their index.
+struct RgVisibilityBufferDraw {
+  RgBufferId<glsl::DrawIndexedIndirectCommand> commands;
+  u32 base_command = 0;
+  Handle<Buffer> indices;
+};
+
+struct VisibilityBufferMeshPassClass::BeginInfo {
+  MeshPassClass::BeginInfo base;
+  NotNull<Vector<RgVisibilityBufferDraw> *> draws;
+};
+
+class VisibilityBufferMeshPassClass::Instance
+    : public MeshPassClass::Instance {
+private:
+  friend class MeshPassClass;
+  Instance(VisibilityBufferMeshPassClass &cls, const BeginInfo &begin_info);
+
+  void build_batches(Batches &batches);
+
+  struct RenderPassResources {
+    RgBufferToken<glsl::Mesh> meshes;
+    RgBufferToken<glsl::MeshInstance> mesh_instances;
+    RgBufferToken<glm::mat4x3> transform_matrices;
+    glm::mat4 proj_view;
+    u32 draw = 0;
+  };
+
+  auto get_render_pass_resources(RgPassBuilder &pass,
+                                 const RenderPassConfig &cfg)
+      -> RenderPassResources;
 
   static void bind_render_pass_resources(const RgRuntime &rg,
                                          RenderPass &render_pass,
                                          const RenderPassResources &rcs);
+
+private:
+  Vector<RgVisibilityBufferDraw> *m_draws = nullptr;
 };
 
 class OpaqueMeshPassClass : public MeshPassClass {
@@ -240,6 +367,10 @@ struct OpaqueMeshPassClass::BeginInfo {
   MeshPassClass::BeginInfo base;
   RgTextureId exposure;
   u32 exposure_temporal_layer = 0;
+  TempSpan<const RgTextureId> shadow_maps;
+  TempSpan<const glm::mat4> shadow_proj_views;
+  Handle<Sampler> shadow_map_sampler;
+  u32 shadowed_directional_light = 0;
 };
 
 class OpaqueMeshPassClass::Instance : public MeshPassClass::Instance {
@@ -257,13 +388,17 @@ private:
     RgBufferToken<glsl::Material> materials;
     RgBufferToken<glsl::DirectionalLight> directional_lights;
     RgTextureToken exposure;
+    StaticVector<RgTextureToken, glsl::MAX_NUM_SHADOW_CASCADES> shadow_maps;
+    StaticVector<glm::mat4, glsl::MAX_NUM_SHADOW_CASCADES> shadow_proj_views;
     glm::mat4 proj_view;
     glm::vec3 eye;
     u32 num_directional_lights = 0;
+    u32 shadowed_directional_light = 0;
   };
 
-  auto
-  get_render_pass_resources(RgPassBuilder &pass) const -> RenderPassResources;
+  auto get_render_pass_resources(RgPassBuilder &pass,
+                                 const RenderPassConfig &cfg) const
+      -> RenderPassResources;
 
   static void bind_render_pass_resources(const RgRuntime &rg,
                                          RenderPass &render_pass,
@@ -272,6 +407,10 @@ private:
 private:
   RgTextureId m_exposure;
   u32 m_exposure_temporal_layer = 0;
+  StaticVector<RgTextureId, glsl::MAX_NUM_SHADOW_CASCADES> m_shadow_maps;
+  StaticVector<glm::mat4, glsl::MAX_NUM_SHADOW_CASCADES> m_shadow_proj_views;
+  Handle<Sampler> m_shadow_map_sampler;
+  u32 m_shadowed_directional_light = 0;
 };
 
 } // namespace ren
@@ -0,0 +1,136 @@
+#include "Passes/FrameCapture.hpp"
+#include "CommandRecorder.hpp"
+#include "PipelineLoading.hpp"
+#include "RenderGraph.hpp"
+#include "Support/Math.hpp"
+#include "glsl/FrameCapturePass.h"
+
+namespace ren {
+
+auto get_frame_capture_layout(FrameCaptureFormat format,
+                              glm::uvec2 size) -> FrameCaptureLayout {
+  FrameCaptureLayout layout = {
+      .format = format,
+      .size = size,
+  };
+  switch (format) {
+  case FrameCaptureFormat::RGBA8: {
+    u32 stride = size.x * 4;
+    layout.planes.push_back({.size = stride * size.y, .stride = stride});
+  } break;
+  case FrameCaptureFormat::YUV420: {
+    u32 width = pad(size.x, glsl::FRAME_CAPTURE_BLOCK_SIZE_X);
+    u32 height = pad(size.y, glsl::FRAME_CAPTURE_BLOCK_SIZE_Y);
+    usize luma_size = width * height;
+    usize chroma_size = luma_size / 4;
+    layout.planes.push_back({.size = luma_size, .stride = width});
+    layout.planes.push_back({
+        .offset = luma_size,
+        .size = chroma_size,
+        .stride = width / 2,
+    });
+    layout.planes.push_back({
+        .offset = luma_size + chroma_size,
+        .size = chroma_size,
+        .stride = width / 2,
+    });
+  } break;
+  }
+  const FrameCapturePlaneLayout &last = layout.planes.back();
+  layout.size_bytes = last.offset + last.size;
+  return layout;
+}
+
+namespace {
+
+struct FrameCapturePassResources {
+  Handle<ComputePipeline> pipeline;
+  RgTextureToken src;
+  RgBufferToken<u32> data;
+  FrameCaptureLayout layout;
+};
+
+void run_frame_capture_pass(const RgRuntime &rg, ComputePass &pass,
+                            const FrameCapturePassResources &rcs) {
+  const FrameCaptureLayout &layout = rcs.layout;
+  glsl::FrameCapturePassArgs args = {
+      .data = rg.get_buffer_device_ptr(rcs.data),
+      .src = glsl::StorageTexture2D(rg.get_storage_texture_descriptor(rcs.src)),
+      .size = layout.size,
+  };
+  switch (layout.format) {
+  case FrameCaptureFormat::RGBA8: {
+    args.format = glsl::FRAME_CAPTURE_FORMAT_RGBA8;
+  } break;
+  case FrameCaptureFormat::YUV420: {
+    args.format = glsl::FRAME_CAPTURE_FORMAT_YUV420;
+    args.u_offset = layout.planes[1].offset / sizeof(u32);
+    args.v_offset = layout.planes[2].offset / sizeof(u32);
+  } break;
+  }
+
+  pass.bind_compute_pipeline(rcs.pipeline);
+  pass.bind_descriptor_sets({rg.get_texture_set()});
+  pass.set_push_constants(args);
+  glm::uvec2 num_blocks = {
+      ceil_div(layout.size.x, glsl::FRAME_CAPTURE_BLOCK_SIZE_X),
+      ceil_div(layout.size.y, glsl::FRAME_CAPTURE_BLOCK_SIZE_Y),
+  };
+  pass.dispatch_threads(
+      num_blocks,
+      {glsl::FRAME_CAPTURE_THREADS_X, glsl::FRAME_CAPTURE_THREADS_Y});
+}
+
+} // namespace
+
+void setup_frame_capture_passes(const PassCommonConfig &ccfg,
+                                const FrameCapturePassConfig &cfg) {
+  RgBuilder &rgb = *ccfg.rgb;
+
+  ren_assert(cfg.layout.size_bytes % sizeof(u32) == 0);
+  ren_assert(cfg.dst.size_bytes() == cfg.layout.size_bytes);
+
+  // Convert into device memory and copy the result to host memory instead of
+  // having the shader write to host memory.
+  FrameCapturePassResources rcs = {
+      .pipeline = ccfg.pipelines->frame_capture,
+      .layout = cfg.layout,
+  };
+
+  auto convert = rgb.create_pass({.name = "frame-capture-convert"});
+
+  rcs.src = convert.read_texture(cfg.src, CS_READ_TEXTURE);
+
+  auto data = rgb.create_buffer<u32>({
+      .heap = BufferHeap::Static,
+      .count = cfg.layout.size_bytes / sizeof(u32),
+  });
+  std::tie(data, rcs.data) =
+      convert.write_buffer("frame-capture-data", data, CS_WRITE_BUFFER);
+
+  convert.set_compute_callback(
+      [rcs](Renderer &, const RgRuntime &rg, ComputePass &pass) {
+        run_frame_capture_pass(rg, pass, rcs);
+      });
+
+  auto readback = rgb.create_buffer("frame-capture-readback",
+                                    StatefulBufferSlice<std::byte>{
+                                        .slice = cfg.dst,
+                                    });
+
+  auto copy = rgb.create_pass({.name = "frame-capture-readback"});
+
+  RgBufferToken<u32> src_token = copy.read_buffer(data, TRANSFER_SRC_BUFFER);
+
+  RgBufferToken<std::byte> dst_token;
+  std::tie(std::ignore, dst_token) = copy.write_buffer(
+      "frame-capture-readback-final", readback, TRANSFER_DST_BUFFER);
+
+  copy.set_callback(
+      [=](Renderer &, const RgRuntime &rg, CommandRecorder &cmd) {
+        cmd.copy_buffer(BufferView(rg.get_buffer(src_token)),
+                        rg.get_buffer(dst_token));
+      });
+}
+
+} // namespace ren
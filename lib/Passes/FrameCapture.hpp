@@ -0,0 +1,34 @@
+#pragma once
+#include "Pass.hpp"
+#include "Support/Vector.hpp"
+
+namespace ren {
+
+struct FrameCapturePlaneLayout {
+  usize offset = 0;
+  usize size = 0;
+  u32 stride = 0;
+};
+
+/// Layout of a captured frame in memory.
+struct FrameCaptureLayout {
+  FrameCaptureFormat format = {};
+  glm::uvec2 size = {};
+  StaticVector<FrameCapturePlaneLayout, 3> planes;
+  usize size_bytes = 0;
+};
+
+auto get_frame_capture_layout(FrameCaptureFormat format,
+                              glm::uvec2 size) -> FrameCaptureLayout;
+
+struct FrameCapturePassConfig {
+  RgTextureId src;
+  FrameCaptureLayout layout;
+  /// Host-visible buffer that the frame is copied to.
+  BufferView dst;
+};
+
+void setup_frame_capture_passes(const PassCommonConfig &ccfg,
+                                const FrameCapturePassConfig &cfg);
+
+} // namespace ren
@@ -7,8 +7,23 @@
 
 namespace ren {
 
-auto rg_import_gpu_scene(RgBuilder &rgb,
+auto rg_import_gpu_scene(const PassCommonConfig &ccfg,
                          const GpuScene &gpu_scene) -> RgGpuScene {
+  RgBuilder &rgb = *ccfg.rgb;
+
+  if (!ccfg.rcs->mesh_instance_screen_areas) {
+    ccfg.rcs->mesh_instance_screen_areas = ccfg.rgp->create_buffer<float>({
+        .name = "mesh-instance-screen-areas",
+        .count = MAX_NUM_MESH_INSTANCES,
+        .usage = TRANSFER_DST_BUFFER,
+        .cb =
+            [](const BufferView &buffer, Renderer &, CommandRecorder &cmd) {
+              // No mesh instances were visible before the buffer was created.
+              cmd.fill_buffer(buffer, 0.0f);
+            },
+    });
+  }
+
   return {
       .meshes = rgb.create_buffer("meshes", gpu_scene.meshes),
       .mesh_instances =
@@ -24,6 +39,8 @@ auto rg_import_gpu_scene(RgBuilder &rgb,
       .materials = rgb.create_buffer("materials", gpu_scene.materials),
       .directional_lights =
           rgb.create_buffer("directional-lights", gpu_scene.directional_lights),
+      .mesh_instance_screen_areas =
+          rgb.import_buffer(ccfg.rcs->mesh_instance_screen_areas),
   };
 }
 
@@ -52,10 +69,16 @@ void setup_gpu_scene_update_pass(const PassCommonConfig &ccfg,
   }
 
   RgBufferToken<glsl::MeshInstance> mesh_instances;
+  RgBufferToken<float> mesh_instance_screen_areas;
   if (not scene->update_mesh_instances.empty()) {
     std::tie(cfg.gpu_scene->mesh_instances, mesh_instances) =
         pass.write_buffer("mesh-instances-updated",
                           cfg.gpu_scene->mesh_instances, TRANSFER_DST_BUFFER);
+    std::tie(cfg.gpu_scene->mesh_instance_screen_areas,
+             mesh_instance_screen_areas) =
+        pass.write_buffer("mesh-instance-screen-areas-updated",
+                          cfg.gpu_scene->mesh_instance_screen_areas,
+                          TRANSFER_DST_BUFFER);
   }
 
   RgBufferToken<glm::mat4x3> transform_matrices;
@@ -105,6 +128,14 @@ void setup_gpu_scene_update_pass(const PassCommonConfig &ccfg,
       }
     }
 
+    if (mesh_instance_screen_areas) {
+      // New mesh instances were not visible in the previous frame.
+      BufferSlice<float> buffer = rg.get_buffer(mesh_instance_screen_areas);
+      for (Handle<MeshInstance> h : scene->update_mesh_instances) {
+        cmd.fill_buffer(BufferView(buffer.slice(h, 1)), 0.0f);
+      }
+    }
+
     auto [transforms_ptr, _0, transforms_staging_buffer] =
         ccfg.allocator->allocate<glm::mat4x3>(
             scene->mesh_instance_transforms.size());
@@ -5,7 +5,8 @@
 
 namespace ren {
 
-auto rg_import_gpu_scene(RgBuilder &rgb, const GpuScene &scene) -> RgGpuScene;
+auto rg_import_gpu_scene(const PassCommonConfig &ccfg,
+                         const GpuScene &scene) -> RgGpuScene;
 void rg_export_gpu_scene(const RgBuilder &rgb, const RgGpuScene &rg_gpu_scene,
                          NotNull<GpuScene *> gpu_scene);
 
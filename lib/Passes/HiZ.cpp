@@ -25,31 +25,20 @@ void setup_hi_z_pass(const PassCommonConfig &ccfg, const HiZPassConfig &cfg) {
     });
   }
 
-  RgBufferId<glsl::uint> counter;
-  {
-    auto init_pass = ccfg.rgb->create_pass({.name = "hi-z-init"});
+  // The tile mip levels and the rest are written by separate passes. The
+  // second one reads only the last tile mip level, so that the barrier between
+  // them doesn't cover the whole texture.
+  u32 num_tile_mips = std::min(num_mips, glsl::HI_Z_SPD_NUM_TILE_MIPS);
 
-    counter = ccfg.rgb->create_buffer<glsl::uint>(RgBufferCreateInfo{
-        .heap = BufferHeap::Static,
-        .count = 1,
-    });
-
-    RgBufferToken<glsl::uint> rcs;
-    std::tie(counter, rcs) = init_pass.write_buffer(
-        "hi-z-spd-counter-zero", counter, TRANSFER_DST_BUFFER);
-    init_pass.set_callback(
-        [rcs](Renderer &renderer, const RgRuntime &rg, CommandRecorder &cmd) {
-          cmd.fill_buffer(BufferView(rg.get_buffer(rcs)), 0);
-        });
-  }
-
-  auto pass = ccfg.rgb->create_pass({.name = "hi-z-spd"});
+  auto pass = ccfg.rgb->create_pass({
+      .name = "hi-z-spd",
+      .queue = RgQueue::AsyncCompute,
+  });
 
   struct Resources {
     Handle<ComputePipeline> pipeline;
     RgTextureToken depth_buffer;
     RgTextureToken hi_z;
-    RgBufferToken<glsl::uint> counter;
   } rcs;
 
   rcs.pipeline = ccfg.pipelines->hi_z;
@@ -57,25 +46,22 @@ void setup_hi_z_pass(const PassCommonConfig &ccfg, const HiZPassConfig &cfg) {
   rcs.depth_buffer = pass.read_texture(cfg.depth_buffer, CS_SAMPLE_TEXTURE,
                                        ccfg.samplers->hi_z);
 
-  std::tie(*cfg.hi_z, rcs.hi_z) =
-      pass.write_texture("hi-z", ccfg.rcs->hi_z, CS_WRITE_TEXTURE);
-
-  std::tie(counter, rcs.counter) =
-      pass.write_buffer("hi-z-spd-counter", counter, CS_READ_WRITE_BUFFER);
+  std::tie(*cfg.hi_z, rcs.hi_z) = pass.write_texture(
+      "hi-z-tile", ccfg.rcs->hi_z, CS_WRITE_TEXTURE,
+      {.first_mip_level = 0, .num_mip_levels = num_tile_mips});
 
-  pass.set_compute_callback([rcs, size, num_mips](Renderer &renderer,
-                                                  const RgRuntime &rg,
-                                                  ComputePass &cmd) {
+  pass.set_compute_callback([rcs, size, num_mips, num_tile_mips](
+                                Renderer &renderer, const RgRuntime &rg,
+                                ComputePass &cmd) {
     cmd.bind_compute_pipeline(rcs.pipeline);
     cmd.bind_descriptor_sets({rg.get_texture_set()});
     auto [descriptors, descriptors_ptr, _] =
-        rg.allocate<glsl::RWStorageTexture2D>(num_mips);
-    for (i32 mip = 0; mip < num_mips; ++mip) {
+        rg.allocate<glsl::RWStorageTexture2D>(num_tile_mips);
+    for (u32 mip = 0; mip < num_tile_mips; ++mip) {
       descriptors[mip] = glsl::RWStorageTexture2D(
           rg.get_storage_texture_descriptor(rcs.hi_z, mip));
     }
     cmd.set_push_constants(glsl::HiZSpdPassArgs{
-        .counter = rg.get_buffer_device_ptr(rcs.counter),
         .dsts = descriptors_ptr,
         .dst_size = size,
         .num_dst_mips = num_mips,
@@ -86,6 +72,53 @@ void setup_hi_z_pass(const PassCommonConfig &ccfg, const HiZPassConfig &cfg) {
         size, {glsl::HI_Z_SPD_THREADS_X * glsl::HI_Z_SPD_THREAD_ELEMS_X,
                glsl::HI_Z_SPD_THREADS_Y * glsl::HI_Z_SPD_THREAD_ELEMS_Y});
   });
+
+  if (num_mips == num_tile_mips) {
+    return;
+  }
+
+  auto tail_pass = ccfg.rgb->create_pass({
+      .name = "hi-z-spd-tail",
+      .queue = RgQueue::AsyncCompute,
+  });
+
+  struct TailResources {
+    Handle<ComputePipeline> pipeline;
+    RgTextureToken src;
+    RgTextureToken hi_z;
+  } tail_rcs;
+
+  tail_rcs.pipeline = ccfg.pipelines->hi_z;
+
+  tail_rcs.src = tail_pass.read_texture(
+      *cfg.hi_z, CS_READ_TEXTURE,
+      {.first_mip_level = num_tile_mips - 1, .num_mip_levels = 1});
+
+  std::tie(*cfg.hi_z, tail_rcs.hi_z) =
+      tail_pass.write_texture("hi-z", *cfg.hi_z, CS_WRITE_TEXTURE,
+                              {.first_mip_level = num_tile_mips});
+
+  tail_pass.set_compute_callback([tail_rcs, size, num_mips, num_tile_mips](
+                                     Renderer &renderer, const RgRuntime &rg,
+                                     ComputePass &cmd) {
+    cmd.bind_compute_pipeline(tail_rcs.pipeline);
+    cmd.bind_descriptor_sets({rg.get_texture_set()});
+    auto [descriptors, descriptors_ptr, _] =
+        rg.allocate<glsl::RWStorageTexture2D>(num_mips);
+    descriptors[num_tile_mips - 1] = glsl::RWStorageTexture2D(
+        rg.get_storage_texture_descriptor(tail_rcs.src, num_tile_mips - 1));
+    for (u32 mip = num_tile_mips; mip < num_mips; ++mip) {
+      descriptors[mip] = glsl::RWStorageTexture2D(
+          rg.get_storage_texture_descriptor(tail_rcs.hi_z, mip));
+    }
+    cmd.set_push_constants(glsl::HiZSpdPassArgs{
+        .dsts = descriptors_ptr,
+        .dst_size = size,
+        .num_dst_mips = num_mips,
+        .tail = 1,
+    });
+    cmd.dispatch_groups(1);
+  });
 }
 
 } // namespace ren
@@ -2,7 +2,9 @@
 #include "MeshPass.hpp"
 #include "RenderGraph.hpp"
 #include "Scene.hpp"
+#include "Support/Math.hpp"
 #include "Swapchain.hpp"
+#include "glsl/VisibilityBufferPass.h"
 
 namespace ren {
 
@@ -14,6 +16,8 @@ struct EarlyZPassConfig {
 void setup_early_z_pass(const PassCommonConfig &ccfg,
                         const EarlyZPassConfig &cfg) {
   const SceneData &scene = *ccfg.scene;
+  float min_occluder_screen_area =
+      scene.settings.early_z_min_occluder_screen_area;
   DepthOnlyMeshPassClass mesh_pass;
   mesh_pass.record(*ccfg.rgb,
                    DepthOnlyMeshPassClass::BeginInfo{
@@ -31,6 +35,10 @@ void setup_early_z_pass(const PassCommonConfig &ccfg,
                                .scene = ccfg.scene,
                                .camera = ccfg.scene->get_camera(),
                                .viewport = ccfg.swapchain->get_size(),
+                               .occluders_only =
+                                   min_occluder_screen_area > 0.0f,
+                               .min_occluder_screen_area =
+                                   min_occluder_screen_area,
                                .gpu_scene = cfg.gpu_scene,
                                .upload_allocator = ccfg.allocator,
                            },
@@ -44,12 +52,18 @@ struct OpaquePassConfig {
   RgTextureId depth_buffer;
   RgTextureId exposure;
   u32 exposure_temporal_layer = 0;
+  const ShadowCascades *shadows = nullptr;
 };
 
 void setup_opaque_pass(const PassCommonConfig &ccfg,
                        const OpaquePassConfig &cfg) {
   const SceneData &scene = *ccfg.scene;
   RgTextureId depth_buffer = cfg.depth_buffer;
+  // Depth of instances that were not drawn in the prepass still has to be
+  // written.
+  bool early_z = scene.settings.early_z;
+  bool occluders_only =
+      early_z and scene.settings.early_z_min_occluder_screen_area > 0.0f;
   OpaqueMeshPassClass mesh_pass;
   mesh_pass
       .record(*ccfg.rgb,
@@ -65,10 +79,12 @@ void setup_opaque_pass(const PassCommonConfig &ccfg,
                           }},
                           .color_attachment_names = {"hdr"},
                           .depth_attachment = &depth_buffer,
-                          .depth_attachment_ops = scene.settings.early_z ?
+                          .depth_attachment_ops = early_z ?
                            DepthAttachmentOperations {
                                 .load = VK_ATTACHMENT_LOAD_OP_LOAD,
-                                .store = VK_ATTACHMENT_STORE_OP_NONE,
+                                .store = occluders_only ?
+                                    VK_ATTACHMENT_STORE_OP_STORE :
+                                    VK_ATTACHMENT_STORE_OP_NONE,
                            } :
                            DepthAttachmentOperations {
                                .load = VK_ATTACHMENT_LOAD_OP_CLEAR,
@@ -79,14 +95,325 @@ void setup_opaque_pass(const PassCommonConfig &ccfg,
                           .scene = ccfg.scene,
                           .camera = ccfg.scene->get_camera(),
                           .viewport = ccfg.swapchain->get_size(),
+                          .write_screen_areas = occluders_only,
                           .gpu_scene = cfg.gpu_scene,
                           .upload_allocator = ccfg.allocator,
                       },
                   .exposure = cfg.exposure,
                   .exposure_temporal_layer = cfg.exposure_temporal_layer,
+                  .shadow_maps = cfg.shadows->shadow_maps,
+                  .shadow_proj_views = cfg.shadows->proj_views,
+                  .shadow_map_sampler = ccfg.samplers->shadow_map,
+                  .shadowed_directional_light = cfg.shadows->light,
               });
 }
 
+struct VisibilityBufferPassesConfig {
+  RgGpuScene gpu_scene;
+  NotNull<RgTextureId *> hdr;
+  NotNull<RgTextureId *> depth_buffer;
+  RgTextureId exposure;
+  u32 exposure_temporal_layer = 0;
+  const ShadowCascades *shadows = nullptr;
+};
+
+struct RgVisibilityBufferDrawToken {
+  RgBufferToken<glsl::DrawIndexedIndirectCommand> commands;
+  u32 base_command = 0;
+  Handle<Buffer> indices;
+};
+
+auto upload_visibility_buffer_draws(
+    const Renderer &renderer, const RgRuntime &rg,
+    Span<const RgVisibilityBufferDrawToken> draws)
+    -> DevicePtr<glsl::VisibilityBufferDraw> {
+  auto [draws_host_ptr, draws_device_ptr, _] =
+      rg.allocate<glsl::VisibilityBufferDraw>(draws.size());
+  for (usize i : range(draws.size())) {
+    draws_host_ptr[i] = {
+        .commands = rg.get_buffer_device_ptr(draws[i].commands) +
+                    draws[i].base_command,
+        .indices = renderer.get_buffer_device_ptr<u32>(draws[i].indices),
+    };
+  }
+  return draws_device_ptr;
+}
+
+/// Rasterizes triangle ids into a visibility buffer and then shades it in
+/// compute. Tiles are classified by the mesh attributes that they require, and
+/// each class is shaded with a separate indirect dispatch.
+void setup_visibility_buffer_passes(const PassCommonConfig &ccfg,
+                                    const VisibilityBufferPassesConfig &cfg) {
+  const SceneData &scene = *ccfg.scene;
+  RgBuilder &rgb = *ccfg.rgb;
+
+  glm::uvec2 viewport = ccfg.swapchain->get_size();
+
+  if (!ccfg.rcs->visibility_buffer) {
+    ccfg.rcs->visibility_buffer = ccfg.rgp->create_texture({
+        .name = "visibility-buffer",
+        .format = VISIBILITY_BUFFER_FORMAT,
+        .width = viewport.x,
+        .height = viewport.y,
+    });
+  }
+  RgTextureId visibility_buffer = ccfg.rcs->visibility_buffer;
+
+  Vector<RgVisibilityBufferDraw> draws;
+  VisibilityBufferMeshPassClass mesh_pass;
+  mesh_pass.record(rgb, VisibilityBufferMeshPassClass::BeginInfo{
+                            .base =
+                                {
+                                    .pass_name = "visibility-buffer",
+                                    .color_attachments = {&visibility_buffer},
+                                    .color_attachment_ops = {{
+                                        .load = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                        .store = VK_ATTACHMENT_STORE_OP_STORE,
+                                        .clear_color = glm::vec4(0.0f),
+                                    }},
+                                    .color_attachment_names =
+                                        {"visibility-buffer"},
+                                    .depth_attachment = cfg.depth_buffer,
+                                    .depth_attachment_ops =
+                                        {
+                                            .load = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                            .store =
+                                                VK_ATTACHMENT_STORE_OP_STORE,
+                                        },
+                                    .depth_attachment_name = "depth-buffer",
+                                    .pipelines = ccfg.pipelines,
+                                    .scene = ccfg.scene,
+                                    .camera = scene.get_camera(),
+                                    .viewport = viewport,
+                                    .gpu_scene = cfg.gpu_scene,
+                                    .upload_allocator = ccfg.allocator,
+                                },
+                            .draws = &draws,
+                        });
+
+  if (draws.empty()) {
+    return;
+  }
+
+  u32 max_num_tiles =
+      ceil_div(viewport.x, glsl::VISIBILITY_BUFFER_TILE_SIZE) *
+      ceil_div(viewport.y, glsl::VISIBILITY_BUFFER_TILE_SIZE);
+
+  auto tile_commands = rgb.create_buffer<glsl::DispatchIndirectCommand>({
+      .heap = BufferHeap::Static,
+      .size = glsl::NUM_VISIBILITY_BUFFER_TILE_CLASSES,
+  });
+
+  auto tiles = rgb.create_buffer<u32>({
+      .heap = BufferHeap::Static,
+      .size = glsl::NUM_VISIBILITY_BUFFER_TILE_CLASSES * max_num_tiles,
+  });
+
+  {
+    auto pass = rgb.create_pass({.name = "visibility-buffer-init-tiles"});
+
+    RgBufferToken<glsl::DispatchIndirectCommand> tile_commands_token;
+    std::tie(tile_commands, tile_commands_token) = pass.write_buffer(
+        "init-visibility-buffer-tile-commands", tile_commands,
+        TRANSFER_DST_BUFFER);
+
+    pass.set_callback([tile_commands_token](Renderer &, const RgRuntime &rg,
+                                            CommandRecorder &cmd) {
+      std::array<glsl::DispatchIndirectCommand,
+                 glsl::NUM_VISIBILITY_BUFFER_TILE_CLASSES>
+          commands;
+      std::ranges::fill(commands,
+                        glsl::DispatchIndirectCommand{.x = 0, .y = 1, .z = 1});
+      cmd.update_buffer(BufferView(rg.get_buffer(tile_commands_token)),
+                        commands);
+    });
+  }
+
+  {
+    auto pass = rgb.create_pass({.name = "visibility-buffer-classify"});
+
+    struct {
+      Handle<ComputePipeline> pipeline;
+      RgBufferToken<glsl::Mesh> meshes;
+      RgBufferToken<glsl::MeshInstance> mesh_instances;
+      RgBufferToken<glsl::Material> materials;
+      SmallVector<RgVisibilityBufferDrawToken> draws;
+      RgBufferToken<glsl::DispatchIndirectCommand> tile_commands;
+      RgBufferToken<u32> tiles;
+      u32 max_num_tiles;
+      RgTextureToken visibility_buffer;
+      RgTextureToken hdr;
+      glm::uvec2 viewport;
+    } rcs;
+
+    rcs.pipeline = ccfg.pipelines->visibility_buffer_classify;
+
+    rcs.meshes = pass.read_buffer(cfg.gpu_scene.meshes, CS_READ_BUFFER);
+    rcs.mesh_instances =
+        pass.read_buffer(cfg.gpu_scene.mesh_instances, CS_READ_BUFFER);
+    rcs.materials = pass.read_buffer(cfg.gpu_scene.materials, CS_READ_BUFFER);
+    for (const RgVisibilityBufferDraw &draw : draws) {
+      rcs.draws.push_back({
+          .commands = pass.read_buffer(draw.commands, CS_READ_BUFFER),
+          .base_command = draw.base_command,
+          .indices = draw.indices,
+      });
+    }
+
+    std::tie(tile_commands, rcs.tile_commands) = pass.write_buffer(
+        "visibility-buffer-tile-commands", tile_commands,
+        CS_READ_WRITE_BUFFER);
+    std::tie(tiles, rcs.tiles) =
+        pass.write_buffer("visibility-buffer-tiles", tiles, CS_WRITE_BUFFER);
+    rcs.max_num_tiles = max_num_tiles;
+
+    rcs.visibility_buffer =
+        pass.read_texture(visibility_buffer, CS_READ_TEXTURE);
+    std::tie(*cfg.hdr, rcs.hdr) =
+        pass.write_texture("hdr", *cfg.hdr, CS_WRITE_TEXTURE);
+
+    rcs.viewport = viewport;
+
+    pass.set_compute_callback([rcs](Renderer &renderer, const RgRuntime &rg,
+                                    ComputePass &cmd) {
+      cmd.bind_compute_pipeline(rcs.pipeline);
+      cmd.bind_descriptor_sets({rg.get_texture_set()});
+      cmd.set_push_constants(glsl::VisibilityBufferClassifyPassArgs{
+          .meshes = rg.get_buffer_device_ptr(rcs.meshes),
+          .mesh_instances = rg.get_buffer_device_ptr(rcs.mesh_instances),
+          .materials = rg.get_buffer_device_ptr(rcs.materials),
+          .draws = upload_visibility_buffer_draws(renderer, rg, rcs.draws),
+          .tile_commands = rg.get_buffer_device_ptr(rcs.tile_commands),
+          .tiles = rg.get_buffer_device_ptr(rcs.tiles),
+          .max_num_tiles = rcs.max_num_tiles,
+          .visibility_buffer = glsl::UStorageTexture2D(
+              rg.get_storage_texture_descriptor(rcs.visibility_buffer)),
+          .hdr = glsl::RWStorageTexture2D(
+              rg.get_storage_texture_descriptor(rcs.hdr)),
+      });
+      cmd.dispatch_threads(rcs.viewport,
+                           glm::uvec2(glsl::VISIBILITY_BUFFER_TILE_SIZE));
+    });
+  }
+
+  {
+    auto pass = rgb.create_pass({.name = "visibility-buffer-shade"});
+
+    struct {
+      Handle<ComputePipeline> pipeline;
+      RgBufferToken<glsl::Mesh> meshes;
+      RgBufferToken<glsl::MeshInstance> mesh_instances;
+      RgBufferToken<glm::mat4x3> transform_matrices;
+      RgBufferToken<glm::mat3> normal_matrices;
+      RgBufferToken<glsl::Material> materials;
+      RgBufferToken<glsl::DirectionalLight> directional_lights;
+      SmallVector<RgVisibilityBufferDrawToken> draws;
+      RgBufferToken<glsl::DispatchIndirectCommand> tile_commands;
+      RgBufferToken<u32> tiles;
+      u32 max_num_tiles;
+      RgTextureToken visibility_buffer;
+      RgTextureToken exposure;
+      RgTextureToken hdr;
+      StaticVector<RgTextureToken, glsl::MAX_NUM_SHADOW_CASCADES> shadow_maps;
+      StaticVector<glm::mat4, glsl::MAX_NUM_SHADOW_CASCADES> shadow_proj_views;
+      glm::mat4 proj_view;
+      glm::vec3 eye;
+      u32 num_directional_lights;
+      u32 shadowed_directional_light;
+    } rcs;
+
+    rcs.pipeline = ccfg.pipelines->visibility_buffer_shade;
+
+    rcs.meshes = pass.read_buffer(cfg.gpu_scene.meshes, CS_READ_BUFFER);
+    rcs.mesh_instances =
+        pass.read_buffer(cfg.gpu_scene.mesh_instances, CS_READ_BUFFER);
+    rcs.transform_matrices =
+        pass.read_buffer(cfg.gpu_scene.transform_matrices, CS_READ_BUFFER);
+    rcs.normal_matrices =
+        pass.read_buffer(cfg.gpu_scene.normal_matrices, CS_READ_BUFFER);
+    rcs.materials = pass.read_buffer(cfg.gpu_scene.materials, CS_READ_BUFFER);
+    rcs.directional_lights =
+        pass.read_buffer(cfg.gpu_scene.directional_lights, CS_READ_BUFFER);
+    for (const RgVisibilityBufferDraw &draw : draws) {
+      rcs.draws.push_back({
+          .commands = pass.read_buffer(draw.commands, CS_READ_BUFFER),
+          .base_command = draw.base_command,
+          .indices = draw.indices,
+      });
+    }
+
+    rcs.tile_commands =
+        pass.read_buffer(tile_commands, INDIRECT_COMMAND_SRC_BUFFER);
+    rcs.tiles = pass.read_buffer(tiles, CS_READ_BUFFER);
+    rcs.max_num_tiles = max_num_tiles;
+
+    rcs.visibility_buffer =
+        pass.read_texture(visibility_buffer, CS_READ_TEXTURE);
+    rcs.exposure = pass.read_texture(cfg.exposure, CS_READ_TEXTURE,
+                                     cfg.exposure_temporal_layer);
+    std::tie(*cfg.hdr, rcs.hdr) =
+        pass.write_texture("hdr", *cfg.hdr, CS_WRITE_TEXTURE);
+
+    for (RgTextureId shadow_map : cfg.shadows->shadow_maps) {
+      rcs.shadow_maps.push_back(pass.read_texture(
+          shadow_map, CS_SAMPLE_TEXTURE, ccfg.samplers->shadow_map));
+    }
+    rcs.shadow_proj_views = cfg.shadows->proj_views;
+
+    const Camera &camera = scene.get_camera();
+    rcs.proj_view = get_projection_view_matrix(camera, viewport);
+    rcs.eye = camera.position;
+    rcs.num_directional_lights = scene.directional_lights.size();
+    rcs.shadowed_directional_light = cfg.shadows->light;
+
+    pass.set_compute_callback([rcs](Renderer &renderer, const RgRuntime &rg,
+                                    ComputePass &cmd) {
+      auto [uniforms_host_ptr, uniforms_device_ptr, _] =
+          rg.allocate<glsl::VisibilityBufferShadePassUniforms>();
+      *uniforms_host_ptr = {
+          .meshes = rg.get_buffer_device_ptr(rcs.meshes),
+          .mesh_instances = rg.get_buffer_device_ptr(rcs.mesh_instances),
+          .transform_matrices =
+              rg.get_buffer_device_ptr(rcs.transform_matrices),
+          .normal_matrices = rg.get_buffer_device_ptr(rcs.normal_matrices),
+          .materials = rg.get_buffer_device_ptr(rcs.materials),
+          .directional_lights =
+              rg.get_buffer_device_ptr(rcs.directional_lights),
+          .draws = upload_visibility_buffer_draws(renderer, rg, rcs.draws),
+          .proj_view = rcs.proj_view,
+          .eye = rcs.eye,
+          .num_directional_lights = rcs.num_directional_lights,
+          .num_shadow_cascades = u32(rcs.shadow_maps.size()),
+          .shadowed_directional_light = rcs.shadowed_directional_light,
+          .visibility_buffer = glsl::UStorageTexture2D(
+              rg.get_storage_texture_descriptor(rcs.visibility_buffer)),
+          .exposure = glsl::StorageTexture2D(
+              rg.get_storage_texture_descriptor(rcs.exposure)),
+          .hdr = glsl::RWStorageTexture2D(
+              rg.get_storage_texture_descriptor(rcs.hdr)),
+      };
+      for (usize i : range(rcs.shadow_maps.size())) {
+        uniforms_host_ptr->shadow_proj_views[i] = rcs.shadow_proj_views[i];
+        uniforms_host_ptr->shadow_maps[i] = glsl::SampledTexture2D(
+            rg.get_sampled_texture_descriptor(rcs.shadow_maps[i]));
+      }
+
+      cmd.bind_compute_pipeline(rcs.pipeline);
+      cmd.bind_descriptor_sets({rg.get_texture_set()});
+      DevicePtr<u32> tiles = rg.get_buffer_device_ptr(rcs.tiles);
+      for (u32 tile_class : range(glsl::NUM_VISIBILITY_BUFFER_TILE_CLASSES)) {
+        cmd.set_push_constants(glsl::VisibilityBufferShadePassArgs{
+            .ub = uniforms_device_ptr,
+            .tiles = tiles + tile_class * rcs.max_num_tiles,
+            .tile_class = tile_class,
+        });
+        cmd.dispatch_indirect(
+            rg.get_buffer(rcs.tile_commands).slice(tile_class, 1));
+      }
+    });
+  }
+}
+
 } // namespace ren
 
 void ren::setup_opaque_passes(const PassCommonConfig &ccfg,
@@ -105,13 +432,6 @@ void ren::setup_opaque_passes(const PassCommonConfig &ccfg,
   }
   *cfg.depth_buffer = ccfg.rcs->depth_buffer;
 
-  if (scene.settings.early_z) {
-    setup_early_z_pass(ccfg, EarlyZPassConfig{
-                                 .gpu_scene = cfg.gpu_scene,
-                                 .depth_buffer = cfg.depth_buffer,
-                             });
-  }
-
   if (!ccfg.rcs->hdr) {
     ccfg.rcs->hdr = ccfg.rgp->create_texture({
         .name = "hdr",
@@ -122,6 +442,26 @@ void ren::setup_opaque_passes(const PassCommonConfig &ccfg,
   }
   *cfg.hdr = ccfg.rcs->hdr;
 
+  if (scene.settings.visibility_buffer) {
+    setup_visibility_buffer_passes(
+        ccfg, VisibilityBufferPassesConfig{
+                  .gpu_scene = cfg.gpu_scene,
+                  .hdr = cfg.hdr,
+                  .depth_buffer = cfg.depth_buffer,
+                  .exposure = cfg.exposure,
+                  .exposure_temporal_layer = cfg.exposure_temporal_layer,
+                  .shadows = &cfg.shadows,
+              });
+    return;
+  }
+
+  if (scene.settings.early_z) {
+    setup_early_z_pass(ccfg, EarlyZPassConfig{
+                                 .gpu_scene = cfg.gpu_scene,
+                                 .depth_buffer = cfg.depth_buffer,
+                             });
+  }
+
   setup_opaque_pass(ccfg,
                     OpaquePassConfig{
                         .gpu_scene = cfg.gpu_scene,
@@ -129,5 +469,6 @@ void ren::setup_opaque_passes(const PassCommonConfig &ccfg,
                         .depth_buffer = *cfg.depth_buffer,
                         .exposure = cfg.exposure,
                         .exposure_temporal_layer = cfg.exposure_temporal_layer,
+                        .shadows = &cfg.shadows,
                     });
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "GpuScene.hpp"
 #include "Pass.hpp"
+#include "Shadows.hpp"
 
 namespace ren {
 
@@ -10,6 +11,7 @@ struct OpaquePassesConfig {
   RgGpuScene gpu_scene;
   RgTextureId exposure;
   u32 exposure_temporal_layer = 0;
+  ShadowCascades shadows;
   NotNull<RgTextureId *> depth_buffer;
   NotNull<RgTextureId *> hdr;
 };
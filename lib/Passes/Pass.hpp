@@ -2,6 +2,7 @@
 #include "BumpAllocator.hpp"
 #include "RenderGraph.hpp"
 #include "Support/NotNull.hpp"
+#include "glsl/Lighting.h"
 
 namespace ren {
 
@@ -13,17 +14,25 @@ struct PassPersistentConfig {
   glm::uvec2 viewport;
   ExposureMode exposure = {};
   VkImageUsageFlags backbuffer_usage = 0;
+  u32 shadow_map_size = 0;
 };
 
 struct PassPersistentResources {
   RgTextureId exposure;
   RgTextureId hdr;
   RgTextureId depth_buffer;
+  RgTextureId visibility_buffer;
   RgTextureId hi_z;
   RgTextureId sdr;
   RgTextureId backbuffer;
+  RgPersistentBufferId<float> mesh_instance_screen_areas;
   RgSemaphoreId acquire_semaphore;
   RgSemaphoreId present_semaphore;
+  StaticVector<RgTextureId, glsl::MAX_NUM_SHADOW_CASCADES> shadow_maps;
+  /// Matrices that cached shadow maps were rendered with.
+  std::array<glm::mat4, glsl::MAX_NUM_SHADOW_CASCADES> shadow_proj_views = {};
+  /// Scene geometry version that cached shadow maps were rendered with.
+  u64 shadow_geometry_version = 0;
 };
 
 struct PassCommonConfig {
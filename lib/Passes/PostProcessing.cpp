@@ -136,7 +136,10 @@ void setup_reduce_luminance_histogram_pass(
 
   rcs.pipeline = ccfg.pipelines->reduce_luminance_histogram;
 
-  auto pass = ccfg.rgb->create_pass({.name = "reduce-luminance-histogram"});
+  auto pass = ccfg.rgb->create_pass({
+      .name = "reduce-luminance-histogram",
+      .queue = RgQueue::AsyncCompute,
+  });
 
   rcs.histogram = pass.read_buffer(cfg.histogram, CS_READ_BUFFER);
 
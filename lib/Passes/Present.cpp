@@ -1,5 +1,6 @@
 #include "Passes/Present.hpp"
 #include "CommandRecorder.hpp"
+#include "Renderer.hpp"
 #include "Swapchain.hpp"
 
 void ren::setup_present_pass(const PassCommonConfig &ccfg,
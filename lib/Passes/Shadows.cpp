@@ -0,0 +1,227 @@
+#include "Passes/Shadows.hpp"
+#include "MeshPass.hpp"
+#include "Scene.hpp"
+#include "Swapchain.hpp"
+
+#include <fmt/format.h>
+
+namespace ren {
+
+namespace {
+
+struct BoundingSphere {
+  glm::vec3 center = {};
+  float radius = 0.0f;
+};
+
+/// Returns the bounding sphere of the part of the camera's view volume between
+/// the near and far distances. It only depends on the camera's position and
+/// forward direction, so it doesn't change when the camera rotates around its
+/// view axis.
+auto get_view_volume_slice_bounding_sphere(const Camera &camera,
+                                           float aspect_ratio, float near,
+                                           float far) -> BoundingSphere {
+  // Squared distance from the view axis to the view volume's corners at
+  // distance d is a * d^2 + b.
+  float a = 0.0f;
+  float b = 0.0f;
+  switch (camera.proj) {
+  case CameraProjection::Perspective: {
+    float tan_y = glm::tan(camera.persp_hfov / aspect_ratio * 0.5f);
+    float tan_x = tan_y * aspect_ratio;
+    a = tan_x * tan_x + tan_y * tan_y;
+  } break;
+  case CameraProjection::Orthograpic: {
+    float half_width = camera.ortho_width * 0.5f;
+    float half_height = half_width / aspect_ratio;
+    b = half_width * half_width + half_height * half_height;
+  } break;
+  }
+
+  float near_r2 = a * near * near + b;
+  float far_r2 = a * far * far + b;
+  // Find the point on the view axis that is equally distant from the near and
+  // far corners.
+  float c = ((far * far - near * near) + (far_r2 - near_r2)) /
+            (2.0f * (far - near));
+  c = glm::clamp(c, near, far);
+  float radius = glm::sqrt(glm::max((c - near) * (c - near) + near_r2,
+                                    (far - c) * (far - c) + far_r2));
+
+  return {
+      .center = camera.position + glm::normalize(camera.forward) * c,
+      .radius = radius,
+  };
+}
+
+/// Returns an orthographic camera that looks at a cascade's bounding sphere
+/// from the light. The camera is snapped to the shadow map's texel grid so that
+/// shadow edges don't shimmer and the cascade can be reused when the main
+/// camera moves by less than a texel.
+auto get_cascade_camera(glm::vec3 light_origin, BoundingSphere sphere, u32 size,
+                        float caster_distance) -> Camera {
+  // Round up so that floating point error doesn't change the texel size.
+  float radius = glm::ceil(sphere.radius * 16.0f) / 16.0f;
+  float texel_size = 2.0f * radius / size;
+
+  glm::vec3 forward = -light_origin;
+  glm::vec3 up = glm::abs(forward.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f)
+                                             : glm::vec3(1.0f, 0.0f, 0.0f);
+  glm::vec3 right = glm::normalize(glm::cross(forward, up));
+  up = glm::cross(right, forward);
+
+  glm::vec3 center = {
+      glm::dot(sphere.center, right),
+      glm::dot(sphere.center, up),
+      glm::dot(sphere.center, forward),
+  };
+  center = glm::floor(center / texel_size) * texel_size;
+  center = right * center.x + up * center.y + forward * center.z;
+
+  float distance = radius + caster_distance;
+
+  return {
+      .position = center - forward * distance,
+      .forward = forward,
+      .up = up,
+      .proj = CameraProjection::Orthograpic,
+      .ortho_width = 2.0f * radius,
+      .near = 0.0f,
+      .far = distance + radius,
+  };
+}
+
+} // namespace
+
+void setup_shadow_passes(const PassCommonConfig &ccfg,
+                         const ShadowPassesConfig &cfg) {
+  const SceneData &scene = *ccfg.scene;
+  const SceneGraphicsSettings &settings = scene.settings;
+  PassPersistentResources &rcs = *ccfg.rcs;
+  ShadowCascades &shadows = *cfg.shadows;
+
+  shadows = {};
+
+  if (not settings.shadows or scene.directional_lights.empty()) {
+    return;
+  }
+
+  auto [light, light_data] = *scene.directional_lights.begin();
+  shadows.light = light;
+
+  u32 num_cascades = glm::clamp<u32>(settings.num_shadow_cascades, 1,
+                                     glsl::MAX_NUM_SHADOW_CASCADES);
+  u32 size = settings.shadow_map_size;
+
+  for (u32 i : range<u32>(rcs.shadow_maps.size(), num_cascades)) {
+    rcs.shadow_maps.push_back(ccfg.rgp->create_texture({
+        .name = fmt::format("shadow-map-{}", i),
+        .format = DEPTH_FORMAT,
+        .width = size,
+        .height = size,
+        .persistent = true,
+    }));
+    // Never matches a real matrix, so the cascade will be rendered.
+    rcs.shadow_proj_views[i] = glm::mat4(0.0f);
+  }
+
+  bool geometry_changed =
+      rcs.shadow_geometry_version != scene.geometry_version;
+  rcs.shadow_geometry_version = scene.geometry_version;
+
+  const Camera &camera = scene.get_camera();
+  glm::uvec2 viewport = ccfg.swapchain->get_size();
+  float aspect_ratio = float(viewport.x) / float(viewport.y);
+
+  float near = camera.near;
+  float far = settings.shadow_distance;
+  if (camera.far > 0.0f) {
+    far = glm::min(far, camera.far);
+  }
+  far = glm::max(far, near + 1.0f);
+
+  // Practical split scheme: blend logarithmic and uniform splits. Logarithmic
+  // splits are only defined for perspective projections with a positive near
+  // distance.
+  float lambda =
+      camera.proj == CameraProjection::Perspective and near > 0.0f ? 0.5f
+                                                                   : 0.0f;
+
+  StaticVector<u32, glsl::MAX_NUM_SHADOW_CASCADES> dirty_cascades;
+  std::array<Camera, glsl::MAX_NUM_SHADOW_CASCADES> cascade_cameras;
+  float cascade_near = near;
+  for (u32 i : range(num_cascades)) {
+    float t = float(i + 1) / num_cascades;
+    float cascade_far = glm::mix(near + (far - near) * t,
+                                 near * glm::pow(far / near, t), lambda);
+    if (i + 1 == num_cascades) {
+      cascade_far = far;
+    }
+
+    BoundingSphere sphere = get_view_volume_slice_bounding_sphere(
+        camera, aspect_ratio, cascade_near, cascade_far);
+    cascade_cameras[i] = get_cascade_camera(light_data.origin, sphere, size,
+                                            settings.shadow_distance);
+    glm::mat4 proj_view =
+        get_projection_view_matrix(cascade_cameras[i], {size, size});
+
+    shadows.shadow_maps.push_back(rcs.shadow_maps[i]);
+    shadows.proj_views.push_back(proj_view);
+
+    // Reuse the cascade if neither the light nor the geometry moved.
+    if (geometry_changed or proj_view != rcs.shadow_proj_views[i]) {
+      dirty_cascades.push_back(i);
+      rcs.shadow_proj_views[i] = proj_view;
+    }
+
+    cascade_near = cascade_far;
+  }
+
+  if (dirty_cascades.empty()) {
+    return;
+  }
+
+  // Render all dirty cascades as views of a single mesh pass so that they
+  // share instance culling.
+  StaticVector<String, glsl::MAX_NUM_SHADOW_CASCADES> names;
+  for (u32 i : dirty_cascades) {
+    names.push_back(fmt::format("shadow-map-{}", i));
+  }
+
+  StaticVector<MeshPassView, glsl::MAX_NUM_SHADOW_CASCADES> extra_views;
+  for (usize v : range<usize>(1, dirty_cascades.size())) {
+    u32 i = dirty_cascades[v];
+    extra_views.push_back({
+        .camera = cascade_cameras[i],
+        .viewport = {size, size},
+        .depth_attachment = &shadows.shadow_maps[i],
+        .depth_attachment_name = names[v],
+    });
+  }
+
+  u32 first = dirty_cascades[0];
+  DepthOnlyMeshPassClass mesh_pass;
+  mesh_pass.record(*ccfg.rgb,
+                   DepthOnlyMeshPassClass::BeginInfo{
+                       .base =
+                           {
+                               .pass_name = "shadows",
+                               .depth_attachment = &shadows.shadow_maps[first],
+                               .depth_attachment_ops =
+                                   {
+                                       .load = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                       .store = VK_ATTACHMENT_STORE_OP_STORE,
+                                   },
+                               .depth_attachment_name = names[0],
+                               .pipelines = ccfg.pipelines,
+                               .scene = ccfg.scene,
+                               .camera = cascade_cameras[first],
+                               .viewport = {size, size},
+                               .extra_views = extra_views,
+                               .gpu_scene = cfg.gpu_scene,
+                               .upload_allocator = ccfg.allocator,
+                           },
+                   });
+}
+
+} // namespace ren
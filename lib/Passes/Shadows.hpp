@@ -0,0 +1,23 @@
+#pragma once
+#include "GpuScene.hpp"
+#include "Pass.hpp"
+
+namespace ren {
+
+struct ShadowCascades {
+  /// Shadow maps sorted by distance from the camera.
+  StaticVector<RgTextureId, glsl::MAX_NUM_SHADOW_CASCADES> shadow_maps;
+  StaticVector<glm::mat4, glsl::MAX_NUM_SHADOW_CASCADES> proj_views;
+  /// Index of the directional light that casts shadows.
+  u32 light = 0;
+};
+
+struct ShadowPassesConfig {
+  RgGpuScene gpu_scene;
+  NotNull<ShadowCascades *> shadows;
+};
+
+void setup_shadow_passes(const PassCommonConfig &ccfg,
+                         const ShadowPassesConfig &cfg);
+
+} // namespace ren
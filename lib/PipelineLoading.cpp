@@ -5,6 +5,7 @@
 #include "glsl/Texture.h"
 
 #include "EarlyZVS.h"
+#include "FrameCaptureCS.h"
 #include "HiZSpdCS.h"
 #include "ImGuiFS.h"
 #include "ImGuiVS.h"
@@ -14,6 +15,10 @@
 #include "OpaqueVS.h"
 #include "PostProcessingCS.h"
 #include "ReduceLuminanceHistogramCS.h"
+#include "VisibilityBufferClassifyCS.h"
+#include "VisibilityBufferFS.h"
+#include "VisibilityBufferShadeCS.h"
+#include "VisibilityBufferVS.h"
 #include "glsl/OpaquePass.h"
 
 #include <spirv_reflect.h>
@@ -129,10 +134,25 @@ auto load_pipelines(ResourceArena &arena,
                                     "Hi-Z SPD"),
       .early_z_pass = load_early_z_pass_pipeline(arena),
       .opaque_pass = load_opaque_pass_pipelines(arena, persistent_set_layout),
+      .visibility_buffer_pass = load_visibility_buffer_pass_pipeline(arena),
+      .visibility_buffer_classify = load_compute_pipeline(
+          arena, persistent_set_layout,
+          Span(VisibilityBufferClassifyCS, VisibilityBufferClassifyCS_count)
+              .as_bytes(),
+          "Visibility buffer classify"),
+      .visibility_buffer_shade = load_compute_pipeline(
+          arena, persistent_set_layout,
+          Span(VisibilityBufferShadeCS, VisibilityBufferShadeCS_count)
+              .as_bytes(),
+          "Visibility buffer shade"),
       .post_processing =
           load_post_processing_pipeline(arena, persistent_set_layout),
       .reduce_luminance_histogram = load_reduce_luminance_histogram_pipeline(
           arena, persistent_set_layout),
+      .frame_capture = load_compute_pipeline(
+          arena, persistent_set_layout,
+          Span(FrameCaptureCS, FrameCaptureCS_count).as_bytes(),
+          "Frame capture"),
 #if REN_IMGUI
       .imgui_pass =
           load_imgui_pipeline(arena, persistent_set_layout, SDR_FORMAT),
@@ -208,6 +228,29 @@ auto load_opaque_pass_pipelines(
   return pipelines;
 }
 
+auto load_visibility_buffer_pass_pipeline(ResourceArena &arena)
+    -> Handle<GraphicsPipeline> {
+  auto vs = Span(VisibilityBufferVS, VisibilityBufferVS_count).as_bytes();
+  auto fs = Span(VisibilityBufferFS, VisibilityBufferFS_count).as_bytes();
+  auto layout = create_pipeline_layout(arena, Handle<DescriptorSetLayout>(),
+                                       {vs, fs}, "Visibility buffer pass");
+  std::array color_attachments = {ColorAttachmentInfo{
+      .format = VISIBILITY_BUFFER_FORMAT,
+  }};
+  return arena.create_graphics_pipeline({
+      .name = "Visibility buffer pass graphics pipeline",
+      .layout = layout,
+      .vertex_shader = {vs},
+      .fragment_shader = ShaderInfo{fs},
+      .depth_test =
+          DepthTestInfo{
+              .format = DEPTH_FORMAT,
+              .compare_op = VK_COMPARE_OP_GREATER_OR_EQUAL,
+          },
+      .color_attachments = color_attachments,
+  });
+}
+
 auto load_reduce_luminance_histogram_pipeline(
     ResourceArena &arena, Handle<DescriptorSetLayout> persistent_set_layout)
     -> Handle<ComputePipeline> {
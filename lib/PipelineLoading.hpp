@@ -15,8 +15,12 @@ struct Pipelines {
   Handle<GraphicsPipeline> early_z_pass;
   std::array<Handle<GraphicsPipeline>, glsl::NUM_MESH_ATTRIBUTE_FLAGS>
       opaque_pass;
+  Handle<GraphicsPipeline> visibility_buffer_pass;
+  Handle<ComputePipeline> visibility_buffer_classify;
+  Handle<ComputePipeline> visibility_buffer_shade;
   Handle<ComputePipeline> post_processing;
   Handle<ComputePipeline> reduce_luminance_histogram;
+  Handle<ComputePipeline> frame_capture;
   Handle<GraphicsPipeline> imgui_pass;
 };
 
@@ -39,6 +43,9 @@ auto load_opaque_pass_pipelines(
     ResourceArena &arena, Handle<DescriptorSetLayout> persistent_set_layout)
     -> std::array<Handle<GraphicsPipeline>, glsl::NUM_MESH_ATTRIBUTE_FLAGS>;
 
+auto load_visibility_buffer_pass_pipeline(ResourceArena &arena)
+    -> Handle<GraphicsPipeline>;
+
 auto load_post_processing_pipeline(
     ResourceArena &arena, Handle<DescriptorSetLayout> persistent_set_layout)
     -> Handle<ComputePipeline>;
@@ -1,18 +1,50 @@
 #include "RenderGraph.hpp"
 #include "CommandAllocator.hpp"
 #include "CommandRecorder.hpp"
+#include "DescriptorAllocator.hpp"
 #include "Formats.hpp"
+#include "Renderer.hpp"
+#include "RendererResourceLock.hpp"
 #include "Support/Errors.hpp"
+#include "Support/Hash.hpp"
 #include "Support/NotNull.hpp"
 #include "Support/Views.hpp"
 #include "Swapchain.hpp"
+#include "ThreadPool.hpp"
 
+#include <bit>
 #include <fmt/format.h>
+#include <numeric>
+#include <vulkan/vk_enum_string_helper.h>
 
 namespace ren {
 
-RgPersistent::RgPersistent(Renderer &renderer)
-    : m_texture_arena(renderer), m_prev_texture_arena(renderer) {}
+RgPersistent::RgPersistent(IRgDevice &device) {
+  m_device = &device;
+  if (m_device->has_async_compute()) {
+    m_queue_semaphores[(usize)RgQueue::Graphics] =
+        m_device->create_semaphore({
+            .name = "Render graph graphics queue timeline semaphore",
+            .initial_value = 0,
+        });
+    m_queue_semaphores[(usize)RgQueue::AsyncCompute] =
+        m_device->create_semaphore({
+            .name = "Render graph async compute queue timeline semaphore",
+            .initial_value = 0,
+        });
+  }
+}
+
+RgPersistent::~RgPersistent() {
+  for (Handle<Semaphore> semaphore : m_queue_semaphores) {
+    m_device->destroy(semaphore);
+  }
+  destroy_textures(m_texture_handles);
+  destroy_textures(m_prev_texture_handles);
+  free_texture_memory(m_texture_memory);
+  free_texture_memory(m_prev_texture_memory);
+  destroy_buffers();
+}
 
 auto RgPersistent::create_texture(RgTextureCreateInfo &&create_info)
     -> RgTextureId {
@@ -63,7 +95,7 @@ auto RgPersistent::create_texture(RgTextureCreateInfo &&create_info)
       } else {
         handle_name = fmt::format("{}#{}", create_info.name, i);
       }
-      if (i == 0) {
+      if (i == 0 and not create_info.persistent) {
         name = fmt::format("rg#{}", handle_name);
       } else {
         init_name = fmt::format("rg#{}", handle_name);
@@ -73,7 +105,7 @@ auto RgPersistent::create_texture(RgTextureCreateInfo &&create_info)
 #endif
 
     RgTextureId init_id;
-    if (i > 0) {
+    if (i > 0 or create_info.persistent) {
       init_id = m_textures.insert({
 #if REN_RG_DEBUG
           .name = std::move(init_name),
@@ -101,13 +133,58 @@ auto RgPersistent::create_texture(RgTextureCreateInfo &&create_info)
         }),
     };
 
-    m_persistent_textures[id] = i > 0;
+    m_persistent_textures[id] = i > 0 or create_info.persistent;
     m_external_textures[id] = is_external;
   }
 
   return m_physical_textures[physical_texture_id].id;
 }
 
+auto RgPersistent::create_buffer(RgPersistentBufferCreateInfo &&create_info)
+    -> RgUntypedPersistentBufferId {
+#if REN_RG_DEBUG
+  ren_assert(not create_info.name.empty());
+#endif
+  u32 num_temporal_layers = create_info.num_temporal_layers;
+  ren_assert(num_temporal_layers > 0);
+  ren_assert(num_temporal_layers <= RG_MAX_TEMPORAL_LAYERS);
+
+  RgPersistentBuffer buffer = {
+      .heap = create_info.heap,
+      .size = create_info.size,
+      .num_temporal_layers = num_temporal_layers,
+      .init_usage = create_info.usage,
+      .init_cb = std::move(create_info.cb),
+  };
+  if (buffer.init_cb) {
+    buffer.uninitialized_layers = (1 << num_temporal_layers) - 1;
+  }
+  for (usize i : range(num_temporal_layers)) {
+    buffer.handles[i] = m_device->create_buffer({
+#if REN_RG_DEBUG
+        .name = num_temporal_layers == 1
+                    ? create_info.name
+                    : fmt::format("{}#{}", create_info.name, i),
+#endif
+        .heap = create_info.heap,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        .size = create_info.size,
+        // Which queues use the buffer isn't known until it's read or written.
+        .concurrent = true,
+        .owner = MemoryOwner::RenderGraph,
+    });
+  }
+#if REN_RG_DEBUG
+  buffer.name = std::move(create_info.name);
+#endif
+
+  return m_buffers.insert(std::move(buffer));
+}
+
 auto RgPersistent::create_external_semaphore(RgDebugName name)
     -> RgSemaphoreId {
   RgSemaphoreId semaphore = m_semaphores.emplace();
@@ -118,13 +195,83 @@ auto RgPersistent::create_external_semaphore(RgDebugName name)
 }
 
 void RgPersistent::reset() {
-  m_texture_arena.clear();
+  release_frame_resources();
+  destroy_textures(m_texture_handles);
+  free_texture_memory(m_texture_memory);
   m_physical_textures.clear();
   m_persistent_textures.clear();
   m_external_textures.clear();
   m_textures.clear();
   m_texture_init_info.clear();
+  destroy_buffers();
   m_semaphores.clear();
+  m_rt_data.m_hash = 0;
+  m_rt_data.m_structure_key.clear();
+}
+
+void RgPersistent::release_frame_resources() {
+  destroy_textures(m_prev_texture_handles);
+  free_texture_memory(m_prev_texture_memory);
+  m_physical_textures.resize(m_physical_textures.size() -
+                             std::exchange(m_num_prev_physical_textures, 0));
+  m_persistent_textures.resize(m_physical_textures.size());
+  m_external_textures.resize(m_physical_textures.size());
+  for (RgTextureId texture : m_frame_textures) {
+    m_textures.erase(texture);
+  }
+  m_frame_textures.clear();
+}
+
+void RgPersistent::destroy_textures(Vector<Handle<Texture>> &textures) {
+  if (textures.empty()) {
+    return;
+  }
+  m_device->wait_idle();
+  for (Handle<Texture> texture : textures) {
+    free_texture_descriptors(texture);
+    m_device->destroy(texture);
+  }
+  textures.clear();
+}
+
+void RgPersistent::destroy_buffers() {
+  if (m_buffers.empty()) {
+    return;
+  }
+  m_device->wait_idle();
+  for (const auto &[_, buffer] : m_buffers) {
+    for (usize i : range(buffer.num_temporal_layers)) {
+      m_device->destroy(buffer.handles[i]);
+    }
+  }
+  m_buffers.clear();
+}
+
+void RgPersistent::free_texture_descriptors(Handle<Texture> texture) {
+  auto it = m_texture_descriptors.find(texture);
+  if (it == m_texture_descriptors.end()) {
+    return;
+  }
+  const RgCachedTextureDescriptors &descriptors = it->second;
+  if (descriptors.sampled) {
+    m_device->free(descriptors.sampled);
+  }
+  for (const auto &[_, combined] : descriptors.combined) {
+    m_device->free(combined);
+  }
+  for (glsl::RWStorageTexture storage : descriptors.storage) {
+    if (storage) {
+      m_device->free(storage);
+    }
+  }
+  m_texture_descriptors.erase(it);
+}
+
+void RgPersistent::free_texture_memory(Vector<VmaAllocation> &memory) {
+  for (VmaAllocation allocation : memory) {
+    m_device->free_memory(allocation);
+  }
+  memory.clear();
 }
 
 void RgPersistent::rotate_textures() {
@@ -146,15 +293,15 @@ void RgPersistent::rotate_textures() {
         break;
       }
 #if REN_RG_DEBUG
-      prev_physical_texture.name = std::move(physical_texture.name);
+      prev_physical_texture.name = std::move(cur_physical_texture.name);
 #endif
-      prev_physical_texture.usage = physical_texture.usage;
-      prev_physical_texture.handle = physical_texture.handle;
-      prev_physical_texture.state = physical_texture.state;
+      prev_physical_texture.usage = cur_physical_texture.usage;
+      prev_physical_texture.handle = cur_physical_texture.handle;
+      prev_physical_texture.state = cur_physical_texture.state;
     }
     RgPhysicalTexture &last_physical_texture = m_physical_textures[last - 1];
 #if REN_RG_DEBUG
-    last_physical_texture.name = std::move(physical_texture.name);
+    last_physical_texture.name = std::move(name);
 #endif
     last_physical_texture.usage = usage;
     last_physical_texture.handle = handle;
@@ -162,6 +309,29 @@ void RgPersistent::rotate_textures() {
   }
 }
 
+void RgPersistent::rotate_buffers() {
+  for (auto &&[_, buffer] : m_buffers) {
+    buffer.ids = {};
+    if (buffer.num_temporal_layers == 1) {
+      continue;
+    }
+    // Reuse the oldest temporal layer for the current frame.
+    auto rotate = [&](auto &layers) {
+      auto begin = layers.begin();
+      auto end = begin + buffer.num_temporal_layers;
+      std::ranges::rotate(begin, end - 1, end);
+    };
+    rotate(buffer.handles);
+    rotate(buffer.states);
+    u32 last = buffer.num_temporal_layers - 1;
+    u32 mask = (1 << buffer.num_temporal_layers) - 1;
+    buffer.uninitialized_layers =
+        ((buffer.uninitialized_layers << 1) |
+         (buffer.uninitialized_layers >> last)) &
+        mask;
+  }
+}
+
 namespace {
 
 auto get_buffer_usage_flags(VkAccessFlags2 accesses) -> VkBufferUsageFlags {
@@ -230,15 +400,235 @@ auto get_texture_usage_flags(VkAccessFlags2 accesses) -> VkImageUsageFlags {
   return flags;
 }
 
+/// Replaces the counts of remaining mip levels and array layers in a texture
+/// use's range with the actual ones.
+auto resolve_subresource_range(const RgTextureSubresourceRange &range,
+                               u32 num_mip_levels, u32 num_array_layers)
+    -> RgTextureSubresourceRange {
+  RgTextureSubresourceRange resolved = range;
+  if (range.num_mip_levels == -1) {
+    ren_assert(range.first_mip_level < num_mip_levels);
+    resolved.num_mip_levels = num_mip_levels - range.first_mip_level;
+  }
+  if (range.num_array_layers == -1) {
+    ren_assert(range.first_array_layer < num_array_layers);
+    resolved.num_array_layers = num_array_layers - range.first_array_layer;
+  }
+  ren_assert(resolved.first_mip_level + resolved.num_mip_levels <=
+             num_mip_levels);
+  ren_assert(resolved.first_array_layer + resolved.num_array_layers <=
+             num_array_layers);
+  return resolved;
+}
+
+/// Formats Vulkan flags or enum values without their common prefix and the
+/// bit suffix.
+auto strip_vk_names(String str, StringView prefix) -> String {
+  for (StringView pattern : {prefix, StringView("_BIT")}) {
+    for (usize i = str.find(pattern); i != String::npos;
+         i = str.find(pattern, i)) {
+      str.erase(i, pattern.size());
+    }
+  }
+  return str;
+}
+
+auto format_stage_mask(VkPipelineStageFlags2 stage_mask) -> String {
+  if (!stage_mask) {
+    return "NONE";
+  }
+  return strip_vk_names(string_VkPipelineStageFlags2(stage_mask),
+                        "VK_PIPELINE_STAGE_2_");
+}
+
+auto format_access_mask(VkAccessFlags2 access_mask) -> String {
+  if (!access_mask) {
+    return "NONE";
+  }
+  return strip_vk_names(string_VkAccessFlags2(access_mask), "VK_ACCESS_2_");
+}
+
+auto format_layout(VkImageLayout layout) -> String {
+  return strip_vk_names(string_VkImageLayout(layout), "VK_IMAGE_LAYOUT_");
+}
+
 } // namespace
 
-RgBuilder::RgBuilder(RgPersistent &rgp, Renderer &renderer,
-                     DescriptorAllocatorScope &descriptor_allocator) {
-  m_renderer = &renderer;
+void RgPersistent::write_graphviz(std::FILE *file) const {
+  const RgBuildData &bd = m_build_data;
+  const RgRtData &rt = m_rt_data;
+
+  fmt::println(file, "digraph RenderGraph {{");
+  fmt::println(file, "  rankdir=LR;");
+  fmt::println(file, "  node [fontname=monospace, fontsize=10];");
+  fmt::println(file, "  edge [fontname=monospace, fontsize=8];");
+
+  auto format_usage = [](VkPipelineStageFlags2 stage_mask,
+                         VkAccessFlags2 access_mask) -> String {
+    return fmt::format("{}\\n{}", format_stage_mask(stage_mask),
+                       format_access_mask(access_mask));
+  };
+
+  auto format_barrier = [](const auto &barrier) -> String {
+    return fmt::format("{}:{} -> {}:{}",
+                       format_stage_mask(barrier.srcStageMask),
+                       format_access_mask(barrier.srcAccessMask),
+                       format_stage_mask(barrier.dstStageMask),
+                       format_access_mask(barrier.dstAccessMask));
+  };
+
+  auto get_texture_name = [&](RgPhysicalTextureId physical_texture) {
+#if REN_RG_DEBUG
+    return escape_string(m_physical_textures[physical_texture].name);
+#else
+    return fmt::format("texture {}", u32(physical_texture));
+#endif
+  };
+
+  DynamicBitset declared_buffers(bd.m_physical_buffers.size());
+  auto declare_buffer = [&](RgUntypedBufferId buffer) -> u32 {
+    RgPhysicalBufferId physical_buffer = bd.m_buffers[buffer].parent;
+    if (not declared_buffers[physical_buffer]) {
+      declared_buffers.set(physical_buffer);
+#if REN_RG_DEBUG
+      // Physical buffers don't have names, so use the name of the first
+      // buffer that refers to it.
+      String name = escape_string(bd.m_buffers[buffer].name);
+#else
+      String name = fmt::format("buffer {}", u32(physical_buffer));
+#endif
+      fmt::println(file, "  b{} [shape=ellipse, label=\"{}\"];",
+                   u32(physical_buffer), name);
+    }
+    return physical_buffer;
+  };
+
+  DynamicBitset declared_textures(m_physical_textures.size());
+  auto declare_texture = [&](RgTextureId texture) -> u32 {
+    RgPhysicalTextureId physical_texture = m_textures[texture].parent;
+    if (not declared_textures[physical_texture]) {
+      declared_textures.set(physical_texture);
+      // Persistent textures are bold and external ones are dashed.
+      StringView style = m_persistent_textures[physical_texture] ? "bold"
+                         : m_external_textures[physical_texture] ? "dashed"
+                                                                 : "solid";
+      fmt::println(file, "  t{} [shape=ellipse, style={}, label=\"{}\"];",
+                   u32(physical_texture), style,
+                   get_texture_name(physical_texture));
+    }
+    return physical_texture;
+  };
+
+  // Index of the pass after which each event is set.
+  Vector<u32> event_src_passes(rt.m_event_barriers.size(), -1);
+  for (u32 pass_index : range<u32>(rt.m_passes.size())) {
+    const RgRtPass &rt_pass = rt.m_passes[pass_index];
+    for (u32 event : Span(rt.m_set_events)
+                         .subspan(rt_pass.base_set_event,
+                                  rt_pass.num_set_events)) {
+      event_src_passes[event] = pass_index;
+    }
+  }
+
+  // Passes are labeled with their name and the barriers that are placed
+  // before them. Split barriers are drawn as edges from the pass that sets
+  // their event and waits for other queues as edges from the pass that is
+  // waited for.
+  for (u32 pass_index : range<u32>(rt.m_passes.size())) {
+    const RgRtPass &rt_pass = rt.m_passes[pass_index];
+    const RgPass &pass = bd.m_passes[rt_pass.pass];
+
+#if REN_RG_DEBUG
+    String label = escape_string(rt.m_pass_names[rt_pass.pass]);
+#else
+    String label = fmt::format("pass {}", pass_index);
+#endif
+    label += "\\l";
+    for (const VkMemoryBarrier2 &barrier :
+         Span(rt.m_memory_barriers)
+             .subspan(rt_pass.base_memory_barrier,
+                      rt_pass.num_memory_barriers)) {
+      label += fmt::format("barrier {}\\l", format_barrier(barrier));
+    }
+    for (u32 i : range(rt_pass.base_texture_barrier,
+                       rt_pass.base_texture_barrier +
+                           rt_pass.num_texture_barriers)) {
+      const VkImageMemoryBarrier2 &barrier = rt.m_texture_barriers[i];
+      const VkImageSubresourceRange &subresources = barrier.subresourceRange;
+      label += fmt::format(
+          "image barrier {} mips {}-{} layers {}-{} {} -> {} {}\\l",
+          get_texture_name(rt.m_texture_barrier_textures[i]),
+          subresources.baseMipLevel,
+          subresources.baseMipLevel + subresources.levelCount - 1,
+          subresources.baseArrayLayer,
+          subresources.baseArrayLayer + subresources.layerCount - 1,
+          format_layout(barrier.oldLayout), format_layout(barrier.newLayout),
+          format_barrier(barrier));
+    }
+    StringView color =
+        rt_pass.queue == RgQueue::AsyncCompute ? "lightsalmon" : "lightblue";
+    fmt::println(file,
+                 "  p{} [shape=box, style=filled, fillcolor={}, label=\"{}\"];",
+                 pass_index, color, label);
+
+    for (RgBufferUseId use_id : pass.read_buffers) {
+      const RgBufferUse &use = bd.m_buffer_uses[use_id];
+      fmt::println(file, "  b{} -> p{} [label=\"{}\"];",
+                   declare_buffer(use.buffer), pass_index,
+                   format_usage(use.usage.stage_mask, use.usage.access_mask));
+    }
+    for (RgBufferUseId use_id : pass.write_buffers) {
+      const RgBufferUse &use = bd.m_buffer_uses[use_id];
+      fmt::println(file, "  p{} -> b{} [label=\"{}\"];", pass_index,
+                   declare_buffer(use.buffer),
+                   format_usage(use.usage.stage_mask, use.usage.access_mask));
+    }
+    for (RgTextureUseId use_id : pass.read_textures) {
+      const RgTextureUse &use = bd.m_texture_uses[use_id];
+      fmt::println(file, "  t{} -> p{} [label=\"{}\\n{}\"];",
+                   declare_texture(use.texture), pass_index,
+                   format_usage(use.state.stage_mask, use.state.access_mask),
+                   format_layout(use.state.layout));
+    }
+    for (RgTextureUseId use_id : pass.write_textures) {
+      const RgTextureUse &use = bd.m_texture_uses[use_id];
+      fmt::println(file, "  p{} -> t{} [label=\"{}\\n{}\"];", pass_index,
+                   declare_texture(use.texture),
+                   format_usage(use.state.stage_mask, use.state.access_mask),
+                   format_layout(use.state.layout));
+    }
+
+    for (u32 event : range(rt_pass.base_wait_event,
+                           rt_pass.base_wait_event + rt_pass.num_wait_events)) {
+      fmt::println(file,
+                   "  p{} -> p{} [style=dashed, color=red, label=\"event "
+                   "{}\"];",
+                   event_src_passes[event], pass_index,
+                   format_barrier(rt.m_event_barriers[event]));
+    }
+    for (const RgQueueWait &wait :
+         Span(rt.m_queue_waits)
+             .subspan(rt_pass.base_queue_wait, rt_pass.num_queue_waits)) {
+      fmt::println(file,
+                   "  p{} -> p{} [style=dotted, color=blue, label=\"semaphore "
+                   "{}\"];",
+                   wait.src_pass, pass_index,
+                   format_stage_mask(wait.stage_mask));
+    }
+  }
+
+  fmt::println(file, "}}");
+}
+
+RgBuilder::RgBuilder(RgPersistent &rgp) {
+  m_device = rgp.m_device;
   m_rgp = &rgp;
   m_data = &rgp.m_build_data;
   m_rt_data = &rgp.m_rt_data;
-  m_descriptor_allocator = &descriptor_allocator;
+
+  // The previous graph has already been executed, so textures that were only
+  // used by it can be destroyed.
+  m_rgp->release_frame_resources();
 
   for (auto &&[_, texture] : m_rgp->m_textures) {
     texture.def = {};
@@ -248,7 +638,24 @@ RgBuilder::RgBuilder(RgPersistent &rgp, Renderer &renderer,
 #endif
   }
 
+  // Callbacks of the previous graph are no longer used, since it has already
+  // been executed.
+  m_rgp->m_callback_arena.reset();
+
+  m_rgp->rotate_buffers();
+
   auto &bd = *m_data;
+  for (auto &&[_, pass] : bd.m_passes) {
+    pass.read_buffers.clear();
+    pass.write_buffers.clear();
+    pass.read_textures.clear();
+    pass.write_textures.clear();
+    pass.wait_semaphores.clear();
+    pass.signal_semaphores.clear();
+    pass.queue = RgQueue::Graphics;
+    pass.ext = Monostate();
+    bd.m_pass_pool.push_back(std::move(pass));
+  }
   bd.m_passes.clear();
   bd.m_schedule.clear();
   bd.m_physical_buffers.clear();
@@ -256,19 +663,29 @@ RgBuilder::RgBuilder(RgPersistent &rgp, Renderer &renderer,
   bd.m_buffer_uses.clear();
   bd.m_texture_uses.clear();
   bd.m_semaphore_signals.clear();
+  bd.m_output_buffers.clear();
+  bd.m_output_textures.clear();
 
-  auto &gd = *m_rt_data;
 #if REN_RG_DEBUG
-  gd.m_pass_names.clear();
+  m_rt_data->m_pass_names.clear();
 #endif
-  gd.m_color_attachments.clear();
-  gd.m_depth_stencil_attachments.clear();
 }
 
 auto RgBuilder::create_pass(RgPassCreateInfo &&create_info) -> RgPassBuilder {
-  RgPassId pass = m_data->m_passes.emplace();
+  RgPassId pass;
+  if (m_data->m_pass_pool.empty()) {
+    pass = m_data->m_passes.emplace();
+  } else {
+    pass = m_data->m_passes.insert(std::move(m_data->m_pass_pool.back()));
+    m_data->m_pass_pool.pop_back();
+  }
+  if (m_rgp->m_async_compute and m_device->has_async_compute()) {
+    m_data->m_passes[pass].queue = create_info.queue;
+  }
 #if REN_RG_DEBUG
-  m_rt_data->m_pass_names.insert(pass, std::move(create_info.name));
+  const String &name =
+      *m_rgp->m_pass_name_pool.insert(std::move(create_info.name)).first;
+  m_rt_data->m_pass_names.insert(pass, name.c_str());
 #endif
   m_data->m_schedule.push_back(pass);
   return RgPassBuilder(pass, *this);
@@ -354,13 +771,17 @@ auto RgBuilder::write_buffer(RgPassId pass, RgDebugName name,
 }
 
 auto RgBuilder::add_texture_use(RgTextureId texture, const TextureState &usage,
-                                Handle<Sampler> sampler) -> RgTextureUseId {
+                                Handle<Sampler> sampler,
+                                const RgTextureSubresourceRange &range)
+    -> RgTextureUseId {
   ren_assert(texture);
+  ren_assert(range.num_mip_levels > 0 and range.num_array_layers > 0);
   RgTextureUseId id(m_data->m_texture_uses.size());
   m_data->m_texture_uses.push_back({
       .texture = texture,
       .sampler = sampler,
       .state = usage,
+      .range = range,
   });
   return id;
 }
@@ -389,7 +810,9 @@ auto RgBuilder::create_virtual_texture(RgPassId pass, RgDebugName name,
 
 auto RgBuilder::read_texture(RgPassId pass, RgTextureId texture,
                              const TextureState &usage, Handle<Sampler> sampler,
-                             u32 temporal_layer) -> RgTextureToken {
+                             u32 temporal_layer,
+                             const RgTextureSubresourceRange &range)
+    -> RgTextureToken {
   ren_assert(texture);
   if (sampler) {
     ren_assert_msg(usage.access_mask & VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
@@ -405,17 +828,18 @@ auto RgBuilder::read_texture(RgPassId pass, RgTextureId texture,
     texture = m_rgp->m_physical_textures[physical_texture + temporal_layer].id;
     ren_assert_msg(texture, "Temporal layer index out of range");
   }
-  RgTextureUseId use = add_texture_use(texture, usage, sampler);
+  RgTextureUseId use = add_texture_use(texture, usage, sampler, range);
   m_data->m_passes[pass].read_textures.push_back(use);
   return RgTextureToken(use);
 }
 
 auto RgBuilder::write_texture(RgPassId pass, RgDebugName name, RgTextureId src,
-                              const TextureState &usage)
+                              const TextureState &usage,
+                              const RgTextureSubresourceRange &range)
     -> std::tuple<RgTextureId, RgTextureToken> {
   ren_assert(src);
   ren_assert(m_rgp->m_textures[src].def != pass);
-  RgTextureUseId use = add_texture_use(src, usage);
+  RgTextureUseId use = add_texture_use(src, usage, NullHandle, range);
   m_data->m_passes[pass].write_textures.push_back(use);
   RgTextureId dst = create_virtual_texture(pass, std::move(name), src);
   return {dst, RgTextureToken(use)};
@@ -441,6 +865,59 @@ auto RgBuilder::write_texture(RgPassId pass, RgTextureId dst_id,
   return RgTextureToken(use);
 }
 
+auto RgBuilder::import_buffer(RgUntypedPersistentBufferId id,
+                              u32 temporal_layer) -> RgUntypedBufferId {
+  RgPersistentBuffer &buffer = m_rgp->m_buffers[id];
+  ren_assert_msg(temporal_layer < buffer.num_temporal_layers,
+                 "Temporal layer index out of range");
+  RgUntypedBufferId &rg_buffer = buffer.ids[temporal_layer];
+  if (rg_buffer) {
+    return rg_buffer;
+  }
+
+#if REN_RG_DEBUG
+  String name = buffer.num_temporal_layers == 1
+                    ? buffer.name
+                    : fmt::format("{}#{}", buffer.name, temporal_layer);
+#endif
+  rg_buffer = create_buffer({
+#if REN_RG_DEBUG
+      .name = name,
+#endif
+      .heap = buffer.heap,
+      .size = buffer.size,
+  });
+  set_external_buffer(rg_buffer,
+                      {
+                          .buffer = buffer.handles[temporal_layer],
+                          .count = buffer.size,
+                      },
+                      buffer.states[temporal_layer]);
+
+  u32 layer_bit = 1 << temporal_layer;
+  if (buffer.uninitialized_layers & layer_bit) {
+    buffer.uninitialized_layers &= ~layer_bit;
+    auto pass = create_pass({
+#if REN_RG_DEBUG
+        .name = fmt::format("rg#init-{}", name),
+#endif
+    });
+    RgUntypedBufferToken token;
+    std::tie(rg_buffer, token) = write_buffer(
+        pass.m_pass, "rg#initialized", rg_buffer, buffer.init_usage);
+    pass.set_callback([token, cb = buffer.init_cb](Renderer &renderer,
+                                                   const RgRuntime &rg,
+                                                   CommandRecorder &cmd) {
+      cb(rg.get_buffer(token), renderer, cmd);
+    });
+    // The pass that uses the buffer might have been created before it was
+    // imported, so schedule the init pass first.
+    std::ranges::rotate(m_data->m_schedule, m_data->m_schedule.end() - 1);
+  }
+
+  return rg_buffer;
+}
+
 void RgBuilder::set_external_buffer(RgUntypedBufferId id,
                                     const BufferView &view,
                                     const BufferState &state) {
@@ -491,6 +968,203 @@ void RgBuilder::set_external_semaphore(RgSemaphoreId semaphore,
   m_rgp->m_semaphores[semaphore].handle = handle;
 }
 
+void RgBuilder::set_output_buffer(RgUntypedBufferId id) {
+  ren_assert(id);
+  m_data->m_output_buffers.push_back(id);
+}
+
+void RgBuilder::set_output_texture(RgTextureId id) {
+  ren_assert(id);
+  m_data->m_output_textures.push_back(id);
+}
+
+void RgBuilder::cull_passes() {
+  GenMap<bool, RgPassId> &live_passes = m_data->m_live_passes;
+  live_passes.clear();
+
+  auto mark_live = [&](RgPassId pass) {
+    if (pass) {
+      live_passes.insert(pass, true);
+    }
+  };
+
+  for (RgUntypedBufferId buffer : m_data->m_output_buffers) {
+    mark_live(m_data->m_buffers[buffer].def);
+  }
+  for (RgTextureId texture : m_data->m_output_textures) {
+    mark_live(m_rgp->m_textures[texture].def);
+  }
+
+  // Passes with effects outside of the graph are always live: host passes,
+  // passes that wait for or signal semaphores, and passes that write to
+  // external buffers or to external or persistent textures.
+  auto is_sink = [&](const RgPass &pass) {
+    if (pass.ext.get<RgHostPass>() or not pass.wait_semaphores.empty() or
+        not pass.signal_semaphores.empty()) {
+      return true;
+    }
+    for (RgBufferUseId use : pass.write_buffers) {
+      RgPhysicalBufferId physical_buffer =
+          m_data->m_buffers[m_data->m_buffer_uses[use].buffer].parent;
+      if (m_data->m_physical_buffers[physical_buffer].view.buffer) {
+        return true;
+      }
+    }
+    for (RgTextureUseId use : pass.write_textures) {
+      RgPhysicalTextureId physical_texture =
+          m_rgp->m_textures[m_data->m_texture_uses[use].texture].parent;
+      if (m_rgp->m_persistent_textures[physical_texture] or
+          m_rgp->m_external_textures[physical_texture]) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Passes can only depend on passes that were created before them, so a
+  // single reverse sweep over the schedule finds all live passes.
+  for (RgPassId pass_id : m_data->m_schedule | std::views::reverse) {
+    const RgPass &pass = m_data->m_passes[pass_id];
+    if (not live_passes.contains(pass_id)) {
+      if (not is_sink(pass)) {
+        continue;
+      }
+      live_passes.insert(pass_id, true);
+    }
+    for (RgBufferUseId use : pass.read_buffers) {
+      mark_live(m_data->m_buffers[m_data->m_buffer_uses[use].buffer].def);
+    }
+    for (RgBufferUseId use : pass.write_buffers) {
+      mark_live(m_data->m_buffers[m_data->m_buffer_uses[use].buffer].def);
+    }
+    for (RgTextureUseId use : pass.read_textures) {
+      mark_live(m_rgp->m_textures[m_data->m_texture_uses[use].texture].def);
+    }
+    for (RgTextureUseId use : pass.write_textures) {
+      mark_live(m_rgp->m_textures[m_data->m_texture_uses[use].texture].def);
+    }
+  }
+
+#if REN_RG_DEBUG
+  bool has_culled_passes = false;
+  for (RgPassId pass_id : m_data->m_schedule) {
+    if (live_passes.contains(pass_id)) {
+      continue;
+    }
+    if (not has_culled_passes) {
+      fmt::println(stderr, "Culled passes:");
+      has_culled_passes = true;
+    }
+    fmt::println(stderr, "  * {}", m_rt_data->m_pass_names[pass_id]);
+  }
+  if (has_culled_passes) {
+    fmt::println(stderr, "");
+  }
+#endif
+
+  std::erase_if(m_data->m_schedule, [&](RgPassId pass_id) {
+    return not live_passes.contains(pass_id);
+  });
+}
+
+auto RgBuilder::reorder_passes() -> RgPassReorderingStats {
+  usize num_passes = m_data->m_schedule.size();
+
+  GenMap<u32, RgPassId> &pass_indices = m_data->m_pass_indices;
+  pass_indices.clear();
+  for (u32 i : range<u32>(num_passes)) {
+    pass_indices.insert(m_data->m_schedule[i], i);
+  }
+
+  // A pass depends on the passes that defined the resources that it reads or
+  // writes. Passes that overwrite a resource depend on all of its readers.
+  Vector<SmallVector<u32>> &dependencies = m_data->m_pass_dependencies;
+  dependencies.resize(num_passes);
+  for (SmallVector<u32> &pass_dependencies : dependencies) {
+    pass_dependencies.clear();
+  }
+  auto add_dependency = [&](RgPassId src, RgPassId dst) {
+    if (not src or not dst) {
+      return;
+    }
+    // Passes that were culled don't impose any constraints.
+    Optional<u32 &> src_index = pass_indices.try_get(src);
+    Optional<u32 &> dst_index = pass_indices.try_get(dst);
+    if (src_index and dst_index) {
+      dependencies[*dst_index].push_back(*src_index);
+    }
+  };
+
+  // Passes with effects outside of the graph keep their relative order.
+  RgPassId last_ordered_pass;
+
+  for (RgPassId pass_id : m_data->m_schedule) {
+    const RgPass &pass = m_data->m_passes[pass_id];
+    for (RgBufferUseId use : pass.read_buffers) {
+      const RgBuffer &buffer =
+          m_data->m_buffers[m_data->m_buffer_uses[use].buffer];
+      add_dependency(buffer.def, pass_id);
+      add_dependency(pass_id, buffer.kill);
+    }
+    for (RgBufferUseId use : pass.write_buffers) {
+      const RgBuffer &buffer =
+          m_data->m_buffers[m_data->m_buffer_uses[use].buffer];
+      add_dependency(buffer.def, pass_id);
+    }
+    for (RgTextureUseId use : pass.read_textures) {
+      const RgTexture &texture =
+          m_rgp->m_textures[m_data->m_texture_uses[use].texture];
+      add_dependency(texture.def, pass_id);
+      add_dependency(pass_id, texture.kill);
+    }
+    for (RgTextureUseId use : pass.write_textures) {
+      const RgTexture &texture =
+          m_rgp->m_textures[m_data->m_texture_uses[use].texture];
+      add_dependency(texture.def, pass_id);
+    }
+    if (pass.ext.get<RgHostPass>() or not pass.wait_semaphores.empty() or
+        not pass.signal_semaphores.empty()) {
+      add_dependency(last_ordered_pass, pass_id);
+      last_ordered_pass = pass_id;
+    }
+  }
+
+  for (SmallVector<u32> &pass_dependencies : dependencies) {
+    std::ranges::sort(pass_dependencies);
+    auto [first, last] = std::ranges::unique(pass_dependencies);
+    pass_dependencies.erase(first, last);
+  }
+
+  RgScheduleScratch &scratch = m_data->m_schedule_scratch;
+  Vector<u32> &schedule = m_data->m_new_pass_order;
+  schedule_passes(dependencies, scratch, schedule);
+
+  Vector<u32> &old_schedule = m_data->m_old_pass_order;
+  old_schedule.resize(num_passes);
+  std::ranges::iota(old_schedule, 0);
+  RgPassReorderingStats stats = {
+      .num_barrier_stalls_before =
+          count_barrier_stalls(dependencies, old_schedule, scratch),
+      .num_barrier_stalls_after =
+          count_barrier_stalls(dependencies, schedule, scratch),
+  };
+
+#if REN_RG_DEBUG
+  fmt::println(stderr,
+               "Estimated barrier stalls: {} before reordering, {} after",
+               stats.num_barrier_stalls_before, stats.num_barrier_stalls_after);
+  fmt::println(stderr, "");
+#endif
+
+  Vector<RgPassId> &old_schedule_ids = m_data->m_old_schedule;
+  old_schedule_ids = m_data->m_schedule;
+  for (u32 i : range<u32>(num_passes)) {
+    m_data->m_schedule[i] = old_schedule_ids[schedule[i]];
+  }
+
+  return stats;
+}
+
 void RgBuilder::dump_pass_schedule() const {
 #if REN_RG_DEBUG
   fmt::println(stderr, "Scheduled passes:");
@@ -633,8 +1307,13 @@ void RgBuilder::alloc_textures() {
   }
   m_rgp->m_texture_init_info.clear();
 
+  // Only textures that are used on both queues are shared between them.
+  // Others belong to the queue family that uses them, so no ownership
+  // transfers are needed.
+  Vector<u8> &texture_queues = m_data->m_texture_queues;
+  texture_queues.assign(m_rgp->m_physical_textures.size(), 0);
   bool need_alloc = false;
-  auto update_texture_usage_flags = [&](RgTextureUseId use_id) {
+  auto update_texture_usage_flags = [&](RgQueue queue, RgTextureUseId use_id) {
     const RgTextureUse &use = m_data->m_texture_uses[use_id];
     const RgTexture &texture = m_rgp->m_textures[use.texture];
     RgPhysicalTextureId physical_texture_id = texture.parent;
@@ -644,23 +1323,158 @@ void RgBuilder::alloc_textures() {
     bool needs_usage_update =
         (physical_texture.usage | usage) != physical_texture.usage;
     physical_texture.usage |= usage;
-    if (!physical_texture.handle or needs_usage_update) {
+    u8 &queues = texture_queues[physical_texture_id];
+    queues |= 1 << (usize)queue;
+    bool needs_sharing_update =
+        std::popcount(queues) > 1 and not physical_texture.concurrent;
+    physical_texture.concurrent |= needs_sharing_update;
+    if (!physical_texture.handle or needs_usage_update or
+        needs_sharing_update) {
       ren_assert(not m_rgp->m_external_textures[physical_texture_id]);
       need_alloc = true;
     }
   };
-  for (const auto &[_, pass] : m_data->m_passes) {
-    std::ranges::for_each(pass.read_textures, update_texture_usage_flags);
-    std::ranges::for_each(pass.write_textures, update_texture_usage_flags);
+  for (RgPassId pass_id : m_data->m_schedule) {
+    const RgPass &pass = m_data->m_passes[pass_id];
+    for (RgTextureUseId use : pass.read_textures) {
+      update_texture_usage_flags(pass.queue, use);
+    }
+    for (RgTextureUseId use : pass.write_textures) {
+      update_texture_usage_flags(pass.queue, use);
+    }
+  }
+
+  // Transient textures whose lifetimes in the schedule don't overlap share
+  // memory.
+  usize num_physical_textures = m_rgp->m_physical_textures.size();
+  Vector<RgTextureLifetime> &lifetimes = m_data->m_texture_lifetimes;
+  lifetimes.assign(num_physical_textures, {});
+  for (auto i : range<u32>(m_data->m_schedule.size())) {
+    const RgPass &pass = m_data->m_passes[m_data->m_schedule[i]];
+    auto update_lifetime = [&](RgTextureUseId use_id) {
+      const RgTextureUse &use = m_data->m_texture_uses[use_id];
+      RgTextureLifetime &lifetime =
+          lifetimes[m_rgp->m_textures[use.texture].parent];
+      lifetime.first = std::min(lifetime.first, i);
+      lifetime.last = std::max(lifetime.last, i);
+    };
+    std::ranges::for_each(pass.read_textures, update_lifetime);
+    std::ranges::for_each(pass.write_textures, update_lifetime);
+  }
+
+  // Reallocate if textures that share memory are now used at the same time.
+  if (not need_alloc) {
+    for (auto i : range(num_physical_textures)) {
+      u32 block = m_rgp->m_physical_textures[i].memory_block;
+      if (block == -1) {
+        continue;
+      }
+      for (auto j : range(i + 1, num_physical_textures)) {
+        if (m_rgp->m_physical_textures[j].memory_block == block and
+            lifetimes[i].overlaps(lifetimes[j])) {
+          need_alloc = true;
+        }
+      }
+    }
   }
 
   if (not need_alloc) {
     return;
   }
 
-  std::swap(m_rgp->m_texture_arena, m_rgp->m_prev_texture_arena);
+  auto get_texture_create_info =
+      [&](const RgPhysicalTexture &physical_texture) -> TextureCreateInfo {
+    return {
+#if REN_RG_DEBUG
+        .name = physical_texture.name,
+#endif
+        .type = physical_texture.type,
+        .format = physical_texture.format,
+        .usage = physical_texture.usage,
+        .width = physical_texture.size.x,
+        .height = physical_texture.size.y,
+        .depth = physical_texture.size.z,
+        .num_mip_levels = physical_texture.num_mip_levels,
+        .num_array_layers = physical_texture.num_array_layers,
+        .concurrent = physical_texture.concurrent,
+        .owner = MemoryOwner::RenderGraph,
+    };
+  };
+
+  std::swap(m_rgp->m_texture_handles, m_rgp->m_prev_texture_handles);
+  std::swap(m_rgp->m_texture_memory, m_rgp->m_prev_texture_memory);
+
+  // Greedily place transient textures, largest first, into the first memory
+  // block whose textures are all used at different times.
+  Vector<RgTextureMemoryBlock> &memory_blocks = m_data->m_texture_memory_blocks;
+  memory_blocks.clear();
+  Vector<std::tuple<usize, VkMemoryRequirements>> &transient_textures =
+      m_data->m_transient_textures;
+  transient_textures.clear();
+  for (auto i : range(num_physical_textures)) {
+    RgPhysicalTexture &physical_texture = m_rgp->m_physical_textures[i];
+    physical_texture.memory_block = -1;
+    // Temporal textures rotate their handles between layers, so they can't
+    // be transient.
+    bool is_temporal = i % RG_MAX_TEMPORAL_LAYERS == 0 and
+                       m_rgp->m_physical_textures[i + 1].id;
+    if (!physical_texture.usage or m_rgp->m_persistent_textures[i] or
+        m_rgp->m_external_textures[i] or is_temporal) {
+      continue;
+    }
+    transient_textures.push_back(
+        {i, m_device->get_texture_memory_requirements(
+                get_texture_create_info(physical_texture))});
+  }
+  std::ranges::stable_sort(transient_textures, std::ranges::greater(),
+                           [](const auto &t) { return std::get<1>(t).size; });
+
+  [[maybe_unused]] VkDeviceSize transient_texture_memory_size = 0;
+  for (const auto &transient_texture : transient_textures) {
+    usize i = std::get<0>(transient_texture);
+    const VkMemoryRequirements &requirements = std::get<1>(transient_texture);
+    transient_texture_memory_size += requirements.size;
+    auto can_alias = [&](const RgTextureMemoryBlock &block) {
+      return (block.requirements.memoryTypeBits &
+              requirements.memoryTypeBits) and
+             std::ranges::none_of(block.textures, [&](usize j) {
+               return lifetimes[i].overlaps(lifetimes[j]);
+             });
+    };
+    auto it = std::ranges::find_if(memory_blocks, can_alias);
+    if (it == memory_blocks.end()) {
+      memory_blocks.push_back({.requirements = requirements});
+      it = memory_blocks.end() - 1;
+    }
+    RgTextureMemoryBlock &block = *it;
+    block.requirements.size = std::max(block.requirements.size,
+                                       requirements.size);
+    block.requirements.alignment = std::max(block.requirements.alignment,
+                                            requirements.alignment);
+    block.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+    block.textures.push_back(i);
+  }
+
+  [[maybe_unused]] VkDeviceSize aliased_texture_memory_size = 0;
+  for (const RgTextureMemoryBlock &block : memory_blocks) {
+    u32 index = m_rgp->m_texture_memory.size();
+    m_rgp->m_texture_memory.push_back(
+        m_device->allocate_memory(block.requirements));
+    for (usize i : block.textures) {
+      m_rgp->m_physical_textures[i].memory_block = index;
+    }
+    aliased_texture_memory_size += block.requirements.size;
+  }
+
+#if REN_RG_DEBUG
+  fmt::println(stderr,
+               "Transient texture memory: {:.1f} MiB, {:.1f} MiB with "
+               "aliasing",
+               transient_texture_memory_size / (1024.0 * 1024.0),
+               aliased_texture_memory_size / (1024.0 * 1024.0));
+#endif
+
   m_rgp->m_num_prev_physical_textures = 0;
-  usize num_physical_textures = m_rgp->m_physical_textures.size();
   for (auto i : range(num_physical_textures)) {
     NotNull<RgPhysicalTexture *> physical_texture =
         &m_rgp->m_physical_textures[i];
@@ -704,19 +1518,13 @@ void RgBuilder::alloc_textures() {
       });
     }
 
-    physical_texture->handle = m_rgp->m_texture_arena.create_texture({
-#if REN_RG_DEBUG
-        .name = physical_texture->name,
-#endif
-        .type = physical_texture->type,
-        .format = physical_texture->format,
-        .usage = physical_texture->usage,
-        .width = physical_texture->size.x,
-        .height = physical_texture->size.y,
-        .depth = physical_texture->size.z,
-        .num_mip_levels = physical_texture->num_mip_levels,
-        .num_array_layers = physical_texture->num_array_layers,
-    });
+    TextureCreateInfo create_info = get_texture_create_info(*physical_texture);
+    if (physical_texture->memory_block != -1) {
+      create_info.alias_allocation =
+          m_rgp->m_texture_memory[physical_texture->memory_block];
+    }
+    physical_texture->handle = m_rgp->m_texture_handles.emplace_back(
+        m_device->create_texture(std::move(create_info)));
     physical_texture->state = {};
   }
 
@@ -727,39 +1535,159 @@ void RgBuilder::alloc_textures() {
   }
 }
 
-void RgBuilder::alloc_buffers(DeviceBumpAllocator &device_allocator,
-                              UploadBumpAllocator &upload_allocator) {
+void RgBuilder::alloc_buffers() {
+  // Don't allocate buffers that are only used by culled passes.
+  DynamicBitset &used_buffers = m_data->m_used_buffers;
+  used_buffers.clear();
+  used_buffers.resize(m_data->m_physical_buffers.size());
+  auto mark_used = [&](RgBufferUseId use) {
+    used_buffers.set(
+        m_data->m_buffers[m_data->m_buffer_uses[use].buffer].parent);
+  };
+  for (RgPassId pass_id : m_data->m_schedule) {
+    const RgPass &pass = m_data->m_passes[pass_id];
+    std::ranges::for_each(pass.read_buffers, mark_used);
+    std::ranges::for_each(pass.write_buffers, mark_used);
+  }
+
   for (auto i : range(m_data->m_physical_buffers.size())) {
     RgPhysicalBufferId id(i);
     RgPhysicalBuffer &physical_buffer = m_data->m_physical_buffers[id];
-    if (physical_buffer.view.buffer) {
+    if (physical_buffer.view.buffer or not used_buffers[i]) {
       continue;
     }
-    switch (BufferHeap heap = physical_buffer.heap) {
-    default:
-      unreachable("Unsupported RenderGraph buffer heap: {}", int(heap));
-    case BufferHeap::Static: {
-      physical_buffer.view =
-          device_allocator.allocate(physical_buffer.size).slice;
-    } break;
-    case BufferHeap::Dynamic:
-    case BufferHeap::Staging: {
-      physical_buffer.view =
-          upload_allocator.allocate(physical_buffer.size).slice;
-    } break;
+    physical_buffer.view =
+        m_device->allocate_buffer(physical_buffer.heap, physical_buffer.size);
+  }
+}
+
+void RgBuilder::get_structure_key(Vector<u64> &key) const {
+  key.clear();
+  auto push = [&](u64 value) { key.push_back(value); };
+
+  // Buffer views are patched in every frame, so only the initial states of
+  // physical buffers affect compiled data.
+  push(m_data->m_physical_buffers.size());
+  for (const RgPhysicalBuffer &physical_buffer : m_data->m_physical_buffers) {
+    push(physical_buffer.state.stage_mask);
+    push(physical_buffer.state.access_mask);
+  }
+
+  // Texture handles are patched into barriers, so only whether a texture is
+  // allocated matters. This allows external textures like swapchain images
+  // to change between frames.
+  push(m_rgp->m_physical_textures.size());
+  for (auto i : range(m_rgp->m_physical_textures.size())) {
+    const RgPhysicalTexture &physical_texture = m_rgp->m_physical_textures[i];
+    push(bool(physical_texture.handle));
+    // Barriers are placed for each mip level and array layer.
+    if (physical_texture.handle) {
+      const Texture &texture = m_device->get_texture(physical_texture.handle);
+      push(texture.num_mip_levels);
+      push(texture.num_array_layers);
+    }
+    push(physical_texture.state.stage_mask);
+    push(physical_texture.state.access_mask);
+    push(physical_texture.state.layout);
+    push(bool(m_rgp->m_persistent_textures[i]));
+    push(bool(m_rgp->m_external_textures[i]));
+    push(physical_texture.memory_block);
+  }
+
+  auto push_buffer_use = [&](RgBufferUseId use_id) {
+    const RgBufferUse &use = m_data->m_buffer_uses[use_id];
+    push(m_data->m_buffers[use.buffer].parent);
+    push(use.usage.stage_mask);
+    push(use.usage.access_mask);
+  };
+
+  auto push_texture_use = [&](RgTextureUseId use_id) {
+    const RgTextureUse &use = m_data->m_texture_uses[use_id];
+    push(m_rgp->m_textures[use.texture].parent);
+    push(use.state.stage_mask);
+    push(use.state.access_mask);
+    push(use.state.layout);
+    push(use.range.first_mip_level);
+    push(use.range.num_mip_levels);
+    push(use.range.first_array_layer);
+    push(use.range.num_array_layers);
+  };
+
+  auto push_semaphore_signal = [&](RgSemaphoreSignalId signal_id) {
+    // Semaphore handles and values are patched in every frame.
+    const RgSemaphoreSignal &signal = m_data->m_semaphore_signals[signal_id];
+    push(std::bit_cast<u32>(signal.semaphore));
+    push(signal.stage_mask);
+  };
+
+  push(m_data->m_schedule.size());
+  for (RgPassId pass_id : m_data->m_schedule) {
+    const RgPass &pass = m_data->m_passes[pass_id];
+
+    push(pass.read_buffers.size());
+    std::ranges::for_each(pass.read_buffers, push_buffer_use);
+    push(pass.write_buffers.size());
+    std::ranges::for_each(pass.write_buffers, push_buffer_use);
+    push(pass.read_textures.size());
+    std::ranges::for_each(pass.read_textures, push_texture_use);
+    push(pass.write_textures.size());
+    std::ranges::for_each(pass.write_textures, push_texture_use);
+    push(pass.wait_semaphores.size());
+    std::ranges::for_each(pass.wait_semaphores, push_semaphore_signal);
+    push(pass.signal_semaphores.size());
+    std::ranges::for_each(pass.signal_semaphores, push_semaphore_signal);
+
+    push((u64)pass.queue);
+    push(pass.ext.index());
+    if (auto graphics_pass = pass.ext.get<RgGraphicsPass>()) {
+      push(graphics_pass->color_attachments.size());
+      for (const Optional<RgColorAttachment> &att :
+           graphics_pass->color_attachments) {
+        push(bool(att));
+        if (att) {
+          push(u32(att->texture));
+          push(att->ops.load);
+          push(att->ops.store);
+          for (auto c : range(4)) {
+            push(std::bit_cast<u32>(att->ops.clear_color[c]));
+          }
+        }
+      }
+      const auto &att = graphics_pass->depth_stencil_attachment;
+      push(bool(att));
+      if (att) {
+        push(u32(att->texture));
+        push(bool(att->depth_ops));
+        if (att->depth_ops) {
+          push(att->depth_ops->load);
+          push(att->depth_ops->store);
+          push(std::bit_cast<u32>(att->depth_ops->clear_depth));
+        }
+        push(bool(att->stencil_ops));
+        if (att->stencil_ops) {
+          push(att->stencil_ops->load);
+          push(att->stencil_ops->store);
+        }
+      }
     }
   }
+
 }
 
 void RgBuilder::init_runtime_passes() {
   auto &rt_passes = m_rt_data->m_passes;
   rt_passes.clear();
   rt_passes.reserve(m_data->m_schedule.size());
+  m_rt_data->m_color_attachments.clear();
+  m_rt_data->m_depth_stencil_attachments.clear();
 
   for (RgPassId pass_id : m_data->m_schedule) {
     RgPass &pass = m_data->m_passes[pass_id];
     RgRtPass &rt_pass = m_rt_data->m_passes.emplace_back();
-    rt_pass = {.pass = pass_id};
+    rt_pass = {
+        .pass = pass_id,
+        .queue = pass.queue,
+    };
     pass.ext.visit(OverloadSet{
         [&](Monostate) {
           unreachable("Callback for pass {} has not been "
@@ -775,6 +1703,7 @@ void RgBuilder::init_runtime_passes() {
           rt_pass.ext = RgRtHostPass{.cb = std::move(host_pass.cb)};
         },
         [&](RgGraphicsPass &graphics_pass) {
+          ren_assert(pass.queue == RgQueue::Graphics);
           rt_pass.ext = RgRtGraphicsPass{
               .base_color_attachment =
                   u32(m_rt_data->m_color_attachments.size()),
@@ -803,6 +1732,33 @@ void RgBuilder::init_runtime_passes() {
   }
 }
 
+void RgBuilder::patch_runtime_passes() {
+  auto &rt_passes = m_rt_data->m_passes;
+  ren_assert(rt_passes.size() == m_data->m_schedule.size());
+  for (auto i : range(rt_passes.size())) {
+    RgPassId pass_id = m_data->m_schedule[i];
+    RgPass &pass = m_data->m_passes[pass_id];
+    RgRtPass &rt_pass = rt_passes[i];
+    rt_pass.pass = pass_id;
+    pass.ext.visit(OverloadSet{
+        [&](Monostate) { unreachable("Callback for pass has not been set!"); },
+        [&](RgHostPass &host_pass) {
+          rt_pass.ext.get<RgRtHostPass>()->cb = std::move(host_pass.cb);
+        },
+        [&](RgGraphicsPass &graphics_pass) {
+          rt_pass.ext.get<RgRtGraphicsPass>()->cb =
+              std::move(graphics_pass.cb);
+        },
+        [&](RgComputePass &compute_pass) {
+          rt_pass.ext.get<RgRtComputePass>()->cb = std::move(compute_pass.cb);
+        },
+        [&](RgGenericPass &pass) {
+          rt_pass.ext.get<RgRtGenericPass>()->cb = std::move(pass.cb);
+        },
+    });
+  }
+}
+
 void RgBuilder::init_runtime_buffers() {
   auto &rt_buffers = m_rt_data->m_buffers;
   const auto &buffer_uses = m_data->m_buffer_uses;
@@ -814,6 +1770,16 @@ void RgBuilder::init_runtime_buffers() {
   }
 }
 
+void RgBuilder::update_persistent_buffer_states() {
+  for (auto &&[_, buffer] : m_rgp->m_buffers) {
+    for (usize i : range(buffer.num_temporal_layers)) {
+      if (buffer.ids[i]) {
+        buffer.states[i] = get_final_buffer_state(buffer.ids[i]);
+      }
+    }
+  }
+}
+
 void RgBuilder::init_runtime_textures() {
   auto &rt_textures = m_rt_data->m_textures;
   const auto &texture_uses = m_data->m_texture_uses;
@@ -828,6 +1794,10 @@ void RgBuilder::init_runtime_textures() {
     const RgPhysicalTexture &physical_texture =
         physical_textures[physical_texture_id];
     rt_textures[i] = physical_texture.handle;
+    // Textures that are only used by culled passes are not allocated.
+    if (!physical_texture.handle) {
+      continue;
+    }
     num_storage_texture_descriptors +=
         use.state.access_mask & (VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
                                  VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
@@ -848,15 +1818,62 @@ void RgBuilder::init_runtime_textures() {
     const RgPhysicalTexture &physical_texture =
         physical_textures[physical_texture_id];
     RgTextureDescriptors &descriptors = rt_texture_descriptors[i];
+    descriptors = {};
+    if (!physical_texture.handle) {
+      continue;
+    }
+
+    TextureView view = m_device->get_texture_view(physical_texture.handle);
+    // Only the used subresources are guaranteed to be in the use's layout,
+    // so views of other ranges than the whole texture are created for a
+    // single frame. Storage views of single mip levels of all array layers
+    // are the same as the cached ones.
+    if (use.range != RgTextureSubresourceRange()) {
+      RgTextureSubresourceRange subresources = resolve_subresource_range(
+          use.range, view.num_mip_levels, view.num_array_layers);
+      bool all_layers = subresources.first_array_layer == 0 and
+                        subresources.num_array_layers == view.num_array_layers;
+      view.first_array_layer = subresources.first_array_layer;
+      view.num_array_layers = subresources.num_array_layers;
+      if (use.state.access_mask & VK_ACCESS_2_SHADER_SAMPLED_READ_BIT) {
+        view.first_mip_level = subresources.first_mip_level;
+        view.num_mip_levels = subresources.num_mip_levels;
+        if (use.sampler) {
+          descriptors.combined =
+              m_device->allocate_sampled_texture(view, use.sampler);
+        } else {
+          descriptors.sampled = m_device->allocate_texture(view);
+        }
+      } else if (use.state.access_mask &
+                 (VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                  VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)) {
+        // Storage descriptors are still indexed by mip level.
+        view.num_mip_levels = 1;
+        descriptors.storage =
+            &rt_storage_texture_descriptors[num_storage_texture_descriptors];
+        std::fill_n(descriptors.storage, physical_texture.num_mip_levels,
+                    glsl::RWStorageTexture());
+        for (u32 mip = subresources.first_mip_level;
+             mip < subresources.first_mip_level + subresources.num_mip_levels;
+             ++mip) {
+          view.first_mip_level = mip;
+          descriptors.storage[mip] =
+              all_layers
+                  ? alloc_storage_texture_descriptor(physical_texture_id, view)
+                  : m_device->allocate_storage_texture(view);
+        }
+        num_storage_texture_descriptors += physical_texture.num_mip_levels;
+      }
+      continue;
+    }
 
-    TextureView view = m_renderer->get_texture_view(physical_texture.handle);
     if (use.state.access_mask & VK_ACCESS_2_SHADER_SAMPLED_READ_BIT) {
       if (use.sampler) {
-        descriptors.combined = m_descriptor_allocator->allocate_sampled_texture(
-            *m_renderer, view, use.sampler);
+        descriptors.combined = alloc_sampled_texture_descriptor(
+            physical_texture_id, view, use.sampler);
       } else {
         descriptors.sampled =
-            m_descriptor_allocator->allocate_texture(*m_renderer, view);
+            alloc_texture_descriptor(physical_texture_id, view);
       }
     } else if (use.state.access_mask & (VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
                                         VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)) {
@@ -866,7 +1883,7 @@ void RgBuilder::init_runtime_textures() {
       for (i32 mip = 0; mip < physical_texture.num_mip_levels; ++mip) {
         view.first_mip_level = mip;
         descriptors.storage[mip] =
-            m_descriptor_allocator->allocate_storage_texture(*m_renderer, view);
+            alloc_storage_texture_descriptor(physical_texture_id, view);
       }
 
       num_storage_texture_descriptors += physical_texture.num_mip_levels;
@@ -874,6 +1891,57 @@ void RgBuilder::init_runtime_textures() {
   }
 }
 
+// Descriptors of textures owned by the render graph are cached until the
+// textures are destroyed. External textures can be destroyed behind the render
+// graph's back, so their descriptors are only valid for a frame.
+
+auto RgBuilder::alloc_texture_descriptor(RgPhysicalTextureId physical_texture,
+                                         const TextureView &view)
+    -> glsl::Texture {
+  if (m_rgp->m_external_textures[physical_texture]) {
+    return m_device->allocate_texture(view);
+  }
+  glsl::Texture &descriptor =
+      m_rgp->m_texture_descriptors[view.texture].sampled;
+  if (!descriptor) {
+    descriptor = m_device->allocate_persistent_texture(view);
+  }
+  return descriptor;
+}
+
+auto RgBuilder::alloc_sampled_texture_descriptor(
+    RgPhysicalTextureId physical_texture, const TextureView &view,
+    Handle<Sampler> sampler) -> glsl::SampledTexture {
+  if (m_rgp->m_external_textures[physical_texture]) {
+    return m_device->allocate_sampled_texture(view, sampler);
+  }
+  auto &descriptors = m_rgp->m_texture_descriptors[view.texture].combined;
+  if (Optional<glsl::SampledTexture &> descriptor = descriptors.get(sampler)) {
+    return *descriptor;
+  }
+  glsl::SampledTexture descriptor =
+      m_device->allocate_persistent_sampled_texture(view, sampler);
+  descriptors.insert(sampler, descriptor);
+  return descriptor;
+}
+
+auto RgBuilder::alloc_storage_texture_descriptor(
+    RgPhysicalTextureId physical_texture,
+    const TextureView &view) -> glsl::RWStorageTexture {
+  if (m_rgp->m_external_textures[physical_texture]) {
+    return m_device->allocate_storage_texture(view);
+  }
+  auto &descriptors = m_rgp->m_texture_descriptors[view.texture].storage;
+  u32 mip = view.first_mip_level;
+  if (descriptors.size() <= mip) {
+    descriptors.resize(mip + 1);
+  }
+  if (!descriptors[mip]) {
+    descriptors[mip] = m_device->allocate_persistent_storage_texture(view);
+  }
+  return descriptors[mip];
+}
+
 void RgBuilder::place_barriers_and_semaphores() {
   constexpr VkAccessFlags2 READ_ONLY_ACCESS_MASK =
       VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT |
@@ -889,10 +1957,39 @@ void RgBuilder::place_barriers_and_semaphores() {
       VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
       VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
 
+  // Stages and accesses that are supported by the async compute queue.
+  constexpr VkPipelineStageFlags2 ASYNC_COMPUTE_STAGE_MASK =
+      VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+      VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT | VK_PIPELINE_STAGE_2_HOST_BIT |
+      VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+  constexpr VkAccessFlags2 ASYNC_COMPUTE_ACCESS_MASK =
+      VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_UNIFORM_READ_BIT |
+      VK_ACCESS_2_SHADER_SAMPLED_READ_BIT |
+      VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_READ_BIT |
+      VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_READ_BIT |
+      VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT |
+      VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+  // Index of the pass that last read from a resource on each queue.
+  using QueuePasses = std::array<u32, RG_NUM_QUEUES>;
+  QueuePasses no_passes;
+  no_passes.fill(-1);
+
   Vector<BufferState> buffer_after_write_hazard_src_states(
       m_data->m_physical_buffers.size());
   Vector<VkPipelineStageFlags2> buffer_after_read_hazard_src_states(
       m_data->m_physical_buffers.size());
+  // Index of the pass that last wrote to or read from each resource in this
+  // frame, or -1.
+  Vector<u32> buffer_last_write_passes(m_data->m_physical_buffers.size(), -1);
+  Vector<QueuePasses> buffer_last_read_passes(m_data->m_physical_buffers.size(),
+                                              no_passes);
+  // Stages and accesses that the last write to each resource has been made
+  // visible to.
+  Vector<BufferState> buffer_visible_states(m_data->m_physical_buffers.size());
 
   for (auto i : range(m_data->m_physical_buffers.size())) {
     RgPhysicalBuffer &physical_buffer = m_data->m_physical_buffers[i];
@@ -903,15 +2000,35 @@ void RgBuilder::place_barriers_and_semaphores() {
           .access_mask = state.access_mask & WRITE_ONLY_ACCESS_MASK,
       };
     } else {
-      buffer_after_read_hazard_src_states[i] = state.access_mask;
+      buffer_after_read_hazard_src_states[i] = state.stage_mask;
     }
   }
 
+  // Texture states are tracked for each mip level and array layer. The states
+  // of a texture's subresources are stored starting at its offset.
+  Vector<u32> texture_subresource_offsets(m_rgp->m_physical_textures.size() +
+                                          1);
+  for (auto i : range(m_rgp->m_physical_textures.size())) {
+    Handle<Texture> handle = m_rgp->m_physical_textures[i].handle;
+    u32 num_subresources = 0;
+    if (handle) {
+      const Texture &texture = m_device->get_texture(handle);
+      num_subresources = texture.num_mip_levels * texture.num_array_layers;
+    }
+    texture_subresource_offsets[i + 1] =
+        texture_subresource_offsets[i] + num_subresources;
+  }
+  u32 num_texture_subresources = texture_subresource_offsets.back();
+
   Vector<MemoryState> texture_after_write_hazard_src_states(
-      m_rgp->m_physical_textures.size());
+      num_texture_subresources);
   Vector<VkPipelineStageFlags2> texture_after_read_hazard_src_states(
-      m_rgp->m_physical_textures.size());
-  Vector<VkImageLayout> texture_layouts(m_rgp->m_physical_textures.size());
+      num_texture_subresources);
+  Vector<VkImageLayout> texture_layouts(num_texture_subresources);
+  Vector<u32> texture_last_write_passes(num_texture_subresources, -1);
+  Vector<QueuePasses> texture_last_read_passes(num_texture_subresources,
+                                               no_passes);
+  Vector<MemoryState> texture_visible_states(num_texture_subresources);
 
   for (auto i : range(m_rgp->m_physical_textures.size())) {
     RgPhysicalTexture &physical_texture = m_rgp->m_physical_textures[i];
@@ -919,43 +2036,174 @@ void RgBuilder::place_barriers_and_semaphores() {
       continue;
     }
     const TextureState &state = physical_texture.state;
-    if (state.access_mask & WRITE_ONLY_ACCESS_MASK) {
-      texture_after_write_hazard_src_states[i] = {
-          .stage_mask = state.stage_mask,
-          .access_mask = state.access_mask & WRITE_ONLY_ACCESS_MASK,
-      };
-    } else {
-      texture_after_read_hazard_src_states[i] = state.access_mask;
-    }
-    texture_layouts[i] =
+    VkImageLayout layout =
         m_rgp->m_persistent_textures[i] or m_rgp->m_external_textures[i]
             ? state.layout
             : VK_IMAGE_LAYOUT_UNDEFINED;
+    for (u32 subresource : range(texture_subresource_offsets[i],
+                                 texture_subresource_offsets[i + 1])) {
+      if (state.access_mask & WRITE_ONLY_ACCESS_MASK) {
+        texture_after_write_hazard_src_states[subresource] = {
+            .stage_mask = state.stage_mask,
+            .access_mask = state.access_mask & WRITE_ONLY_ACCESS_MASK,
+        };
+      } else {
+        texture_after_read_hazard_src_states[subresource] = state.stage_mask;
+      }
+      texture_layouts[subresource] = layout;
+    }
   }
 
   auto &m_memory_barriers = m_rt_data->m_memory_barriers;
   auto &m_texture_barriers = m_rt_data->m_texture_barriers;
+  auto &m_texture_barrier_textures = m_rt_data->m_texture_barrier_textures;
+  auto &m_event_barriers = m_rt_data->m_event_barriers;
+  auto &m_queue_waits = m_rt_data->m_queue_waits;
   auto &m_semaphore_submit_info = m_rt_data->m_semaphore_submit_info;
   m_memory_barriers.clear();
   m_texture_barriers.clear();
+  m_texture_barrier_textures.clear();
+  m_event_barriers.clear();
+  m_queue_waits.clear();
   m_semaphore_submit_info.clear();
   const auto &m_buffer_uses = m_data->m_buffer_uses;
   const auto &m_buffers = m_data->m_buffers;
   const auto &m_texture_uses = m_data->m_texture_uses;
   const auto &m_textures = m_rgp->m_textures;
 
-  m_memory_barriers.clear();
-  m_texture_barriers.clear();
+  // Index of the pass after which each event is set.
+  Vector<u32> event_src_passes;
+
+  // Records that the last write to a resource is made visible to a read.
+  // Returns false if a previous barrier has already done that, in which case
+  // the read doesn't need a new one.
+  auto make_visible = [](MemoryState &visible_state,
+                         VkPipelineStageFlags2 stage_mask,
+                         VkAccessFlags2 access_mask) -> bool {
+    if (not(stage_mask & ~visible_state.stage_mask) and
+        not(access_mask & ~visible_state.access_mask)) {
+      return false;
+    }
+    // Only widen the visible state if each of its stages will still be
+    // covered for each of its accesses.
+    if (access_mask == visible_state.access_mask) {
+      visible_state.stage_mask |= stage_mask;
+    } else if (stage_mask == visible_state.stage_mask) {
+      visible_state.access_mask |= access_mask;
+    } else {
+      visible_state = {
+          .stage_mask = stage_mask,
+          .access_mask = access_mask,
+      };
+    }
+    return true;
+  };
 
-  for (RgRtPass &rt_pass : m_rt_data->m_passes) {
+  for (u32 pass_index : range<u32>(m_rt_data->m_passes.size())) {
+    RgRtPass &rt_pass = m_rt_data->m_passes[pass_index];
     const RgPass &pass = m_data->m_passes[rt_pass.pass];
 
     usize old_memory_barrier_count = m_memory_barriers.size();
     usize old_texture_barrier_count = m_texture_barriers.size();
+    usize old_event_count = m_event_barriers.size();
+    usize old_queue_wait_count = m_queue_waits.size();
     usize old_semaphore_count = m_semaphore_submit_info.size();
 
-    // TODO: merge separate barriers together if it
-    // doesn't change how synchronization happens
+    RgQueue queue = rt_pass.queue;
+
+    // Dependencies on passes on another queue are resolved by waiting for
+    // their submission's timeline semaphore value, which also makes all of
+    // their writes available and visible. Returns false if the source pass
+    // is on the same queue.
+    auto wait_for_pass = [&](u32 src_pass,
+                             VkPipelineStageFlags2 stage_mask) -> bool {
+      if (src_pass == -1 or m_rt_data->m_passes[src_pass].queue == queue) {
+        return false;
+      }
+      RgQueue src_queue = m_rt_data->m_passes[src_pass].queue;
+      for (RgQueueWait &wait :
+           Span(m_queue_waits).subspan(old_queue_wait_count)) {
+        if (m_rt_data->m_passes[wait.src_pass].queue == src_queue) {
+          wait.src_pass = std::max(wait.src_pass, src_pass);
+          wait.stage_mask |= stage_mask;
+          return true;
+        }
+      }
+      m_queue_waits.push_back({
+          .src_pass = src_pass,
+          .stage_mask = stage_mask,
+      });
+      return true;
+    };
+
+    // Waits for the last reads from a resource on other queues and returns
+    // the last read on this one.
+    auto wait_for_reads = [&](const QueuePasses &src_passes,
+                              VkPipelineStageFlags2 stage_mask) -> u32 {
+      for (u32 src_pass : src_passes) {
+        wait_for_pass(src_pass, stage_mask);
+      }
+      return src_passes[(usize)queue];
+    };
+
+    // Stages of other queues can't be used in barriers on the async compute
+    // queue. Work on other queues is synchronized with semaphores instead.
+    auto mask_src_scope = [&](VkPipelineStageFlags2 &stage_mask,
+                              VkAccessFlags2 &access_mask) {
+      if (queue == RgQueue::AsyncCompute) {
+        stage_mask &= ASYNC_COMPUTE_STAGE_MASK;
+        access_mask &= ASYNC_COMPUTE_ACCESS_MASK;
+        if (!stage_mask) {
+          access_mask = VK_ACCESS_2_NONE;
+        }
+      }
+    };
+
+    // If other passes were scheduled between the source pass and this one,
+    // split the barrier: signal an event after the source pass and wait for
+    // it before this one, so that the passes in between are not blocked.
+    // Otherwise, merge it with another global memory barrier of this pass if
+    // they share source or destination stages, which doesn't change how
+    // synchronization happens.
+    auto place_memory_barrier = [&](u32 src_pass, VkMemoryBarrier2 barrier) {
+      if (wait_for_pass(src_pass, barrier.dstStageMask)) {
+        return;
+      }
+      mask_src_scope(barrier.srcStageMask, barrier.srcAccessMask);
+      if (!barrier.srcStageMask) {
+        return;
+      }
+
+      auto merge = [&](VkMemoryBarrier2 &dst) {
+        dst.srcStageMask |= barrier.srcStageMask;
+        dst.srcAccessMask |= barrier.srcAccessMask;
+        dst.dstStageMask |= barrier.dstStageMask;
+        dst.dstAccessMask |= barrier.dstAccessMask;
+      };
+
+      if (src_pass != -1 and src_pass + 1 < pass_index) {
+        for (usize i : range(old_event_count, m_event_barriers.size())) {
+          if (event_src_passes[i] == src_pass) {
+            merge(m_event_barriers[i]);
+            return;
+          }
+        }
+        m_event_barriers.push_back(barrier);
+        event_src_passes.push_back(src_pass);
+        return;
+      }
+
+      for (VkMemoryBarrier2 &dst :
+           Span(m_memory_barriers).subspan(old_memory_barrier_count)) {
+        if (dst.srcStageMask == barrier.srcStageMask or
+            dst.dstStageMask == barrier.dstStageMask) {
+          merge(dst);
+          return;
+        }
+      }
+      m_memory_barriers.push_back(barrier);
+    };
+
     auto maybe_place_barrier_for_buffer = [&](RgBufferUseId use_id) {
       const RgBufferUse &use = m_buffer_uses[use_id];
       RgPhysicalBufferId physical_buffer = m_buffers[use.buffer].parent;
@@ -973,6 +2221,8 @@ void RgBuilder::place_barriers_and_semaphores() {
 
       VkPipelineStageFlags2 src_stage_mask = VK_PIPELINE_STAGE_2_NONE;
       VkAccessFlagBits2 src_access_mask = VK_ACCESS_2_NONE;
+      VkAccessFlagBits2 barrier_dst_access_mask = dst_access_mask;
+      u32 src_pass = -1;
 
       if (dst_access_mask & WRITE_ONLY_ACCESS_MASK) {
         BufferState &after_write_state =
@@ -982,16 +2232,25 @@ void RgBuilder::place_barriers_and_semaphores() {
         src_stage_mask =
             std::exchange(buffer_after_read_hazard_src_states[physical_buffer],
                           VK_PIPELINE_STAGE_2_NONE);
-        // If this is a WAR hazard, need to
-        // wait for all previous reads to
-        // finish. The previous write's memory
-        // has already been made available by
-        // previous RAW barriers, so it only
-        // needs to be made visible
-        // FIXME: According to the Vulkan spec,
-        // WAR hazards require only an
-        // execution barrier
-        if (src_stage_mask == VK_PIPELINE_STAGE_2_NONE) {
+        src_pass = wait_for_reads(
+            std::exchange(buffer_last_read_passes[physical_buffer], no_passes),
+            dst_stage_mask);
+        if (src_stage_mask != VK_PIPELINE_STAGE_2_NONE) {
+          // This is a WAR hazard, which only
+          // requires an execution dependency on
+          // all previous reads. The previous
+          // write's memory has already been made
+          // available by previous RAW barriers,
+          // so it only needs to be made visible
+          // if this use also reads
+          barrier_dst_access_mask &= ~WRITE_ONLY_ACCESS_MASK;
+          if (barrier_dst_access_mask) {
+            wait_for_pass(buffer_last_write_passes[physical_buffer],
+                          dst_stage_mask);
+            src_stage_mask |= after_write_state.stage_mask;
+            src_access_mask = after_write_state.access_mask;
+          }
+        } else {
           // No reads were performed between
           // this write and the previous one so
           // this is a WAW hazard. Need to wait
@@ -1000,7 +2259,10 @@ void RgBuilder::place_barriers_and_semaphores() {
           // visible
           src_stage_mask = after_write_state.stage_mask;
           src_access_mask = after_write_state.access_mask;
+          src_pass = buffer_last_write_passes[physical_buffer];
         }
+        buffer_last_write_passes[physical_buffer] = pass_index;
+        buffer_visible_states[physical_buffer] = {};
         // Update the source stage and access
         // masks that further RAW and WAW
         // hazards will use
@@ -1010,21 +2272,27 @@ void RgBuilder::place_barriers_and_semaphores() {
         after_write_state.access_mask =
             dst_access_mask & WRITE_ONLY_ACCESS_MASK;
       } else {
+        // Update the source stage mask that
+        // the next WAR hazard will use
+        buffer_after_read_hazard_src_states[physical_buffer] |= dst_stage_mask;
+        buffer_last_read_passes[physical_buffer][(usize)queue] = pass_index;
         // This is a RAW hazard. Need to wait
         // for the previous write to finish and
         // make it's memory available and
-        // visible
-        // TODO/FIXME: all RAW barriers should
-        // be merged, since if they are issued
-        // separately they might cause the
-        // cache to be flushed multiple times
+        // visible, unless a previous read in
+        // the same stages already did that
+        src_pass = buffer_last_write_passes[physical_buffer];
+        if (wait_for_pass(src_pass, dst_stage_mask)) {
+          return;
+        }
+        if (not make_visible(buffer_visible_states[physical_buffer],
+                             dst_stage_mask, dst_access_mask)) {
+          return;
+        }
         const BufferState &after_write_state =
             buffer_after_write_hazard_src_states[physical_buffer];
         src_stage_mask = after_write_state.stage_mask;
         src_access_mask = after_write_state.access_mask;
-        // Update the source stage mask that
-        // the next WAR hazard will use
-        buffer_after_read_hazard_src_states[physical_buffer] |= dst_stage_mask;
       }
 
       // First barrier isn't required and can
@@ -1035,127 +2303,280 @@ void RgBuilder::place_barriers_and_semaphores() {
         return;
       }
 
-      m_memory_barriers.push_back({
-          .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
-          .srcStageMask = src_stage_mask,
-          .srcAccessMask = src_access_mask,
-          .dstStageMask = dst_stage_mask,
-          .dstAccessMask = dst_access_mask,
-      });
+      place_memory_barrier(src_pass,
+                           {
+                               .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                               .srcStageMask = src_stage_mask,
+                               .srcAccessMask = src_access_mask,
+                               .dstStageMask = dst_stage_mask,
+                               .dstAccessMask = barrier_dst_access_mask,
+                           });
     };
 
     std::ranges::for_each(pass.read_buffers, maybe_place_barrier_for_buffer);
     std::ranges::for_each(pass.write_buffers, maybe_place_barrier_for_buffer);
 
-    auto maybe_place_barrier_for_texture = [&](RgTextureUseId use_id) {
-      const RgTextureUse &use = m_texture_uses[use_id];
-      RgPhysicalTextureId physical_texture = m_textures[use.texture].parent;
-
-      VkPipelineStageFlags2 dst_stage_mask = use.state.stage_mask;
-      VkAccessFlags2 dst_access_mask = use.state.access_mask;
-      VkImageLayout dst_layout = use.state.layout;
-      ren_assert(dst_layout);
-      if (dst_layout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
-        ren_assert(dst_stage_mask);
-        ren_assert(dst_access_mask);
-      }
+    // Index of this pass's first image barrier for the current texture use.
+    usize use_texture_barrier_begin = 0;
+
+    auto maybe_place_barrier_for_subresource =
+        [&](const RgTextureUse &use, RgPhysicalTextureId physical_texture,
+            const Texture &texture, u32 mip, u32 layer) {
+          u32 subresource = texture_subresource_offsets[physical_texture] +
+                            mip * texture.num_array_layers + layer;
+
+          VkPipelineStageFlags2 dst_stage_mask = use.state.stage_mask;
+          VkAccessFlags2 dst_access_mask = use.state.access_mask;
+          VkImageLayout dst_layout = use.state.layout;
+
+          VkImageLayout &src_layout = texture_layouts[subresource];
+
+          if (dst_layout == src_layout) {
+            // Only a memory barrier is required if
+            // layout doesn't change NOTE: this code is
+            // copy-pasted from above
+
+            VkPipelineStageFlags2 src_stage_mask = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlagBits2 src_access_mask = VK_ACCESS_2_NONE;
+            VkAccessFlagBits2 barrier_dst_access_mask = dst_access_mask;
+            u32 src_pass = -1;
+
+            if (dst_access_mask & WRITE_ONLY_ACCESS_MASK) {
+              MemoryState &after_write_state =
+                  texture_after_write_hazard_src_states[subresource];
+              src_stage_mask = std::exchange(
+                  texture_after_read_hazard_src_states[subresource],
+                  VK_PIPELINE_STAGE_2_NONE);
+              src_pass = wait_for_reads(
+                  std::exchange(texture_last_read_passes[subresource],
+                                no_passes),
+                  dst_stage_mask);
+              if (src_stage_mask != VK_PIPELINE_STAGE_2_NONE) {
+                barrier_dst_access_mask &= ~WRITE_ONLY_ACCESS_MASK;
+                if (barrier_dst_access_mask) {
+                  wait_for_pass(texture_last_write_passes[subresource],
+                                dst_stage_mask);
+                  src_stage_mask |= after_write_state.stage_mask;
+                  src_access_mask = after_write_state.access_mask;
+                }
+              } else {
+                src_stage_mask = after_write_state.stage_mask;
+                src_access_mask = after_write_state.access_mask;
+                src_pass = texture_last_write_passes[subresource];
+              }
+              after_write_state.stage_mask = dst_stage_mask;
+              after_write_state.access_mask =
+                  dst_access_mask & WRITE_ONLY_ACCESS_MASK;
+              texture_last_write_passes[subresource] = pass_index;
+              texture_visible_states[subresource] = {};
+            } else {
+              texture_after_read_hazard_src_states[subresource] |=
+                  dst_stage_mask;
+              texture_last_read_passes[subresource][(usize)queue] =
+                  pass_index;
+              src_pass = texture_last_write_passes[subresource];
+              if (wait_for_pass(src_pass, dst_stage_mask)) {
+                return;
+              }
+              if (not make_visible(texture_visible_states[subresource],
+                                   dst_stage_mask, dst_access_mask)) {
+                return;
+              }
+              const MemoryState &after_write_state =
+                  texture_after_write_hazard_src_states[subresource];
+              src_stage_mask = after_write_state.stage_mask;
+              src_access_mask = after_write_state.access_mask;
+            }
 
-      VkImageLayout &src_layout = texture_layouts[physical_texture];
+            // Textures that were only read from in the previous frame don't
+            // need a barrier on their first read in this one
+            if (src_stage_mask == VK_PIPELINE_STAGE_2_NONE) {
+              return;
+            }
 
-      if (dst_layout == src_layout) {
-        // Only a memory barrier is required if
-        // layout doesn't change NOTE: this code is
-        // copy-pasted from above
+            place_memory_barrier(
+                src_pass, {
+                              .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                              .srcStageMask = src_stage_mask,
+                              .srcAccessMask = src_access_mask,
+                              .dstStageMask = dst_stage_mask,
+                              .dstAccessMask = barrier_dst_access_mask,
+                          });
+            return;
+          }
 
-        VkPipelineStageFlags2 src_stage_mask = VK_PIPELINE_STAGE_2_NONE;
-        VkAccessFlagBits2 src_access_mask = VK_ACCESS_2_NONE;
+          // Need an image barrier to change layout.
+          // Layout transitions are read-write
+          // operations, so only to take care of WAR
+          // and WAW hazards in this case
 
-        if (dst_access_mask & WRITE_ONLY_ACCESS_MASK) {
           MemoryState &after_write_state =
-              texture_after_write_hazard_src_states[physical_texture];
-          src_stage_mask = std::exchange(
-              texture_after_read_hazard_src_states[physical_texture],
+              texture_after_write_hazard_src_states[subresource];
+          // If this is a WAR hazard, must wait for
+          // all previous reads to finish and make
+          // the layout transition's memory
+          // available. Also reset the source stage
+          // mask that the next WAR barrier will use
+          VkPipelineStageFlags2 src_stage_mask = std::exchange(
+              texture_after_read_hazard_src_states[subresource],
               VK_PIPELINE_STAGE_2_NONE);
+          VkAccessFlagBits2 src_access_mask = VK_ACCESS_2_NONE;
+          // Semaphore waits for passes on other queues are chained with the
+          // image barrier through its source stages
+          bool waits_for_other_queues = false;
+          for (u32 src_pass : texture_last_read_passes[subresource]) {
+            waits_for_other_queues |= wait_for_pass(src_pass, dst_stage_mask);
+          }
           if (src_stage_mask == VK_PIPELINE_STAGE_2_NONE) {
+            // If there were no reads between this
+            // write and the previous one, need to
+            // wait for the previous write to finish
+            // and make it's memory available and the
+            // layout transition's memory visible
             src_stage_mask = after_write_state.stage_mask;
             src_access_mask = after_write_state.access_mask;
+            waits_for_other_queues |= wait_for_pass(
+                texture_last_write_passes[subresource], dst_stage_mask);
+          }
+          // On first use, a transient texture must also wait for all accesses
+          // to textures that share its memory. Its contents are discarded by
+          // the transition from the undefined layout.
+          u32 memory_block =
+              m_rgp->m_physical_textures[physical_texture].memory_block;
+          if (src_layout == VK_IMAGE_LAYOUT_UNDEFINED and memory_block != -1) {
+            for (auto i : range(m_rgp->m_physical_textures.size())) {
+              if (i == physical_texture or
+                  m_rgp->m_physical_textures[i].memory_block != memory_block) {
+                continue;
+              }
+              for (u32 j : range(texture_subresource_offsets[i],
+                                 texture_subresource_offsets[i + 1])) {
+                const MemoryState &alias_after_write_state =
+                    texture_after_write_hazard_src_states[j];
+                src_stage_mask |= texture_after_read_hazard_src_states[j] |
+                                  alias_after_write_state.stage_mask;
+                src_access_mask |= alias_after_write_state.access_mask;
+                for (u32 src_pass : texture_last_read_passes[j]) {
+                  waits_for_other_queues |=
+                      wait_for_pass(src_pass, dst_stage_mask);
+                }
+                waits_for_other_queues |=
+                    wait_for_pass(texture_last_write_passes[j], dst_stage_mask);
+              }
+            }
           }
+          mask_src_scope(src_stage_mask, src_access_mask);
+          if (waits_for_other_queues) {
+            src_stage_mask |= dst_stage_mask;
+          }
+          // Update the source stage and access masks
+          // that further RAW and WAW barriers will
+          // use
           after_write_state.stage_mask = dst_stage_mask;
           after_write_state.access_mask =
               dst_access_mask & WRITE_ONLY_ACCESS_MASK;
-        } else {
-          const MemoryState &after_write_state =
-              texture_after_write_hazard_src_states[physical_texture];
-          src_stage_mask = after_write_state.stage_mask;
-          src_access_mask = after_write_state.access_mask;
-          texture_after_read_hazard_src_states[physical_texture] |=
-              dst_stage_mask;
-        }
+          texture_last_write_passes[subresource] = pass_index;
+          texture_last_read_passes[subresource] = no_passes;
+          // The layout transition is made visible to this use by the image
+          // barrier
+          texture_visible_states[subresource] = {
+              .stage_mask = dst_stage_mask,
+              .access_mask = dst_access_mask,
+          };
 
-        ren_assert(src_stage_mask != VK_PIPELINE_STAGE_2_NONE);
+          // Extend the previous image barrier of this use if it transitions
+          // the previous array layer of this mip level from the same layout
+          if (m_texture_barriers.size() > use_texture_barrier_begin) {
+            VkImageMemoryBarrier2 &barrier = m_texture_barriers.back();
+            VkImageSubresourceRange &barrier_range = barrier.subresourceRange;
+            if (barrier.oldLayout == src_layout and
+                barrier_range.baseMipLevel == mip and
+                barrier_range.levelCount == 1 and
+                barrier_range.baseArrayLayer + barrier_range.layerCount ==
+                    layer) {
+              barrier.srcStageMask |= src_stage_mask;
+              barrier.srcAccessMask |= src_access_mask;
+              barrier_range.layerCount++;
+              src_layout = dst_layout;
+              return;
+            }
+          }
 
-        m_memory_barriers.push_back({
-            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
-            .srcStageMask = src_stage_mask,
-            .srcAccessMask = src_access_mask,
-            .dstStageMask = dst_stage_mask,
-            .dstAccessMask = dst_access_mask,
-        });
-      } else {
-        // Need an image barrier to change layout.
-        // Layout transitions are read-write
-        // operations, so only to take care of WAR
-        // and WAW hazards in this case
-
-        MemoryState &after_write_state =
-            texture_after_write_hazard_src_states[physical_texture];
-        // If this is a WAR hazard, must wait for
-        // all previous reads to finish and make
-        // the layout transition's memory
-        // available. Also reset the source stage
-        // mask that the next WAR barrier will use
-        VkPipelineStageFlags2 src_stage_mask = std::exchange(
-            texture_after_read_hazard_src_states[physical_texture],
-            VK_PIPELINE_STAGE_2_NONE);
-        VkAccessFlagBits2 src_access_mask = VK_ACCESS_2_NONE;
-        if (src_stage_mask == VK_PIPELINE_STAGE_2_NONE) {
-          // If there were no reads between this
-          // write and the previous one, need to
-          // wait for the previous write to finish
-          // and make it's memory available and the
-          // layout transition's memory visible
-          src_stage_mask = after_write_state.stage_mask;
-          src_access_mask = after_write_state.access_mask;
-        }
-        // Update the source stage and access masks
-        // that further RAW and WAW barriers will
-        // use
-        after_write_state.stage_mask = dst_stage_mask;
-        after_write_state.access_mask =
-            dst_access_mask & WRITE_ONLY_ACCESS_MASK;
+          m_texture_barriers.push_back({
+              .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+              .srcStageMask = src_stage_mask,
+              .srcAccessMask = src_access_mask,
+              .dstStageMask = dst_stage_mask,
+              .dstAccessMask = dst_access_mask,
+              .oldLayout = src_layout,
+              .newLayout = dst_layout,
+              .image = texture.image,
+              .subresourceRange =
+                  {
+                      .aspectMask = getVkImageAspectFlags(texture.format),
+                      .baseMipLevel = mip,
+                      .levelCount = 1,
+                      .baseArrayLayer = layer,
+                      .layerCount = 1,
+                  },
+          });
+          m_texture_barrier_textures.push_back(physical_texture);
 
-        const Texture &texture = m_renderer->get_texture(
-            m_rgp->m_physical_textures[physical_texture].handle);
-
-        m_texture_barriers.push_back({
-            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-            .srcStageMask = src_stage_mask,
-            .srcAccessMask = src_access_mask,
-            .dstStageMask = dst_stage_mask,
-            .dstAccessMask = dst_access_mask,
-            .oldLayout = src_layout,
-            .newLayout = dst_layout,
-            .image = texture.image,
-            .subresourceRange =
-                {
-                    .aspectMask = getVkImageAspectFlags(texture.format),
-                    .levelCount = texture.num_mip_levels,
-                    .layerCount = texture.num_array_layers,
-                },
-        });
+          // Update current layout
+          src_layout = dst_layout;
+        };
 
-        // Update current layout
-        src_layout = dst_layout;
+    auto maybe_place_barrier_for_texture = [&](RgTextureUseId use_id) {
+      const RgTextureUse &use = m_texture_uses[use_id];
+      RgPhysicalTextureId physical_texture = m_textures[use.texture].parent;
+      const Texture &texture = m_device->get_texture(
+          m_rgp->m_physical_textures[physical_texture].handle);
+
+      VkImageLayout dst_layout = use.state.layout;
+      ren_assert(dst_layout);
+      if (dst_layout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+        ren_assert(use.state.stage_mask);
+        ren_assert(use.state.access_mask);
+      }
+
+      RgTextureSubresourceRange subresources = resolve_subresource_range(
+          use.range, texture.num_mip_levels, texture.num_array_layers);
+
+      use_texture_barrier_begin = m_texture_barriers.size();
+      for (u32 mip = subresources.first_mip_level;
+           mip < subresources.first_mip_level + subresources.num_mip_levels;
+           ++mip) {
+        usize mip_texture_barrier_begin = m_texture_barriers.size();
+        for (u32 layer = subresources.first_array_layer;
+             layer <
+             subresources.first_array_layer + subresources.num_array_layers;
+             ++layer) {
+          maybe_place_barrier_for_subresource(use, physical_texture, texture,
+                                              mip, layer);
+        }
+        // Merge this mip level's image barrier into the previous mip level's
+        // one if they transition the same array layers from the same layout,
+        // so that uniform ranges are transitioned with a single barrier
+        if (m_texture_barriers.size() != mip_texture_barrier_begin + 1 or
+            mip_texture_barrier_begin == use_texture_barrier_begin) {
+          continue;
+        }
+        VkImageMemoryBarrier2 &prev_barrier =
+            m_texture_barriers[mip_texture_barrier_begin - 1];
+        const VkImageMemoryBarrier2 &barrier = m_texture_barriers.back();
+        VkImageSubresourceRange &prev_range = prev_barrier.subresourceRange;
+        const VkImageSubresourceRange &mip_range = barrier.subresourceRange;
+        if (prev_barrier.oldLayout != barrier.oldLayout or
+            prev_range.baseMipLevel + prev_range.levelCount != mip or
+            prev_range.baseArrayLayer != mip_range.baseArrayLayer or
+            prev_range.layerCount != mip_range.layerCount) {
+          continue;
+        }
+        prev_barrier.srcStageMask |= barrier.srcStageMask;
+        prev_barrier.srcAccessMask |= barrier.srcAccessMask;
+        prev_range.levelCount++;
+        m_texture_barriers.pop_back();
+        m_texture_barrier_textures.pop_back();
       }
     };
 
@@ -1167,7 +2588,7 @@ void RgBuilder::place_barriers_and_semaphores() {
       m_semaphore_submit_info.push_back({
           .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
           .semaphore =
-              m_renderer
+              m_device
                   ->get_semaphore(m_rgp->m_semaphores[signal.semaphore].handle)
                   .handle,
           .value = signal.value,
@@ -1180,6 +2601,7 @@ void RgBuilder::place_barriers_and_semaphores() {
 
     usize new_memory_barrier_count = m_memory_barriers.size();
     usize new_texture_barrier_count = m_texture_barriers.size();
+    usize new_event_count = m_event_barriers.size();
 
     rt_pass.base_memory_barrier = old_memory_barrier_count;
     rt_pass.num_memory_barriers =
@@ -1187,6 +2609,10 @@ void RgBuilder::place_barriers_and_semaphores() {
     rt_pass.base_texture_barrier = old_texture_barrier_count;
     rt_pass.num_texture_barriers =
         new_texture_barrier_count - old_texture_barrier_count;
+    rt_pass.base_wait_event = old_event_count;
+    rt_pass.num_wait_events = new_event_count - old_event_count;
+    rt_pass.base_queue_wait = old_queue_wait_count;
+    rt_pass.num_queue_waits = m_queue_waits.size() - old_queue_wait_count;
     rt_pass.base_wait_semaphore = old_semaphore_count;
     rt_pass.num_wait_semaphores = pass.wait_semaphores.size();
     rt_pass.base_signal_semaphore =
@@ -1194,6 +2620,28 @@ void RgBuilder::place_barriers_and_semaphores() {
     rt_pass.num_signal_semaphores = pass.signal_semaphores.size();
   }
 
+  // Group events by the pass after which they are set.
+  auto &set_events = m_rt_data->m_set_events;
+  set_events.resize(m_event_barriers.size());
+  for (RgRtPass &rt_pass : m_rt_data->m_passes) {
+    rt_pass.num_set_events = 0;
+  }
+  for (u32 src_pass : event_src_passes) {
+    m_rt_data->m_passes[src_pass].num_set_events++;
+  }
+  u32 num_set_events = 0;
+  for (RgRtPass &rt_pass : m_rt_data->m_passes) {
+    rt_pass.base_set_event = num_set_events;
+    num_set_events += rt_pass.num_set_events;
+    rt_pass.num_set_events = 0;
+  }
+  for (u32 event : range<u32>(event_src_passes.size())) {
+    RgRtPass &rt_pass = m_rt_data->m_passes[event_src_passes[event]];
+    set_events[rt_pass.base_set_event + rt_pass.num_set_events++] = event;
+  }
+
+  auto &final_buffer_states = m_rt_data->m_final_buffer_states;
+  final_buffer_states.resize(m_data->m_physical_buffers.size());
   for (auto i : range(m_data->m_physical_buffers.size())) {
     RgPhysicalBuffer &physical_buffer = m_data->m_physical_buffers[i];
     VkPipelineStageFlags2 stage_mask = buffer_after_read_hazard_src_states[i];
@@ -1207,46 +2655,129 @@ void RgBuilder::place_barriers_and_semaphores() {
         .stage_mask = stage_mask,
         .access_mask = access_mask,
     };
+    final_buffer_states[i] = physical_buffer.state;
   }
 
+  auto &final_texture_states = m_rt_data->m_final_texture_states;
+  final_texture_states.resize(m_rgp->m_physical_textures.size());
   for (auto i : range(m_rgp->m_physical_textures.size())) {
     RgPhysicalTexture &physical_texture = m_rgp->m_physical_textures[i];
-    VkPipelineStageFlags2 stage_mask = texture_after_read_hazard_src_states[i];
-    VkAccessFlags2 access_mask = 0;
-    if (!stage_mask) {
-      const MemoryState &state = texture_after_write_hazard_src_states[i];
-      stage_mask = state.stage_mask;
-      access_mask = state.access_mask;
+    // The final state of a texture covers the final states of all of its
+    // subresources.
+    TextureState state = {};
+    u32 first_subresource = texture_subresource_offsets[i];
+    if (first_subresource != texture_subresource_offsets[i + 1]) {
+      state.layout = texture_layouts[first_subresource];
     }
-    physical_texture.state = {
-        .stage_mask = stage_mask,
-        .access_mask = access_mask,
-        .layout = texture_layouts[i],
+    for (u32 subresource :
+         range(first_subresource, texture_subresource_offsets[i + 1])) {
+      VkPipelineStageFlags2 stage_mask =
+          texture_after_read_hazard_src_states[subresource];
+      VkAccessFlags2 access_mask = 0;
+      if (!stage_mask) {
+        const MemoryState &after_write_state =
+            texture_after_write_hazard_src_states[subresource];
+        stage_mask = after_write_state.stage_mask;
+        access_mask = after_write_state.access_mask;
+      }
+      state.stage_mask |= stage_mask;
+      state.access_mask |= access_mask;
+      // Transient textures start in the undefined layout in every frame.
+      ren_assert_msg((not m_rgp->m_persistent_textures[i] and
+                      not m_rgp->m_external_textures[i]) or
+                         texture_layouts[subresource] == state.layout,
+                     "Persistent and external textures must end the frame "
+                     "with all subresources in the same layout");
+    }
+    physical_texture.state = state;
+    final_texture_states[i] = physical_texture.state;
+  }
+}
+
+void RgBuilder::patch_barriers_and_semaphores() {
+  auto &texture_barriers = m_rt_data->m_texture_barriers;
+  const auto &texture_barrier_textures = m_rt_data->m_texture_barrier_textures;
+  for (auto i : range(texture_barriers.size())) {
+    const Texture &texture = m_device->get_texture(
+        m_rgp->m_physical_textures[texture_barrier_textures[i]].handle);
+    // Subresource counts are part of the structure hash, so only the image
+    // can change.
+    VkImageMemoryBarrier2 &barrier = texture_barriers[i];
+    barrier.image = texture.image;
+    barrier.subresourceRange.aspectMask = getVkImageAspectFlags(texture.format);
+  }
+
+  auto &semaphore_submit_info = m_rt_data->m_semaphore_submit_info;
+  for (const RgRtPass &rt_pass : m_rt_data->m_passes) {
+    const RgPass &pass = m_data->m_passes[rt_pass.pass];
+    auto patch_semaphore = [&](u32 index, RgSemaphoreSignalId id) {
+      const RgSemaphoreSignal &signal = m_data->m_semaphore_signals[id];
+      VkSemaphoreSubmitInfo &submit_info = semaphore_submit_info[index];
+      Handle<Semaphore> handle = m_rgp->m_semaphores[signal.semaphore].handle;
+      submit_info.semaphore = m_device->get_semaphore(handle).handle;
+      submit_info.value = signal.value;
     };
+    for (auto i : range(pass.wait_semaphores.size())) {
+      patch_semaphore(rt_pass.base_wait_semaphore + i, pass.wait_semaphores[i]);
+    }
+    for (auto i : range(pass.signal_semaphores.size())) {
+      patch_semaphore(rt_pass.base_signal_semaphore + i,
+                      pass.signal_semaphores[i]);
+    }
+  }
+
+  for (auto i : range(m_data->m_physical_buffers.size())) {
+    m_data->m_physical_buffers[i].state = m_rt_data->m_final_buffer_states[i];
+  }
+  for (auto i : range(m_rgp->m_physical_textures.size())) {
+    m_rgp->m_physical_textures[i].state = m_rt_data->m_final_texture_states[i];
   }
 }
 
-auto RgBuilder::build(DeviceBumpAllocator &device_allocator,
-                      UploadBumpAllocator &upload_allocator) -> RenderGraph {
+auto RgBuilder::build() -> RenderGraph {
   m_rgp->rotate_textures();
 
+  cull_passes();
+  m_rgp->m_pass_reordering_stats = {};
+  if (m_rgp->m_reorder_passes) {
+    m_rgp->m_pass_reordering_stats = reorder_passes();
+  }
+
   alloc_textures();
-  alloc_buffers(device_allocator, upload_allocator);
+  alloc_buffers();
 
   dump_pass_schedule();
 
-  init_runtime_passes();
-  init_runtime_buffers();
-  init_runtime_textures();
-
-  place_barriers_and_semaphores();
+  // The pass structure is almost always the same as in the previous frame, so
+  // reuse compiled passes, attachments and barriers if it didn't change.
+  // Buffer views and texture descriptors are per-frame, so they are always
+  // recreated. The hash only rejects changed structures quickly: a match is
+  // confirmed by comparing the full keys, since a collision would reuse
+  // barriers that were placed for another graph.
+  Vector<u64> &key = m_data->m_structure_key;
+  get_structure_key(key);
+  u64 hash = 0;
+  for (u64 word : key) {
+    hash = hash_combine(hash, word);
+  }
+  if (hash == m_rt_data->m_hash and key == m_rt_data->m_structure_key) {
+    patch_runtime_passes();
+    init_runtime_buffers();
+    init_runtime_textures();
+    patch_barriers_and_semaphores();
+  } else {
+    init_runtime_passes();
+    init_runtime_buffers();
+    init_runtime_textures();
+    place_barriers_and_semaphores();
+    m_rt_data->m_hash = hash;
+    std::swap(key, m_rt_data->m_structure_key);
+  }
+  update_persistent_buffer_states();
 
   RenderGraph rg;
-  rg.m_renderer = m_renderer;
   rg.m_rgp = m_rgp;
   rg.m_data = m_rt_data;
-  rg.m_upload_allocator = &upload_allocator;
-  rg.m_texture_set = m_descriptor_allocator->get_set();
 
   return rg;
 }
@@ -1287,12 +2818,28 @@ auto RgPassBuilder::read_texture(RgTextureId texture, const TextureState &usage,
                                  temporal_layer);
 }
 
+auto RgPassBuilder::read_texture(RgTextureId texture, const TextureState &usage,
+                                 const RgTextureSubresourceRange &range,
+                                 Handle<Sampler> sampler,
+                                 u32 temporal_layer) -> RgTextureToken {
+  return m_builder->read_texture(m_pass, texture, usage, sampler,
+                                 temporal_layer, range);
+}
+
 auto RgPassBuilder::write_texture(RgDebugName name, RgTextureId texture,
                                   const TextureState &usage)
     -> std::tuple<RgTextureId, RgTextureToken> {
   return m_builder->write_texture(m_pass, std::move(name), texture, usage);
 }
 
+auto RgPassBuilder::write_texture(RgDebugName name, RgTextureId texture,
+                                  const TextureState &usage,
+                                  const RgTextureSubresourceRange &range)
+    -> std::tuple<RgTextureId, RgTextureToken> {
+  return m_builder->write_texture(m_pass, std::move(name), texture, usage,
+                                  range);
+}
+
 void RgPassBuilder::add_color_attachment(u32 index, RgTextureToken texture,
                                          const ColorAttachmentOperations &ops) {
   auto &color_attachments = m_builder->m_data->m_passes[m_pass]
@@ -1357,163 +2904,389 @@ void RgPassBuilder::signal_semaphore(RgSemaphoreId semaphore,
   m_builder->signal_semaphore(m_pass, semaphore, stages, value);
 }
 
-void RenderGraph::execute(CommandAllocator &cmd_alloc) {
-  RgRuntime rt;
-  rt.m_rg = this;
+void RenderGraph::execute(RgRendererDevice &device,
+                          CommandAllocator &cmd_alloc, ThreadPool *thread_pool,
+                          Span<CommandAllocator> worker_cmd_allocs,
+                          Span<UploadBumpAllocator> worker_upload_allocs,
+                          RgTimestamps *timestamps) {
+  ren_assert(worker_cmd_allocs.size() == worker_upload_allocs.size());
+  ren_assert(&device == m_rgp->m_device);
+  m_renderer = &device.get_renderer();
+  m_upload_allocator = &device.get_upload_allocator();
+  m_texture_set = device.get_descriptor_allocator().get_set();
+
+  TimestampQueries timestamp_queries;
+  if (timestamps) {
+    if (m_renderer->get_timestamp_period() > 0.0f) {
+      timestamp_queries =
+          cmd_alloc.allocate_timestamp_queries(2 * m_data->m_passes.size());
+    }
+    timestamps->queries = timestamp_queries;
+    timestamps->pass_names.assign(m_data->m_passes.size(), "");
+    timestamps->pass_queues.resize(m_data->m_passes.size());
+    for (usize i : range(m_data->m_passes.size())) {
+      timestamps->pass_queues[i] = m_data->m_passes[i].queue;
+#if REN_RG_DEBUG
+      timestamps->pass_names[i] =
+          m_data->m_pass_names[m_data->m_passes[i].pass];
+#endif
+    }
+  }
+
+  auto &events = m_data->m_events;
+  auto &event_dependencies = m_data->m_event_dependencies;
+  events.resize(m_data->m_event_barriers.size());
+  event_dependencies.resize(m_data->m_event_barriers.size());
+  for (usize i : range(events.size())) {
+    events[i] = cmd_alloc.allocate_event();
+    event_dependencies[i] = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &m_data->m_event_barriers[i],
+    };
+  }
 
-  auto &batch_cmd_buffers = m_data->m_batch_cmd_buffers;
-  batch_cmd_buffers.clear();
-  Span<const VkSemaphoreSubmitInfo> batch_wait_semaphores;
-  Span<const VkSemaphoreSubmitInfo> batch_signal_semaphores;
+  auto &cmd_buffers = m_data->m_cmd_buffers;
+  cmd_buffers.assign(m_data->m_passes.size(), nullptr);
+
+  auto record_pass = [&](usize pass_index, CommandAllocator &thread_cmd_alloc,
+                         UploadBumpAllocator &upload_allocator) {
+    const RgRtPass &pass = m_data->m_passes[pass_index];
+
+    RgRuntime rt;
+    rt.m_rg = this;
+    rt.m_upload_allocator = &upload_allocator;
+
+    VkCommandBuffer &cmd_buffer = cmd_buffers[pass_index];
+    u32 begin_query = timestamp_queries.base + 2 * pass_index;
+    Optional<CommandRecorder> cmd_recorder;
+    Optional<DebugRegion> debug_region;
+    auto get_command_recorder = [&]() -> CommandRecorder & {
+      if (!cmd_recorder) {
+        cmd_buffer = pass.queue == RgQueue::AsyncCompute
+                         ? thread_cmd_alloc.allocate_compute()
+                         : thread_cmd_alloc.allocate();
+        cmd_recorder.emplace(*m_renderer, cmd_buffer);
+#if REN_RG_DEBUG
+        debug_region.emplace(
+            cmd_recorder->debug_region(m_data->m_pass_names[pass.pass]));
+#endif
+        if (timestamp_queries.count > 0) {
+          cmd_recorder->write_timestamp(VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
+                                        timestamp_queries.pool, begin_query);
+        }
+      }
+      return *cmd_recorder;
+    };
 
-  auto submit_batch = [&] {
-    if (batch_cmd_buffers.empty() and batch_wait_semaphores.empty() and
-        batch_signal_semaphores.empty()) {
+    if (pass.num_wait_events > 0) {
+      get_command_recorder().wait_events(
+          Span(events).subspan(pass.base_wait_event, pass.num_wait_events),
+          Span(event_dependencies)
+              .subspan(pass.base_wait_event, pass.num_wait_events));
+    }
+
+    if (pass.num_memory_barriers > 0 or pass.num_texture_barriers > 0) {
+      auto memory_barriers =
+          Span(m_data->m_memory_barriers)
+              .subspan(pass.base_memory_barrier, pass.num_memory_barriers);
+      auto texture_barriers =
+          Span(m_data->m_texture_barriers)
+              .subspan(pass.base_texture_barrier, pass.num_texture_barriers);
+      get_command_recorder().pipeline_barrier(memory_barriers,
+                                              texture_barriers);
+    }
+
+    pass.ext.visit(OverloadSet{
+        [&](const RgRtHostPass &host_pass) {
+          if (host_pass.cb) {
+            host_pass.cb(*m_renderer, rt);
+          }
+        },
+        [&](const RgRtGraphicsPass &graphics_pass) {
+          if (!graphics_pass.cb) {
+            return;
+          }
+
+          glm::uvec2 viewport = {-1, -1};
+
+          auto color_attachments =
+              Span(m_data->m_color_attachments)
+                  .subspan(graphics_pass.base_color_attachment,
+                           graphics_pass.num_color_attachments) |
+              map([&](const Optional<RgColorAttachment> &att)
+                      -> Optional<ColorAttachment> {
+                return att.map(
+                    [&](const RgColorAttachment &att) -> ColorAttachment {
+                      TextureView view = m_renderer->get_texture_view(
+                          rt.get_texture(att.texture));
+                      viewport = m_renderer->get_texture_view_size(view);
+                      return {
+                          .texture = view,
+                          .ops = att.ops,
+                      };
+                    });
+              }) |
+              std::ranges::to<StaticVector<Optional<ColorAttachment>,
+                                           MAX_COLOR_ATTACHMENTS>>();
+
+          auto depth_stencil_attachment = graphics_pass.depth_attachment.map(
+              [&](u32 index) -> DepthStencilAttachment {
+                const RgDepthStencilAttachment &att =
+                    m_data->m_depth_stencil_attachments[index];
+                TextureView view =
+                    m_renderer->get_texture_view(rt.get_texture(att.texture));
+                viewport = m_renderer->get_texture_view_size(view);
+                return {
+                    .texture = view,
+                    .depth_ops = att.depth_ops,
+                    .stencil_ops = att.stencil_ops,
+                };
+              });
+
+          RenderPass render_pass = get_command_recorder().render_pass({
+              .color_attachments = color_attachments,
+              .depth_stencil_attachment = depth_stencil_attachment,
+          });
+          render_pass.set_viewports({{
+              .width = float(viewport.x),
+              .height = float(viewport.y),
+              .maxDepth = 1.0f,
+          }});
+          render_pass.set_scissor_rects({{.extent = {viewport.x, viewport.y}}});
+
+          graphics_pass.cb(*m_renderer, rt, render_pass);
+        },
+        [&](const RgRtComputePass &compute_pass) {
+          if (compute_pass.cb) {
+            ComputePass comp = get_command_recorder().compute_pass();
+            compute_pass.cb(*m_renderer, rt, comp);
+          }
+        },
+        [&](const RgRtGenericPass &pass) {
+          if (pass.cb) {
+            pass.cb(*m_renderer, rt, get_command_recorder());
+          }
+        },
+    });
+
+    for (u32 event : Span(m_data->m_set_events)
+                         .subspan(pass.base_set_event, pass.num_set_events)) {
+      get_command_recorder().set_event(events[event],
+                                       event_dependencies[event]);
+    }
+
+    if (cmd_recorder and timestamp_queries.count > 0) {
+      cmd_recorder->write_timestamp(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                    timestamp_queries.pool, begin_query + 1);
+    }
+  };
+
+  u32 num_workers = 0;
+  if (thread_pool) {
+    ren_assert(worker_cmd_allocs.size() >= thread_pool->get_num_workers());
+    num_workers = thread_pool->get_num_workers();
+  }
+
+  // Records passes in [begin, end) into separate command buffers, splitting
+  // them into contiguous chunks between the calling thread and the workers.
+  // Recording threads hold the renderer resource lock for each pass, so that
+  // bump allocators can only create blocks while no other thread is in the
+  // middle of a pass.
+  auto record_passes = [&](usize begin, usize end) {
+    usize num_passes = end - begin;
+    u32 num_tasks = std::min<usize>(num_workers + 1, num_passes);
+    if (num_tasks <= 1) {
+      for (usize i : range(begin, end)) {
+        record_pass(i, cmd_alloc, *m_upload_allocator);
+      }
       return;
     }
-    m_renderer->graphicsQueueSubmit(batch_cmd_buffers, batch_wait_semaphores,
-                                    batch_signal_semaphores);
-    batch_cmd_buffers.clear();
-    batch_wait_semaphores = {};
-    batch_signal_semaphores = {};
+    usize chunk_size = ceil_div(num_passes, usize(num_tasks));
+    auto record_chunk = [&](u32 task) {
+      CommandAllocator &thread_cmd_alloc =
+          task == 0 ? cmd_alloc : worker_cmd_allocs[task - 1];
+      UploadBumpAllocator &thread_upload_alloc =
+          task == 0 ? *m_upload_allocator : worker_upload_allocs[task - 1];
+      usize chunk_begin = std::min(begin + task * chunk_size, end);
+      usize chunk_end = std::min(chunk_begin + chunk_size, end);
+      for (usize i : range(chunk_begin, chunk_end)) {
+        SharedRendererResourceLock lock;
+        record_pass(i, thread_cmd_alloc, thread_upload_alloc);
+      }
+    };
+    thread_pool->run(num_tasks, record_chunk);
   };
 
-  for (const RgRtPass &pass : m_data->m_passes) {
-    if (pass.num_wait_semaphores > 0) {
-      submit_batch();
-      batch_wait_semaphores =
-          Span(m_data->m_semaphore_submit_info)
-              .subspan(pass.base_wait_semaphore, pass.num_wait_semaphores);
+  if (num_workers > 0) {
+    // Image views are created lazily by the renderer, which is not
+    // thread-safe, so create attachment views before recording in parallel.
+    RgRuntime rt;
+    rt.m_rg = this;
+    for (const Optional<RgColorAttachment> &att :
+         m_data->m_color_attachments) {
+      if (att) {
+        m_renderer->getVkImageView(
+            m_renderer->get_texture_view(rt.get_texture(att->texture)));
+      }
     }
+    for (const RgDepthStencilAttachment &att :
+         m_data->m_depth_stencil_attachments) {
+      m_renderer->getVkImageView(
+          m_renderer->get_texture_view(rt.get_texture(att.texture)));
+    }
+  }
 
-    VkCommandBuffer cmd_buffer = nullptr;
-    {
-      Optional<CommandRecorder> cmd_recorder;
-      Optional<DebugRegion> debug_region;
-      auto get_command_recorder = [&]() -> CommandRecorder & {
-        if (!cmd_recorder) {
-          cmd_buffer = cmd_alloc.allocate();
-          cmd_recorder.emplace(*m_renderer, cmd_buffer);
-#if REN_RG_DEBUG
-          debug_region.emplace(cmd_recorder->debug_region(
-              m_data->m_pass_names[pass.pass].c_str()));
-#endif
-        }
-        return *cmd_recorder;
-      };
+  // Passes on different queues are synchronized with the queues' timeline
+  // semaphores. A batch only signals its queue's semaphore if another queue
+  // might wait for it.
+  auto &queue_semaphores = m_rgp->m_queue_semaphores;
+  auto &queue_times = m_rgp->m_queue_times;
+  bool use_queue_semaphores = m_renderer->has_async_compute();
+  std::array<u64, RG_NUM_QUEUES> frame_start_queue_times = queue_times;
+  std::array<bool, RG_NUM_QUEUES> queue_used = {};
+
+  auto &batches = m_data->m_batches;
+  auto &pass_semaphore_values = m_data->m_pass_semaphore_values;
+  pass_semaphore_values.assign(m_data->m_passes.size(), 0);
+
+  auto get_queue_semaphore = [&](RgQueue queue) -> VkSemaphore {
+    return m_renderer->get_semaphore(queue_semaphores[(usize)queue]).handle;
+  };
 
-      if (pass.num_memory_barriers > 0 or pass.num_texture_barriers > 0) {
-        auto memory_barriers =
-            Span(m_data->m_memory_barriers)
-                .subspan(pass.base_memory_barrier, pass.num_memory_barriers);
-        auto texture_barriers =
-            Span(m_data->m_texture_barriers)
-                .subspan(pass.base_texture_barrier, pass.num_texture_barriers);
-        get_command_recorder().pipeline_barrier(memory_barriers,
-                                                texture_barriers);
+  auto submit_batch = [&](RgQueue queue) {
+    RgQueueBatch &batch = batches[(usize)queue];
+    if (batch.cmd_buffers.empty() and batch.wait_semaphores.empty() and
+        batch.signal_semaphores.empty() and batch.passes.empty()) {
+      return;
+    }
+    if (use_queue_semaphores) {
+      // Work from the previous frame on the other queues might still be
+      // using resources that this queue accesses.
+      if (not queue_used[(usize)queue]) {
+        queue_used[(usize)queue] = true;
+        for (usize q : range(RG_NUM_QUEUES)) {
+          if (q == (usize)queue or frame_start_queue_times[q] == 0) {
+            continue;
+          }
+          batch.wait_semaphores.push_back({
+              .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+              .semaphore = get_queue_semaphore((RgQueue)q),
+              .value = frame_start_queue_times[q],
+              .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+          });
+        }
       }
+      u64 value = ++queue_times[(usize)queue];
+      batch.signal_semaphores.push_back({
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+          .semaphore = get_queue_semaphore(queue),
+          .value = value,
+          .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      });
+      for (u32 pass : batch.passes) {
+        pass_semaphore_values[pass] = value;
+      }
+    }
+    if (queue == RgQueue::AsyncCompute) {
+      m_renderer->computeQueueSubmit(batch.cmd_buffers, batch.wait_semaphores,
+                                     batch.signal_semaphores);
+    } else {
+      m_renderer->graphicsQueueSubmit(batch.cmd_buffers, batch.wait_semaphores,
+                                      batch.signal_semaphores);
+    }
+    batch.cmd_buffers.clear();
+    batch.wait_semaphores.clear();
+    batch.signal_semaphores.clear();
+    batch.passes.clear();
+  };
 
-      pass.ext.visit(OverloadSet{
-          [&](const RgRtHostPass &host_pass) {
-            if (host_pass.cb) {
-              host_pass.cb(*m_renderer, rt);
-            }
-          },
-          [&](const RgRtGraphicsPass &graphics_pass) {
-            if (!graphics_pass.cb) {
-              return;
-            }
+  // Adds a pass's command buffer to its queue's batch. Batches are submitted
+  // before passes that wait for semaphores or for other queues and after
+  // passes that signal semaphores.
+  auto submit_pass = [&](usize i) {
+    const RgRtPass &pass = m_data->m_passes[i];
+    RgQueueBatch &batch = batches[(usize)pass.queue];
 
-            glm::uvec2 viewport = {-1, -1};
-
-            auto color_attachments =
-                Span(m_data->m_color_attachments)
-                    .subspan(graphics_pass.base_color_attachment,
-                             graphics_pass.num_color_attachments) |
-                map([&](const Optional<RgColorAttachment> &att)
-                        -> Optional<ColorAttachment> {
-                  return att.map(
-                      [&](const RgColorAttachment &att) -> ColorAttachment {
-                        TextureView view = m_renderer->get_texture_view(
-                            rt.get_texture(att.texture));
-                        viewport = m_renderer->get_texture_view_size(view);
-                        return {
-                            .texture = view,
-                            .ops = att.ops,
-                        };
-                      });
-                }) |
-                std::ranges::to<StaticVector<Optional<ColorAttachment>,
-                                             MAX_COLOR_ATTACHMENTS>>();
-
-            auto depth_stencil_attachment = graphics_pass.depth_attachment.map(
-                [&](u32 index) -> DepthStencilAttachment {
-                  const RgDepthStencilAttachment &att =
-                      m_data->m_depth_stencil_attachments[index];
-                  TextureView view =
-                      m_renderer->get_texture_view(rt.get_texture(att.texture));
-                  viewport = m_renderer->get_texture_view_size(view);
-                  return {
-                      .texture = view,
-                      .depth_ops = att.depth_ops,
-                      .stencil_ops = att.stencil_ops,
-                  };
-                });
-
-            RenderPass render_pass = get_command_recorder().render_pass({
-                .color_attachments = color_attachments,
-                .depth_stencil_attachment = depth_stencil_attachment,
-            });
-            render_pass.set_viewports({{
-                .width = float(viewport.x),
-                .height = float(viewport.y),
-                .maxDepth = 1.0f,
-            }});
-            render_pass.set_scissor_rects(
-                {{.extent = {viewport.x, viewport.y}}});
-
-            graphics_pass.cb(*m_renderer, rt, render_pass);
-          },
-          [&](const RgRtComputePass &compute_pass) {
-            if (compute_pass.cb) {
-              ComputePass comp = get_command_recorder().compute_pass();
-              compute_pass.cb(*m_renderer, rt, comp);
-            }
-          },
-          [&](const RgRtGenericPass &pass) {
-            if (pass.cb) {
-              pass.cb(*m_renderer, rt, get_command_recorder());
-            }
-          },
+    auto queue_waits = Span(m_data->m_queue_waits)
+                           .subspan(pass.base_queue_wait, pass.num_queue_waits);
+
+    if (pass.num_wait_semaphores > 0 or not queue_waits.empty()) {
+      submit_batch(pass.queue);
+    }
+
+    for (const RgQueueWait &wait : queue_waits) {
+      RgQueue src_queue = m_data->m_passes[wait.src_pass].queue;
+      if (pass_semaphore_values[wait.src_pass] == 0) {
+        submit_batch(src_queue);
+      }
+      batch.wait_semaphores.push_back({
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+          .semaphore = get_queue_semaphore(src_queue),
+          .value = pass_semaphore_values[wait.src_pass],
+          .stageMask = wait.stage_mask,
       });
     }
 
-    if (cmd_buffer) {
-      batch_cmd_buffers.push_back({
+    batch.wait_semaphores.append(
+        Span(m_data->m_semaphore_submit_info)
+            .subspan(pass.base_wait_semaphore, pass.num_wait_semaphores));
+
+    if (cmd_buffers[i]) {
+      batch.cmd_buffers.push_back({
           .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
-          .commandBuffer = cmd_buffer,
+          .commandBuffer = cmd_buffers[i],
       });
     }
+    batch.passes.push_back(i);
 
     if (pass.num_signal_semaphores > 0) {
-      batch_signal_semaphores =
+      batch.signal_semaphores.append(
           Span(m_data->m_semaphore_submit_info)
-              .subspan(pass.base_signal_semaphore, pass.num_signal_semaphores);
-      submit_batch();
+              .subspan(pass.base_signal_semaphore, pass.num_signal_semaphores));
+      submit_batch(pass.queue);
     }
-  }
-
-  submit_batch();
+  };
 
-  m_rgp->m_prev_texture_arena.clear();
-  m_rgp->m_physical_textures.resize(m_rgp->m_physical_textures.size() -
-                                    m_rgp->m_num_prev_physical_textures);
-  m_rgp->m_persistent_textures.resize(m_rgp->m_physical_textures.size());
-  m_rgp->m_external_textures.resize(m_rgp->m_physical_textures.size());
-  for (RgTextureId texture : m_rgp->m_frame_textures) {
-    m_rgp->m_textures.erase(texture);
+  // Passes are recorded in segments that end where a batch is submitted, and
+  // each segment is submitted as soon as it has been recorded, so that the GPU
+  // can start working while the next one is recorded. Host passes run on the
+  // calling thread after all previous passes have been recorded and before
+  // any of the next ones.
+  usize begin = 0;
+  auto record_and_submit = [&](usize end) {
+    record_passes(begin, end);
+    for (usize i : range(begin, end)) {
+      submit_pass(i);
+    }
+    begin = end;
+  };
+  for (usize i : range(m_data->m_passes.size())) {
+    const RgRtPass &pass = m_data->m_passes[i];
+    bool is_host_pass = pass.ext.get<RgRtHostPass>();
+    if (is_host_pass or pass.num_wait_semaphores > 0 or
+        pass.num_queue_waits > 0) {
+      record_and_submit(i);
+    }
+    if (is_host_pass or pass.num_signal_semaphores > 0) {
+      record_and_submit(i + 1);
+    }
+  }
+  record_and_submit(m_data->m_passes.size());
+
+  submit_batch(RgQueue::AsyncCompute);
+  // Make the graphics queue wait for all async compute work, so that waiting
+  // for the graphics queue is enough to know that the frame has finished.
+  if (queue_times[(usize)RgQueue::AsyncCompute] !=
+      frame_start_queue_times[(usize)RgQueue::AsyncCompute]) {
+    batches[(usize)RgQueue::Graphics].wait_semaphores.push_back({
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = get_queue_semaphore(RgQueue::AsyncCompute),
+        .value = queue_times[(usize)RgQueue::AsyncCompute],
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    });
   }
-  m_rgp->m_frame_textures.clear();
+  submit_batch(RgQueue::Graphics);
 }
 
 auto RgRuntime::get_buffer(RgUntypedBufferToken buffer) const
@@ -1522,6 +3295,19 @@ auto RgRuntime::get_buffer(RgUntypedBufferToken buffer) const
   return m_rg->m_data->m_buffers[buffer];
 }
 
+auto RgRuntime::get_untyped_buffer_device_ptr(RgUntypedBufferToken buffer)
+    const -> DevicePtr<std::byte> {
+  DevicePtr<std::byte> ptr =
+      m_rg->m_renderer->get_buffer_device_ptr(get_buffer(buffer));
+  ren_assert(ptr);
+  return ptr;
+}
+
+auto RgRuntime::map_untyped_buffer(RgUntypedBufferToken buffer) const
+    -> std::byte * {
+  return m_rg->m_renderer->map_buffer(get_buffer(buffer));
+}
+
 auto RgRuntime::get_texture(RgTextureToken texture) const -> Handle<Texture> {
   ren_assert(texture);
   return m_rg->m_data->m_textures[texture];
@@ -1562,7 +3348,8 @@ auto RgRuntime::get_texture_set() const -> VkDescriptorSet {
 }
 
 auto RgRuntime::get_allocator() const -> UploadBumpAllocator & {
-  return *m_rg->m_upload_allocator;
+  ren_assert(m_upload_allocator);
+  return *m_upload_allocator;
 }
 
 } // namespace ren
@@ -1,19 +1,24 @@
 #pragma once
 #include "Attachments.hpp"
 #include "BumpAllocator.hpp"
+#include "CommandAllocator.hpp"
 #include "Config.hpp"
-#include "DescriptorAllocator.hpp"
-#include "Renderer.hpp"
-#include "ResourceArena.hpp"
+#include "RgDevice.hpp"
+#include "RgSchedule.hpp"
+#include "Support/Arena.hpp"
 #include "Support/DynamicBitset.hpp"
 #include "Support/GenArray.hpp"
 #include "Support/GenMap.hpp"
 #include "Support/HashMap.hpp"
+#include "Support/HashSet.hpp"
+#include "Support/LinearMap.hpp"
 #include "Support/NewType.hpp"
+#include "Support/Span.hpp"
 #include "Support/String.hpp"
 #include "Support/Variant.hpp"
 #include "Texture.hpp"
 
+#include <cstdio>
 #include <functional>
 #include <vulkan/vulkan.h>
 
@@ -27,9 +32,10 @@ using RgDebugName = DummyString;
 
 #define REN_RG_DEBUG_NAME_TYPE [[no_unique_address]] RgDebugName
 
-class CommandAllocator;
 class CommandRecorder;
+class Renderer;
 class Swapchain;
+class ThreadPool;
 class RenderPass;
 class ComputePass;
 
@@ -42,7 +48,7 @@ class RgRuntime;
 template <typename F>
 concept CRgHostCallback = std::invocable<F, Renderer &, const RgRuntime &>;
 
-using RgHostCallback = std::function<void(Renderer &, const RgRuntime &)>;
+using RgHostCallback = ArenaFunction<void(Renderer &, const RgRuntime &)>;
 static_assert(CRgHostCallback<RgHostCallback>);
 
 template <typename F>
@@ -50,7 +56,7 @@ concept CRgGraphicsCallback =
     std::invocable<F, Renderer &, const RgRuntime &, RenderPass &>;
 
 using RgGraphicsCallback =
-    std::function<void(Renderer &, const RgRuntime &, RenderPass &)>;
+    ArenaFunction<void(Renderer &, const RgRuntime &, RenderPass &)>;
 static_assert(CRgGraphicsCallback<RgGraphicsCallback>);
 
 template <typename F>
@@ -58,7 +64,7 @@ concept CRgComputeCallback =
     std::invocable<F, Renderer &, const RgRuntime &, ComputePass &>;
 
 using RgComputeCallback =
-    std::function<void(Renderer &, const RgRuntime &, ComputePass &)>;
+    ArenaFunction<void(Renderer &, const RgRuntime &, ComputePass &)>;
 static_assert(CRgComputeCallback<RgComputeCallback>);
 
 template <typename F>
@@ -66,7 +72,7 @@ concept CRgCallback =
     std::invocable<F, Renderer &, const RgRuntime &, CommandRecorder &>;
 
 using RgCallback =
-    std::function<void(Renderer &, const RgRuntime &, CommandRecorder &)>;
+    ArenaFunction<void(Renderer &, const RgRuntime &, CommandRecorder &)>;
 static_assert(CRgCallback<RgCallback>);
 
 template <typename F>
@@ -77,6 +83,14 @@ using RgTextureInitCallback =
     std::function<void(Handle<Texture>, Renderer &, CommandRecorder &)>;
 static_assert(CRgTextureInitCallback<RgTextureInitCallback>);
 
+template <typename F>
+concept CRgBufferInitCallback =
+    std::invocable<F, const BufferView &, Renderer &, CommandRecorder &>;
+
+using RgBufferInitCallback =
+    std::function<void(const BufferView &, Renderer &, CommandRecorder &)>;
+static_assert(CRgBufferInitCallback<RgBufferInitCallback>);
+
 struct RgPass;
 using RgPassId = Handle<RgPass>;
 
@@ -108,6 +122,10 @@ using RgUntypedBufferToken = RgBufferToken<std::byte>;
 
 REN_NEW_TYPE(RgBufferUseId, u32);
 
+struct RgPersistentBuffer;
+REN_NEW_TEMPLATE_TYPE(RgPersistentBufferId, Handle<RgPersistentBuffer>, T);
+using RgUntypedPersistentBufferId = Handle<RgPersistentBuffer>;
+
 REN_NEW_TYPE(RgPhysicalTextureId, u32);
 
 struct RgTexture;
@@ -136,8 +154,20 @@ using RgSemaphoreId = Handle<RgSemaphore>;
 
 REN_NEW_TYPE(RgSemaphoreSignalId, u32);
 
+enum class RgQueue {
+  Graphics,
+  /// Compute passes can run on the async compute queue in parallel with
+  /// graphics work. Falls back to the graphics queue if the renderer doesn't
+  /// have one or async compute is disabled.
+  AsyncCompute,
+  Last = AsyncCompute,
+};
+
+constexpr usize RG_NUM_QUEUES = (usize)RgQueue::Last + 1;
+
 struct RgPassCreateInfo {
   REN_RG_DEBUG_NAME_TYPE name;
+  RgQueue queue = RgQueue::Graphics;
 };
 
 struct RgHostPass {
@@ -177,6 +207,7 @@ struct RgPass {
   SmallVector<RgTextureUseId> write_textures;
   SmallVector<RgSemaphoreSignalId> wait_semaphores;
   SmallVector<RgSemaphoreSignalId> signal_semaphores;
+  RgQueue queue = RgQueue::Graphics;
   Variant<Monostate, RgHostPass, RgGraphicsPass, RgComputePass, RgGenericPass>
       ext;
 };
@@ -217,6 +248,46 @@ struct RgBufferUse {
   BufferState usage;
 };
 
+struct RgPersistentBufferCreateInfo {
+  /// Buffer name.
+  REN_RG_DEBUG_NAME_TYPE name;
+  /// Memory heap from which to allocate buffer.
+  BufferHeap heap = BufferHeap::Static;
+  /// Buffer size.
+  union {
+    usize size = 1;
+    usize count;
+  };
+  /// Number of temporal layers. Temporal layer i holds what temporal layer 0
+  /// held i frames ago.
+  u32 num_temporal_layers = 1;
+  /// Buffer usage in init callback.
+  BufferState usage;
+  /// Init callback for each temporal layer, which is called before the layer
+  /// is first used. Contents are undefined if it's empty.
+  RgBufferInitCallback cb;
+};
+
+/// Buffer owned by the render graph whose contents and state are preserved
+/// between frames.
+struct RgPersistentBuffer {
+#if REN_RG_DEBUG
+  String name;
+#endif
+  BufferHeap heap = {};
+  usize size = 0;
+  u32 num_temporal_layers = 1;
+  std::array<Handle<Buffer>, RG_MAX_TEMPORAL_LAYERS> handles;
+  std::array<BufferState, RG_MAX_TEMPORAL_LAYERS> states;
+  /// Mask of temporal layers that still have to be initialized.
+  u32 uninitialized_layers = 0;
+  BufferState init_usage;
+  RgBufferInitCallback init_cb;
+  /// Render graph buffer that each temporal layer was imported as in the
+  /// frame that is being built.
+  std::array<RgUntypedBufferId, RG_MAX_TEMPORAL_LAYERS> ids;
+};
+
 struct RgTextureExternalInfo {
   /// Texture usage
   VkImageUsageFlags usage = 0;
@@ -248,6 +319,8 @@ struct RgTextureCreateInfo {
   u32 num_mip_levels = 1;
   /// Number of array layers
   u32 num_array_layers = 1;
+  /// Preserve contents between frames.
+  bool persistent = false;
   /// Additional create info.
   Variant<Monostate, RgTextureTemporalInfo, RgTextureExternalInfo> ext;
 };
@@ -267,10 +340,15 @@ struct RgPhysicalTexture {
   glm::uvec3 size = {};
   u32 num_mip_levels = 1;
   u32 num_array_layers = 1;
+  /// Used by both graphics and async compute passes.
+  bool concurrent = false;
   Handle<Texture> handle;
   TextureState state;
   RgTextureId init_id;
   RgTextureId id;
+  /// Memory block that the texture shares with other transient textures, or
+  /// -1 if it has its own memory.
+  u32 memory_block = -1;
 };
 
 struct RgTexture {
@@ -285,10 +363,26 @@ struct RgTexture {
 #endif
 };
 
+/// Mip levels and array layers of a texture that a pass uses. Barriers are
+/// only placed for these subresources, so a pass can write one mip level of a
+/// texture while the previous one is read.
+struct RgTextureSubresourceRange {
+  u32 first_mip_level = 0;
+  /// Number of mip levels, or -1 for all remaining ones.
+  u32 num_mip_levels = -1;
+  u32 first_array_layer = 0;
+  /// Number of array layers, or -1 for all remaining ones.
+  u32 num_array_layers = -1;
+
+public:
+  bool operator==(const RgTextureSubresourceRange &) const = default;
+};
+
 struct RgTextureUse {
   RgTextureId texture;
   Handle<Sampler> sampler;
   TextureState state;
+  RgTextureSubresourceRange range;
 };
 
 struct RgSemaphore {
@@ -304,8 +398,26 @@ struct RgSemaphoreSignal {
   u64 value = 0;
 };
 
+/// Range of positions in the schedule during which a texture is used.
+struct RgTextureLifetime {
+  u32 first = -1;
+  u32 last = 0;
+
+  auto overlaps(const RgTextureLifetime &other) const -> bool {
+    return first <= other.last and other.first <= last;
+  }
+};
+
+/// Memory that is shared by transient textures with disjoint lifetimes.
+struct RgTextureMemoryBlock {
+  VkMemoryRequirements requirements = {};
+  SmallVector<usize> textures;
+};
+
 struct RgBuildData {
   GenArray<RgPass> m_passes;
+  /// Passes from previous frames whose vectors are reused by new passes.
+  Vector<RgPass> m_pass_pool;
   Vector<RgPassId> m_schedule;
 
   Vector<RgPhysicalBuffer> m_physical_buffers;
@@ -315,6 +427,28 @@ struct RgBuildData {
   Vector<RgTextureUse> m_texture_uses;
 
   Vector<RgSemaphoreSignal> m_semaphore_signals;
+
+  Vector<RgUntypedBufferId> m_output_buffers;
+  Vector<RgTextureId> m_output_textures;
+
+  /// Structural key of this frame's graph.
+  Vector<u64> m_structure_key;
+
+  // Scratch data of the build steps. It is cleared instead of recreated
+  // every frame, so that building a graph that is no larger than in previous
+  // frames doesn't allocate.
+  GenMap<bool, RgPassId> m_live_passes;
+  GenMap<u32, RgPassId> m_pass_indices;
+  Vector<SmallVector<u32>> m_pass_dependencies;
+  RgScheduleScratch m_schedule_scratch;
+  Vector<u32> m_old_pass_order;
+  Vector<u32> m_new_pass_order;
+  Vector<RgPassId> m_old_schedule;
+  Vector<u8> m_texture_queues;
+  Vector<RgTextureLifetime> m_texture_lifetimes;
+  Vector<RgTextureMemoryBlock> m_texture_memory_blocks;
+  Vector<std::tuple<usize, VkMemoryRequirements>> m_transient_textures;
+  DynamicBitset m_used_buffers;
 };
 
 struct RgRtHostPass {
@@ -336,12 +470,34 @@ struct RgRtGenericPass {
   RgCallback cb;
 };
 
+/// Wait for the submission of a pass on another queue.
+struct RgQueueWait {
+  u32 src_pass = -1;
+  VkPipelineStageFlags2 stage_mask = VK_PIPELINE_STAGE_2_NONE;
+};
+
+/// Submission to a queue that is being built.
+struct RgQueueBatch {
+  Vector<VkCommandBufferSubmitInfo> cmd_buffers;
+  Vector<VkSemaphoreSubmitInfo> wait_semaphores;
+  Vector<VkSemaphoreSubmitInfo> signal_semaphores;
+  /// Passes whose completion is signaled by this batch.
+  Vector<u32> passes;
+};
+
 struct RgRtPass {
   RgPassId pass;
+  RgQueue queue = RgQueue::Graphics;
   u32 base_memory_barrier = 0;
   u32 num_memory_barriers = 0;
   u32 base_texture_barrier = 0;
   u32 num_texture_barriers = 0;
+  u32 base_wait_event = 0;
+  u32 num_wait_events = 0;
+  u32 base_set_event = 0;
+  u32 num_set_events = 0;
+  u32 base_queue_wait = 0;
+  u32 num_queue_waits = 0;
   u32 base_wait_semaphore = 0;
   u32 num_wait_semaphores = 0;
   u32 base_signal_semaphore = 0;
@@ -355,12 +511,34 @@ struct RgTextureDescriptors {
   glsl::RWStorageTexture *storage = nullptr;
 };
 
+/// Descriptors of a texture owned by the render graph, which are reused across
+/// frames until the texture is destroyed.
+struct RgCachedTextureDescriptors {
+  glsl::Texture sampled;
+  SmallLinearMap<Handle<Sampler>, glsl::SampledTexture, 2> combined;
+  /// Storage descriptor of each mip level.
+  Vector<glsl::RWStorageTexture> storage;
+};
+
 struct RgRtData {
+  /// Structural hash of the graph that passes, attachments, barriers and
+  /// semaphores were compiled from, or 0 if they are not valid.
+  u64 m_hash = 0;
+  /// Structural key that m_hash was computed from.
+  Vector<u64> m_structure_key;
+
   Vector<RgRtPass> m_passes;
 #if REN_RG_DEBUG
-  GenMap<String, RgPassId> m_pass_names;
+  /// Points to names that RgPersistent keeps alive.
+  GenMap<const char *, RgPassId> m_pass_names;
 #endif
-  Vector<VkCommandBufferSubmitInfo> m_batch_cmd_buffers;
+  /// Command buffer of each pass, or null if the pass didn't record any
+  /// commands.
+  Vector<VkCommandBuffer> m_cmd_buffers;
+  std::array<RgQueueBatch, RG_NUM_QUEUES> m_batches;
+  /// Value of its queue's timeline semaphore that is signaled after each pass
+  /// completes, or 0 if the pass hasn't been submitted yet.
+  Vector<u64> m_pass_semaphore_values;
 
   Vector<Optional<RgColorAttachment>> m_color_attachments;
   Vector<RgDepthStencilAttachment> m_depth_stencil_attachments;
@@ -373,30 +551,92 @@ struct RgRtData {
 
   Vector<VkMemoryBarrier2> m_memory_barriers;
   Vector<VkImageMemoryBarrier2> m_texture_barriers;
+  Vector<RgPhysicalTextureId> m_texture_barrier_textures;
+  /// Barrier of each split barrier's event.
+  Vector<VkMemoryBarrier2> m_event_barriers;
+  /// Events grouped by the pass after which they are set.
+  Vector<u32> m_set_events;
+  Vector<VkEvent> m_events;
+  Vector<VkDependencyInfo> m_event_dependencies;
+  Vector<RgQueueWait> m_queue_waits;
   Vector<VkSemaphoreSubmitInfo> m_semaphore_submit_info;
+
+  Vector<BufferState> m_final_buffer_states;
+  Vector<TextureState> m_final_texture_states;
 };
 
 class RgPersistent {
 public:
-  RgPersistent(Renderer &renderer);
+  RgPersistent(IRgDevice &device);
+  RgPersistent(const RgPersistent &) = delete;
+  ~RgPersistent();
+
+  RgPersistent &operator=(const RgPersistent &) = delete;
 
   [[nodiscard]] auto
   create_texture(RgTextureCreateInfo &&create_info) -> RgTextureId;
 
+  [[nodiscard]] auto create_buffer(RgPersistentBufferCreateInfo &&create_info)
+      -> RgUntypedPersistentBufferId;
+
+  template <typename T>
+  [[nodiscard]] auto create_buffer(RgPersistentBufferCreateInfo &&create_info)
+      -> RgPersistentBufferId<T> {
+    create_info.size = create_info.count * sizeof(T);
+    return RgPersistentBufferId<T>(create_buffer(std::move(create_info)));
+  }
+
   [[nodiscard]] auto
   create_external_semaphore(RgDebugName name) -> RgSemaphoreId;
 
   void reset();
 
+  void set_async_compute(bool enabled) { m_async_compute = enabled; }
+
+  void set_pass_reordering(bool enabled) { m_reorder_passes = enabled; }
+
+  /// Writes the last built graph in Graphviz DOT format. Scheduled passes are
+  /// labeled with the barriers that are placed before them and connected to
+  /// the buffers and textures that they use.
+  void write_graphviz(std::FILE *file) const;
+
+  /// Passes and resources of the last built graph.
+  auto get_build_data() const -> const RgBuildData & { return m_build_data; }
+
+  /// Passes, barriers and semaphores that the last built graph was compiled
+  /// to, so that it can be inspected without being executed.
+  auto get_runtime_data() const -> const RgRtData & { return m_rt_data; }
+
+  /// Estimated barrier stalls of the last built graph before and after its
+  /// passes were reordered, or zeros if pass reordering is disabled.
+  auto get_pass_reordering_stats() const -> const RgPassReorderingStats & {
+    return m_pass_reordering_stats;
+  }
+
 private:
   friend class RgBuilder;
   friend class RenderGraph;
-  using TextureArena = detail::ResourceArenaImpl<Texture>;
 
   void rotate_textures();
 
+  void rotate_buffers();
+
+  /// Destroys textures and frees memory that were replaced when the last graph
+  /// was built, and forgets textures that were only declared for it.
+  void release_frame_resources();
+
+  void destroy_buffers();
+
+  void destroy_textures(Vector<Handle<Texture>> &textures);
+
+  void free_texture_descriptors(Handle<Texture> texture);
+
+  void free_texture_memory(Vector<VmaAllocation> &memory);
+
 private:
-  TextureArena m_texture_arena;
+  IRgDevice *m_device = nullptr;
+  Vector<Handle<Texture>> m_texture_handles;
+  Vector<VmaAllocation> m_texture_memory;
   Vector<RgPhysicalTexture> m_physical_textures;
   DynamicBitset m_persistent_textures;
   DynamicBitset m_external_textures;
@@ -404,21 +644,44 @@ private:
 
   HashMap<RgPhysicalTextureId, RgTextureInitInfo> m_texture_init_info;
 
-  TextureArena m_prev_texture_arena;
+  HashMap<Handle<Texture>, RgCachedTextureDescriptors> m_texture_descriptors;
+
+  GenArray<RgPersistentBuffer> m_buffers;
+
+  Vector<Handle<Texture>> m_prev_texture_handles;
+  Vector<VmaAllocation> m_prev_texture_memory;
   usize m_num_prev_physical_textures = 0;
 
   Vector<RgTextureId> m_frame_textures;
 
   GenArray<RgSemaphore> m_semaphores;
 
+  /// Closures of pass callbacks, which are destroyed when the next render
+  /// graph is built.
+  Arena m_callback_arena;
+
+#if REN_RG_DEBUG
+  /// Names of all passes that have been created. Passes have mostly the same
+  /// names every frame, so each one is only stored once, which also keeps it
+  /// alive for timestamps that are read frames later.
+  HashSet<String> m_pass_name_pool;
+#endif
+
+  bool m_async_compute = true;
+  bool m_reorder_passes = false;
+  RgPassReorderingStats m_pass_reordering_stats;
+  /// Timeline semaphore of each queue, signaled with the queue's time by
+  /// every submission if the renderer has an async compute queue.
+  std::array<Handle<Semaphore>, RG_NUM_QUEUES> m_queue_semaphores;
+  std::array<u64, RG_NUM_QUEUES> m_queue_times = {};
+
   RgBuildData m_build_data;
   RgRtData m_rt_data;
 };
 
 class RgBuilder {
 public:
-  RgBuilder(RgPersistent &rgp, Renderer &renderer,
-            DescriptorAllocatorScope &descriptor_allocator);
+  RgBuilder(RgPersistent &rgp);
 
   [[nodiscard]] auto
   create_pass(RgPassCreateInfo &&create_info) -> RgPassBuilder;
@@ -439,13 +702,26 @@ public:
                 const StatefulBufferSlice<T> &slice) -> RgBufferId<T> {
     RgBufferId<T> buffer = create_buffer<T>({
         .name = std::move(name),
-        .heap = m_renderer->get_buffer(slice.slice.buffer).heap,
+        .heap = m_device->get_buffer(slice.slice.buffer).heap,
         .count = slice.slice.count,
     });
     set_external_buffer(buffer, BufferView(slice.slice), slice.state);
     return buffer;
   }
 
+  /// Returns the render graph buffer that holds a temporal layer of a
+  /// persistent buffer in this frame.
+  [[nodiscard]] auto import_buffer(RgUntypedPersistentBufferId buffer,
+                                   u32 temporal_layer = 0)
+      -> RgUntypedBufferId;
+
+  template <typename T>
+  [[nodiscard]] auto import_buffer(RgPersistentBufferId<T> buffer,
+                                   u32 temporal_layer = 0) -> RgBufferId<T> {
+    return RgBufferId<T>(
+        import_buffer(RgUntypedPersistentBufferId(buffer), temporal_layer));
+  }
+
   void set_external_buffer(RgUntypedBufferId id, const BufferView &view,
                            const BufferState &usage = {});
 
@@ -454,8 +730,13 @@ public:
 
   void set_external_semaphore(RgSemaphoreId id, Handle<Semaphore> semaphore);
 
-  auto build(DeviceBumpAllocator &device_allocator,
-             UploadBumpAllocator &upload_allocator) -> RenderGraph;
+  /// Keep passes that produce a buffer alive even if nothing reads it.
+  void set_output_buffer(RgUntypedBufferId id);
+
+  /// Keep passes that produce a texture alive even if nothing reads it.
+  void set_output_texture(RgTextureId id);
+
+  auto build() -> RenderGraph;
 
   auto get_final_buffer_state(RgUntypedBufferId buffer) const -> BufferState;
 
@@ -480,18 +761,23 @@ private:
 
   [[nodiscard]] auto
   add_texture_use(RgTextureId texture, const TextureState &usage,
-                  Handle<Sampler> sampler = NullHandle) -> RgTextureUseId;
+                  Handle<Sampler> sampler = NullHandle,
+                  const RgTextureSubresourceRange &range = {})
+      -> RgTextureUseId;
 
   [[nodiscard]] auto create_virtual_texture(RgPassId pass, RgDebugName name,
                                             RgTextureId parent) -> RgTextureId;
 
-  [[nodiscard]] auto read_texture(RgPassId pass, RgTextureId texture,
-                                  const TextureState &usage, Handle<Sampler>,
-                                  u32 temporal_layer) -> RgTextureToken;
+  [[nodiscard]] auto
+  read_texture(RgPassId pass, RgTextureId texture, const TextureState &usage,
+               Handle<Sampler>, u32 temporal_layer,
+               const RgTextureSubresourceRange &range = {}) -> RgTextureToken;
 
-  [[nodiscard]] auto write_texture(
-      RgPassId pass, RgDebugName name, RgTextureId texture,
-      const TextureState &usage) -> std::tuple<RgTextureId, RgTextureToken>;
+  [[nodiscard]] auto
+  write_texture(RgPassId pass, RgDebugName name, RgTextureId texture,
+                const TextureState &usage,
+                const RgTextureSubresourceRange &range = {})
+      -> std::tuple<RgTextureId, RgTextureToken>;
 
   [[nodiscard]] auto write_texture(RgPassId pass, RgTextureId dst,
                                    RgTextureId texture,
@@ -510,52 +796,83 @@ private:
   void set_host_callback(RgPassId id, CRgHostCallback auto cb) {
     RgPass &pass = m_data->m_passes[id];
     ren_assert(!pass.ext);
-    pass.ext = RgHostPass{.cb = std::move(cb)};
+    pass.ext = RgHostPass{.cb = {m_rgp->m_callback_arena, std::move(cb)}};
   }
 
   void set_graphics_callback(RgPassId id, CRgGraphicsCallback auto cb) {
     RgPass &pass = m_data->m_passes[id];
     ren_assert(!pass.ext or pass.ext.get<RgGraphicsPass>());
-    pass.ext.get_or_emplace<RgGraphicsPass>().cb = std::move(cb);
+    pass.ext.get_or_emplace<RgGraphicsPass>().cb = {m_rgp->m_callback_arena,
+                                                     std::move(cb)};
   }
 
   void set_compute_callback(RgPassId id, CRgComputeCallback auto cb) {
     RgPass &pass = m_data->m_passes[id];
     ren_assert(!pass.ext);
-    pass.ext = RgComputePass{.cb = std::move(cb)};
+    pass.ext = RgComputePass{.cb = {m_rgp->m_callback_arena, std::move(cb)}};
   }
 
   void set_callback(RgPassId id, CRgCallback auto cb) {
     RgPass &pass = m_data->m_passes[id];
     ren_assert(!pass.ext);
-    pass.ext = RgGenericPass{.cb = std::move(cb)};
+    pass.ext = RgGenericPass{.cb = {m_rgp->m_callback_arena, std::move(cb)}};
   }
 
+  void cull_passes();
+
+  /// Reorders passes to increase the distance between passes and the passes
+  /// whose results they use, so that barriers between them stall less.
+  /// Returns how many stalls are estimated before and after.
+  auto reorder_passes() -> RgPassReorderingStats;
+
   void alloc_textures();
 
-  void alloc_buffers(DeviceBumpAllocator &device_allocator,
-                     UploadBumpAllocator &upload_allocator);
+  void alloc_buffers();
 
   void dump_pass_schedule() const;
 
+  /// Writes everything that compiled passes, attachments, barriers and
+  /// semaphores depend on to a key. Graphs with equal keys compile to the
+  /// same data up to handles and values that are patched in every frame.
+  void get_structure_key(Vector<u64> &key) const;
+
   void init_runtime_passes();
 
+  void patch_runtime_passes();
+
   void init_runtime_buffers();
 
   void init_runtime_textures();
 
+  void update_persistent_buffer_states();
+
+  auto alloc_texture_descriptor(RgPhysicalTextureId physical_texture,
+                                const TextureView &view) -> glsl::Texture;
+
+  auto alloc_sampled_texture_descriptor(RgPhysicalTextureId physical_texture,
+                                        const TextureView &view,
+                                        Handle<Sampler> sampler)
+      -> glsl::SampledTexture;
+
+  auto alloc_storage_texture_descriptor(RgPhysicalTextureId physical_texture,
+                                        const TextureView &view)
+      -> glsl::RWStorageTexture;
+
   void place_barriers_and_semaphores();
 
+  void patch_barriers_and_semaphores();
+
 private:
-  Renderer *m_renderer = nullptr;
+  IRgDevice *m_device = nullptr;
   RgPersistent *m_rgp = nullptr;
   RgBuildData *m_data = nullptr;
   RgRtData *m_rt_data = nullptr;
-  DescriptorAllocatorScope *m_descriptor_allocator = nullptr;
 };
 
 class RgPassBuilder {
 public:
+  auto get_id() const -> RgPassId { return m_pass; }
+
   [[nodiscard]] auto
   read_buffer(RgUntypedBufferId buffer,
               const BufferState &usage) -> RgUntypedBufferToken;
@@ -588,10 +905,24 @@ public:
                                   Handle<Sampler> sampler,
                                   u32 temporal_layer = 0) -> RgTextureToken;
 
+  /// Reads only a range of the texture's mip levels and array layers.
+  [[nodiscard]] auto read_texture(RgTextureId texture,
+                                  const TextureState &usage,
+                                  const RgTextureSubresourceRange &range,
+                                  Handle<Sampler> sampler = NullHandle,
+                                  u32 temporal_layer = 0) -> RgTextureToken;
+
   [[nodiscard]] auto write_texture(RgDebugName name, RgTextureId texture,
                                    const TextureState &usage)
       -> std::tuple<RgTextureId, RgTextureToken>;
 
+  /// Writes only a range of the texture's mip levels and array layers. The
+  /// contents of the rest of the texture are preserved.
+  [[nodiscard]] auto write_texture(RgDebugName name, RgTextureId texture,
+                                   const TextureState &usage,
+                                   const RgTextureSubresourceRange &range)
+      -> std::tuple<RgTextureId, RgTextureToken>;
+
   [[nodiscard]] auto write_color_attachment(
       RgDebugName name, RgTextureId texture,
       const ColorAttachmentOperations &ops,
@@ -646,9 +977,30 @@ private:
   RgBuilder *m_builder = nullptr;
 };
 
+/// GPU timestamps that were written around passes in a frame.
+struct RgTimestamps {
+  /// Timestamps at the start and at the end of each pass, or none if the
+  /// renderer doesn't support timestamps.
+  TimestampQueries queries;
+  /// Name of each pass in execution order. Empty if render graph debug
+  /// features are disabled. The names stay valid as long as the RgPersistent
+  /// that the graph was built with.
+  Vector<const char *> pass_names;
+  /// Queue of each pass in execution order.
+  Vector<RgQueue> pass_queues;
+};
+
 class RenderGraph {
 public:
-  void execute(CommandAllocator &cmd_allocator);
+  /// Records passes on the calling thread and on the thread pool's workers,
+  /// which need a command and an upload allocator each, and submits them in
+  /// order. If timestamps are requested, they are written around every pass.
+  /// The device must be the one the graph was built with.
+  void execute(RgRendererDevice &device, CommandAllocator &cmd_allocator,
+               ThreadPool *thread_pool = nullptr,
+               Span<CommandAllocator> worker_cmd_allocators = {},
+               Span<UploadBumpAllocator> worker_upload_allocators = {},
+               RgTimestamps *timestamps = nullptr);
 
 private:
   friend RgBuilder;
@@ -674,10 +1026,7 @@ public:
   template <typename T>
   auto
   get_buffer_device_ptr(RgUntypedBufferToken buffer) const -> DevicePtr<T> {
-    DevicePtr<T> ptr = m_rg->m_renderer->get_buffer_device_ptr(
-        BufferSlice<T>(get_buffer(buffer)));
-    ren_assert(ptr);
-    return ptr;
+    return DevicePtr<T>(get_untyped_buffer_device_ptr(buffer));
   }
 
   template <typename T>
@@ -687,7 +1036,7 @@ public:
 
   template <typename T>
   auto map_buffer(RgUntypedBufferToken buffer) const -> T * {
-    return m_rg->m_renderer->map_buffer(BufferSlice<T>(get_buffer(buffer)));
+    return (T *)map_untyped_buffer(buffer);
   }
 
   template <typename T> auto map_buffer(RgBufferToken<T> buffer) const -> T * {
@@ -716,8 +1065,14 @@ public:
 private:
   friend RenderGraph;
 
+  auto get_untyped_buffer_device_ptr(RgUntypedBufferToken buffer) const
+      -> DevicePtr<std::byte>;
+
+  auto map_untyped_buffer(RgUntypedBufferToken buffer) const -> std::byte *;
+
 private:
   RenderGraph *m_rg = nullptr;
+  UploadBumpAllocator *m_upload_allocator = nullptr;
 };
 
 } // namespace ren
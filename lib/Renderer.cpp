@@ -6,6 +6,8 @@
 #include "Support/Views.hpp"
 #include "Swapchain.hpp"
 
+#include <atomic>
+#include <cstring>
 #include <volk.h>
 
 namespace ren {
@@ -40,6 +42,12 @@ void set_debug_name(VkDevice device, T object, const DebugName &name) {
 #endif
 }
 
+/// Allocations store their owner in their user data, so that they can be
+/// untracked when they are freed.
+auto get_memory_owner_user_data(MemoryOwner owner) -> void * {
+  return (void *)usize(owner);
+}
+
 } // namespace
 
 namespace {
@@ -82,6 +90,8 @@ auto create_instance(Span<const char *const> external_extensions)
 }
 
 #if REN_VULKAN_VALIDATION
+std::atomic<u32> g_num_validation_errors = 0;
+
 auto create_debug_report_callback(VkInstance instance)
     -> VkDebugReportCallbackEXT {
   VkDebugReportCallbackCreateInfoEXT create_info = {
@@ -93,6 +103,9 @@ auto create_debug_report_callback(VkInstance instance)
                         const char *pLayerPrefix, const char *pMessage,
                         void *pUserData) -> VkBool32 {
         fmt::println(stderr, "{}", pMessage);
+        if (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) {
+          g_num_validation_errors.fetch_add(1, std::memory_order_relaxed);
+        }
 #if 0
         if (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) {
           ren_trap();
@@ -137,15 +150,76 @@ auto find_graphics_queue_family(VkPhysicalDevice adapter) -> Optional<usize> {
   return None;
 }
 
-auto create_device(VkPhysicalDevice adapter,
-                   u32 graphics_queue_family) -> VkDevice {
+/// Returns a compute-only queue family, which can run compute work in
+/// parallel with the graphics queue.
+auto find_async_compute_queue_family(VkPhysicalDevice adapter)
+    -> Optional<usize> {
+  uint32_t num_queues = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(adapter, &num_queues, nullptr);
+  SmallVector<VkQueueFamilyProperties, 4> queues(num_queues);
+  vkGetPhysicalDeviceQueueFamilyProperties(adapter, &num_queues, queues.data());
+  for (usize i = 0; i < num_queues; ++i) {
+    if ((queues[i].queueFlags & VK_QUEUE_COMPUTE_BIT) and
+        not(queues[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+      return i;
+    }
+  }
+  return None;
+}
+
+/// Returns the number of nanoseconds per timestamp tick, or 0 if timestamps
+/// aren't supported on all queue families.
+auto get_timestamp_period(VkPhysicalDevice adapter,
+                          Span<const u32> queue_families) -> float {
+  uint32_t num_queues = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(adapter, &num_queues, nullptr);
+  SmallVector<VkQueueFamilyProperties, 4> queues(num_queues);
+  vkGetPhysicalDeviceQueueFamilyProperties(adapter, &num_queues, queues.data());
+  for (u32 family : queue_families) {
+    if (queues[family].timestampValidBits == 0) {
+      return 0.0f;
+    }
+  }
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(adapter, &properties);
+  return properties.limits.timestampPeriod;
+}
+
+auto is_device_extension_supported(VkPhysicalDevice adapter,
+                                   const char *name) -> bool {
+  uint32_t num_extensions = 0;
+  vkEnumerateDeviceExtensionProperties(adapter, nullptr, &num_extensions,
+                                       nullptr);
+  Vector<VkExtensionProperties> extensions(num_extensions);
+  vkEnumerateDeviceExtensionProperties(adapter, nullptr, &num_extensions,
+                                       extensions.data());
+  for (const VkExtensionProperties &extension : extensions) {
+    if (std::strcmp(extension.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto create_device(VkPhysicalDevice adapter, u32 graphics_queue_family,
+                   Optional<u32> compute_queue_family,
+                   bool memory_budget) -> VkDevice {
   float queue_priority = 1.0f;
-  VkDeviceQueueCreateInfo queue_create_info = {
+  StaticVector<VkDeviceQueueCreateInfo, 2> queue_create_infos;
+  queue_create_infos.push_back({
       .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
       .queueFamilyIndex = graphics_queue_family,
       .queueCount = 1,
       .pQueuePriorities = &queue_priority,
-  };
+  });
+  if (compute_queue_family) {
+    queue_create_infos.push_back({
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = *compute_queue_family,
+        .queueCount = 1,
+        .pQueuePriorities = &queue_priority,
+    });
+  }
 
   void *pnext = nullptr;
   auto add_features = [&](auto &features) {
@@ -182,6 +256,7 @@ auto create_device(VkPhysicalDevice adapter,
       .descriptorBindingPartiallyBound = true,
       .samplerFilterMinmax = true,
       .scalarBlockLayout = true,
+      .hostQueryReset = true,
       .timelineSemaphore = true,
       .bufferDeviceAddress = true,
   };
@@ -204,16 +279,19 @@ auto create_device(VkPhysicalDevice adapter,
 
   add_features(uint8_features);
 
-  std::array extensions = {
+  SmallVector<const char *> extensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME,
       VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME,
   };
+  if (memory_budget) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
 
   VkDeviceCreateInfo create_info = {
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
       .pNext = pnext,
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &queue_create_info,
+      .queueCreateInfoCount = u32(queue_create_infos.size()),
+      .pQueueCreateInfos = queue_create_infos.data(),
       .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
       .ppEnabledExtensionNames = extensions.data(),
   };
@@ -226,7 +304,7 @@ auto create_device(VkPhysicalDevice adapter,
 }
 
 auto create_allocator(VkInstance instance, VkPhysicalDevice adapter,
-                      VkDevice device) -> VmaAllocator {
+                      VkDevice device, bool memory_budget) -> VmaAllocator {
   VmaVulkanFunctions vk = {
       .vkGetInstanceProcAddr = vkGetInstanceProcAddr,
       .vkGetDeviceProcAddr = vkGetDeviceProcAddr,
@@ -260,7 +338,9 @@ auto create_allocator(VkInstance instance, VkPhysicalDevice adapter,
   };
 
   VmaAllocatorCreateInfo allocator_info = {
-      .flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
+      .flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT |
+               (memory_budget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT
+                              : 0u),
       .physicalDevice = adapter,
       .device = device,
       .pVulkanFunctions = &vk,
@@ -277,6 +357,12 @@ auto create_allocator(VkInstance instance, VkPhysicalDevice adapter,
 
 } // namespace
 
+#if REN_VULKAN_VALIDATION
+auto get_num_vulkan_validation_errors() -> u32 {
+  return g_num_validation_errors.load(std::memory_order_relaxed);
+}
+#endif
+
 Renderer::Renderer(Span<const char *const> extensions, u32 adapter) {
   throw_if_failed(volkInitialize(), "Volk: failed to initialize");
 
@@ -300,13 +386,34 @@ Renderer::Renderer(Span<const char *const> extensions, u32 adapter) {
     throw std::runtime_error("Vulkan: Failed to find graphics queue");
   }
 
-  m_device = create_device(m_adapter, m_graphics_queue_family);
+  Optional<usize> compute_queue_family =
+      find_async_compute_queue_family(m_adapter);
+
+  // Without VK_EXT_memory_budget, VMA estimates budgets from heap sizes.
+  bool memory_budget = is_device_extension_supported(
+      m_adapter, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  m_device = create_device(m_adapter, m_graphics_queue_family,
+                           compute_queue_family.map(
+                               [](usize family) { return u32(family); }),
+                           memory_budget);
 
   volkLoadDevice(get_device());
 
   vkGetDeviceQueue(get_device(), m_graphics_queue_family, 0, &m_graphics_queue);
+  m_queue_families[m_num_queue_families++] = m_graphics_queue_family;
+
+  if (compute_queue_family) {
+    m_compute_queue_family = *compute_queue_family;
+    vkGetDeviceQueue(get_device(), m_compute_queue_family, 0, &m_compute_queue);
+    m_queue_families[m_num_queue_families++] = m_compute_queue_family;
+  }
 
-  m_allocator = create_allocator(get_instance(), m_adapter, get_device());
+  m_timestamp_period = get_timestamp_period(
+      m_adapter, Span(m_queue_families).subspan(0, m_num_queue_families));
+
+  m_allocator =
+      create_allocator(get_instance(), m_adapter, get_device(), memory_budget);
 }
 
 Renderer::~Renderer() {
@@ -507,14 +614,20 @@ auto Renderer::create_buffer(const BufferCreateInfo &&create_info)
     -> Handle<Buffer> {
   ren_assert(create_info.size > 0);
 
+  bool concurrent = create_info.concurrent and m_num_queue_families > 1;
   VkBufferCreateInfo buffer_info = {
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
       .size = create_info.size,
       .usage = create_info.usage,
+      .sharingMode =
+          concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = concurrent ? m_num_queue_families : 0,
+      .pQueueFamilyIndices = m_queue_families.data(),
   };
 
   VmaAllocationCreateInfo alloc_info = {
       .usage = VMA_MEMORY_USAGE_AUTO,
+      .pUserData = get_memory_owner_user_data(create_info.owner),
   };
 
   switch (create_info.heap) {
@@ -548,6 +661,7 @@ auto Renderer::create_buffer(const BufferCreateInfo &&create_info)
                                   &buffer, &allocation, &map_info),
                   "VMA: Failed to create buffer");
   set_debug_name(get_device(), buffer, create_info.name);
+  m_memory_usage[usize(create_info.owner)] += map_info.size;
 
   uint64_t address = 0;
   if (create_info.usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
@@ -571,6 +685,7 @@ auto Renderer::create_buffer(const BufferCreateInfo &&create_info)
 
 void Renderer::destroy(Handle<Buffer> handle) {
   m_buffers.try_pop(handle).map([&](const Buffer &buffer) {
+    untrack_allocation(buffer.allocation);
     vmaDestroyBuffer(m_allocator, buffer.handle, buffer.allocation);
   });
 }
@@ -603,16 +718,25 @@ auto Renderer::get_buffer_view(Handle<Buffer> handle) const -> BufferView {
   };
 };
 
-auto Renderer::create_texture(const TextureCreateInfo &&create_info)
-    -> Handle<Texture> {
+void Renderer::invalidate_buffer(const BufferView &view) const {
+  const Buffer &buffer = get_buffer(view.buffer);
+  throw_if_failed(vmaInvalidateAllocation(m_allocator, buffer.allocation,
+                                          view.offset, view.size_bytes()),
+                  "VMA: Failed to invalidate buffer memory");
+}
+
+auto Renderer::get_image_create_info(const TextureCreateInfo &create_info) const
+    -> VkImageCreateInfo {
   ren_assert(create_info.width > 0);
   ren_assert(create_info.height > 0);
   ren_assert(create_info.depth > 0);
   ren_assert(create_info.num_mip_levels > 0);
   ren_assert(create_info.num_array_layers > 0);
 
-  VkImageCreateInfo image_info = {
+  bool concurrent = create_info.concurrent and m_num_queue_families > 1;
+  return {
       .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .flags = create_info.alias_allocation ? VK_IMAGE_CREATE_ALIAS_BIT : 0u,
       .imageType = create_info.type,
       .format = create_info.format,
       .extent = {create_info.width, create_info.height, create_info.depth},
@@ -621,21 +745,41 @@ auto Renderer::create_texture(const TextureCreateInfo &&create_info)
       .samples = VK_SAMPLE_COUNT_1_BIT,
       .tiling = VK_IMAGE_TILING_OPTIMAL,
       .usage = create_info.usage,
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .sharingMode =
+          concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = concurrent ? m_num_queue_families : 0,
+      .pQueueFamilyIndices = m_queue_families.data(),
   };
+}
 
-  VmaAllocationCreateInfo alloc_info = {.usage = VMA_MEMORY_USAGE_AUTO};
+auto Renderer::create_texture(const TextureCreateInfo &&create_info)
+    -> Handle<Texture> {
+  VkImageCreateInfo image_info = get_image_create_info(create_info);
 
   VkImage image;
-  VmaAllocation allocation;
-  throw_if_failed(vmaCreateImage(get_allocator(), &image_info, &alloc_info,
-                                 &image, &allocation, nullptr),
-                  "VMA: Failed to create image");
+  VmaAllocation allocation = nullptr;
+  if (create_info.alias_allocation) {
+    throw_if_failed(vmaCreateAliasingImage(get_allocator(),
+                                           create_info.alias_allocation,
+                                           &image_info, &image),
+                    "VMA: Failed to create aliasing image");
+  } else {
+    VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO,
+        .pUserData = get_memory_owner_user_data(create_info.owner),
+    };
+    VmaAllocationInfo allocation_info;
+    throw_if_failed(vmaCreateImage(get_allocator(), &image_info, &alloc_info,
+                                   &image, &allocation, &allocation_info),
+                    "VMA: Failed to create image");
+    m_memory_usage[usize(create_info.owner)] += allocation_info.size;
+  }
   set_debug_name(get_device(), image, create_info.name);
 
   return m_textures.emplace(Texture{
       .image = image,
       .allocation = allocation,
+      .is_alias = create_info.alias_allocation != nullptr,
       .type = create_info.type,
       .format = create_info.format,
       .usage = create_info.usage,
@@ -644,9 +788,78 @@ auto Renderer::create_texture(const TextureCreateInfo &&create_info)
       .depth = create_info.depth,
       .num_mip_levels = create_info.num_mip_levels,
       .num_array_layers = create_info.num_array_layers,
+      .concurrent = image_info.sharingMode == VK_SHARING_MODE_CONCURRENT,
   });
 }
 
+auto Renderer::get_texture_memory_requirements(
+    const TextureCreateInfo &create_info) const -> VkMemoryRequirements {
+  VkImageCreateInfo image_info = get_image_create_info(create_info);
+  image_info.flags |= VK_IMAGE_CREATE_ALIAS_BIT;
+  VkDeviceImageMemoryRequirements info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+      .pCreateInfo = &image_info,
+  };
+  VkMemoryRequirements2 requirements = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+  };
+  vkGetDeviceImageMemoryRequirements(get_device(), &info, &requirements);
+  return requirements.memoryRequirements;
+}
+
+auto Renderer::allocate_memory(const VkMemoryRequirements &requirements,
+                               MemoryOwner owner) -> VmaAllocation {
+  VmaAllocationCreateInfo alloc_info = {
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+      .pUserData = get_memory_owner_user_data(owner),
+  };
+  VmaAllocation allocation;
+  VmaAllocationInfo allocation_info;
+  throw_if_failed(vmaAllocateMemory(get_allocator(), &requirements,
+                                    &alloc_info, &allocation,
+                                    &allocation_info),
+                  "VMA: Failed to allocate memory");
+  m_memory_usage[usize(owner)] += allocation_info.size;
+  return allocation;
+}
+
+void Renderer::free_memory(VmaAllocation allocation) {
+  untrack_allocation(allocation);
+  vmaFreeMemory(m_allocator, allocation);
+}
+
+void Renderer::untrack_allocation(VmaAllocation allocation) {
+  VmaAllocationInfo allocation_info;
+  vmaGetAllocationInfo(m_allocator, allocation, &allocation_info);
+  auto owner = usize(allocation_info.pUserData);
+  ren_assert(m_memory_usage[owner] >= allocation_info.size);
+  m_memory_usage[owner] -= allocation_info.size;
+}
+
+auto Renderer::get_memory_usage(MemoryOwner owner) const -> usize {
+  return m_memory_usage[usize(owner)];
+}
+
+void Renderer::set_frame_index(u32 index) {
+  vmaSetCurrentFrameIndex(m_allocator, index);
+}
+
+void Renderer::get_memory_heaps(Vector<MemoryHeapStatistics> &heaps) const {
+  const VkPhysicalDeviceMemoryProperties *properties;
+  vmaGetMemoryProperties(m_allocator, &properties);
+  std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+  vmaGetHeapBudgets(m_allocator, budgets.data());
+  heaps.clear();
+  for (usize i : range(properties->memoryHeapCount)) {
+    heaps.push_back({
+        .device_local = bool(properties->memoryHeaps[i].flags &
+                             VK_MEMORY_HEAP_DEVICE_LOCAL_BIT),
+        .usage = budgets[i].usage,
+        .budget = budgets[i].budget,
+    });
+  }
+}
+
 auto Renderer::create_swapchain_texture(
     const SwapchainTextureCreateInfo &&create_info) -> Handle<Texture> {
   set_debug_name(get_device(), create_info.image, "Swapchain image");
@@ -667,7 +880,10 @@ auto Renderer::create_swapchain_texture(
 void Renderer::destroy(Handle<Texture> handle) {
   m_textures.try_pop(handle).map([&](const Texture &texture) {
     if (texture.allocation) {
+      untrack_allocation(texture.allocation);
       vmaDestroyImage(m_allocator, texture.image, texture.allocation);
+    } else if (texture.is_alias) {
+      vkDestroyImage(m_device, texture.image, nullptr);
     }
     for (const auto &[_, view] : m_image_views[handle]) {
       vkDestroyImageView(m_device, view, nullptr);
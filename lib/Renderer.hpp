@@ -31,6 +31,17 @@ class Renderer final : public IRenderer {
 
   unsigned m_graphics_queue_family = -1;
   VkQueue m_graphics_queue = nullptr;
+  /// Family of the queue that runs compute work asynchronously with the
+  /// graphics queue, or -1 if the adapter doesn't have one.
+  unsigned m_compute_queue_family = -1;
+  VkQueue m_compute_queue = nullptr;
+  /// Queue families that resources are shared between.
+  std::array<u32, 2> m_queue_families = {};
+  u32 m_num_queue_families = 0;
+  /// Nanoseconds per timestamp tick, or 0 if timestamps aren't supported.
+  float m_timestamp_period = 0.0f;
+  /// Bytes of memory allocated by each owner.
+  std::array<usize, NUM_MEMORY_OWNERS> m_memory_usage = {};
 
   GenArray<Buffer> m_buffers;
 
@@ -145,6 +156,10 @@ public:
     return map_buffer<T>(slice.buffer, slice.offset);
   }
 
+  /// Makes device writes to mapped memory visible to the host. Required
+  /// before reading back from memory that is not host-coherent.
+  void invalidate_buffer(const BufferView &view) const;
+
   template <typename T>
   auto get_buffer_device_ptr(Handle<Buffer> buffer,
                              u64 map_offset = 0) const -> DevicePtr<T> {
@@ -178,6 +193,24 @@ public:
   [[nodiscard]] auto
   create_texture(const TextureCreateInfo &&create_info) -> Handle<Texture>;
 
+  auto get_texture_memory_requirements(
+      const TextureCreateInfo &create_info) const -> VkMemoryRequirements;
+
+  [[nodiscard]] auto allocate_memory(const VkMemoryRequirements &requirements,
+                                     MemoryOwner owner) -> VmaAllocation;
+
+  void free_memory(VmaAllocation allocation);
+
+  /// Returns the number of bytes of memory allocated for an owner. Textures
+  /// placed in aliased memory and swapchain images are not counted.
+  auto get_memory_usage(MemoryOwner owner) const -> usize;
+
+  /// VMA refreshes heap budgets when the frame index changes.
+  void set_frame_index(u32 index);
+
+  /// Returns usage and budgets of the adapter's memory heaps.
+  void get_memory_heaps(Vector<MemoryHeapStatistics> &heaps) const;
+
   void destroy(Handle<Texture> texture);
 
   [[nodiscard]] auto create_swapchain_texture(
@@ -274,6 +307,28 @@ public:
                 signal_semaphores);
   }
 
+  auto has_async_compute() const -> bool { return m_compute_queue != nullptr; }
+
+  auto getComputeQueue() const -> VkQueue {
+    ren_assert(m_compute_queue);
+    return m_compute_queue;
+  }
+
+  auto get_compute_queue_family() const -> unsigned {
+    ren_assert(m_compute_queue);
+    return m_compute_queue_family;
+  }
+
+  void computeQueueSubmit(
+      TempSpan<const VkCommandBufferSubmitInfo> cmd_buffers,
+      TempSpan<const VkSemaphoreSubmitInfo> wait_semaphores = {},
+      TempSpan<const VkSemaphoreSubmitInfo> signal_semaphores = {}) {
+    queueSubmit(getComputeQueue(), cmd_buffers, wait_semaphores,
+                signal_semaphores);
+  }
+
+  auto get_timestamp_period() const -> float { return m_timestamp_period; }
+
   void
   queueSubmit(VkQueue queue,
               TempSpan<const VkCommandBufferSubmitInfo> cmd_buffers,
@@ -285,6 +340,16 @@ public:
 
 private:
   template <typename H> friend class Handle;
+
+  auto get_image_create_info(const TextureCreateInfo &create_info) const
+      -> VkImageCreateInfo;
+
+  void untrack_allocation(VmaAllocation allocation);
 };
 
+#if REN_VULKAN_VALIDATION
+/// Number of errors that the validation layer has reported in this process.
+auto get_num_vulkan_validation_errors() -> u32;
+#endif
+
 } // namespace ren
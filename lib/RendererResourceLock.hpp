@@ -0,0 +1,61 @@
+#pragma once
+#include <shared_mutex>
+
+namespace ren {
+
+namespace detail {
+
+inline std::shared_mutex g_renderer_resource_mutex;
+inline thread_local bool t_is_recording_pass = false;
+
+} // namespace detail
+
+/// Render graph passes that are recorded in parallel look up renderer
+/// resources without locking, since the renderer's resource tables are not
+/// thread-safe. Each recording thread holds this lock in shared mode while it
+/// records a pass.
+class SharedRendererResourceLock {
+public:
+  SharedRendererResourceLock() {
+    detail::g_renderer_resource_mutex.lock_shared();
+    detail::t_is_recording_pass = true;
+  }
+
+  SharedRendererResourceLock(const SharedRendererResourceLock &) = delete;
+  SharedRendererResourceLock &
+  operator=(const SharedRendererResourceLock &) = delete;
+
+  ~SharedRendererResourceLock() {
+    detail::t_is_recording_pass = false;
+    detail::g_renderer_resource_mutex.unlock_shared();
+  }
+};
+
+/// Must be held to create or destroy renderer resources while passes might be
+/// recorded on other threads. On a thread that is recording a pass, it gives
+/// up the shared lock first and waits for the passes that other threads are
+/// recording to finish. As when recording on a single thread, references to
+/// renderer resources don't stay valid across it.
+class ExclusiveRendererResourceLock {
+public:
+  ExclusiveRendererResourceLock() {
+    if (detail::t_is_recording_pass) {
+      detail::g_renderer_resource_mutex.unlock_shared();
+    }
+    detail::g_renderer_resource_mutex.lock();
+  }
+
+  ExclusiveRendererResourceLock(const ExclusiveRendererResourceLock &) =
+      delete;
+  ExclusiveRendererResourceLock &
+  operator=(const ExclusiveRendererResourceLock &) = delete;
+
+  ~ExclusiveRendererResourceLock() {
+    detail::g_renderer_resource_mutex.unlock();
+    if (detail::t_is_recording_pass) {
+      detail::g_renderer_resource_mutex.lock_shared();
+    }
+  }
+};
+
+} // namespace ren
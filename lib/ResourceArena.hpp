@@ -2,6 +2,8 @@
 #include "Renderer.hpp"
 #include "Support/Vector.hpp"
 
+#include <algorithm>
+
 namespace ren {
 
 namespace detail {
@@ -90,6 +92,20 @@ public:
     return insert(m_renderer->create_compute_pipeline(std::move(create_info)));
   }
 
+  /// Destroys a single resource before the arena is cleared. The resource must
+  /// not be in use by the GPU.
+  template <typename T>
+  void destroy(Handle<T> handle)
+    requires IsArenaResource<T>
+  {
+    Vector<Handle<T>> &arena = get_type_arena<T>();
+    auto it = std::ranges::find(arena, handle);
+    ren_assert(it != arena.end());
+    m_renderer->destroy(handle);
+    *it = arena.back();
+    arena.pop_back();
+  }
+
   void clear() {
     usize count = (get_type_arena<Ts>().size() + ...);
     if (count > 0) {
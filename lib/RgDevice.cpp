@@ -0,0 +1,156 @@
+#include "RgDevice.hpp"
+#include "DescriptorAllocator.hpp"
+#include "Renderer.hpp"
+#include "Support/Errors.hpp"
+
+namespace ren {
+
+void RgRendererDevice::begin_frame(
+    DescriptorAllocatorScope &descriptor_allocator,
+    DeviceBumpAllocator &device_allocator,
+    UploadBumpAllocator &upload_allocator) {
+  m_descriptor_allocator = &descriptor_allocator;
+  m_device_allocator = &device_allocator;
+  m_upload_allocator = &upload_allocator;
+}
+
+auto RgRendererDevice::get_descriptor_allocator() const
+    -> DescriptorAllocatorScope & {
+  ren_assert(m_descriptor_allocator);
+  return *m_descriptor_allocator;
+}
+
+auto RgRendererDevice::get_upload_allocator() const -> UploadBumpAllocator & {
+  ren_assert(m_upload_allocator);
+  return *m_upload_allocator;
+}
+
+auto RgRendererDevice::has_async_compute() const -> bool {
+  return m_renderer->has_async_compute();
+}
+
+void RgRendererDevice::wait_idle() { m_renderer->wait_idle(); }
+
+auto RgRendererDevice::create_semaphore(
+    const SemaphoreCreateInfo &&create_info) -> Handle<Semaphore> {
+  return m_renderer->create_semaphore(std::move(create_info));
+}
+
+void RgRendererDevice::destroy(Handle<Semaphore> semaphore) {
+  m_renderer->destroy(semaphore);
+}
+
+auto RgRendererDevice::get_semaphore(Handle<Semaphore> semaphore) const
+    -> const Semaphore & {
+  return m_renderer->get_semaphore(semaphore);
+}
+
+auto RgRendererDevice::get_texture_memory_requirements(
+    const TextureCreateInfo &create_info) const -> VkMemoryRequirements {
+  return m_renderer->get_texture_memory_requirements(create_info);
+}
+
+auto RgRendererDevice::allocate_memory(const VkMemoryRequirements &requirements)
+    -> VmaAllocation {
+  return m_renderer->allocate_memory(requirements, MemoryOwner::RenderGraph);
+}
+
+void RgRendererDevice::free_memory(VmaAllocation allocation) {
+  m_renderer->free_memory(allocation);
+}
+
+auto RgRendererDevice::create_texture(const TextureCreateInfo &&create_info)
+    -> Handle<Texture> {
+  return m_renderer->create_texture(std::move(create_info));
+}
+
+void RgRendererDevice::destroy(Handle<Texture> texture) {
+  m_renderer->destroy(texture);
+}
+
+auto RgRendererDevice::get_texture(Handle<Texture> texture) const
+    -> const Texture & {
+  return m_renderer->get_texture(texture);
+}
+
+auto RgRendererDevice::get_texture_view(Handle<Texture> texture) const
+    -> TextureView {
+  return m_renderer->get_texture_view(texture);
+}
+
+auto RgRendererDevice::create_buffer(const BufferCreateInfo &&create_info)
+    -> Handle<Buffer> {
+  return m_renderer->create_buffer(std::move(create_info));
+}
+
+void RgRendererDevice::destroy(Handle<Buffer> buffer) {
+  m_renderer->destroy(buffer);
+}
+
+auto RgRendererDevice::get_buffer(Handle<Buffer> buffer) const
+    -> const Buffer & {
+  return m_renderer->get_buffer(buffer);
+}
+
+auto RgRendererDevice::allocate_buffer(BufferHeap heap,
+                                       usize size) -> BufferView {
+  ren_assert(m_device_allocator and m_upload_allocator);
+  switch (heap) {
+  default:
+    unreachable("Unsupported RenderGraph buffer heap: {}", int(heap));
+  case BufferHeap::Static:
+    return m_device_allocator->allocate(size).slice;
+  case BufferHeap::Dynamic:
+  case BufferHeap::Staging:
+    return m_upload_allocator->allocate(size).slice;
+  }
+}
+
+auto RgRendererDevice::allocate_texture(const TextureView &view)
+    -> glsl::Texture {
+  return get_descriptor_allocator().allocate_texture(*m_renderer, view);
+}
+
+auto RgRendererDevice::allocate_sampled_texture(const TextureView &view,
+                                                Handle<Sampler> sampler)
+    -> glsl::SampledTexture {
+  return get_descriptor_allocator().allocate_sampled_texture(*m_renderer, view,
+                                                             sampler);
+}
+
+auto RgRendererDevice::allocate_storage_texture(const TextureView &view)
+    -> glsl::RWStorageTexture {
+  return get_descriptor_allocator().allocate_storage_texture(*m_renderer,
+                                                             view);
+}
+
+auto RgRendererDevice::allocate_persistent_texture(const TextureView &view)
+    -> glsl::Texture {
+  return m_persistent_descriptor_allocator->allocate_texture(*m_renderer, view);
+}
+
+auto RgRendererDevice::allocate_persistent_sampled_texture(
+    const TextureView &view, Handle<Sampler> sampler) -> glsl::SampledTexture {
+  return m_persistent_descriptor_allocator->allocate_sampled_texture(
+      *m_renderer, view, sampler);
+}
+
+auto RgRendererDevice::allocate_persistent_storage_texture(
+    const TextureView &view) -> glsl::RWStorageTexture {
+  return m_persistent_descriptor_allocator->allocate_storage_texture(
+      *m_renderer, view);
+}
+
+void RgRendererDevice::free(glsl::Texture texture) {
+  m_persistent_descriptor_allocator->free_texture(texture);
+}
+
+void RgRendererDevice::free(glsl::SampledTexture texture) {
+  m_persistent_descriptor_allocator->free_sampled_texture(texture);
+}
+
+void RgRendererDevice::free(glsl::RWStorageTexture texture) {
+  m_persistent_descriptor_allocator->free_storage_texture(texture);
+}
+
+} // namespace ren
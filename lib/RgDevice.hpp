@@ -0,0 +1,183 @@
+#pragma once
+#include "Buffer.hpp"
+#include "BumpAllocator.hpp"
+#include "Semaphore.hpp"
+#include "Texture.hpp"
+#include "glsl/Texture.h"
+
+namespace ren {
+
+class DescriptorAllocator;
+class DescriptorAllocatorScope;
+class Renderer;
+
+/// Device operations that render graph compilation depends on. RgPersistent
+/// and RgBuilder only talk to the device through this interface, so a graph
+/// can be built without a GPU against a device that just records calls.
+class IRgDevice {
+public:
+  virtual ~IRgDevice() = default;
+
+  virtual auto has_async_compute() const -> bool = 0;
+
+  virtual void wait_idle() = 0;
+
+  [[nodiscard]] virtual auto
+  create_semaphore(const SemaphoreCreateInfo &&create_info)
+      -> Handle<Semaphore> = 0;
+
+  virtual void destroy(Handle<Semaphore> semaphore) = 0;
+
+  virtual auto
+  get_semaphore(Handle<Semaphore> semaphore) const -> const Semaphore & = 0;
+
+  virtual auto get_texture_memory_requirements(
+      const TextureCreateInfo &create_info) const -> VkMemoryRequirements = 0;
+
+  [[nodiscard]] virtual auto
+  allocate_memory(const VkMemoryRequirements &requirements)
+      -> VmaAllocation = 0;
+
+  virtual void free_memory(VmaAllocation allocation) = 0;
+
+  [[nodiscard]] virtual auto
+  create_texture(const TextureCreateInfo &&create_info) -> Handle<Texture> = 0;
+
+  virtual void destroy(Handle<Texture> texture) = 0;
+
+  virtual auto
+  get_texture(Handle<Texture> texture) const -> const Texture & = 0;
+
+  virtual auto get_texture_view(Handle<Texture> texture) const
+      -> TextureView = 0;
+
+  [[nodiscard]] virtual auto
+  create_buffer(const BufferCreateInfo &&create_info) -> Handle<Buffer> = 0;
+
+  virtual void destroy(Handle<Buffer> buffer) = 0;
+
+  virtual auto get_buffer(Handle<Buffer> buffer) const -> const Buffer & = 0;
+
+  /// Allocates a buffer that is valid until the end of the frame.
+  virtual auto allocate_buffer(BufferHeap heap, usize size) -> BufferView = 0;
+
+  /// Texture descriptors are valid until the end of the frame.
+  virtual auto allocate_texture(const TextureView &view) -> glsl::Texture = 0;
+
+  virtual auto
+  allocate_sampled_texture(const TextureView &view,
+                           Handle<Sampler> sampler) -> glsl::SampledTexture = 0;
+
+  virtual auto allocate_storage_texture(const TextureView &view)
+      -> glsl::RWStorageTexture = 0;
+
+  /// Persistent texture descriptors are valid until they are freed.
+  virtual auto
+  allocate_persistent_texture(const TextureView &view) -> glsl::Texture = 0;
+
+  virtual auto allocate_persistent_sampled_texture(const TextureView &view,
+                                                   Handle<Sampler> sampler)
+      -> glsl::SampledTexture = 0;
+
+  virtual auto allocate_persistent_storage_texture(const TextureView &view)
+      -> glsl::RWStorageTexture = 0;
+
+  virtual void free(glsl::Texture texture) = 0;
+
+  virtual void free(glsl::SampledTexture texture) = 0;
+
+  virtual void free(glsl::RWStorageTexture texture) = 0;
+};
+
+/// Render graph device backed by the renderer. Per-frame allocators must be
+/// set with begin_frame before a render graph is built.
+class RgRendererDevice final : public IRgDevice {
+public:
+  RgRendererDevice(Renderer &renderer,
+                   DescriptorAllocator &persistent_descriptor_allocator) {
+    m_renderer = &renderer;
+    m_persistent_descriptor_allocator = &persistent_descriptor_allocator;
+  }
+
+  void begin_frame(DescriptorAllocatorScope &descriptor_allocator,
+                   DeviceBumpAllocator &device_allocator,
+                   UploadBumpAllocator &upload_allocator);
+
+  auto get_renderer() const -> Renderer & { return *m_renderer; }
+
+  auto get_descriptor_allocator() const -> DescriptorAllocatorScope &;
+
+  auto get_upload_allocator() const -> UploadBumpAllocator &;
+
+  auto has_async_compute() const -> bool override;
+
+  void wait_idle() override;
+
+  [[nodiscard]] auto create_semaphore(const SemaphoreCreateInfo &&create_info)
+      -> Handle<Semaphore> override;
+
+  void destroy(Handle<Semaphore> semaphore) override;
+
+  auto get_semaphore(Handle<Semaphore> semaphore) const
+      -> const Semaphore & override;
+
+  auto get_texture_memory_requirements(const TextureCreateInfo &create_info)
+      const -> VkMemoryRequirements override;
+
+  [[nodiscard]] auto allocate_memory(const VkMemoryRequirements &requirements)
+      -> VmaAllocation override;
+
+  void free_memory(VmaAllocation allocation) override;
+
+  [[nodiscard]] auto create_texture(const TextureCreateInfo &&create_info)
+      -> Handle<Texture> override;
+
+  void destroy(Handle<Texture> texture) override;
+
+  auto get_texture(Handle<Texture> texture) const -> const Texture & override;
+
+  auto get_texture_view(Handle<Texture> texture) const -> TextureView override;
+
+  [[nodiscard]] auto create_buffer(const BufferCreateInfo &&create_info)
+      -> Handle<Buffer> override;
+
+  void destroy(Handle<Buffer> buffer) override;
+
+  auto get_buffer(Handle<Buffer> buffer) const -> const Buffer & override;
+
+  auto allocate_buffer(BufferHeap heap, usize size) -> BufferView override;
+
+  auto allocate_texture(const TextureView &view) -> glsl::Texture override;
+
+  auto allocate_sampled_texture(const TextureView &view,
+                                Handle<Sampler> sampler)
+      -> glsl::SampledTexture override;
+
+  auto allocate_storage_texture(const TextureView &view)
+      -> glsl::RWStorageTexture override;
+
+  auto allocate_persistent_texture(const TextureView &view)
+      -> glsl::Texture override;
+
+  auto allocate_persistent_sampled_texture(const TextureView &view,
+                                           Handle<Sampler> sampler)
+      -> glsl::SampledTexture override;
+
+  auto allocate_persistent_storage_texture(const TextureView &view)
+      -> glsl::RWStorageTexture override;
+
+  void free(glsl::Texture texture) override;
+
+  void free(glsl::SampledTexture texture) override;
+
+  void free(glsl::RWStorageTexture texture) override;
+
+private:
+  Renderer *m_renderer = nullptr;
+  DescriptorAllocator *m_persistent_descriptor_allocator = nullptr;
+  DescriptorAllocatorScope *m_descriptor_allocator = nullptr;
+  DeviceBumpAllocator *m_device_allocator = nullptr;
+  UploadBumpAllocator *m_upload_allocator = nullptr;
+};
+
+} // namespace ren
@@ -0,0 +1,131 @@
+#include "RgSchedule.hpp"
+#include "Support/Assert.hpp"
+#include "Support/Views.hpp"
+
+#include <algorithm>
+#include <ranges>
+
+namespace ren {
+
+auto count_barrier_stalls(Span<const SmallVector<u32>> dependencies,
+                          Span<const u32> schedule,
+                          RgScheduleScratch &scratch) -> u32 {
+  Vector<u32> &positions = scratch.positions;
+  positions.resize(schedule.size());
+  for (u32 i : range<u32>(schedule.size())) {
+    positions[schedule[i]] = i;
+  }
+  u32 num_stalls = 0;
+  for (u32 pass : range<u32>(dependencies.size())) {
+    for (u32 dependency : dependencies[pass]) {
+      if (positions[pass] - positions[dependency] < RG_BARRIER_STALL_DISTANCE) {
+        num_stalls++;
+        break;
+      }
+    }
+  }
+  return num_stalls;
+}
+
+auto count_barrier_stalls(Span<const SmallVector<u32>> dependencies,
+                          Span<const u32> schedule) -> u32 {
+  RgScheduleScratch scratch;
+  return count_barrier_stalls(dependencies, schedule, scratch);
+}
+
+void schedule_passes(Span<const SmallVector<u32>> dependencies,
+                     RgScheduleScratch &scratch, Vector<u32> &schedule) {
+  u32 num_passes = dependencies.size();
+
+  Vector<u32> &num_dependencies = scratch.num_dependencies;
+  num_dependencies.resize(num_passes);
+  // Clear the dependents of each pass instead of recreating them, so that
+  // they keep their memory.
+  Vector<SmallVector<u32>> &dependents = scratch.dependents;
+  dependents.resize(num_passes);
+  for (SmallVector<u32> &pass_dependents : dependents) {
+    pass_dependents.clear();
+  }
+  for (u32 pass : range(num_passes)) {
+    num_dependencies[pass] = dependencies[pass].size();
+    for (u32 dependency : dependencies[pass]) {
+      ren_assert(dependency < pass);
+      dependents[dependency].push_back(pass);
+    }
+  }
+
+  // Length of the longest chain of dependent passes that starts at each pass.
+  Vector<u32> &critical_paths = scratch.critical_paths;
+  critical_paths.assign(num_passes, 1);
+  for (u32 pass : range(num_passes) | std::views::reverse) {
+    for (u32 dependent : dependents[pass]) {
+      critical_paths[pass] =
+          std::max(critical_paths[pass], critical_paths[dependent] + 1);
+    }
+  }
+
+  Vector<u32> &positions = scratch.positions;
+  positions.assign(num_passes, -1);
+  Vector<u32> &ready = scratch.ready;
+  ready.clear();
+  for (u32 pass : range(num_passes)) {
+    if (num_dependencies[pass] == 0) {
+      ready.push_back(pass);
+    }
+  }
+
+  schedule.clear();
+  schedule.reserve(num_passes);
+  while (not ready.empty()) {
+    u32 position = schedule.size();
+    auto get_distance = [&](u32 pass) -> u32 {
+      u32 distance = RG_BARRIER_STALL_DISTANCE;
+      for (u32 dependency : dependencies[pass]) {
+        distance = std::min(distance, position - positions[dependency]);
+      }
+      return distance;
+    };
+
+    usize best = 0;
+    u32 best_distance = get_distance(ready[0]);
+    for (usize i : range<usize>(1, ready.size())) {
+      u32 pass = ready[i];
+      u32 distance = get_distance(pass);
+      u32 best_pass = ready[best];
+      if (distance != best_distance) {
+        if (distance < best_distance) {
+          continue;
+        }
+      } else if (critical_paths[pass] != critical_paths[best_pass]) {
+        if (critical_paths[pass] < critical_paths[best_pass]) {
+          continue;
+        }
+      } else if (pass > best_pass) {
+        continue;
+      }
+      best = i;
+      best_distance = distance;
+    }
+
+    u32 pass = ready[best];
+    ready.erase(ready.begin() + best);
+    positions[pass] = position;
+    schedule.push_back(pass);
+    for (u32 dependent : dependents[pass]) {
+      if (--num_dependencies[dependent] == 0) {
+        ready.push_back(dependent);
+      }
+    }
+  }
+  ren_assert(schedule.size() == num_passes);
+}
+
+auto schedule_passes(Span<const SmallVector<u32>> dependencies)
+    -> Vector<u32> {
+  RgScheduleScratch scratch;
+  Vector<u32> schedule;
+  schedule_passes(dependencies, scratch, schedule);
+  return schedule;
+}
+
+} // namespace ren
@@ -0,0 +1,52 @@
+#pragma once
+#include "Support/Span.hpp"
+#include "Support/StdDef.hpp"
+#include "Support/Vector.hpp"
+
+namespace ren {
+
+/// Passes that are closer than this to a pass that they depend on are assumed
+/// to stall on the barrier between them.
+constexpr u32 RG_BARRIER_STALL_DISTANCE = 3;
+
+/// Estimated number of barrier stalls in a render graph's schedule before and
+/// after its passes were reordered.
+struct RgPassReorderingStats {
+  u32 num_barrier_stalls_before = 0;
+  u32 num_barrier_stalls_after = 0;
+};
+
+/// Memory that scheduling reuses between calls, so that the render graph
+/// doesn't allocate when it schedules the same number of passes again.
+struct RgScheduleScratch {
+  Vector<u32> num_dependencies;
+  Vector<SmallVector<u32>> dependents;
+  Vector<u32> critical_paths;
+  Vector<u32> positions;
+  Vector<u32> ready;
+};
+
+/// Returns the number of passes that are scheduled closer than
+/// RG_BARRIER_STALL_DISTANCE to one of their dependencies. dependencies[i]
+/// holds the passes that pass i depends on and schedule holds the passes in
+/// the order in which they run.
+auto count_barrier_stalls(Span<const SmallVector<u32>> dependencies,
+                          Span<const u32> schedule,
+                          RgScheduleScratch &scratch) -> u32;
+
+auto count_barrier_stalls(Span<const SmallVector<u32>> dependencies,
+                          Span<const u32> schedule) -> u32;
+
+/// Topologically sorts a DAG of passes into schedule, trying to put passes at
+/// least RG_BARRIER_STALL_DISTANCE after the passes that they depend on. Among
+/// passes that are equally far from their dependencies, those with the
+/// longest critical path are scheduled first, and ties are broken by the
+/// original order, so the result is deterministic. Passes must only depend on
+/// passes with lower indices.
+void schedule_passes(Span<const SmallVector<u32>> dependencies,
+                     RgScheduleScratch &scratch, Vector<u32> &schedule);
+
+auto schedule_passes(Span<const SmallVector<u32>> dependencies)
+    -> Vector<u32>;
+
+} // namespace ren
@@ -4,23 +4,28 @@
 #include "ImGuiConfig.hpp"
 #include "MeshProcessing.hpp"
 #include "Passes/Exposure.hpp"
+#include "Passes/FrameCapture.hpp"
 #include "Passes/GpuSceneUpdate.hpp"
 #include "Passes/HiZ.hpp"
 #include "Passes/ImGui.hpp"
 #include "Passes/Opaque.hpp"
 #include "Passes/PostProcessing.hpp"
 #include "Passes/Present.hpp"
+#include "Passes/Shadows.hpp"
 #include "Support/Span.hpp"
 #include "Support/Views.hpp"
 #include "Swapchain.hpp"
 
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <fmt/format.h>
 
 namespace ren {
 
 Scene::Scene(Renderer &renderer, Swapchain &swapchain)
     : m_arena(renderer), m_fif_arena(renderer),
-      m_device_allocator(renderer, m_arena, 64 * 1024 * 1024) {
+      m_device_allocator(renderer, m_arena, 4 * 1024 * 1024) {
   m_renderer = &renderer;
   m_swapchain = &swapchain;
 
@@ -46,6 +51,14 @@ Scene::Scene(Renderer &renderer, Swapchain &swapchain)
           .address_mode_v = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
           .reduction_mode = SamplerReductionMode::Max,
       }),
+      .shadow_map = m_arena.create_sampler({
+          .name = "Shadow map sampler",
+          .mag_filter = VK_FILTER_NEAREST,
+          .min_filter = VK_FILTER_NEAREST,
+          .mipmap_mode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+          .address_mode_u = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+          .address_mode_v = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      }),
   };
 
   m_descriptor_allocator->allocate_sampler(*m_renderer, m_samplers.dflt,
@@ -53,11 +66,24 @@ Scene::Scene(Renderer &renderer, Swapchain &swapchain)
 
   m_pipelines = load_pipelines(m_arena, texture_descriptor_set_layout);
 
-  m_rgp = std::make_unique<RgPersistent>(*m_renderer);
+  m_rg_device = std::make_unique<RgRendererDevice>(*m_renderer,
+                                                   *m_descriptor_allocator);
+  m_rgp = std::make_unique<RgPersistent>(*m_rg_device);
 
   allocate_per_frame_resources();
 
   m_gpu_scene = init_gpu_scene(m_arena);
+
+  // Allow exporting the render graph without changing the application.
+  if (const char *path = std::getenv("REN_RG_EXPORT_DOT")) {
+    m_rg_export.dot_path = path;
+  }
+  if (const char *path = std::getenv("REN_RG_EXPORT_TRACE")) {
+    m_rg_export.trace_path = path;
+  }
+  if (const char *frame = std::getenv("REN_RG_EXPORT_FRAME")) {
+    m_rg_export_delay = std::strtoul(frame, nullptr, 10);
+  }
 }
 
 void Scene::allocate_per_frame_resources() {
@@ -73,10 +99,11 @@ void Scene::allocate_per_frame_resources() {
             .name = fmt::format("Present semaphore {}", i),
         }),
         .upload_allocator =
-            UploadBumpAllocator(*m_renderer, m_fif_arena, 64 * 1024 * 1024),
+            UploadBumpAllocator(*m_renderer, m_fif_arena, 4 * 1024 * 1024),
         .cmd_allocator = CommandAllocator(*m_renderer),
         .descriptor_allocator =
             DescriptorAllocatorScope(*m_descriptor_allocator),
+        .capture_arena = ResourceArena(*m_renderer),
     });
   }
   m_graphics_time = m_num_frames_in_flight;
@@ -90,6 +117,12 @@ void ScenePerFrameResources::reset() {
   upload_allocator.reset();
   cmd_allocator.reset();
   descriptor_allocator.reset();
+  for (UploadBumpAllocator &allocator : worker_upload_allocators) {
+    allocator.reset();
+  }
+  for (CommandAllocator &allocator : worker_cmd_allocators) {
+    allocator.reset();
+  }
 }
 
 void Scene::next_frame() {
@@ -117,6 +150,9 @@ void Scene::next_frame() {
     m_renderer->wait_for_semaphore(
         m_renderer->get_semaphore(m_graphics_semaphore),
         m_graphics_time - m_num_frames_in_flight);
+    update_frame_statistics(get_per_frame_resources());
+    write_frame_trace(get_per_frame_resources());
+    deliver_captured_frame(get_per_frame_resources());
     get_per_frame_resources().reset();
   }
 
@@ -129,6 +165,8 @@ void Scene::next_frame() {
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
       .commandBuffer = cmd,
   }});
+
+  update_memory_statistics();
 }
 
 auto Scene::create_mesh(const MeshCreateInfo &desc) -> expected<MeshId> {
@@ -169,6 +207,7 @@ auto Scene::create_mesh(const MeshCreateInfo &desc) -> expected<MeshId> {
           .usage = VK_BUFFER_USAGE_2_TRANSFER_DST_BIT_KHR |
                    VK_BUFFER_USAGE_2_SHADER_DEVICE_ADDRESS_BIT_KHR,
           .count = data.size(),
+          .owner = MemoryOwner::MeshData,
       });
       buffer = slice.buffer;
       m_resource_uploader.stage_buffer(
@@ -285,6 +324,7 @@ auto Scene::create_image(const ImageCreateInfo &desc) -> expected<ImageId> {
       .width = desc.width,
       .height = desc.height,
       .num_mip_levels = get_mip_level_count(desc.width, desc.height),
+      .owner = MemoryOwner::Images,
   });
   usize size = desc.width * desc.height * get_format_size(format);
   m_resource_uploader.stage_texture(
@@ -377,6 +417,15 @@ void Scene::set_exposure(const ExposureDesc &desc) {
   m_data.exposure.ec = desc.ec;
 };
 
+void Scene::set_frame_capture(FrameCaptureDesc desc) {
+  m_frame_capture = std::move(desc);
+}
+
+void Scene::export_render_graph(RenderGraphExportDesc desc) {
+  m_rg_export = std::move(desc);
+  m_rg_export_delay = 0;
+}
+
 auto Scene::create_mesh_instances(
     std::span<const MeshInstanceCreateInfo> create_info,
     std::span<MeshInstanceId> out) -> expected<void> {
@@ -389,6 +438,7 @@ auto Scene::create_mesh_instances(
     Handle<MeshInstance> handle = m_data.mesh_instances.insert({
         .mesh = std::bit_cast<Handle<Mesh>>(create_info[i].mesh),
         .material = std::bit_cast<Handle<Material>>(create_info[i].material),
+        .occluder = create_info[i].occluder,
     });
     m_data.mesh_instance_transforms.insert(
         handle,
@@ -400,6 +450,7 @@ auto Scene::create_mesh_instances(
     });
     out[i] = std::bit_cast<MeshInstanceId>(handle);
   }
+  m_data.geometry_version++;
   return {};
 }
 
@@ -409,6 +460,7 @@ void Scene::destroy_mesh_instances(
     m_data.mesh_instances.erase(
         std::bit_cast<Handle<MeshInstance>>(mesh_instance));
   }
+  m_data.geometry_version++;
 }
 
 void Scene::set_mesh_instance_transforms(
@@ -423,6 +475,7 @@ void Scene::set_mesh_instance_transforms(
     m_data.mesh_instance_transforms[h] =
         matrices[i] * glsl::make_decode_position_matrix(mesh.pos_enc_bb);
   }
+  m_data.geometry_version++;
 }
 
 auto Scene::create_directional_light(const DirectionalLightDesc &desc)
@@ -452,21 +505,254 @@ void Scene::set_directional_light(DirectionalLightId light,
 };
 
 auto Scene::draw() -> expected<void> {
+  // An offscreen swapchain that was resized to 0x0 has no images to render
+  // to, so frames are skipped until it's resized again.
+  glm::uvec2 swapchain_size = m_swapchain->get_size();
+  if (m_swapchain->is_offscreen() and
+      (swapchain_size.x == 0 or swapchain_size.y == 0)) {
+    return {};
+  }
+
+  using Milliseconds = std::chrono::duration<float, std::milli>;
+  auto frame_start = std::chrono::steady_clock::now();
+
   ScenePerFrameResources &fr = get_per_frame_resources();
 
+  RenderGraphExportDesc rg_export;
+  if (m_rg_export_delay > 0) {
+    m_rg_export_delay--;
+  } else {
+    rg_export = std::exchange(m_rg_export, {});
+  }
+
   m_resource_uploader.upload(*m_renderer, fr.cmd_allocator);
 
+  auto build_start = std::chrono::steady_clock::now();
   RenderGraph render_graph = build_rg();
+  auto build_end = std::chrono::steady_clock::now();
+
+  u32 num_descriptor_writes = m_descriptor_allocator->flush(*m_renderer);
 
-  render_graph.execute(fr.cmd_allocator);
+  u32 num_workers = std::max(m_data.settings.num_recording_threads, 1) - 1;
+  if (not m_recording_thread_pool or
+      m_recording_thread_pool->get_num_workers() != num_workers) {
+    m_recording_thread_pool.emplace(num_workers);
+  }
+  while (fr.worker_cmd_allocators.size() < num_workers) {
+    fr.worker_upload_allocators.emplace_back(*m_renderer, m_fif_arena,
+                                             4 * 1024 * 1024);
+    fr.worker_cmd_allocators.emplace_back(*m_renderer);
+  }
+  render_graph.execute(
+      *m_rg_device, fr.cmd_allocator, &*m_recording_thread_pool,
+      Span(fr.worker_cmd_allocators).subspan(0, num_workers),
+      Span(fr.worker_upload_allocators).subspan(0, num_workers),
+      &fr.timestamps);
+  auto record_end = std::chrono::steady_clock::now();
 
   m_swapchain->present(fr.present_semaphore);
 
+  auto frame_end = std::chrono::steady_clock::now();
+  fr.statistics = {
+      .cpu_build_time_ms = Milliseconds(build_end - build_start).count(),
+      .cpu_record_time_ms = Milliseconds(record_end - build_end).count(),
+      .cpu_frame_time_ms = Milliseconds(frame_end - frame_start).count(),
+      .num_descriptor_writes = num_descriptor_writes,
+  };
+  auto add_bump_statistics = [&](const auto &stats) {
+    fr.statistics.num_bump_bytes_used += stats.num_bytes_used;
+    fr.statistics.num_bump_bytes_wasted += stats.num_bytes_wasted;
+    fr.statistics.num_bump_bytes_reserved += stats.num_bytes_reserved;
+    fr.statistics.num_bump_blocks +=
+        stats.num_blocks + stats.num_dedicated_blocks;
+  };
+  add_bump_statistics(m_device_allocator.get_statistics());
+  add_bump_statistics(fr.upload_allocator.get_statistics());
+  for (const UploadBumpAllocator &allocator : fr.worker_upload_allocators) {
+    add_bump_statistics(allocator.get_statistics());
+  }
+
+  // The graph's build data stays valid until the next frame's graph is built.
+  if (not rg_export.dot_path.empty()) {
+    if (std::FILE *file = std::fopen(rg_export.dot_path.c_str(), "w")) {
+      m_rgp->write_graphviz(file);
+      std::fclose(file);
+    } else {
+      fmt::println(stderr, "Failed to open {} for writing", rg_export.dot_path);
+    }
+  }
+  if (not rg_export.trace_path.empty()) {
+    fr.trace = SceneFrameTrace{
+        .path = std::move(rg_export.trace_path),
+        .frame_start = frame_start,
+        .build_start = build_start,
+        .build_end = build_end,
+        .record_end = record_end,
+        .frame_end = frame_end,
+    };
+  }
+
   next_frame();
 
   return {};
 }
 
+auto Scene::get_frame_statistics() const -> FrameStatistics {
+  return m_frame_statistics;
+}
+
+auto Scene::get_memory_statistics() const -> MemoryStatistics {
+  return m_memory_statistics;
+}
+
+void Scene::update_memory_statistics() {
+  m_renderer->set_frame_index(m_graphics_time);
+  m_renderer->get_memory_heaps(m_memory_heaps);
+  for (usize owner : range(NUM_MEMORY_OWNERS)) {
+    m_memory_statistics.owners[owner] =
+        m_renderer->get_memory_usage(MemoryOwner(owner));
+  }
+  m_memory_statistics.heaps = m_memory_heaps;
+}
+
+void Scene::update_frame_statistics(const ScenePerFrameResources &frame) {
+  m_frame_statistics = frame.statistics;
+  m_pass_statistics.clear();
+
+  const RgTimestamps &timestamps = frame.timestamps;
+  m_timestamps.resize(timestamps.queries.count);
+  frame.cmd_allocator.read_timestamp_queries(timestamps.queries, m_timestamps);
+
+  // Convert from ticks to milliseconds.
+  float period = m_renderer->get_timestamp_period() / 1'000'000.0f;
+  u64 frame_begin = -1;
+  u64 frame_end = 0;
+  for (usize pass : range(m_timestamps.size() / 2)) {
+    const TimestampQueryResult &begin = m_timestamps[2 * pass];
+    const TimestampQueryResult &end = m_timestamps[2 * pass + 1];
+    // Passes that didn't record any commands don't have timestamps.
+    if (not begin.availability or not end.availability) {
+      continue;
+    }
+    frame_begin = std::min(frame_begin, begin.timestamp);
+    frame_end = std::max(frame_end, end.timestamp);
+    m_pass_statistics.push_back({
+        .name = timestamps.pass_names[pass],
+        .gpu_time_ms = (end.timestamp - begin.timestamp) * period,
+    });
+  }
+  if (frame_begin < frame_end) {
+    m_frame_statistics.gpu_frame_time_ms = (frame_end - frame_begin) * period;
+  }
+  m_frame_statistics.passes = m_pass_statistics;
+}
+
+void Scene::deliver_captured_frame(ScenePerFrameResources &frame) {
+  if (not frame.capture_layout) {
+    return;
+  }
+  FrameCaptureLayout layout = *frame.capture_layout;
+  frame.capture_layout = None;
+  // Capture might have been disabled while the frame was in flight.
+  if (not m_frame_capture.callback) {
+    return;
+  }
+
+  m_renderer->invalidate_buffer(frame.capture_buffer);
+  const std::byte *data = m_renderer->map_buffer(frame.capture_buffer);
+  StaticVector<CapturedFramePlane, 3> planes;
+  for (const FrameCapturePlaneLayout &plane : layout.planes) {
+    planes.push_back({
+        .data = {data + plane.offset, plane.size},
+        .stride = plane.stride,
+    });
+  }
+  m_frame_capture.callback({
+      .format = layout.format,
+      .width = layout.size.x,
+      .height = layout.size.y,
+      .planes = planes,
+  });
+}
+
+void Scene::write_frame_trace(ScenePerFrameResources &frame) {
+  if (not frame.trace) {
+    return;
+  }
+  SceneFrameTrace trace = std::move(*frame.trace);
+  frame.trace = None;
+
+  std::FILE *file = std::fopen(trace.path.c_str(), "w");
+  if (!file) {
+    fmt::println(stderr, "Failed to open {} for writing", trace.path);
+    return;
+  }
+
+  // Chrome trace event timestamps are in microseconds.
+  using Microseconds = std::chrono::duration<double, std::micro>;
+  auto get_time = [&](std::chrono::steady_clock::time_point time) {
+    return Microseconds(time - trace.frame_start).count();
+  };
+
+  fmt::println(file, "{{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  constexpr StringView THREAD_NAMES[] = {
+      "CPU",
+      "GPU graphics queue",
+      "GPU async compute queue",
+  };
+  for (usize tid : range(std::size(THREAD_NAMES))) {
+    fmt::print(file,
+               "{}  {{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+               "\"tid\": {}, \"args\": {{\"name\": \"{}\"}}}}",
+               tid > 0 ? ",\n" : "", tid, THREAD_NAMES[tid]);
+  }
+
+  auto write_span = [&](StringView name, usize tid, double begin, double end) {
+    fmt::print(file,
+               ",\n  {{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 0, "
+               "\"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+               escape_string(name), tid, begin, end - begin);
+  };
+
+  write_span("draw", 0, 0.0, get_time(trace.frame_end));
+  write_span("build render graph", 0, get_time(trace.build_start),
+             get_time(trace.build_end));
+  write_span("record render graph", 0, get_time(trace.build_end),
+             get_time(trace.record_end));
+  write_span("present", 0, get_time(trace.record_end),
+             get_time(trace.frame_end));
+
+  // GPU timestamps are in another time domain, so GPU work is placed as if it
+  // started when recording ended.
+  const RgTimestamps &timestamps = frame.timestamps;
+  double period = m_renderer->get_timestamp_period() / 1'000.0;
+  u64 gpu_begin = -1;
+  for (const TimestampQueryResult &result : m_timestamps) {
+    if (result.availability) {
+      gpu_begin = std::min(gpu_begin, result.timestamp);
+    }
+  }
+  double gpu_offset = get_time(trace.record_end);
+  for (usize pass : range(m_timestamps.size() / 2)) {
+    const TimestampQueryResult &begin = m_timestamps[2 * pass];
+    const TimestampQueryResult &end = m_timestamps[2 * pass + 1];
+    // Passes that didn't record any commands don't have timestamps.
+    if (not begin.availability or not end.availability) {
+      continue;
+    }
+    String name = timestamps.pass_names[pass];
+    if (name.empty()) {
+      name = fmt::format("pass {}", pass);
+    }
+    write_span(name, 1 + (usize)timestamps.pass_queues[pass],
+               gpu_offset + (begin.timestamp - gpu_begin) * period,
+               gpu_offset + (end.timestamp - gpu_begin) * period);
+  }
+
+  fmt::println(file, "\n]}}");
+  std::fclose(file);
+}
+
 #if REN_IMGUI
 void Scene::draw_imgui() {
   ren_ImGuiScope(m_imgui_context);
@@ -515,9 +801,100 @@ void Scene::draw_imgui() {
                         &settings.meshlet_frustum_culling);
       }
 
+      ImGui::SeparatorText("Shadows");
+      {
+        ImGui::Checkbox("Directional light shadows", &settings.shadows);
+
+        ImGui::BeginDisabled(!settings.shadows);
+        ImGui::SliderInt("Shadow cascades", &settings.num_shadow_cascades, 1,
+                         glsl::MAX_NUM_SHADOW_CASCADES);
+        ImGui::SliderInt("Shadow map size", &settings.shadow_map_size, 256,
+                         8192, "%d", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderFloat("Shadow distance", &settings.shadow_distance, 1.0f,
+                           1000.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+        ImGui::EndDisabled();
+      }
+
       ImGui::SeparatorText("Opaque pass");
       {
+        ImGui::Checkbox("Visibility buffer", &settings.visibility_buffer);
+        // The visibility buffer pass already writes depth only once per pixel.
+        ImGui::BeginDisabled(settings.visibility_buffer);
         ImGui::Checkbox("Early Z", &settings.early_z);
+        ImGui::BeginDisabled(!settings.early_z);
+        ImGui::SliderFloat("Min occluder screen area",
+                           &settings.early_z_min_occluder_screen_area, 0.0f,
+                           1.0f, "%.4f", ImGuiSliderFlags_Logarithmic);
+        ImGui::EndDisabled();
+        ImGui::EndDisabled();
+      }
+
+      ImGui::SeparatorText("Render graph");
+      {
+        ImGui::SliderInt("Recording threads", &settings.num_recording_threads,
+                         1, 16);
+        ImGui::BeginDisabled(!m_renderer->has_async_compute());
+        ImGui::Checkbox("Async compute", &settings.async_compute);
+        ImGui::EndDisabled();
+        ImGui::Checkbox("Reorder passes", &settings.reorder_passes);
+        if (settings.reorder_passes) {
+          const RgPassReorderingStats &stats =
+              m_rgp->get_pass_reordering_stats();
+          ImGui::Text("Estimated barrier stalls: %u, %u before reordering",
+                      stats.num_barrier_stalls_after,
+                      stats.num_barrier_stalls_before);
+        }
+      }
+
+      ImGui::SeparatorText("Frame statistics");
+      {
+        const FrameStatistics &stats = m_frame_statistics;
+        ImGui::Text("CPU frame time: %.3f ms", stats.cpu_frame_time_ms);
+        ImGui::Text("CPU render graph build time: %.3f ms",
+                    stats.cpu_build_time_ms);
+        ImGui::Text("CPU render graph record time: %.3f ms",
+                    stats.cpu_record_time_ms);
+        ImGui::Text("GPU frame time: %.3f ms", stats.gpu_frame_time_ms);
+        ImGui::Text("Bump allocator memory: %.1f / %.1f MiB in %u blocks",
+                    stats.num_bump_bytes_used / (1024.0f * 1024.0f),
+                    stats.num_bump_bytes_reserved / (1024.0f * 1024.0f),
+                    stats.num_bump_blocks);
+        ImGui::Text("Bump allocator waste: %.1f MiB",
+                    stats.num_bump_bytes_wasted / (1024.0f * 1024.0f));
+        if (not stats.passes.empty() and
+            ImGui::BeginTable("Passes", 2, ImGuiTableFlags_RowBg)) {
+          ImGui::TableSetupColumn("Pass");
+          ImGui::TableSetupColumn("GPU time, ms");
+          ImGui::TableHeadersRow();
+          for (const PassStatistics &pass : stats.passes) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(pass.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", pass.gpu_time_ms);
+          }
+          ImGui::EndTable();
+        }
+      }
+
+      ImGui::SeparatorText("Memory");
+      {
+        const MemoryStatistics &stats = m_memory_statistics;
+        constexpr float MIB = 1024.0f * 1024.0f;
+        constexpr const char *OWNER_NAMES[NUM_MEMORY_OWNERS] = {
+            "Other",        "Mesh data", "Images",
+            "Render graph", "Upload",    "GPU scene",
+        };
+        for (usize owner : range(NUM_MEMORY_OWNERS)) {
+          ImGui::Text("%s: %.1f MiB", OWNER_NAMES[owner],
+                      stats.owners[owner] / MIB);
+        }
+        for (usize heap : range(stats.heaps.size())) {
+          const MemoryHeapStatistics &hs = stats.heaps[heap];
+          ImGui::Text("Heap %zu (%s): %.1f / %.1f MiB", heap,
+                      hs.device_local ? "VRAM" : "system", hs.usage / MIB,
+                      hs.budget / MIB);
+        }
       }
 
       ImGui::End();
@@ -576,14 +953,22 @@ auto Scene::build_rg() -> RenderGraph {
 
   set_if_changed(m_pass_cfg.backbuffer_usage, m_swapchain->get_usage());
 
+  set_if_changed(m_pass_cfg.shadow_map_size,
+                 u32(m_data.settings.shadow_map_size));
+
   if (dirty) {
     m_rgp->reset();
     m_pass_rcs = {};
   }
 
+  m_rgp->set_async_compute(m_data.settings.async_compute);
+  m_rgp->set_pass_reordering(m_data.settings.reorder_passes);
+
   ScenePerFrameResources &pfr = get_per_frame_resources();
 
-  RgBuilder rgb(*m_rgp, *m_renderer, pfr.descriptor_allocator);
+  m_rg_device->begin_frame(pfr.descriptor_allocator, m_device_allocator,
+                           pfr.upload_allocator);
+  RgBuilder rgb(*m_rgp);
 
   PassCommonConfig cfg = {
       .rgp = m_rgp.get(),
@@ -596,7 +981,7 @@ auto Scene::build_rg() -> RenderGraph {
       .swapchain = m_swapchain,
   };
 
-  RgGpuScene rg_gpu_scene = rg_import_gpu_scene(rgb, m_gpu_scene);
+  RgGpuScene rg_gpu_scene = rg_import_gpu_scene(cfg, m_gpu_scene);
   setup_gpu_scene_update_pass(
       cfg, GpuSceneUpdatePassConfig{.gpu_scene = &rg_gpu_scene});
 
@@ -607,6 +992,12 @@ auto Scene::build_rg() -> RenderGraph {
                                .temporal_layer = &exposure_temporal_layer,
                            });
 
+  ShadowCascades shadows;
+  setup_shadow_passes(cfg, ShadowPassesConfig{
+                               .gpu_scene = rg_gpu_scene,
+                               .shadows = &shadows,
+                           });
+
   RgTextureId depth_buffer;
   RgTextureId hdr;
   setup_opaque_passes(cfg,
@@ -614,17 +1005,20 @@ auto Scene::build_rg() -> RenderGraph {
                           .gpu_scene = rg_gpu_scene,
                           .exposure = exposure,
                           .exposure_temporal_layer = exposure_temporal_layer,
+                          .shadows = shadows,
                           .depth_buffer = &depth_buffer,
                           .hdr = &hdr,
                       });
 
+  // Hi-Z passes are culled by the render graph unless occlusion culling is
+  // enabled.
   RgTextureId hi_z;
-  bool run_hi_z = m_data.settings.instance_occulusion_culling;
-  if (run_hi_z) {
-    setup_hi_z_pass(cfg, HiZPassConfig{
-                             .depth_buffer = depth_buffer,
-                             .hi_z = &hi_z,
-                         });
+  setup_hi_z_pass(cfg, HiZPassConfig{
+                           .depth_buffer = depth_buffer,
+                           .hi_z = &hi_z,
+                       });
+  if (m_data.settings.instance_occulusion_culling) {
+    rgb.set_output_texture(hi_z);
   }
 
   RgTextureId sdr;
@@ -644,6 +1038,27 @@ auto Scene::build_rg() -> RenderGraph {
 
   ScenePerFrameResources &fr = get_per_frame_resources();
 
+  if (m_frame_capture.callback) {
+    FrameCaptureLayout layout = get_frame_capture_layout(
+        m_frame_capture.format, m_swapchain->get_size());
+    if (fr.capture_buffer.size_bytes() < layout.size_bytes) {
+      fr.capture_arena.clear();
+      fr.capture_buffer = fr.capture_arena.create_buffer({
+          .name = "Frame capture buffer",
+          .heap = BufferHeap::Readback,
+          .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          .count = layout.size_bytes,
+      });
+    }
+    setup_frame_capture_passes(
+        cfg, FrameCapturePassConfig{
+                 .src = sdr,
+                 .layout = layout,
+                 .dst = fr.capture_buffer.slice(0, layout.size_bytes),
+             });
+    fr.capture_layout = layout;
+  }
+
   setup_present_pass(cfg, PresentPassConfig{
                               .src = sdr,
                               .acquire_semaphore = fr.acquire_semaphore,
@@ -651,7 +1066,7 @@ auto Scene::build_rg() -> RenderGraph {
                               .swapchain = m_swapchain,
                           });
 
-  RenderGraph rg = rgb.build(m_device_allocator, fr.upload_allocator);
+  RenderGraph rg = rgb.build();
 
   rg_export_gpu_scene(rgb, rg_gpu_scene, &m_gpu_scene);
 
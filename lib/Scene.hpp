@@ -6,27 +6,57 @@
 #include "Light.hpp"
 #include "Material.hpp"
 #include "Mesh.hpp"
+#include "Passes/FrameCapture.hpp"
 #include "Passes/Pass.hpp"
 #include "PipelineLoading.hpp"
 #include "RenderGraph.hpp"
 #include "ResourceUploader.hpp"
 #include "Support/GenArray.hpp"
 #include "Support/GenMap.hpp"
+#include "Support/Optional.hpp"
 #include "Texture.hpp"
+#include "ThreadPool.hpp"
 #include "ren/ren.hpp"
 
+#include <chrono>
+
 struct ImGuiContext;
 
 namespace ren {
 
 using Image = Handle<Texture>;
 
+/// CPU timeline of a frame whose render graph trace is exported.
+struct SceneFrameTrace {
+  String path;
+  std::chrono::steady_clock::time_point frame_start;
+  std::chrono::steady_clock::time_point build_start;
+  std::chrono::steady_clock::time_point build_end;
+  std::chrono::steady_clock::time_point record_end;
+  std::chrono::steady_clock::time_point frame_end;
+};
+
 struct ScenePerFrameResources {
   Handle<Semaphore> acquire_semaphore;
   Handle<Semaphore> present_semaphore;
   UploadBumpAllocator upload_allocator;
   CommandAllocator cmd_allocator;
   DescriptorAllocatorScope descriptor_allocator;
+  /// Allocators of the threads that record render graph passes in parallel
+  /// with the main one.
+  Vector<UploadBumpAllocator> worker_upload_allocators;
+  Vector<CommandAllocator> worker_cmd_allocators;
+  /// Timings of the frame that used these resources.
+  FrameStatistics statistics;
+  RgTimestamps timestamps;
+  /// Host-visible buffer that the frame was captured to, if capture was
+  /// enabled. It is read back when the frame's work completes.
+  ResourceArena capture_arena;
+  BufferView capture_buffer;
+  Optional<FrameCaptureLayout> capture_layout;
+  /// Trace that the frame's timings are written to when its work completes,
+  /// if export was requested.
+  Optional<SceneFrameTrace> trace;
 
 public:
   void reset();
@@ -53,8 +83,29 @@ struct SceneGraphicsSettings {
   bool meshlet_cone_culling = true;
   bool meshlet_frustum_culling = true;
 
+  // Shadows
+  bool shadows = true;
+  i32 num_shadow_cascades = 4;
+  i32 shadow_map_size = 2048;
+  float shadow_distance = 100.0f;
+
   // Opaque pass
   bool early_z = true;
+  /// Only draw flagged occluders and instances that covered at least this
+  /// fraction of the screen in the previous frame in the depth prepass. 0 to
+  /// draw all instances. Off by default until SceneBenchmarks shows that it's
+  /// faster on typical scenes.
+  float early_z_min_occluder_screen_area = 0.0f;
+  bool visibility_buffer = false;
+
+  // Render graph
+  /// Number of threads that record render graph passes, including the main
+  /// one.
+  i32 num_recording_threads = 1;
+  /// Run compute passes that support it on the async compute queue.
+  bool async_compute = true;
+  /// Reorder passes to reduce pipeline stalls on barriers.
+  bool reorder_passes = false;
 };
 
 struct SceneData {
@@ -72,6 +123,8 @@ struct SceneData {
 
   GenArray<MeshInstance> mesh_instances;
   GenMap<glm::mat4x3, Handle<MeshInstance>> mesh_instance_transforms;
+  /// Incremented when mesh instances are created, destroyed or moved.
+  u64 geometry_version = 0;
   Vector<Handle<MeshInstance>> update_mesh_instances;
   Vector<glsl::MeshInstance> mesh_instance_update_data;
 
@@ -93,6 +146,7 @@ public:
 struct Samplers {
   Handle<Sampler> dflt;
   Handle<Sampler> hi_z;
+  Handle<Sampler> shadow_map;
 };
 
 class Scene final : public IScene {
@@ -119,6 +173,10 @@ public:
 
   void set_exposure(const ExposureDesc &desc) override;
 
+  void set_frame_capture(FrameCaptureDesc desc) override;
+
+  void export_render_graph(RenderGraphExportDesc desc) override;
+
   auto create_mesh(const MeshCreateInfo &desc) -> expected<MeshId> override;
 
   auto create_image(const ImageCreateInfo &desc) -> expected<ImageId> override;
@@ -147,8 +205,16 @@ public:
 
   auto draw() -> expected<void> override;
 
+  auto get_frame_statistics() const -> FrameStatistics override;
+
+  auto get_memory_statistics() const -> MemoryStatistics override;
+
   void next_frame();
 
+  /// Settings that are otherwise only changed from the debug UI. Used by
+  /// benchmarks to compare rendering modes.
+  auto get_settings() -> SceneGraphicsSettings & { return m_data.settings; }
+
 #if REN_IMGUI
   void set_imgui_context(ImGuiContext *context) noexcept;
 
@@ -172,6 +238,22 @@ private:
 
   auto get_camera(CameraId camera) -> Camera &;
 
+  /// Reads back GPU timings of the frame that used the per-frame resources
+  /// after its work has completed.
+  void update_frame_statistics(const ScenePerFrameResources &frame);
+
+  /// Hands the frame captured to the per-frame resources to the capture
+  /// callback after its work has completed.
+  void deliver_captured_frame(ScenePerFrameResources &frame);
+
+  /// Writes the Chrome trace of the frame that used the per-frame resources
+  /// after its work has completed. Must be called after its statistics have
+  /// been updated.
+  void write_frame_trace(ScenePerFrameResources &frame);
+
+  /// Queries memory usage and refreshes heap budgets for the new frame.
+  void update_memory_statistics();
+
   [[nodiscard]] auto get_or_create_sampler(
       const SamplerCreateInfo &&create_info) -> Handle<Sampler>;
 
@@ -193,11 +275,27 @@ private:
   ResourceArena m_fif_arena;
   std::unique_ptr<DescriptorAllocator> m_descriptor_allocator;
   SmallVector<ScenePerFrameResources, 3> m_per_frame_resources;
+  /// Workers that record render graph passes in parallel with the main
+  /// thread. Recreated when the number of recording threads changes.
+  Optional<ThreadPool> m_recording_thread_pool;
   u64 m_graphics_time = 0;
   u32 m_num_frames_in_flight = 2;
   u32 m_new_num_frames_in_flight = 0;
   Handle<Semaphore> m_graphics_semaphore;
 
+  FrameStatistics m_frame_statistics;
+  Vector<PassStatistics> m_pass_statistics;
+  Vector<TimestampQueryResult> m_timestamps;
+
+  MemoryStatistics m_memory_statistics;
+  Vector<MemoryHeapStatistics> m_memory_heaps;
+
+  FrameCaptureDesc m_frame_capture;
+
+  RenderGraphExportDesc m_rg_export;
+  /// Number of frames to draw before the render graph is exported.
+  u32 m_rg_export_delay = 0;
+
   Pipelines m_pipelines;
 
   DeviceBumpAllocator m_device_allocator;
@@ -210,6 +308,7 @@ private:
 
   PassPersistentConfig m_pass_cfg;
   PassPersistentResources m_pass_rcs;
+  std::unique_ptr<RgRendererDevice> m_rg_device;
   std::unique_ptr<RgPersistent> m_rgp;
 
   SceneData m_data;
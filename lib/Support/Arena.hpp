@@ -0,0 +1,128 @@
+#pragma once
+#include "Assert.hpp"
+#include "Math.hpp"
+#include "StdDef.hpp"
+#include "Vector.hpp"
+
+#include <memory>
+#include <ranges>
+#include <utility>
+
+namespace ren {
+
+/// Linear allocator for objects that are all destroyed at once when the arena
+/// is reset. Memory blocks are kept after a reset, so an arena that is reset
+/// every frame stops allocating once it has grown to fit a frame.
+class Arena {
+public:
+  explicit Arena(usize block_size = 64 * 1024) : m_block_size(block_size) {}
+  Arena(const Arena &) = delete;
+  Arena(Arena &&) = default;
+  ~Arena() { reset(); }
+
+  Arena &operator=(const Arena &) = delete;
+  Arena &operator=(Arena &&other) noexcept {
+    reset();
+    m_blocks = std::move(other.m_blocks);
+    m_block_size = other.m_block_size;
+    m_block = std::exchange(other.m_block, 0);
+    m_offset = std::exchange(other.m_offset, 0);
+    m_destructors = std::move(other.m_destructors);
+    return *this;
+  }
+
+  auto allocate(usize size, usize alignment) -> void * {
+    ren_assert(alignment <= alignof(std::max_align_t));
+    while (m_block < m_blocks.size()) {
+      Block &block = m_blocks[m_block];
+      usize offset = pad(m_offset, alignment);
+      if (offset + size <= block.size) {
+        m_offset = offset + size;
+        return block.data.get() + offset;
+      }
+      m_block++;
+      m_offset = 0;
+    }
+    usize block_size = std::max(m_block_size, size);
+    m_blocks.push_back({
+        .data = std::make_unique<std::byte[]>(block_size),
+        .size = block_size,
+    });
+    m_block = m_blocks.size() - 1;
+    m_offset = size;
+    return m_blocks.back().data.get();
+  }
+
+  template <typename T, typename... Args>
+  auto create(Args &&...args) -> T * {
+    T *ptr = std::construct_at((T *)allocate(sizeof(T), alignof(T)),
+                               std::forward<Args>(args)...);
+    if constexpr (not std::is_trivially_destructible_v<T>) {
+      m_destructors.push_back({
+          .ptr = ptr,
+          .destroy = [](void *ptr) { std::destroy_at((T *)ptr); },
+      });
+    }
+    return ptr;
+  }
+
+  /// Destroys all objects in reverse order of creation and makes the arena's
+  /// memory available for reuse.
+  void reset() {
+    for (const Destructor &destructor : m_destructors | std::views::reverse) {
+      destructor.destroy(destructor.ptr);
+    }
+    m_destructors.clear();
+    m_block = 0;
+    m_offset = 0;
+  }
+
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    usize size = 0;
+  };
+
+  struct Destructor {
+    void *ptr = nullptr;
+    void (*destroy)(void *) = nullptr;
+  };
+
+  Vector<Block> m_blocks;
+  usize m_block_size = 0;
+  usize m_block = 0;
+  usize m_offset = 0;
+  Vector<Destructor> m_destructors;
+};
+
+template <typename Signature> class ArenaFunction;
+
+/// Non-owning type-erased callable whose closure is stored in an arena. It's
+/// valid until the arena is reset.
+template <typename R, typename... Args> class ArenaFunction<R(Args...)> {
+public:
+  ArenaFunction() = default;
+
+  template <typename F>
+    requires std::invocable<std::decay_t<F> &, Args...>
+  ArenaFunction(Arena &arena, F &&f) {
+    using Closure = std::decay_t<F>;
+    m_closure = arena.create<Closure>(std::forward<F>(f));
+    m_trampoline = [](void *closure, Args... args) -> R {
+      return (*(Closure *)closure)(std::forward<Args>(args)...);
+    };
+  }
+
+  explicit operator bool() const { return m_trampoline != nullptr; }
+
+  auto operator()(Args... args) const -> R {
+    ren_assert(m_trampoline);
+    return m_trampoline(m_closure, std::forward<Args>(args)...);
+  }
+
+private:
+  void *m_closure = nullptr;
+  R (*m_trampoline)(void *, Args...) = nullptr;
+};
+
+} // namespace ren
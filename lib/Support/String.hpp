@@ -37,4 +37,40 @@ struct StringHash {
 template <> struct Hash<String> : StringHash {};
 template <> struct Hash<StringView> : StringHash {};
 
+/// Escapes a string for use in a double-quoted JSON string or Graphviz ID.
+/// Quotes and backslashes are prefixed with a backslash and control
+/// characters are replaced with escape sequences.
+inline auto escape_string(StringView str) -> String {
+  String escaped;
+  escaped.reserve(str.size());
+  for (char c : str) {
+    switch (c) {
+    case '"':
+    case '\\':
+      escaped.push_back('\\');
+      escaped.push_back(c);
+      break;
+    case '\n':
+      escaped.append("\\n");
+      break;
+    case '\r':
+      escaped.append("\\r");
+      break;
+    case '\t':
+      escaped.append("\\t");
+      break;
+    default:
+      if ((unsigned char)c < 0x20 or c == 0x7f) {
+        constexpr const char *HEX_DIGITS = "0123456789abcdef";
+        escaped.append("\\u00");
+        escaped.push_back(HEX_DIGITS[(unsigned char)c >> 4]);
+        escaped.push_back(HEX_DIGITS[(unsigned char)c & 0xf]);
+      } else {
+        escaped.push_back(c);
+      }
+    }
+  }
+  return escaped;
+}
+
 }; // namespace ren
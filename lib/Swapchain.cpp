@@ -4,6 +4,7 @@
 #include "Support/Errors.hpp"
 
 #include <algorithm>
+#include <thread>
 
 namespace ren {
 
@@ -116,6 +117,29 @@ Swapchain::Swapchain(Renderer &renderer, VkSurfaceKHR surface) {
   create();
 }
 
+Swapchain::Swapchain(Renderer &renderer,
+                     const OffscreenSwapchainCreateInfo &create_info) {
+  m_renderer = &renderer;
+
+  m_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+      .minImageCount = std::max(create_info.num_images, 1u),
+      .imageFormat = VK_FORMAT_R8G8B8A8_SRGB,
+      .imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+      .imageExtent = {create_info.width, create_info.height},
+      .imageArrayLayers = 1,
+      // Offscreen images can be copied out after they have been rendered.
+      .imageUsage = BLIT_STRATEGY_USAGE | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+      .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+  };
+
+  m_frame_time =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<float>(create_info.frame_time));
+
+  create_offscreen();
+}
+
 Swapchain::~Swapchain() {
   m_renderer->wait_idle();
   destroy();
@@ -170,6 +194,26 @@ void Swapchain::create() {
   }
 }
 
+void Swapchain::create_offscreen() {
+  if (m_create_info.imageExtent.width == 0 or
+      m_create_info.imageExtent.height == 0) {
+    return;
+  }
+  m_renderer->wait_idle();
+  destroy();
+  m_textures.resize(m_create_info.minImageCount);
+  for (Handle<Texture> &texture : m_textures) {
+    texture = m_renderer->create_texture({
+        .name = "Offscreen swapchain image",
+        .format = m_create_info.imageFormat,
+        .usage = m_create_info.imageUsage,
+        .width = m_create_info.imageExtent.width,
+        .height = m_create_info.imageExtent.height,
+    });
+  }
+  m_image_index = -1;
+}
+
 void Swapchain::destroy() {
   vkDestroySwapchainKHR(m_renderer->get_device(), m_swapchain, nullptr);
   for (Handle<Texture> t : m_textures) {
@@ -190,6 +234,23 @@ void Swapchain::set_present_mode(VkPresentModeKHR present_mode) { todo(); }
 
 auto Swapchain::acquire_texture(Handle<Semaphore> signal_semaphore)
     -> Handle<Texture> {
+  if (is_offscreen()) {
+    if (m_textures.empty() or
+        glm::uvec2(m_renderer->get_texture(m_textures[0]).size) != get_size()) {
+      create_offscreen();
+    }
+    // Scenes don't draw frames while an offscreen swapchain is 0x0.
+    ren_assert(not m_textures.empty());
+    m_image_index = (m_image_index + 1) % m_textures.size();
+    // Images aren't presented, so the next one can be used right away.
+    m_renderer->graphicsQueueSubmit({}, {}, {{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = m_renderer->get_semaphore(signal_semaphore).handle,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    }});
+    return m_textures[m_image_index];
+  }
+
   while (true) {
     VkResult result = vkAcquireNextImageKHR(
         m_renderer->get_device(), m_swapchain, UINT64_MAX,
@@ -209,6 +270,20 @@ auto Swapchain::acquire_texture(Handle<Semaphore> signal_semaphore)
 }
 
 void Swapchain::present(Handle<Semaphore> wait_semaphore) {
+  if (is_offscreen()) {
+    // Consume the semaphore so that it can be signaled again.
+    m_renderer->graphicsQueueSubmit({}, {{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = m_renderer->get_semaphore(wait_semaphore).handle,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    }});
+    if (m_frame_time.count() > 0) {
+      std::this_thread::sleep_until(m_present_time + m_frame_time);
+    }
+    m_present_time = std::chrono::steady_clock::now();
+    return;
+  }
+
   VkPresentInfoKHR present_info = {
       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
       .waitSemaphoreCount = 1,
@@ -3,6 +3,8 @@
 #include "Support/Vector.hpp"
 #include "Texture.hpp"
 
+#include <chrono>
+
 namespace ren {
 
 class Renderer;
@@ -15,19 +17,26 @@ struct SwapchainTextureCreateInfo {
   u32 height = 1;
 };
 
+/// Presents to a window surface, or renders to a ring of offscreen images if
+/// it doesn't have one.
 class Swapchain final : public ISwapchain {
   Renderer *m_renderer = nullptr;
   VkSwapchainKHR m_swapchain = nullptr;
   SmallVector<Handle<Texture>, 3> m_textures;
   u32 m_image_index = -1;
   VkSwapchainCreateInfoKHR m_create_info = {};
+  std::chrono::steady_clock::duration m_frame_time = {};
+  std::chrono::steady_clock::time_point m_present_time;
 
 private:
   void create();
+  void create_offscreen();
   void destroy();
 
 public:
   Swapchain(Renderer &renderer, VkSurfaceKHR surface);
+  Swapchain(Renderer &renderer,
+            const OffscreenSwapchainCreateInfo &create_info);
   Swapchain(const Swapchain &) = delete;
   Swapchain(Swapchain &&) noexcept;
   ~Swapchain();
@@ -55,6 +64,8 @@ public:
 
   auto get_surface() const -> VkSurfaceKHR { return m_create_info.surface; }
 
+  auto is_offscreen() const -> bool { return not m_create_info.surface; }
+
   auto acquire_texture(Handle<Semaphore> signal_semaphore) -> Handle<Texture>;
 
   void present(Handle<Semaphore> wait_semaphore);
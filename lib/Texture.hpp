@@ -19,11 +19,22 @@ struct TextureCreateInfo {
   u32 depth = 1;
   u32 num_mip_levels = 1;
   u32 num_array_layers = 1;
+  /// Share the texture between the graphics and the async compute queue.
+  /// Otherwise, it belongs to the queue family that uses it first.
+  bool concurrent = false;
+  /// Memory to place the texture in instead of allocating new memory. The
+  /// texture doesn't own it.
+  VmaAllocation alias_allocation = nullptr;
+  /// Ignored if the texture is placed in aliased memory, which is accounted
+  /// for when it is allocated.
+  MemoryOwner owner = MemoryOwner::Other;
 };
 
 struct Texture {
   VkImage image;
   VmaAllocation allocation;
+  /// Placed in memory that is owned by someone else.
+  bool is_alias;
   VkImageType type;
   VkFormat format;
   VkImageUsageFlags usage;
@@ -37,6 +48,8 @@ struct Texture {
   };
   u32 num_mip_levels;
   u32 num_array_layers;
+  /// Shared between the graphics and the async compute queue.
+  bool concurrent;
 };
 
 struct TextureState {
@@ -0,0 +1,74 @@
+#include "ThreadPool.hpp"
+#include "Support/Assert.hpp"
+#include "Support/Views.hpp"
+
+namespace ren {
+
+ThreadPool::ThreadPool(u32 num_workers) {
+  m_workers.reserve(num_workers);
+  for (u32 worker : range(num_workers)) {
+    m_workers.emplace_back([this, worker] { work(worker); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::scoped_lock lock(m_mutex);
+    m_stop = true;
+  }
+  m_start_cv.notify_all();
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(u32 num_tasks, void *cb,
+                     void (*trampoline)(void *, u32)) {
+  ren_assert(num_tasks <= m_workers.size() + 1);
+  if (num_tasks == 0) {
+    return;
+  }
+  if (num_tasks > 1) {
+    {
+      std::scoped_lock lock(m_mutex);
+      m_generation++;
+      m_num_tasks = num_tasks;
+      m_num_running_workers = num_tasks - 1;
+      m_cb = cb;
+      m_trampoline = trampoline;
+    }
+    m_start_cv.notify_all();
+  }
+  trampoline(cb, 0);
+  if (num_tasks > 1) {
+    std::unique_lock lock(m_mutex);
+    m_finish_cv.wait(lock, [&] { return m_num_running_workers == 0; });
+  }
+}
+
+void ThreadPool::work(u32 worker) {
+  u64 generation = 0;
+  std::unique_lock lock(m_mutex);
+  while (true) {
+    m_start_cv.wait(lock,
+                    [&] { return m_stop or m_generation != generation; });
+    if (m_stop) {
+      return;
+    }
+    generation = m_generation;
+    u32 task = worker + 1;
+    if (task >= m_num_tasks) {
+      continue;
+    }
+    void *cb = m_cb;
+    auto *trampoline = m_trampoline;
+    lock.unlock();
+    trampoline(cb, task);
+    lock.lock();
+    if (--m_num_running_workers == 0) {
+      m_finish_cv.notify_one();
+    }
+  }
+}
+
+} // namespace ren
@@ -0,0 +1,50 @@
+#pragma once
+#include "Support/StdDef.hpp"
+#include "Support/Vector.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ren {
+
+/// Threads that are started once and then run a fixed number of tasks at a
+/// time, one per worker and one on the calling thread, so that work can be
+/// split between threads every frame without starting new ones.
+class ThreadPool {
+public:
+  explicit ThreadPool(u32 num_workers);
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  auto get_num_workers() const -> u32 { return m_workers.size(); }
+
+  /// Calls cb(i) for each i in [0, num_tasks) and returns after all calls
+  /// have returned. Task 0 runs on the calling thread and task i on worker
+  /// i - 1, so there can be at most one more task than there are workers.
+  template <typename F> void run(u32 num_tasks, F &cb) {
+    run(num_tasks, &cb,
+        [](void *cb, u32 task) { (*static_cast<F *>(cb))(task); });
+  }
+
+private:
+  void run(u32 num_tasks, void *cb, void (*trampoline)(void *, u32));
+
+  void work(u32 worker);
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_start_cv;
+  std::condition_variable m_finish_cv;
+  /// Incremented each time tasks are started.
+  u64 m_generation = 0;
+  u32 m_num_tasks = 0;
+  u32 m_num_running_workers = 0;
+  void *m_cb = nullptr;
+  void (*m_trampoline)(void *, u32) = nullptr;
+  bool m_stop = false;
+  Vector<std::thread> m_workers;
+};
+
+} // namespace ren
@@ -7,9 +7,14 @@
 
 GLSL_NAMESPACE_BEGIN
 
+/// The instance is always drawn by occluder-only passes.
+const uint INSTANCE_CULL_OCCLUDER_BIT = 1 << 0;
+
 struct InstanceCullData {
   uint mesh;
   uint mesh_instance;
+  /// Combination of INSTANCE_CULL_*_BIT flags
+  uint flags;
 };
 
 GLSL_DEFINE_PTR_TYPE(InstanceCullData, 4);
@@ -49,14 +54,40 @@ inline ClipSpaceBoundingBox project_bb_to_cs(mat4 pvm,
   return cs_bb;
 }
 
-inline void get_cs_bb_min_max_z(ClipSpaceBoundingBox cs_bb,
-                                GLSL_OUT(float) zmin, GLSL_OUT(float) zmax) {
-  zmin = cs_bb.p[0].w;
-  zmax = cs_bb.p[0].w;
-  for (int i = 1; i < 8; ++i) {
-    zmin = min(zmin, cs_bb.p[i].w);
-    zmax = max(zmax, cs_bb.p[i].w);
+/// Assumes reverse-Z, so the view volume in clip space is -w <= x <= w,
+/// -w <= y <= w, 0 <= z <= w. These are the frustum planes of the projection
+/// matrix and hold for both perspective and orthographic projections, with
+/// either a finite or an infinite far plane. Since a bounding box is a convex
+/// hull of its corners, it's outside of the view volume if all corners are
+/// outside of the same plane, no matter on which side of the camera they lie.
+inline bool cull_cs_bb(ClipSpaceBoundingBox cs_bb) {
+  bool left = true;
+  bool right = true;
+  bool bottom = true;
+  bool top = true;
+  bool behind_far = true;
+  bool before_near = true;
+  for (int i = 0; i < 8; ++i) {
+    vec4 p = cs_bb.p[i];
+    left = left && p.x < -p.w;
+    right = right && p.x > p.w;
+    bottom = bottom && p.y < -p.w;
+    top = top && p.y > p.w;
+    behind_far = behind_far && p.z < 0.0f;
+    before_near = before_near && p.z > p.w;
+  }
+  return left || right || bottom || top || behind_far || before_near;
+}
+
+/// Assumes reverse-Z. Returns true if some of the bounding box's corners are in
+/// front of the near plane, in which case its projection can't be computed.
+inline bool cs_bb_crosses_near_plane(ClipSpaceBoundingBox cs_bb) {
+  for (int i = 0; i < 8; ++i) {
+    if (cs_bb.p[i].z >= cs_bb.p[i].w) {
+      return true;
+    }
   }
+  return false;
 }
 
 struct NDCBoundingBox {
@@ -71,24 +102,6 @@ inline NDCBoundingBox convert_cs_bb_to_ndc(ClipSpaceBoundingBox cs_bb) {
   return ndc_bb;
 }
 
-inline void get_ndc_bb_min_max(NDCBoundingBox ndc_bb, GLSL_OUT(vec3) ndc_min,
-                               GLSL_OUT(vec3) ndc_max) {
-  ndc_min = ndc_bb.ndc[0];
-  ndc_max = ndc_bb.ndc[0];
-  for (int i = 1; i < 8; ++i) {
-    ndc_min = min(ndc_min, ndc_bb.ndc[i]);
-    ndc_max = max(ndc_max, ndc_bb.ndc[i]);
-  }
-}
-
-/// Assumes reverse-Z.
-inline bool cull_ndc_bb(NDCBoundingBox ndc_bb) {
-  vec3 ndc_min, ndc_max;
-  get_ndc_bb_min_max(ndc_bb, ndc_min, ndc_max);
-  return any(lessThan(ndc_max, vec3(-1.0f, -1.0f, 0.0f))) ||
-         any(greaterThan(vec2(ndc_min), vec2(1.0f)));
-}
-
 inline float get_ndc_bb_area(NDCBoundingBox ndc_bb) {
   const uvec4 faces[6] = {
       // Top
@@ -118,10 +131,105 @@ inline float get_ndc_bb_area(NDCBoundingBox ndc_bb) {
   return area;
 }
 
+/// Returns the fraction of the screen that is covered by a mesh's bounding box,
+/// or 0 if it is outside of the view frustum.
+inline float get_screen_area(mat4 pvm, Mesh mesh) {
+  ClipSpaceBoundingBox cs_bb = project_bb_to_cs(pvm, mesh.bb);
+  if (cull_cs_bb(cs_bb)) {
+    return 0.0f;
+  }
+  if (cs_bb_crosses_near_plane(cs_bb)) {
+    return 1.0f;
+  }
+  // NDC area of the whole screen is 4.
+  return min(get_ndc_bb_area(convert_cs_bb_to_ndc(cs_bb)) / 4.0f, 1.0f);
+}
+
+/// Returns the LOD that should be used to draw a mesh or -1 if the mesh should
+/// be culled.
+inline int cull_and_select_lod(mat4 pvm, Mesh mesh, bool frustum_culling,
+                               bool lod_selection,
+                               float lod_triangle_density) {
+  if (!frustum_culling && !lod_selection) {
+    return 0;
+  }
+
+  ClipSpaceBoundingBox cs_bb = project_bb_to_cs(pvm, mesh.bb);
+
+  if (frustum_culling && cull_cs_bb(cs_bb)) {
+    return -1;
+  }
+
+  if (!lod_selection) {
+    return 0;
+  }
+
+  // Select highest lod if bounding box crosses near plane.
+  if (cs_bb_crosses_near_plane(cs_bb)) {
+    return 0;
+  }
+
+  NDCBoundingBox ndc_bb = convert_cs_bb_to_ndc(cs_bb);
+
+  float area = get_ndc_bb_area(ndc_bb);
+  uint num_triangles = uint(area * lod_triangle_density);
+
+  int l = 0;
+  for (; l < int(mesh.num_lods) - 1; ++l) {
+    if (mesh.lods[l].num_triangles <= num_triangles) {
+      break;
+    }
+  }
+
+  return l;
+}
+
+/// The eye position is in homogeneous coordinates. For orthographic projections
+/// its w is 0 and xyz point towards the camera.
+inline bool cull_meshlet(mat4x3 transform_matrix, mat4 proj_view, vec4 eye,
+                         Meshlet meshlet, bool cone_culling,
+                         bool frustum_culling) {
+  if (!cone_culling && !frustum_culling) {
+    return false;
+  }
+
+  if (cone_culling) {
+    vec3 cone_apex =
+        transform_matrix * vec4(decode_position(meshlet.cone_apex), 1.0f);
+    vec3 cone_axis =
+        transform_matrix * vec4(decode_position(meshlet.cone_axis), 0.0f);
+    vec3 view = cone_apex * eye.w - vec3(eye);
+    if (dot(view, normalize(cone_axis)) >= meshlet.cone_cutoff * length(view)) {
+      return true;
+    }
+  }
+
+  if (!frustum_culling) {
+    return false;
+  }
+
+  mat4 pvm = proj_view * mat4(transform_matrix);
+  ClipSpaceBoundingBox cs_bb = project_bb_to_cs(pvm, meshlet.bb);
+
+  return cull_cs_bb(cs_bb);
+}
+
 const uint MESHLET_CULLING_THREADS = 128;
 
 const uint NUM_MESHLET_CULLING_BUCKETS = MESH_MESHLET_COUNT_BITS;
 
+/// Returns the number of entries that are reserved for a meshlet culling
+/// bucket. Each instance adds at most one entry to a bucket and an entry in
+/// bucket i covers 2^i meshlets of a draw that has num_meshlets meshlets in the
+/// highest LOD of all of its instances.
+inline uint get_meshlet_culling_bucket_size(uint num_instances,
+                                            uint num_meshlets, uint bucket) {
+  return min(num_instances, num_meshlets >> bucket);
+}
+
+/// Maximum number of views that can share a single culling pass.
+const uint MAX_NUM_CULLING_VIEWS = 8;
+
 GLSL_NAMESPACE_END
 
 #endif // REN_GLSL_CULLING_H
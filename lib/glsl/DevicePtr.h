@@ -17,6 +17,8 @@ const uint DEVICE_CACHE_LINE_SIZE = 128;
 
 GLSL_DEFINE_PTR_TYPE(uint, 4);
 
+GLSL_DEFINE_PTR_TYPE(float, 4);
+
 GLSL_DEFINE_PTR_TYPE(mat4x3, 4);
 
 GLSL_DEFINE_PTR_TYPE(mat3, 4);
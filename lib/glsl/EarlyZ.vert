@@ -2,6 +2,10 @@
 
 PUSH_CONSTANTS(EarlyZPassArgs);
 
+// The opaque pass must produce bit-identical depth for depth testing against
+// the prepass to work.
+invariant gl_Position;
+
 void main() {
   MeshInstance mesh_instance = DEREF(pc.mesh_instances[gl_BaseInstance]);
   mat4x3 transform_matrix = DEREF(pc.transform_matrices[gl_BaseInstance]);
@@ -0,0 +1,36 @@
+#ifndef REN_GLSL_FRAME_CAPTURE_PASS_H
+#define REN_GLSL_FRAME_CAPTURE_PASS_H
+
+#include "Common.h"
+#include "DevicePtr.h"
+#include "Texture.h"
+
+GLSL_NAMESPACE_BEGIN
+
+const uint FRAME_CAPTURE_FORMAT_RGBA8 = 0;
+const uint FRAME_CAPTURE_FORMAT_YUV420 = 1;
+
+/// Each thread converts a block of pixels. The width of the Y plane is padded
+/// to a multiple of the block width so that each row of a block is written as
+/// whole words, and its height is padded to a multiple of 2 for chroma
+/// subsampling.
+const uint FRAME_CAPTURE_BLOCK_SIZE_X = 8;
+const uint FRAME_CAPTURE_BLOCK_SIZE_Y = 2;
+
+struct FrameCapturePassArgs {
+  /// RGBA8 pixels or the Y plane, followed by the U and V planes.
+  GLSL_PTR(uint) data;
+  StorageTexture2D src;
+  uvec2 size;
+  uint format;
+  /// Offsets of the U and V planes in words.
+  uint u_offset;
+  uint v_offset;
+};
+
+const uint FRAME_CAPTURE_THREADS_X = 8;
+const uint FRAME_CAPTURE_THREADS_Y = 8;
+
+GLSL_NAMESPACE_END
+
+#endif // REN_GLSL_FRAME_CAPTURE_PASS_H
@@ -26,14 +26,15 @@ static_assert((1 << (HI_Z_SPD_NUM_TILE_MIPS - 1)) == HI_Z_SPD_TILE_SIZE);
 const uint HI_Z_SPD_MAX_SIZE = HI_Z_SPD_TILE_SIZE * HI_Z_SPD_TILE_SIZE;
 
 struct HiZSpdPassArgs {
-  /// SPD counter, initialize to 0.
-  GLSL_PTR(uint) counter;
-  /// Destination descriptors.
+  /// Destination descriptors, indexed by mip level.
   GLSL_PTR(RWStorageTexture2D) dsts;
   /// Each destination side length must be the next smallest power-of-two after
   /// each source side's length.
   uvec2 dst_size;
   uint num_dst_mips;
+  /// If not 0, reduce the last tile mip level into the remaining ones with a
+  /// single workgroup instead of reducing the source into the tile mip levels.
+  uint tail;
   /// Source descriptor.
   SampledTexture2D src;
 };
@@ -14,14 +14,29 @@ const uint INSTANCE_CULLING_AND_LOD_THREADS = 128;
 
 const uint INSTANCE_CULLING_AND_LOD_FRUSTUM_BIT = 1 << 0;
 const uint INSTANCE_CULLING_AND_LOD_LOD_SELECTION_BIT = 1 << 1;
+/// Only keep flagged occluders and instances whose screen area in the previous
+/// frame was at least min_occluder_screen_area.
+const uint INSTANCE_CULLING_AND_LOD_OCCLUDERS_BIT = 1 << 2;
+/// Store the screen area of each instance in the first view for the next
+/// frame's occluder selection.
+const uint INSTANCE_CULLING_AND_LOD_WRITE_SCREEN_AREAS_BIT = 1 << 3;
+
+struct InstanceCullingAndLODView {
+  mat4 proj_view;
+  float lod_triangle_density;
+};
 
 struct InstanceCullingAndLODPassUniforms {
   uint feature_mask;
   uint num_instances;
-  mat4 proj_view;
-  float lod_triangle_density;
+  uint num_views;
   int lod_bias;
+  float min_occluder_screen_area;
   GLSL_ARRAY(uint, meshlet_bucket_offsets, NUM_MESHLET_CULLING_BUCKETS);
+  /// Distance between the meshlet cull data of consecutive views. Bucket
+  /// commands and sizes are laid out view by view.
+  uint meshlet_cull_data_view_stride;
+  GLSL_ARRAY(InstanceCullingAndLODView, views, MAX_NUM_CULLING_VIEWS);
 };
 
 GLSL_DEFINE_PTR_TYPE(InstanceCullingAndLODPassUniforms, 4);
@@ -34,6 +49,8 @@ struct InstanceCullingAndLODPassArgs {
   GLSL_PTR(DispatchIndirectCommand) meshlet_bucket_commands;
   GLSL_PTR(uint) meshlet_bucket_sizes;
   GLSL_PTR(MeshletCullData) meshlet_cull_data;
+  /// Screen area of each mesh instance in the previous frame.
+  GLSL_PTR(float) screen_areas;
   int pad;
 };
 
@@ -2,5 +2,26 @@
 #define REN_GLSL_LIGHTING_GLSL
 
 #include "Lighting.h"
+#include "Texture.glsl"
+
+/// Samples the first shadow cascade that contains the position. Points outside
+/// of all cascades are lit.
+float get_shadow_visibility(
+    vec3 position, uint num_cascades,
+    mat4 proj_views[MAX_NUM_SHADOW_CASCADES],
+    SampledTexture2D shadow_maps[MAX_NUM_SHADOW_CASCADES]) {
+  for (uint c = 0; c < num_cascades; ++c) {
+    vec4 p = proj_views[c] * vec4(position, 1.0f);
+    vec3 ndc = p.xyz / p.w;
+    if (any(greaterThan(abs(ndc.xy), vec2(1.0f))) || ndc.z < 0.0f || ndc.z > 1.0f) {
+      continue;
+    }
+    vec2 uv = ndc.xy * 0.5f + 0.5f;
+    float depth = texture_lod(shadow_maps[c], uv, 0).r;
+    // Reverse-Z: points closer to the light have greater depth.
+    return float(ndc.z + SHADOW_MAP_DEPTH_BIAS >= depth);
+  }
+  return 1.0f;
+}
 
 #endif // REN_GLSL_LIGHTING_GLSL
@@ -14,8 +14,14 @@ struct DirectionalLight {
 
 GLSL_DEFINE_PTR_TYPE(DirectionalLight, 4);
 
+const uint MAX_NUM_SHADOW_CASCADES = 4;
+
+/// Constant bias in reverse-Z shadow map depth to prevent self-shadowing.
+const float SHADOW_MAP_DEPTH_BIAS = 0.0005f;
+
+/// Visibility scales direct lighting only and is 0 for fully shadowed points.
 inline vec3 lighting(vec3 n, vec3 l, vec3 v, vec3 color, float metallic,
-                     float roughness, vec3 illuminance) {
+                     float roughness, vec3 illuminance, float visibility) {
   float alpha = roughness * roughness;
   float alpha2 = alpha * alpha;
 
@@ -50,7 +56,7 @@ inline vec3 lighting(vec3 n, vec3 l, vec3 v, vec3 color, float metallic,
 
   const float PI = radians(180.0f);
 
-  vec3 direct = float(nl > 0.0f) * illuminance * (fd + fs);
+  vec3 direct = visibility * float(nl > 0.0f) * illuminance * (fd + fs);
   vec3 indirect = 0.1f * illuminance * fd;
 
   return (direct + indirect) / PI;
@@ -23,7 +23,8 @@ struct MeshletCullingPassArgs {
   uint feature_mask;
   /// Current bucket index.
   uint bucket;
-  vec3 eye;
+  /// Eye position in homogeneous coordinates.
+  vec4 eye;
   mat4 proj_view;
 };
 
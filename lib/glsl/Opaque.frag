@@ -52,7 +52,13 @@ void main() {
   vec3 view = normalize(pc.eye - v_position);
   for (int i = 0; i < pc.num_directional_lights; ++i) {
     DirectionalLight light = DEREF(pc.directional_lights[i]);
-    result.xyz += lighting(normal, light.origin, view, color.xyz, metallic, roughness, light.color * light.illuminance);
+    float visibility = 1.0f;
+    if (uint(i) == DEREF(pc.ub).shadowed_directional_light) {
+      OpaquePassUniforms ub = DEREF(pc.ub);
+      visibility = get_shadow_visibility(v_position, ub.num_shadow_cascades,
+                                         ub.shadow_proj_views, ub.shadow_maps);
+    }
+    result.xyz += lighting(normal, light.origin, view, color.xyz, metallic, roughness, light.color * light.illuminance, visibility);
   }
 
   float exposure = image_load(pc.exposure, ivec2(0)).r;
@@ -11,6 +11,8 @@ layout(location = V_COLOR) out vec4 v_color;
 
 layout(location = V_MATERIAL) out flat uint v_material;
 
+invariant gl_Position;
+
 void main() {
   OpaquePassUniforms ub = DEREF(pc.ub);
 
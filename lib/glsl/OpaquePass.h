@@ -6,6 +6,7 @@
 #include "Lighting.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "Texture.h"
 
 GLSL_NAMESPACE_BEGIN
 
@@ -15,6 +16,12 @@ struct OpaquePassUniforms {
   GLSL_PTR(mat4x3) transform_matrices;
   GLSL_PTR(mat3) normal_matrices;
   mat4 proj_view;
+  uint num_shadow_cascades;
+  /// Index of the directional light that casts shadows.
+  uint shadowed_directional_light;
+  /// Cascades are sorted by distance from the camera.
+  GLSL_ARRAY(mat4, shadow_proj_views, MAX_NUM_SHADOW_CASCADES);
+  GLSL_ARRAY(SampledTexture2D, shadow_maps, MAX_NUM_SHADOW_CASCADES);
 };
 
 GLSL_DEFINE_PTR_TYPE(OpaquePassUniforms, 8);
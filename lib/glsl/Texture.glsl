@@ -16,6 +16,7 @@ layout(binding = SAMPLED_TEXTURES_SLOT) uniform sampler2D g_sampled_textures_2d[
 layout(binding = STORAGE_TEXTURES_SLOT) restrict readonly uniform image2D g_storage_textures_2d[NUM_STORAGE_TEXTURES];
 layout(binding = STORAGE_TEXTURES_SLOT) restrict uniform image2D g_rw_storage_textures_2d[NUM_STORAGE_TEXTURES];
 layout(binding = STORAGE_TEXTURES_SLOT) coherent restrict uniform image2D g_coherent_rw_storage_textures_2d[NUM_STORAGE_TEXTURES];
+layout(binding = STORAGE_TEXTURES_SLOT) restrict readonly uniform uimage2D g_storage_utextures_2d[NUM_STORAGE_TEXTURES];
 // clang-format on
 
 #define MAKE_SAMPLER_2D(s, t) sampler2D(g_textures_2d[t.id], g_samplers[s.id])
@@ -42,6 +43,10 @@ vec4 texture_lod(SampledTexture2D t, vec2 uv, int lod) {
   return textureLod(g_sampled_textures_2d[t.id], uv, lod);
 }
 
+vec4 texture_grad(SampledTexture2D t, vec2 uv, vec2 ddx, vec2 ddy) {
+  return textureGrad(g_sampled_textures_2d[t.id], uv, ddx, ddy);
+}
+
 vec4 texel_fetch(SampledTexture2D t, ivec2 pos, int lod) {
   return texelFetch(g_sampled_textures_2d[t.id], pos, lod);
 }
@@ -75,6 +80,14 @@ DEFINE_W_STORAGE_TEXTURE_2D_IMPL(CoherentRWStorageTexture2D,
 #undef DEFINE_R_STORAGE_TEXTURE_2D_IMPL
 #undef DEFINE_W_STORAGE_TEXTURE_2D_IMPL
 
+ivec2 image_size(UStorageTexture2D img) {
+  return imageSize(g_storage_utextures_2d[img.id]);
+}
+
+uvec4 image_load(UStorageTexture2D img, ivec2 pos) {
+  return imageLoad(g_storage_utextures_2d[img.id], pos);
+}
+
 CoherentRWStorageTexture2D make_coherent(RWStorageTexture2D img) {
   return CoherentRWStorageTexture2D(img.id);
 }
@@ -137,6 +137,9 @@ GLSL_DEFINE_PTR_TYPE(RWStorageTexture2D, TEXTURE_ID_SIZE);
 DEFINE_TEXTURE_DESCRIPTOR(CoherentRWStorageTexture2D, (RWStorageTexture)(RWStorageTexture2D), (StorageTexture)(StorageTexture2D));
 GLSL_DEFINE_PTR_TYPE(CoherentRWStorageTexture2D, TEXTURE_ID_SIZE);
 
+DEFINE_TEXTURE_DESCRIPTOR(UStorageTexture2D, (StorageTexture)(RWStorageTexture), );
+GLSL_DEFINE_PTR_TYPE(UStorageTexture2D, TEXTURE_ID_SIZE);
+
 // clang-format on
 
 #undef DEFINE_TEXTURE_DESCRIPTOR_IMPLICIT_CONVERSION
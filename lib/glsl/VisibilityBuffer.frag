@@ -0,0 +1,11 @@
+#include "VisibilityBufferPass.h"
+
+PUSH_CONSTANTS(VisibilityBufferPassArgs);
+
+layout(location = 0) in flat uint v_command;
+
+layout(location = 0) out uvec2 f_visibility;
+
+void main() {
+  f_visibility = uvec2(pc.draw + 1, (v_command << VISIBILITY_BUFFER_TRIANGLE_BITS) | gl_PrimitiveID);
+}
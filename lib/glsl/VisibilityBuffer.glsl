@@ -0,0 +1,105 @@
+#ifndef REN_GLSL_VISIBILITY_BUFFER_GLSL
+#define REN_GLSL_VISIBILITY_BUFFER_GLSL
+
+#include "DevicePtr.glsl"
+#include "Texture.glsl"
+#include "VisibilityBufferPass.h"
+
+struct VisibilityBufferTriangle {
+  uint mesh_instance;
+  /// Offset of the meshlet's vertices in the mesh's meshlet indices.
+  uint base_vertex;
+  /// Offset of the triangle's first index in the index pool.
+  uint base_index;
+  GLSL_PTR(uint) indices;
+};
+
+/// Returns false if nothing was rasterized into the texel.
+bool decode_visibility_buffer_texel(GLSL_PTR(VisibilityBufferDraw) draws,
+                                    uvec2 texel,
+                                    out VisibilityBufferTriangle triangle) {
+  if (texel.x == 0) {
+    return false;
+  }
+  VisibilityBufferDraw draw = DEREF(draws[texel.x - 1]);
+  uint command_index = texel.y >> VISIBILITY_BUFFER_TRIANGLE_BITS;
+  uint triangle_index =
+      texel.y & ((1 << VISIBILITY_BUFFER_TRIANGLE_BITS) - 1);
+  DrawIndexedIndirectCommand command = DEREF(draw.commands[command_index]);
+  triangle.mesh_instance = command.base_instance;
+  triangle.base_vertex = command.base_vertex;
+  triangle.base_index = command.base_index + 3 * triangle_index;
+  triangle.indices = draw.indices;
+  return true;
+}
+
+/// Returns the vertices of the triangle in the mesh's vertex arrays.
+uvec3 get_visibility_buffer_triangle_vertices(
+    Mesh mesh, VisibilityBufferTriangle triangle) {
+  uvec3 vertices;
+  for (uint k = 0; k < 3; ++k) {
+    uint i = triangle.base_index + k;
+    uint index = (DEREF(triangle.indices[i / 4]) >> (i % 4 * 8)) & 0xFF;
+    vertices[k] =
+        DEREF(mesh.meshlet_indices[triangle.base_vertex + index]);
+  }
+  return vertices;
+}
+
+/// Returns the mesh attributes that are required to shade a mesh instance.
+uint get_required_mesh_attributes(Mesh mesh, Material material) {
+  uint attributes = 0;
+  if (!IS_NULL_DESC(material.base_color_texture) ||
+      !IS_NULL_DESC(material.metallic_roughness_texture)) {
+    attributes |= MESH_ATTRIBUTE_UV_BIT;
+  }
+  if (!IS_NULL_DESC(material.normal_texture)) {
+    attributes |= MESH_ATTRIBUTE_UV_BIT | MESH_ATTRIBUTE_TANGENT_BIT;
+  }
+  if (!IS_NULL_PTR(mesh.colors)) {
+    attributes |= MESH_ATTRIBUTE_COLOR_BIT;
+  }
+  return attributes;
+}
+
+struct Barycentrics {
+  vec3 lambda;
+  /// Derivatives of the barycentrics with respect to the screen x and y
+  /// coordinates.
+  vec3 ddx;
+  vec3 ddy;
+};
+
+/// Computes perspective-correct barycentrics of a pixel and their screen space
+/// derivatives from the triangle's clip space positions. pixel_size is the size
+/// of a pixel in NDC.
+Barycentrics compute_barycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 ndc,
+                                  vec2 pixel_size) {
+  vec3 inv_w = 1.0f / vec3(p0.w, p1.w, p2.w);
+
+  vec2 ndc0 = p0.xy * inv_w.x;
+  vec2 ndc1 = p1.xy * inv_w.y;
+  vec2 ndc2 = p2.xy * inv_w.z;
+
+  float inv_det = 1.0f / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+  // Screen space derivatives of the barycentrics divided by w.
+  vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) *
+             inv_det * inv_w;
+  vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) *
+             inv_det * inv_w;
+
+  vec2 delta = ndc - ndc0;
+  vec3 f = vec3(inv_w.x, 0.0f, 0.0f) + delta.x * ddx + delta.y * ddy;
+  vec3 f_ddx = f + pixel_size.x * ddx;
+  vec3 f_ddy = f + pixel_size.y * ddy;
+
+  Barycentrics b;
+  b.lambda = f / (f.x + f.y + f.z);
+  // Finite differences over one pixel.
+  b.ddx = f_ddx / (f_ddx.x + f_ddx.y + f_ddx.z) - b.lambda;
+  b.ddy = f_ddy / (f_ddy.x + f_ddy.y + f_ddy.z) - b.lambda;
+
+  return b;
+}
+
+#endif // REN_GLSL_VISIBILITY_BUFFER_GLSL
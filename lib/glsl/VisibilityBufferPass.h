@@ -0,0 +1,91 @@
+#ifndef REN_GLSL_VISIBILITY_BUFFER_PASS_H
+#define REN_GLSL_VISIBILITY_BUFFER_PASS_H
+
+#include "Common.h"
+#include "DevicePtr.h"
+#include "Indirect.h"
+#include "Lighting.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "Texture.h"
+
+GLSL_NAMESPACE_BEGIN
+
+/// Visibility buffer texels store the index of the draw plus one in x, or 0
+/// if nothing was rasterized. y stores the index of the draw command
+/// (meshlet) followed by the index of the triangle in it.
+const uint VISIBILITY_BUFFER_TRIANGLE_BITS = 7;
+static_assert((1 << VISIBILITY_BUFFER_TRIANGLE_BITS) >= NUM_MESHLET_TRIANGLES);
+
+struct VisibilityBufferPassArgs {
+  GLSL_PTR(Mesh) meshes;
+  GLSL_PTR(MeshInstance) mesh_instances;
+  GLSL_PTR(mat4x3) transform_matrices;
+  mat4 proj_view;
+  uint draw;
+};
+
+struct VisibilityBufferDraw {
+  /// Draw commands, starting from the draw's first command.
+  GLSL_PTR(DrawIndexedIndirectCommand) commands;
+  /// Index pool of the draw. Each word holds 4 8-bit meshlet triangle indices.
+  GLSL_PTR(uint) indices;
+};
+
+GLSL_DEFINE_PTR_TYPE(VisibilityBufferDraw, 8);
+
+const uint VISIBILITY_BUFFER_TILE_SIZE = 8;
+
+/// Tiles are classified by the mesh attributes that are required to shade all
+/// of their pixels.
+const uint NUM_VISIBILITY_BUFFER_TILE_CLASSES = NUM_MESH_ATTRIBUTE_FLAGS;
+
+struct VisibilityBufferClassifyPassArgs {
+  GLSL_PTR(Mesh) meshes;
+  GLSL_PTR(MeshInstance) mesh_instances;
+  GLSL_PTR(Material) materials;
+  GLSL_PTR(VisibilityBufferDraw) draws;
+  /// Shading dispatch command for each tile class.
+  GLSL_PTR(DispatchIndirectCommand) tile_commands;
+  /// Packed tile coordinates, max_num_tiles for each tile class.
+  GLSL_PTR(uint) tiles;
+  uint max_num_tiles;
+  UStorageTexture2D visibility_buffer;
+  RWStorageTexture2D hdr;
+};
+
+struct VisibilityBufferShadePassUniforms {
+  GLSL_PTR(Mesh) meshes;
+  GLSL_PTR(MeshInstance) mesh_instances;
+  GLSL_PTR(mat4x3) transform_matrices;
+  GLSL_PTR(mat3) normal_matrices;
+  GLSL_PTR(Material) materials;
+  GLSL_PTR(DirectionalLight) directional_lights;
+  GLSL_PTR(VisibilityBufferDraw) draws;
+  mat4 proj_view;
+  vec3 eye;
+  uint num_directional_lights;
+  uint num_shadow_cascades;
+  /// Index of the directional light that casts shadows.
+  uint shadowed_directional_light;
+  /// Cascades are sorted by distance from the camera.
+  GLSL_ARRAY(mat4, shadow_proj_views, MAX_NUM_SHADOW_CASCADES);
+  GLSL_ARRAY(SampledTexture2D, shadow_maps, MAX_NUM_SHADOW_CASCADES);
+  UStorageTexture2D visibility_buffer;
+  StorageTexture2D exposure;
+  RWStorageTexture2D hdr;
+};
+
+GLSL_DEFINE_PTR_TYPE(VisibilityBufferShadePassUniforms, 8);
+
+struct VisibilityBufferShadePassArgs {
+  GLSL_PTR(VisibilityBufferShadePassUniforms) ub;
+  /// Packed coordinates of the tiles of the current class.
+  GLSL_PTR(uint) tiles;
+  /// Combination of MESH_ATTRIBUTE_*_BIT flags of the current class.
+  uint tile_class;
+};
+
+GLSL_NAMESPACE_END
+
+#endif // REN_GLSL_VISIBILITY_BUFFER_PASS_H
@@ -1,6 +1,7 @@
 #include "ren/ren.hpp"
 #include "Lippincott.hpp"
 #include "Renderer.hpp"
+#include "Swapchain.hpp"
 
 namespace ren {
 
@@ -12,4 +13,12 @@ auto create_renderer(const RendererCreateInfo &desc)
   });
 }
 
+auto create_offscreen_swapchain(IRenderer &irenderer,
+                                const OffscreenSwapchainCreateInfo &create_info)
+    -> expected<std::unique_ptr<ISwapchain>> {
+  auto &renderer = static_cast<Renderer &>(irenderer);
+  return lippincott(
+      [&] { return std::make_unique<Swapchain>(renderer, create_info); });
+}
+
 } // namespace ren
@@ -0,0 +1,37 @@
+#pragma once
+#include "Support/StdDef.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new to count heap allocations, so that tests
+// can check that code stops allocating once it has warmed up. Must only be
+// included by one source file of a test.
+
+namespace ren {
+
+namespace detail {
+
+inline std::atomic<usize> g_num_allocations = 0;
+
+} // namespace detail
+
+/// Number of times that the global operator new was called.
+inline auto get_num_allocations() -> usize {
+  return detail::g_num_allocations.load(std::memory_order_relaxed);
+}
+
+} // namespace ren
+
+auto operator new(std::size_t size) -> void * {
+  ren::detail::g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
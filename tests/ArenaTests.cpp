@@ -0,0 +1,109 @@
+#include "AllocationCounter.hpp"
+#include "Support/Arena.hpp"
+#include "Support/Views.hpp"
+
+#include <array>
+#include <gtest/gtest.h>
+
+using namespace ren;
+
+namespace {
+
+struct Large {
+  std::array<u64, 32> values = {};
+};
+
+/// Records its index in a log when it's destroyed.
+struct Logged {
+  Vector<int> *log = nullptr;
+  int index = 0;
+
+  ~Logged() { log->push_back(index); }
+};
+
+} // namespace
+
+TEST(ArenaTest, AlignsAllocations) {
+  Arena arena(256);
+  for (usize alignment : {1, 2, 4, 8, 16}) {
+    (void)arena.allocate(1, 1);
+    void *ptr = arena.allocate(3, alignment);
+    EXPECT_EQ((uintptr_t)ptr % alignment, 0u) << alignment;
+  }
+}
+
+TEST(ArenaTest, FitsAllocationsLargerThanBlocks) {
+  Arena arena(64);
+  auto *ptr = (std::byte *)arena.allocate(1024, 8);
+  std::fill_n(ptr, 1024, std::byte(0xff));
+  auto *next = arena.create<u64>(1u);
+  EXPECT_EQ(*next, 1u);
+}
+
+TEST(ArenaTest, DestroysObjectsInReverseOrderOnReset) {
+  Vector<int> log;
+  log.reserve(3);
+  Arena arena;
+  for (int i : {0, 1, 2}) {
+    arena.create<Logged>(&log, i);
+  }
+  EXPECT_TRUE(log.empty());
+  arena.reset();
+  Vector<int> expected = {2, 1, 0};
+  EXPECT_EQ(log, expected);
+}
+
+TEST(ArenaTest, StopsAllocatingAfterFirstReset) {
+  Arena arena(4 * 1024);
+  Vector<int> log;
+  log.reserve(2 * 256);
+  auto fill = [&] {
+    for (int i : range(256)) {
+      arena.create<Large>();
+      arena.create<Logged>(&log, i);
+    }
+  };
+
+  fill();
+  arena.reset();
+  usize num_allocations = get_num_allocations();
+  fill();
+  arena.reset();
+  EXPECT_EQ(get_num_allocations(), num_allocations);
+  EXPECT_EQ(log.size(), 2 * 256u);
+}
+
+TEST(ArenaFunctionTest, CallsClosureWithArguments) {
+  Arena arena;
+  Large large;
+  large.values[31] = 7;
+  ArenaFunction<u64(u64, u64)> f(arena, [large](u64 a, u64 b) {
+    return a * b + large.values[31];
+  });
+  ASSERT_TRUE(f);
+  EXPECT_EQ(f(2, 3), 13u);
+  EXPECT_FALSE(ArenaFunction<void()>());
+}
+
+TEST(ArenaFunctionTest, DoesNotAllocateLargeClosuresAfterFirstReset) {
+  Arena arena;
+  u64 sum = 0;
+  auto create_functions = [&] {
+    std::array<ArenaFunction<void(u64 &)>, 64> functions;
+    for (u64 i : range<u64>(functions.size())) {
+      Large large;
+      large.values[0] = i;
+      functions[i] = {arena, [large](u64 &sum) { sum += large.values[0]; }};
+    }
+    for (const ArenaFunction<void(u64 &)> &function : functions) {
+      function(sum);
+    }
+    arena.reset();
+  };
+
+  create_functions();
+  usize num_allocations = get_num_allocations();
+  create_functions();
+  EXPECT_EQ(get_num_allocations(), num_allocations);
+  EXPECT_EQ(sum, 2u * (63 * 64 / 2));
+}
@@ -0,0 +1,262 @@
+#include "Camera.hpp"
+#include "CpuCulling.hpp"
+#include "glsl/InstanceCullingAndLODPass.h"
+#include "glsl/MeshletCullingPass.h"
+
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace ren;
+
+namespace {
+
+auto make_bb(glm::i16vec3 min, glm::i16vec3 max) -> glsl::PositionBoundingBox {
+  return {.min = {.position = min}, .max = {.position = max}};
+}
+
+auto make_transform(glm::vec3 translation, float scale) -> glm::mat4x3 {
+  glm::mat4x3 transform(scale);
+  transform[3] = translation;
+  return transform;
+}
+
+auto make_mesh(glsl::PositionBoundingBox bb, Span<const glsl::Meshlet> meshlets)
+    -> CpuCullingMesh {
+  CpuCullingMesh mesh = {.meshlets = meshlets};
+  mesh.mesh.bb = bb;
+  mesh.mesh.num_lods = 1;
+  mesh.mesh.lods[0] = {
+      .base_meshlet = 0,
+      .num_meshlets = u32(meshlets.size()),
+  };
+  return mesh;
+}
+
+auto make_meshlet(u32 index, glsl::PositionBoundingBox bb) -> glsl::Meshlet {
+  return {
+      .base_index = index * glsl::NUM_MESHLET_VERTICES,
+      .base_triangle = index * glsl::NUM_MESHLET_TRIANGLES * 3,
+      .num_triangles = glsl::NUM_MESHLET_TRIANGLES,
+      .cone_apex = {.position = {0, 0, 0}},
+      .cone_axis = {.position = {0, 0, 1}},
+      // Never cone culled.
+      .cone_cutoff = 2.0f,
+      .bb = bb,
+  };
+}
+
+void expect_same_results(const CpuCullingResult &lhs,
+                         const CpuCullingResult &rhs) {
+  EXPECT_EQ(lhs.statistics.num_instances, rhs.statistics.num_instances);
+  EXPECT_EQ(lhs.statistics.num_culled_instances,
+            rhs.statistics.num_culled_instances);
+  EXPECT_EQ(lhs.statistics.num_meshlets, rhs.statistics.num_meshlets);
+  EXPECT_EQ(lhs.statistics.num_culled_meshlets,
+            rhs.statistics.num_culled_meshlets);
+  EXPECT_EQ(lhs.statistics.num_triangles, rhs.statistics.num_triangles);
+  EXPECT_EQ(lhs.meshlet_bucket_offsets, rhs.meshlet_bucket_offsets);
+  for (u32 bucket : range(glsl::NUM_MESHLET_CULLING_BUCKETS)) {
+    EXPECT_EQ(lhs.meshlet_bucket_commands[bucket].x,
+              rhs.meshlet_bucket_commands[bucket].x);
+    ASSERT_EQ(lhs.meshlet_buckets[bucket].size(),
+              rhs.meshlet_buckets[bucket].size());
+    for (usize i : range(lhs.meshlet_buckets[bucket].size())) {
+      const glsl::MeshletCullData &l = lhs.meshlet_buckets[bucket][i];
+      const glsl::MeshletCullData &r = rhs.meshlet_buckets[bucket][i];
+      EXPECT_EQ(l.mesh, r.mesh);
+      EXPECT_EQ(l.mesh_instance, r.mesh_instance);
+      EXPECT_EQ(l.base_meshlet, r.base_meshlet);
+    }
+  }
+  ASSERT_EQ(lhs.commands.size(), rhs.commands.size());
+  for (usize i : range(lhs.commands.size())) {
+    const glsl::DrawIndexedIndirectCommand &l = lhs.commands[i];
+    const glsl::DrawIndexedIndirectCommand &r = rhs.commands[i];
+    EXPECT_EQ(l.num_indices, r.num_indices);
+    EXPECT_EQ(l.base_index, r.base_index);
+    EXPECT_EQ(l.base_vertex, r.base_vertex);
+    EXPECT_EQ(l.base_instance, r.base_instance);
+  }
+}
+
+/// Randomly placed instances of a mesh with 4 meshlets, one per quadrant of
+/// its bounding box, seen by a perspective camera.
+struct RandomScene {
+  Vector<glsl::Meshlet> meshlets;
+  Vector<CpuCullingMesh> meshes;
+  Vector<glm::mat4x3> transform_matrices;
+  Vector<u32> instance_meshes;
+  Vector<u32> instance_mesh_instances;
+  Camera camera;
+
+  explicit RandomScene(u32 num_instances) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> scale(0.0001f, 0.002f);
+    std::uniform_int_distribution<int> axis(-100, 100);
+    std::uniform_real_distribution<float> cutoff(-1.0f, 1.0f);
+
+    for (u32 i : range(4)) {
+      auto x = i16(i & 1 ? 0 : -1000);
+      auto y = i16(i & 2 ? 0 : -1000);
+      glsl::Meshlet meshlet = make_meshlet(
+          i, make_bb({x, y, -1000}, {i16(x + 1000), i16(y + 1000), 1000}));
+      meshlet.cone_axis.position = {axis(rng), axis(rng), 100};
+      meshlet.cone_cutoff = cutoff(rng);
+      meshlets.push_back(meshlet);
+    }
+    meshes.push_back(make_mesh(
+        make_bb({-1000, -1000, -1000}, {1000, 1000, 1000}), meshlets));
+
+    for (u32 i : range(num_instances)) {
+      transform_matrices.push_back(make_transform(
+          {position(rng), position(rng), position(rng)}, scale(rng)));
+      instance_meshes.push_back(0);
+      instance_mesh_instances.push_back(i);
+    }
+
+    camera = {
+        .position = {-5.0f, 1.0f, 2.0f},
+        .forward = glm::normalize(glm::vec3(1.0f, 0.2f, -0.1f)),
+        .far = 30.0f,
+    };
+  }
+
+  auto cull(u32 num_threads) const -> CpuCullingResult {
+    return cpu_cull(
+        {
+            .instance_feature_mask = glsl::INSTANCE_CULLING_AND_LOD_FRUSTUM_BIT,
+            .meshlet_feature_mask = glsl::MESHLET_CULLING_CONE_BIT |
+                                    glsl::MESHLET_CULLING_FRUSTUM_BIT,
+            .proj_view = get_projection_view_matrix(camera, {1280, 720}),
+            .eye = get_homogeneous_eye_position(camera),
+            .num_threads = num_threads,
+        },
+        meshes, transform_matrices,
+        {
+            .meshes = instance_meshes,
+            .mesh_instances = instance_mesh_instances,
+        });
+  }
+};
+
+} // namespace
+
+TEST(CpuCullingTest, FrustumCullsInstancesOutsideOfViewVolume) {
+  glsl::PositionBoundingBox bb = make_bb({-100, -100, -100}, {100, 100, 100});
+  std::array meshlets = {make_meshlet(0, bb)};
+  std::array meshes = {make_mesh(bb, meshlets)};
+
+  // With an identity projection matrix the view volume is -1 <= x <= 1,
+  // -1 <= y <= 1, 0 <= z <= 1 and the mesh's bounding box is [-0.1, 0.1]^3.
+  std::array transform_matrices = {
+      make_transform({0.0f, 0.0f, 0.5f}, 0.001f),
+      make_transform({5.0f, 0.0f, 0.5f}, 0.001f),
+      make_transform({-5.0f, 0.0f, 0.5f}, 0.001f),
+      make_transform({0.0f, 5.0f, 0.5f}, 0.001f),
+      make_transform({0.0f, -5.0f, 0.5f}, 0.001f),
+      make_transform({0.0f, 0.0f, -1.0f}, 0.001f),
+      make_transform({0.0f, 0.0f, 2.0f}, 0.001f),
+      // Crosses the right plane.
+      make_transform({1.05f, 0.0f, 0.5f}, 0.001f),
+  };
+  std::array<u32, 8> instance_meshes = {};
+  std::array<u32, 8> instance_mesh_instances = {0, 1, 2, 3, 4, 5, 6, 7};
+
+  CpuCullingResult result = cpu_cull(
+      {.instance_feature_mask = glsl::INSTANCE_CULLING_AND_LOD_FRUSTUM_BIT},
+      meshes, transform_matrices,
+      {
+          .meshes = instance_meshes,
+          .mesh_instances = instance_mesh_instances,
+      });
+
+  EXPECT_EQ(result.statistics.num_instances, 8u);
+  EXPECT_EQ(result.statistics.num_culled_instances, 6u);
+  ASSERT_EQ(result.commands.size(), 2u);
+  EXPECT_EQ(result.commands[0].base_instance, 0u);
+  EXPECT_EQ(result.commands[1].base_instance, 7u);
+}
+
+TEST(CpuCullingTest, BucketOffsetsMatchMeshPass) {
+  glsl::PositionBoundingBox bb = make_bb({-100, -100, -100}, {100, 100, 100});
+  Vector<glsl::Meshlet> meshlets;
+  for (u32 i : range(7)) {
+    meshlets.push_back(make_meshlet(i, bb));
+  }
+  std::array meshes = {make_mesh(bb, meshlets)};
+  std::array transform_matrices = {glm::mat4x3(1.0f)};
+  std::array<u32, 5> instance_meshes = {};
+  std::array<u32, 5> instance_mesh_instances = {};
+
+  CpuCullingResult result =
+      cpu_cull({}, meshes, transform_matrices,
+               {
+                   .meshes = instance_meshes,
+                   .mesh_instances = instance_mesh_instances,
+               });
+
+  // 5 instances with 7 meshlets each reserve min(5, 35 >> i) entries for
+  // bucket i.
+  std::array<u32, glsl::NUM_MESHLET_CULLING_BUCKETS> expected_offsets = {
+      0, 5, 10, 15, 19, 21, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+  };
+  EXPECT_EQ(result.meshlet_bucket_offsets, expected_offsets);
+
+  for (u32 bucket : range(glsl::NUM_MESHLET_CULLING_BUCKETS)) {
+    usize expected_size = bucket < 3 ? 5 : 0;
+    EXPECT_EQ(result.meshlet_buckets[bucket].size(), expected_size);
+    EXPECT_EQ(result.meshlet_bucket_commands[bucket].x,
+              expected_size > 0 ? 1u : 0u);
+  }
+  EXPECT_EQ(result.commands.size(), 35u);
+  EXPECT_EQ(result.statistics.num_culled_meshlets, 0u);
+}
+
+TEST(CpuCullingTest, MatchesScalarReference) {
+  // Not a multiple of the SIMD width.
+  RandomScene scene(1031);
+  CpuCullingResult result = scene.cull(1);
+
+  glm::mat4 proj_view = get_projection_view_matrix(scene.camera, {1280, 720});
+  glm::vec4 eye = get_homogeneous_eye_position(scene.camera);
+  const CpuCullingMesh &mesh = scene.meshes[0];
+
+  u32 num_culled_instances = 0;
+  u32 num_meshlets = 0;
+  u32 num_culled_meshlets = 0;
+  for (const glm::mat4x3 &transform_matrix : scene.transform_matrices) {
+    glm::mat4 pvm = proj_view * glm::mat4(transform_matrix);
+    if (glsl::cull_cs_bb(glsl::project_bb_to_cs(pvm, mesh.mesh.bb))) {
+      num_culled_instances++;
+      continue;
+    }
+    for (const glsl::Meshlet &meshlet : mesh.meshlets) {
+      num_meshlets++;
+      if (glsl::cull_meshlet(transform_matrix, proj_view, eye, meshlet, true,
+                             true)) {
+        num_culled_meshlets++;
+      }
+    }
+  }
+
+  // Make sure that the scene actually tests something.
+  ASSERT_GT(num_culled_instances, 0u);
+  ASSERT_LT(num_culled_instances, scene.transform_matrices.size());
+  ASSERT_GT(num_culled_meshlets, 0u);
+
+  EXPECT_EQ(result.statistics.num_instances, scene.transform_matrices.size());
+  EXPECT_EQ(result.statistics.num_culled_instances, num_culled_instances);
+  EXPECT_EQ(result.statistics.num_meshlets, num_meshlets);
+  EXPECT_EQ(result.statistics.num_culled_meshlets, num_culled_meshlets);
+  EXPECT_EQ(result.commands.size(), num_meshlets - num_culled_meshlets);
+}
+
+TEST(CpuCullingTest, ResultsDontDependOnNumberOfThreads) {
+  RandomScene scene(4099);
+  CpuCullingResult expected = scene.cull(1);
+  for (u32 num_threads : {3, 8}) {
+    SCOPED_TRACE(num_threads);
+    expect_same_results(scene.cull(num_threads), expected);
+  }
+}
@@ -0,0 +1,528 @@
+#include "RenderGraph.hpp"
+#include "RgTestDevice.hpp"
+#include "Support/HashMap.hpp"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <random>
+
+using namespace ren;
+
+namespace {
+
+constexpr VkAccessFlags2 WRITE_ACCESS_MASK =
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+/// Barrier that applies to all resources.
+constexpr u64 GLOBAL_RESOURCE = -1;
+
+auto get_buffer_resource(Handle<Buffer> buffer) -> u64 { return u32(buffer); }
+
+auto get_texture_resource(VkImage image) -> u64 {
+  return (u64)(uintptr_t)image | (u64(1) << 63);
+}
+
+auto expand_stage_mask(VkPipelineStageFlags2 stage_mask)
+    -> VkPipelineStageFlags2 {
+  if (stage_mask & VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT) {
+    return -1;
+  }
+  return stage_mask;
+}
+
+auto expand_access_mask(VkAccessFlags2 access_mask) -> VkAccessFlags2 {
+  if (access_mask &
+      (VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT)) {
+    return -1;
+  }
+  return access_mask;
+}
+
+struct SyncBarrier {
+  VkPipelineStageFlags2 src_stage_mask = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 src_access_mask = VK_ACCESS_2_NONE;
+  VkPipelineStageFlags2 dst_stage_mask = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 dst_access_mask = VK_ACCESS_2_NONE;
+  /// Resource whose memory the barrier applies to.
+  u64 resource = GLOBAL_RESOURCE;
+  /// Whether the barrier is an image barrier that changes the layout of its
+  /// resource.
+  bool is_layout_transition = false;
+};
+
+auto get_sync_barrier(const VkMemoryBarrier2 &barrier) -> SyncBarrier {
+  return {
+      .src_stage_mask = barrier.srcStageMask,
+      .src_access_mask = barrier.srcAccessMask,
+      .dst_stage_mask = barrier.dstStageMask,
+      .dst_access_mask = barrier.dstAccessMask,
+  };
+}
+
+auto get_sync_barrier(const VkImageMemoryBarrier2 &barrier) -> SyncBarrier {
+  return {
+      .src_stage_mask = barrier.srcStageMask,
+      .src_access_mask = barrier.srcAccessMask,
+      .dst_stage_mask = barrier.dstStageMask,
+      .dst_access_mask = barrier.dstAccessMask,
+      .resource = get_texture_resource(barrier.image),
+      .is_layout_transition = barrier.oldLayout != barrier.newLayout,
+  };
+}
+
+/// Reference model of Vulkan's synchronization rules for a single queue. It
+/// tracks, for every access, which later stages are ordered after it through
+/// execution dependency chains and, for writes, whether they have been made
+/// available and to which stages and accesses they have been made visible.
+/// Unlike the render graph, it doesn't try to place barriers: it only checks
+/// that each access is synchronized with the last write to its resource and,
+/// if it writes, with all reads since then.
+class SyncValidator {
+public:
+  /// Effect of a barrier on a single access, which is captured when its first
+  /// synchronization scope is defined and applied when its second one is.
+  struct Effect {
+    u32 access = 0;
+    VkPipelineStageFlags2 dst_stage_mask = VK_PIPELINE_STAGE_2_NONE;
+    bool make_available = false;
+    Optional<MemoryState> make_visible;
+  };
+
+  /// Captures the effects of barriers whose first synchronization scope
+  /// consists of all accesses by passes before end_pass.
+  auto capture(u32 end_pass, Span<const SyncBarrier> barriers) const
+      -> Vector<Effect> {
+    Vector<Effect> effects;
+    for (u32 i : range<u32>(m_accesses.size())) {
+      const Access &access = m_accesses[i];
+      if (access.pass >= end_pass) {
+        continue;
+      }
+      for (const SyncBarrier &barrier : barriers) {
+        VkPipelineStageFlags2 src_stage_mask =
+            expand_stage_mask(barrier.src_stage_mask);
+        bool is_in_scope = access.state.stage_mask & src_stage_mask;
+        bool is_chained = access.ordered_stage_mask & src_stage_mask;
+        if (not is_in_scope and not is_chained) {
+          continue;
+        }
+        Effect effect = {
+            .access = i,
+            .dst_stage_mask = expand_stage_mask(barrier.dst_stage_mask),
+        };
+        if (barrier.resource == GLOBAL_RESOURCE or
+            barrier.resource == access.resource) {
+          effect.make_available =
+              access.is_write and is_in_scope and
+              (access.state.access_mask &
+               expand_access_mask(barrier.src_access_mask));
+          effect.make_visible = MemoryState{
+              .stage_mask = effect.dst_stage_mask,
+              .access_mask = expand_access_mask(barrier.dst_access_mask),
+          };
+        }
+        effects.push_back(effect);
+      }
+    }
+    return effects;
+  }
+
+  /// Performs a barrier's second synchronization scope. All availability
+  /// operations happen before all visibility operations.
+  void apply(Span<const Effect> effects) {
+    for (const Effect &effect : effects) {
+      Access &access = m_accesses[effect.access];
+      access.ordered_stage_mask |= effect.dst_stage_mask;
+      access.is_available |= effect.make_available;
+    }
+    for (const Effect &effect : effects) {
+      Access &access = m_accesses[effect.access];
+      if (access.is_available and effect.make_visible) {
+        access.visible.push_back(*effect.make_visible);
+      }
+    }
+  }
+
+  /// Records a pipeline barrier before a pass. Layout transitions are checked
+  /// against previous accesses to their image and then act as its last write.
+  void pipeline_barrier(u32 pass, Span<const SyncBarrier> barriers) {
+    for (const SyncBarrier &barrier : barriers) {
+      if (barrier.is_layout_transition) {
+        check_layout_transition(pass, barrier);
+      }
+    }
+    apply(capture(pass, barriers));
+    for (const SyncBarrier &barrier : barriers) {
+      if (not barrier.is_layout_transition) {
+        continue;
+      }
+      VkPipelineStageFlags2 dst_stage_mask =
+          expand_stage_mask(barrier.dst_stage_mask);
+      Resource &resource = m_resources[barrier.resource];
+      resource.last_write = m_accesses.size();
+      resource.reads.clear();
+      m_accesses.push_back({
+          .pass = pass,
+          .resource = barrier.resource,
+          .state = {.stage_mask = dst_stage_mask},
+          .is_write = true,
+          .ordered_stage_mask = dst_stage_mask,
+          .is_available = true,
+          .visible = {{
+              .stage_mask = dst_stage_mask,
+              .access_mask = expand_access_mask(barrier.dst_access_mask),
+          }},
+      });
+    }
+  }
+
+  /// Records an access by a pass and checks that it doesn't race with
+  /// previous accesses to the same resource.
+  void access(u32 pass, u64 resource_id, const MemoryState &state) {
+    bool is_write = state.access_mask & WRITE_ACCESS_MASK;
+    VkAccessFlags2 read_access_mask = state.access_mask & ~WRITE_ACCESS_MASK;
+    Resource &resource = m_resources[resource_id];
+
+    auto is_visible = [&](const MemoryState &visible) {
+      return not(state.stage_mask & ~visible.stage_mask) and
+             not(read_access_mask & ~visible.access_mask);
+    };
+
+    if (resource.last_write != -1) {
+      const Access &write = m_accesses[resource.last_write];
+      if (state.stage_mask & ~write.ordered_stage_mask) {
+        error(pass, resource_id, "is not ordered after the last write");
+      } else if (is_write and not write.is_available) {
+        error(pass, resource_id, "overwrites an unavailable write");
+      } else if (read_access_mask and
+                 std::ranges::none_of(write.visible, is_visible)) {
+        error(pass, resource_id, "reads a write that is not visible");
+      }
+    }
+
+    if (is_write) {
+      for (u32 read : resource.reads) {
+        if (state.stage_mask & ~m_accesses[read].ordered_stage_mask) {
+          error(pass, resource_id, "is not ordered after a previous read");
+          break;
+        }
+      }
+      resource.last_write = m_accesses.size();
+      resource.reads.clear();
+    } else {
+      resource.reads.push_back(m_accesses.size());
+    }
+
+    m_accesses.push_back({
+        .pass = pass,
+        .resource = resource_id,
+        .state = state,
+        .is_write = is_write,
+    });
+  }
+
+  auto get_errors() const -> Span<const String> { return m_errors; }
+
+private:
+  struct Access {
+    u32 pass = 0;
+    u64 resource = 0;
+    MemoryState state;
+    bool is_write = false;
+    /// Stages of later commands that are ordered after this access.
+    VkPipelineStageFlags2 ordered_stage_mask = VK_PIPELINE_STAGE_2_NONE;
+    bool is_available = false;
+    /// Stages and accesses that this access's writes are visible to.
+    Vector<MemoryState> visible;
+  };
+
+  struct Resource {
+    u32 last_write = -1;
+    /// Reads since the last write.
+    Vector<u32> reads;
+  };
+
+  void check_layout_transition(u32 pass, const SyncBarrier &barrier) {
+    VkPipelineStageFlags2 src_stage_mask =
+        expand_stage_mask(barrier.src_stage_mask);
+    auto is_ordered = [&](const Access &access) {
+      return (access.state.stage_mask & src_stage_mask) or
+             (access.ordered_stage_mask & src_stage_mask);
+    };
+    const Resource &resource = m_resources[barrier.resource];
+    for (u32 read : resource.reads) {
+      if (not is_ordered(m_accesses[read])) {
+        error(pass, barrier.resource,
+              "transitions layout before a previous read");
+        return;
+      }
+    }
+    if (resource.last_write == -1) {
+      return;
+    }
+    const Access &write = m_accesses[resource.last_write];
+    if (not is_ordered(write)) {
+      error(pass, barrier.resource,
+            "transitions layout before the last write");
+    } else if (not write.is_available and
+               not((write.state.stage_mask & src_stage_mask) and
+                   (write.state.access_mask &
+                    expand_access_mask(barrier.src_access_mask)))) {
+      error(pass, barrier.resource,
+            "transitions layout without making the last write available");
+    }
+  }
+
+  void error(u32 pass, u64 resource, StringView message) {
+    m_errors.push_back(
+        fmt::format("Pass {}: access to {:#x} {}", pass, resource, message));
+  }
+
+private:
+  Vector<Access> m_accesses;
+  HashMap<u64, Resource> m_resources;
+  Vector<String> m_errors;
+};
+
+/// Replays a compiled graph's barriers, events and accesses in recording
+/// order: waits for events, pipeline barrier, pass and finally event signals.
+void validate_graph(const RgTestDevice &device, const RgPersistent &rgp,
+                    SyncValidator &validator) {
+  const RgBuildData &data = rgp.get_build_data();
+  const RgRtData &rt = rgp.get_runtime_data();
+  Vector<Vector<SyncValidator::Effect>> event_effects(
+      rt.m_event_barriers.size());
+  for (u32 i : range<u32>(rt.m_passes.size())) {
+    const RgRtPass &rt_pass = rt.m_passes[i];
+    EXPECT_EQ(rt_pass.num_queue_waits, 0);
+
+    for (u32 event : range(rt_pass.base_wait_event,
+                           rt_pass.base_wait_event + rt_pass.num_wait_events)) {
+      validator.apply(event_effects[event]);
+    }
+
+    Vector<SyncBarrier> barriers;
+    for (const VkMemoryBarrier2 &barrier :
+         Span(rt.m_memory_barriers)
+             .subspan(rt_pass.base_memory_barrier,
+                      rt_pass.num_memory_barriers)) {
+      barriers.push_back(get_sync_barrier(barrier));
+    }
+    for (const VkImageMemoryBarrier2 &barrier :
+         Span(rt.m_texture_barriers)
+             .subspan(rt_pass.base_texture_barrier,
+                      rt_pass.num_texture_barriers)) {
+      barriers.push_back(get_sync_barrier(barrier));
+    }
+    validator.pipeline_barrier(i, barriers);
+
+    const RgPass &pass = data.m_passes[rt_pass.pass];
+    auto access_buffer = [&](RgBufferUseId use) {
+      validator.access(i, get_buffer_resource(rt.m_buffers[use].buffer),
+                       data.m_buffer_uses[use].usage);
+    };
+    auto access_texture = [&](RgTextureUseId use) {
+      const TextureState &state = data.m_texture_uses[use].state;
+      validator.access(
+          i, get_texture_resource(device.get_texture(rt.m_textures[use]).image),
+          {.stage_mask = state.stage_mask, .access_mask = state.access_mask});
+    };
+    std::ranges::for_each(pass.read_buffers, access_buffer);
+    std::ranges::for_each(pass.write_buffers, access_buffer);
+    std::ranges::for_each(pass.read_textures, access_texture);
+    std::ranges::for_each(pass.write_textures, access_texture);
+
+    for (u32 event : Span(rt.m_set_events)
+                         .subspan(rt_pass.base_set_event,
+                                  rt_pass.num_set_events)) {
+      SyncBarrier barrier = get_sync_barrier(rt.m_event_barriers[event]);
+      event_effects[event] = validator.capture(i + 1, {&barrier, 1});
+    }
+  }
+}
+
+constexpr std::array BUFFER_READ_STATES = {
+    CS_READ_BUFFER, TRANSFER_SRC_BUFFER, INDIRECT_COMMAND_SRC_BUFFER,
+    VS_READ_BUFFER, FS_READ_BUFFER,      INDEX_SRC_BUFFER,
+};
+
+constexpr std::array BUFFER_WRITE_STATES = {
+    CS_WRITE_BUFFER,
+    CS_READ_WRITE_BUFFER,
+    TRANSFER_DST_BUFFER,
+};
+
+constexpr std::array TEXTURE_READ_STATES = {
+    CS_SAMPLE_TEXTURE, FS_SAMPLE_TEXTURE,    CS_READ_TEXTURE,
+    FS_READ_TEXTURE,   TRANSFER_SRC_TEXTURE,
+};
+
+constexpr std::array TEXTURE_WRITE_STATES = {
+    CS_WRITE_TEXTURE,
+    CS_READ_WRITE_TEXTURE,
+    TRANSFER_DST_TEXTURE,
+};
+
+constexpr usize NUM_RANDOM_GRAPHS = 200;
+constexpr u32 NUM_RANDOM_PASSES = 24;
+constexpr usize NUM_RANDOM_BUFFERS = 3;
+constexpr usize NUM_RANDOM_TEXTURES = 3;
+
+/// Builds a graph in which each pass reads or writes one or two random
+/// buffers or textures in random states. Each pass also writes a buffer of its
+/// own that is an output of the graph, so that no pass is culled.
+void build_random_graph(RgTestDevice &device, RgPersistent &rgp, u32 seed) {
+  std::mt19937 rng(seed);
+  auto random = [&](usize n) {
+    return std::uniform_int_distribution<usize>(0, n - 1)(rng);
+  };
+
+  std::array<RgTextureId, NUM_RANDOM_TEXTURES> textures;
+  for (usize i : range(NUM_RANDOM_TEXTURES)) {
+    textures[i] = rgp.create_texture({
+        .name = fmt::format("texture{}", i),
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .width = 64,
+        .height = 64,
+    });
+  }
+
+  device.begin_frame();
+  RgBuilder rgb(rgp);
+
+  std::array<RgUntypedBufferId, NUM_RANDOM_BUFFERS> buffers;
+  for (usize i : range(NUM_RANDOM_BUFFERS)) {
+    buffers[i] =
+        rgb.create_buffer({.name = fmt::format("buffer{}", i), .size = 256});
+  }
+
+  std::array<usize, NUM_RANDOM_BUFFERS + NUM_RANDOM_TEXTURES> resources;
+  std::ranges::iota(resources, 0);
+  for (u32 p : range(NUM_RANDOM_PASSES)) {
+    RgPassBuilder pass = rgb.create_pass({.name = fmt::format("pass{}", p)});
+
+    RgUntypedBufferId output =
+        rgb.create_buffer({.name = fmt::format("output{}", p), .size = 4});
+    std::tie(output, std::ignore) =
+        pass.write_buffer("output#1", output, CS_WRITE_BUFFER);
+    rgb.set_output_buffer(output);
+
+    std::ranges::shuffle(resources, rng);
+    for (usize r : Span(resources).subspan(0, 1 + random(2))) {
+      bool is_write = random(2);
+      if (r < NUM_RANDOM_BUFFERS) {
+        RgUntypedBufferId &buffer = buffers[r];
+        if (is_write) {
+          std::tie(buffer, std::ignore) = pass.write_buffer(
+              "buffer", buffer,
+              BUFFER_WRITE_STATES[random(BUFFER_WRITE_STATES.size())]);
+        } else {
+          (void)pass.read_buffer(
+              buffer, BUFFER_READ_STATES[random(BUFFER_READ_STATES.size())]);
+        }
+      } else {
+        RgTextureId &texture = textures[r - NUM_RANDOM_BUFFERS];
+        if (is_write) {
+          std::tie(texture, std::ignore) = pass.write_texture(
+              "texture", texture,
+              TEXTURE_WRITE_STATES[random(TEXTURE_WRITE_STATES.size())]);
+        } else {
+          (void)pass.read_texture(
+              texture,
+              TEXTURE_READ_STATES[random(TEXTURE_READ_STATES.size())]);
+        }
+      }
+    }
+
+    pass.set_callback([](Renderer &, const RgRuntime &, CommandRecorder &) {});
+  }
+
+  for (RgUntypedBufferId buffer : buffers) {
+    rgb.set_output_buffer(buffer);
+  }
+  for (RgTextureId texture : textures) {
+    rgb.set_output_texture(texture);
+  }
+
+  rgb.build();
+}
+
+void expect_no_errors(const SyncValidator &validator) {
+  for (const String &error : validator.get_errors()) {
+    ADD_FAILURE() << error;
+  }
+}
+
+} // namespace
+
+TEST(SyncValidatorTest, ReportsReadWithoutBarrier) {
+  SyncValidator validator;
+  validator.access(0, 0, CS_WRITE_BUFFER);
+  validator.pipeline_barrier(1, {});
+  validator.access(1, 0, CS_READ_BUFFER);
+  EXPECT_EQ(validator.get_errors().size(), 1);
+}
+
+TEST(SyncValidatorTest, ReportsReadOfWriteMadeVisibleToOtherAccess) {
+  SyncValidator validator;
+  validator.access(0, 0, CS_WRITE_BUFFER);
+  SyncBarrier barrier = {
+      .src_stage_mask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .src_access_mask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+      .dst_stage_mask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                        VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+      .dst_access_mask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+  };
+  validator.pipeline_barrier(1, {&barrier, 1});
+  validator.access(1, 0, CS_READ_BUFFER);
+  validator.access(1, 0, TRANSFER_SRC_BUFFER);
+  EXPECT_EQ(validator.get_errors().size(), 1);
+}
+
+TEST(SyncValidatorTest, AcceptsExecutionOnlyWriteAfterRead) {
+  SyncValidator validator;
+  validator.access(0, 0, CS_WRITE_BUFFER);
+  SyncBarrier raw_barrier = {
+      .src_stage_mask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      .src_access_mask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+      .dst_stage_mask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+      .dst_access_mask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+  };
+  validator.pipeline_barrier(1, {&raw_barrier, 1});
+  validator.access(1, 0, FS_READ_BUFFER);
+  SyncBarrier war_barrier = {
+      .src_stage_mask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+      .dst_stage_mask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+  };
+  validator.pipeline_barrier(2, {&war_barrier, 1});
+  validator.access(2, 0, TRANSFER_DST_BUFFER);
+  EXPECT_EQ(validator.get_errors().size(), 0);
+}
+
+TEST(SyncValidatorTest, ReportsWriteAfterUnorderedRead) {
+  SyncValidator validator;
+  validator.access(0, 0, CS_READ_BUFFER);
+  SyncBarrier barrier = {
+      .src_stage_mask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+      .dst_stage_mask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+  };
+  validator.pipeline_barrier(1, {&barrier, 1});
+  validator.access(1, 0, CS_WRITE_BUFFER);
+  EXPECT_EQ(validator.get_errors().size(), 1);
+}
+
+TEST(RenderGraphSyncTest, RandomGraphsHaveNoHazards) {
+  for (u32 seed : range<u32>(NUM_RANDOM_GRAPHS)) {
+    SCOPED_TRACE(fmt::format("seed {}", seed));
+    RgTestDevice device;
+    RgPersistent rgp(device);
+    build_random_graph(device, rgp, seed);
+    SyncValidator validator;
+    validate_graph(device, rgp, validator);
+    expect_no_errors(validator);
+  }
+}
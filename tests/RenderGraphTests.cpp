@@ -0,0 +1,815 @@
+#include "AllocationCounter.hpp"
+#include "RenderGraph.hpp"
+#include "RgTestDevice.hpp"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace ren;
+
+namespace {
+
+void set_noop_callback(RgPassBuilder &pass) {
+  pass.set_callback([](Renderer &, const RgRuntime &, CommandRecorder &) {});
+}
+
+auto get_schedule(const RgPersistent &rgp) -> Vector<RgPassId> {
+  Vector<RgPassId> schedule;
+  for (const RgRtPass &pass : rgp.get_runtime_data().m_passes) {
+    schedule.push_back(pass.pass);
+  }
+  return schedule;
+}
+
+auto get_memory_barriers(const RgPersistent &rgp, usize pass)
+    -> Span<const VkMemoryBarrier2> {
+  const RgRtData &rt = rgp.get_runtime_data();
+  const RgRtPass &rt_pass = rt.m_passes[pass];
+  return Span(rt.m_memory_barriers)
+      .subspan(rt_pass.base_memory_barrier, rt_pass.num_memory_barriers);
+}
+
+auto get_texture_barriers(const RgPersistent &rgp, usize pass)
+    -> Span<const VkImageMemoryBarrier2> {
+  const RgRtData &rt = rgp.get_runtime_data();
+  const RgRtPass &rt_pass = rt.m_passes[pass];
+  return Span(rt.m_texture_barriers)
+      .subspan(rt_pass.base_texture_barrier, rt_pass.num_texture_barriers);
+}
+
+auto create_texture(RgPersistent &rgp, RgDebugName name, bool persistent)
+    -> RgTextureId {
+  return rgp.create_texture({
+      .name = std::move(name),
+      .format = VK_FORMAT_R8G8B8A8_UNORM,
+      .width = 64,
+      .height = 64,
+      .persistent = persistent,
+  });
+}
+
+} // namespace
+
+TEST(RenderGraphSchedulingTest, CullsPassesWhoseResultsAreUnused) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgBuilder rgb(rgp);
+
+  RgUntypedBufferId a = rgb.create_buffer({.name = "a", .size = 256});
+  RgUntypedBufferId b = rgb.create_buffer({.name = "b", .size = 256});
+  RgUntypedBufferId c = rgb.create_buffer({.name = "c", .size = 256});
+
+  RgPassBuilder producer = rgb.create_pass({.name = "producer"});
+  std::tie(a, std::ignore) = producer.write_buffer("a#1", a, CS_WRITE_BUFFER);
+  set_noop_callback(producer);
+
+  RgPassBuilder consumer = rgb.create_pass({.name = "consumer"});
+  (void)consumer.read_buffer(a, CS_READ_BUFFER);
+  std::tie(b, std::ignore) = consumer.write_buffer("b#1", b, CS_WRITE_BUFFER);
+  set_noop_callback(consumer);
+
+  RgPassBuilder unused = rgb.create_pass({.name = "unused"});
+  (void)unused.read_buffer(a, CS_READ_BUFFER);
+  std::tie(c, std::ignore) = unused.write_buffer("c#1", c, CS_WRITE_BUFFER);
+  set_noop_callback(unused);
+
+  rgb.set_output_buffer(b);
+  rgb.build();
+
+  Vector<RgPassId> expected = {producer.get_id(), consumer.get_id()};
+  EXPECT_EQ(get_schedule(rgp), expected);
+}
+
+TEST(RenderGraphSchedulingTest, KeepsPassesWithExternalEffects) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgTextureId persistent = create_texture(rgp, "persistent", true);
+  RgBuilder rgb(rgp);
+
+  RgPassBuilder host = rgb.create_pass({.name = "host"});
+  host.set_host_callback([](Renderer &, const RgRuntime &) {});
+
+  RgPassBuilder writer = rgb.create_pass({.name = "writer"});
+  std::ignore =
+      writer.write_texture("persistent#1", persistent, CS_WRITE_TEXTURE);
+  set_noop_callback(writer);
+
+  rgb.build();
+
+  Vector<RgPassId> expected = {host.get_id(), writer.get_id()};
+  EXPECT_EQ(get_schedule(rgp), expected);
+}
+
+TEST(RenderGraphSchedulingTest, PreservesSubmissionOrder) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgBuilder rgb(rgp);
+
+  Vector<RgPassId> expected;
+  for (u32 i : range(8)) {
+    RgUntypedBufferId buffer =
+        rgb.create_buffer({.name = fmt::format("buffer{}", i), .size = 64});
+    RgPassBuilder pass = rgb.create_pass({.name = fmt::format("pass{}", i)});
+    std::tie(buffer, std::ignore) =
+        pass.write_buffer("buffer#1", buffer, CS_WRITE_BUFFER);
+    set_noop_callback(pass);
+    rgb.set_output_buffer(buffer);
+    expected.push_back(pass.get_id());
+  }
+  rgb.build();
+
+  EXPECT_EQ(get_schedule(rgp), expected);
+}
+
+TEST(RenderGraphTemporalTest, TextureLayersRotateBetweenFrames) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgTextureId history = rgp.create_texture({
+      .name = "history",
+      .format = VK_FORMAT_R16G16B16A16_SFLOAT,
+      .width = 64,
+      .height = 64,
+      .ext =
+          RgTextureTemporalInfo{
+              .num_temporal_layers = 2,
+              .usage = TRANSFER_DST_TEXTURE,
+              .cb = [](Handle<Texture>, Renderer &, CommandRecorder &) {},
+          },
+  });
+
+  Handle<Texture> prev_current;
+  for (u32 frame : range(4)) {
+    SCOPED_TRACE(frame);
+    device.begin_frame();
+    RgBuilder rgb(rgp);
+    RgPassBuilder pass = rgb.create_pass({.name = "accumulate"});
+    RgTextureToken prev = pass.read_texture(history, CS_READ_TEXTURE, 1);
+    auto [output, current] =
+        pass.write_texture("history#1", history, CS_WRITE_TEXTURE);
+    set_noop_callback(pass);
+    rgb.set_output_texture(output);
+    rgb.build();
+
+    const RgRtData &rt = rgp.get_runtime_data();
+    Handle<Texture> prev_handle = rt.m_textures[prev];
+    Handle<Texture> current_handle = rt.m_textures[current];
+    ASSERT_TRUE(prev_handle);
+    ASSERT_TRUE(current_handle);
+    EXPECT_NE(prev_handle, current_handle);
+    // Temporal layer 1 holds what temporal layer 0 held in the previous
+    // frame.
+    if (frame > 0) {
+      EXPECT_EQ(prev_handle, prev_current);
+    }
+    prev_current = current_handle;
+  }
+
+  // The layers swapped images instead of being reallocated.
+  EXPECT_EQ(device.get_statistics().num_created_textures, 2u);
+}
+
+TEST(RenderGraphTemporalTest, BufferLayersRotateBetweenFrames) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgUntypedPersistentBufferId counters = rgp.create_buffer({
+      .name = "counters",
+      .size = 64,
+      .num_temporal_layers = 3,
+  });
+
+  Vector<Handle<Buffer>> prev_layers;
+  for (u32 frame : range(5)) {
+    SCOPED_TRACE(frame);
+    device.begin_frame();
+    RgBuilder rgb(rgp);
+    RgPassBuilder pass = rgb.create_pass({.name = "count"});
+    Vector<RgUntypedBufferToken> tokens;
+    tokens.push_back(std::get<1>(pass.write_buffer(
+        "counters#1", rgb.import_buffer(counters), CS_WRITE_BUFFER)));
+    for (u32 layer : range(1, 3)) {
+      tokens.push_back(pass.read_buffer(rgb.import_buffer(counters, layer),
+                                        CS_READ_BUFFER));
+    }
+    set_noop_callback(pass);
+    rgb.build();
+
+    const RgRtData &rt = rgp.get_runtime_data();
+    Vector<Handle<Buffer>> layers;
+    for (RgUntypedBufferToken token : tokens) {
+      layers.push_back(rt.m_buffers[token].buffer);
+    }
+    // Temporal layer i holds what temporal layer i - 1 held in the previous
+    // frame, and the oldest layer is reused for the current one.
+    if (frame > 0) {
+      EXPECT_EQ(layers[0], prev_layers[2]);
+      EXPECT_EQ(layers[1], prev_layers[0]);
+      EXPECT_EQ(layers[2], prev_layers[1]);
+    }
+    prev_layers = std::move(layers);
+  }
+}
+
+TEST(RenderGraphTemporalTest, PersistentTextureIsStableBetweenFrames) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgTextureId texture = create_texture(rgp, "persistent", true);
+
+  Handle<Texture> handle;
+  for (u32 frame : range(3)) {
+    SCOPED_TRACE(frame);
+    device.begin_frame();
+    RgBuilder rgb(rgp);
+    RgPassBuilder pass = rgb.create_pass({.name = "update"});
+    RgTextureToken token = std::get<1>(
+        pass.write_texture("persistent#1", texture, CS_READ_WRITE_TEXTURE));
+    set_noop_callback(pass);
+    rgb.build();
+
+    Handle<Texture> current = rgp.get_runtime_data().m_textures[token];
+    ASSERT_TRUE(current);
+    if (frame > 0) {
+      EXPECT_EQ(current, handle);
+    }
+    handle = current;
+  }
+  EXPECT_EQ(device.get_statistics().num_created_textures, 1u);
+}
+
+TEST(RenderGraphBarrierTest, ReadAfterWriteGetsSingleMemoryBarrier) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgBuilder rgb(rgp);
+
+  RgUntypedBufferId data = rgb.create_buffer({.name = "data", .size = 256});
+  RgUntypedBufferId out0 = rgb.create_buffer({.name = "out0", .size = 256});
+  RgUntypedBufferId out1 = rgb.create_buffer({.name = "out1", .size = 256});
+
+  RgPassBuilder writer = rgb.create_pass({.name = "writer"});
+  std::tie(data, std::ignore) =
+      writer.write_buffer("data#1", data, CS_WRITE_BUFFER);
+  set_noop_callback(writer);
+
+  RgPassBuilder reader0 = rgb.create_pass({.name = "reader0"});
+  (void)reader0.read_buffer(data, CS_READ_BUFFER);
+  std::tie(out0, std::ignore) =
+      reader0.write_buffer("out0#1", out0, CS_WRITE_BUFFER);
+  set_noop_callback(reader0);
+
+  RgPassBuilder reader1 = rgb.create_pass({.name = "reader1"});
+  (void)reader1.read_buffer(data, CS_READ_BUFFER);
+  std::tie(out1, std::ignore) =
+      reader1.write_buffer("out1#1", out1, CS_WRITE_BUFFER);
+  set_noop_callback(reader1);
+
+  rgb.set_output_buffer(out0);
+  rgb.set_output_buffer(out1);
+  rgb.build();
+
+  ASSERT_EQ(get_schedule(rgp).size(), 3u);
+  // The first write to a transient buffer doesn't need a barrier.
+  EXPECT_TRUE(get_memory_barriers(rgp, 0).empty());
+
+  Span<const VkMemoryBarrier2> barriers = get_memory_barriers(rgp, 1);
+  ASSERT_EQ(barriers.size(), 1u);
+  EXPECT_EQ(barriers[0].srcStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(barriers[0].srcAccessMask, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+  EXPECT_EQ(barriers[0].dstStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(barriers[0].dstAccessMask, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+  // The write has already been made visible to compute shader reads.
+  EXPECT_TRUE(get_memory_barriers(rgp, 2).empty());
+  EXPECT_TRUE(rgp.get_runtime_data().m_event_barriers.empty());
+}
+
+TEST(RenderGraphBarrierTest, LayoutChangesGetImageBarriers) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgTextureId texture = create_texture(rgp, "texture", false);
+  RgBuilder rgb(rgp);
+
+  RgPassBuilder writer = rgb.create_pass({.name = "writer"});
+  std::tie(texture, std::ignore) =
+      writer.write_texture("texture#1", texture, CS_WRITE_TEXTURE);
+  set_noop_callback(writer);
+
+  RgUntypedBufferId out = rgb.create_buffer({.name = "out", .size = 256});
+  RgPassBuilder reader = rgb.create_pass({.name = "reader"});
+  (void)reader.read_texture(texture, CS_SAMPLE_TEXTURE);
+  std::tie(out, std::ignore) =
+      reader.write_buffer("out#1", out, CS_WRITE_BUFFER);
+  set_noop_callback(reader);
+
+  rgb.set_output_buffer(out);
+  rgb.build();
+
+  ASSERT_EQ(get_schedule(rgp).size(), 2u);
+
+  // The contents of a transient texture are discarded on its first use.
+  Span<const VkImageMemoryBarrier2> barriers = get_texture_barriers(rgp, 0);
+  ASSERT_EQ(barriers.size(), 1u);
+  EXPECT_EQ(barriers[0].oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+  EXPECT_EQ(barriers[0].newLayout, VK_IMAGE_LAYOUT_GENERAL);
+
+  barriers = get_texture_barriers(rgp, 1);
+  ASSERT_EQ(barriers.size(), 1u);
+  EXPECT_EQ(barriers[0].srcStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(barriers[0].srcAccessMask, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+  EXPECT_EQ(barriers[0].dstStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(barriers[0].dstAccessMask, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+  EXPECT_EQ(barriers[0].oldLayout, VK_IMAGE_LAYOUT_GENERAL);
+  EXPECT_EQ(barriers[0].newLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  EXPECT_TRUE(get_memory_barriers(rgp, 1).empty());
+}
+
+TEST(RenderGraphBarrierTest, RecompilesWhenUsageChanges) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+
+  auto build = [&](const BufferState &read_state) {
+    device.begin_frame();
+    RgBuilder rgb(rgp);
+    RgUntypedBufferId data = rgb.create_buffer({.name = "data", .size = 256});
+    RgUntypedBufferId out = rgb.create_buffer({.name = "out", .size = 256});
+
+    RgPassBuilder writer = rgb.create_pass({.name = "writer"});
+    std::tie(data, std::ignore) =
+        writer.write_buffer("data#1", data, CS_WRITE_BUFFER);
+    set_noop_callback(writer);
+
+    RgPassBuilder reader = rgb.create_pass({.name = "reader"});
+    (void)reader.read_buffer(data, read_state);
+    std::tie(out, std::ignore) =
+        reader.write_buffer("out#1", out, CS_WRITE_BUFFER);
+    set_noop_callback(reader);
+
+    rgb.set_output_buffer(out);
+    rgb.build();
+  };
+
+  // The graphs only differ in the stages and accesses of a use, so they have
+  // the same number of passes, uses and resources.
+  for (const BufferState &read_state :
+       {CS_READ_BUFFER, CS_READ_BUFFER, INDIRECT_COMMAND_SRC_BUFFER}) {
+    build(read_state);
+    Span<const VkMemoryBarrier2> barriers = get_memory_barriers(rgp, 1);
+    ASSERT_EQ(barriers.size(), 1u);
+    EXPECT_EQ(barriers[0].dstStageMask, read_state.stage_mask);
+    EXPECT_EQ(barriers[0].dstAccessMask, read_state.access_mask);
+  }
+}
+
+TEST(RenderGraphBarrierTest, MergesMemoryBarriersWithSameDestination) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgBuilder rgb(rgp);
+
+  RgUntypedBufferId a = rgb.create_buffer({.name = "a", .size = 256});
+  RgUntypedBufferId b = rgb.create_buffer({.name = "b", .size = 256});
+  RgUntypedBufferId out = rgb.create_buffer({.name = "out", .size = 256});
+
+  RgPassBuilder writer = rgb.create_pass({.name = "writer"});
+  std::tie(a, std::ignore) = writer.write_buffer("a#1", a, CS_WRITE_BUFFER);
+  std::tie(b, std::ignore) =
+      writer.write_buffer("b#1", b, TRANSFER_DST_BUFFER);
+  set_noop_callback(writer);
+
+  RgPassBuilder reader = rgb.create_pass({.name = "reader"});
+  (void)reader.read_buffer(a, CS_READ_BUFFER);
+  (void)reader.read_buffer(b, CS_READ_BUFFER);
+  std::tie(out, std::ignore) =
+      reader.write_buffer("out#1", out, CS_WRITE_BUFFER);
+  set_noop_callback(reader);
+
+  rgb.set_output_buffer(out);
+  rgb.build();
+
+  const RgRtData &rt = rgp.get_runtime_data();
+  ASSERT_EQ(rt.m_passes.size(), 2u);
+  EXPECT_EQ(rt.m_memory_barriers.size(), 1u);
+  EXPECT_TRUE(rt.m_event_barriers.empty());
+
+  Span<const VkMemoryBarrier2> barriers = get_memory_barriers(rgp, 1);
+  ASSERT_EQ(barriers.size(), 1u);
+  EXPECT_EQ(barriers[0].srcStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                                          VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT);
+  EXPECT_EQ(barriers[0].srcAccessMask, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                                           VK_ACCESS_2_TRANSFER_WRITE_BIT);
+  EXPECT_EQ(barriers[0].dstStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(barriers[0].dstAccessMask, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+}
+
+TEST(RenderGraphBarrierTest, SplitsBarriersAroundIndependentPasses) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgBuilder rgb(rgp);
+
+  RgUntypedBufferId a = rgb.create_buffer({.name = "a", .size = 256});
+  RgUntypedBufferId b = rgb.create_buffer({.name = "b", .size = 256});
+  RgUntypedBufferId c = rgb.create_buffer({.name = "c", .size = 256});
+  RgUntypedBufferId out = rgb.create_buffer({.name = "out", .size = 256});
+
+  RgPassBuilder writer = rgb.create_pass({.name = "writer"});
+  std::tie(a, std::ignore) = writer.write_buffer("a#1", a, CS_WRITE_BUFFER);
+  std::tie(b, std::ignore) = writer.write_buffer("b#1", b, CS_WRITE_BUFFER);
+  set_noop_callback(writer);
+
+  RgPassBuilder independent = rgb.create_pass({.name = "independent"});
+  std::tie(c, std::ignore) =
+      independent.write_buffer("c#1", c, CS_WRITE_BUFFER);
+  set_noop_callback(independent);
+
+  RgPassBuilder reader = rgb.create_pass({.name = "reader"});
+  (void)reader.read_buffer(a, CS_READ_BUFFER);
+  (void)reader.read_buffer(b, CS_READ_BUFFER);
+  std::tie(out, std::ignore) =
+      reader.write_buffer("out#1", out, CS_WRITE_BUFFER);
+  set_noop_callback(reader);
+
+  rgb.set_output_buffer(c);
+  rgb.set_output_buffer(out);
+  rgb.build();
+
+  // Both reads depend on the same pass, so they share a single event that is
+  // set after the writer and waited for before the reader. The independent
+  // pass between them is not blocked.
+  const RgRtData &rt = rgp.get_runtime_data();
+  ASSERT_EQ(rt.m_passes.size(), 3u);
+  EXPECT_TRUE(rt.m_memory_barriers.empty());
+  ASSERT_EQ(rt.m_event_barriers.size(), 1u);
+  EXPECT_EQ(rt.m_passes[0].num_set_events, 1u);
+  EXPECT_EQ(rt.m_passes[1].num_set_events, 0u);
+  EXPECT_EQ(rt.m_passes[1].num_wait_events, 0u);
+  EXPECT_EQ(rt.m_passes[2].num_wait_events, 1u);
+
+  const VkMemoryBarrier2 &barrier = rt.m_event_barriers[0];
+  EXPECT_EQ(barrier.srcStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(barrier.srcAccessMask, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+  EXPECT_EQ(barrier.dstStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(barrier.dstAccessMask, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+}
+
+TEST(RenderGraphSubresourceTest, MipChainDownsampleGetsPerMipBarriers) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  constexpr u32 NUM_MIPS = 4;
+  RgTextureId texture = rgp.create_texture({
+      .name = "texture",
+      .format = VK_FORMAT_R32_SFLOAT,
+      .width = 64,
+      .height = 64,
+      .num_mip_levels = NUM_MIPS,
+  });
+  RgBuilder rgb(rgp);
+
+  // Each pass reads the previous mip level and writes the next one.
+  for (u32 mip = 0; mip < NUM_MIPS; ++mip) {
+    RgPassBuilder pass = rgb.create_pass({.name = fmt::format("mip-{}", mip)});
+    if (mip > 0) {
+      (void)pass.read_texture(
+          texture, CS_SAMPLE_TEXTURE,
+          {.first_mip_level = mip - 1, .num_mip_levels = 1});
+    }
+    std::tie(texture, std::ignore) = pass.write_texture(
+        fmt::format("texture#{}", mip + 1), texture, CS_WRITE_TEXTURE,
+        {.first_mip_level = mip, .num_mip_levels = 1});
+    set_noop_callback(pass);
+  }
+
+  rgb.set_output_texture(texture);
+  rgb.build();
+
+  ASSERT_EQ(get_schedule(rgp).size(), NUM_MIPS);
+  EXPECT_TRUE(rgp.get_runtime_data().m_memory_barriers.empty());
+  EXPECT_TRUE(rgp.get_runtime_data().m_event_barriers.empty());
+
+  auto expect_mip = [](const VkImageMemoryBarrier2 &barrier, u32 mip) {
+    EXPECT_EQ(barrier.subresourceRange.baseMipLevel, mip);
+    EXPECT_EQ(barrier.subresourceRange.levelCount, 1u);
+    EXPECT_EQ(barrier.subresourceRange.baseArrayLayer, 0u);
+    EXPECT_EQ(barrier.subresourceRange.layerCount, 1u);
+  };
+
+  Span<const VkImageMemoryBarrier2> barriers = get_texture_barriers(rgp, 0);
+  ASSERT_EQ(barriers.size(), 1u);
+  expect_mip(barriers[0], 0);
+  EXPECT_EQ(barriers[0].oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+  EXPECT_EQ(barriers[0].newLayout, VK_IMAGE_LAYOUT_GENERAL);
+
+  // Only the mip level that was just written is transitioned for reading and
+  // only the next one is discarded.
+  for (u32 mip = 1; mip < NUM_MIPS; ++mip) {
+    barriers = get_texture_barriers(rgp, mip);
+    ASSERT_EQ(barriers.size(), 2u) << mip;
+    expect_mip(barriers[0], mip - 1);
+    EXPECT_EQ(barriers[0].srcStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    EXPECT_EQ(barriers[0].srcAccessMask, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    EXPECT_EQ(barriers[0].dstStageMask, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    EXPECT_EQ(barriers[0].dstAccessMask, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    EXPECT_EQ(barriers[0].oldLayout, VK_IMAGE_LAYOUT_GENERAL);
+    EXPECT_EQ(barriers[0].newLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    expect_mip(barriers[1], mip);
+    EXPECT_EQ(barriers[1].oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+    EXPECT_EQ(barriers[1].newLayout, VK_IMAGE_LAYOUT_GENERAL);
+  }
+}
+
+TEST(RenderGraphSubresourceTest, ReadsAndWritesDifferentMipsInOnePass) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgTextureId texture = rgp.create_texture({
+      .name = "texture",
+      .format = VK_FORMAT_R32_SFLOAT,
+      .width = 64,
+      .height = 64,
+      .num_mip_levels = 4,
+  });
+  RgBuilder rgb(rgp);
+
+  // Same as the Hi-Z passes: the first pass writes the top mip levels and the
+  // second one reduces the last of them into the rest.
+  RgPassBuilder head = rgb.create_pass({.name = "head"});
+  std::tie(texture, std::ignore) =
+      head.write_texture("texture#1", texture, CS_WRITE_TEXTURE,
+                         {.first_mip_level = 0, .num_mip_levels = 2});
+  set_noop_callback(head);
+
+  RgPassBuilder tail = rgb.create_pass({.name = "tail"});
+  (void)tail.read_texture(texture, CS_READ_TEXTURE,
+                          {.first_mip_level = 1, .num_mip_levels = 1});
+  std::tie(texture, std::ignore) = tail.write_texture(
+      "texture#2", texture, CS_WRITE_TEXTURE, {.first_mip_level = 2});
+  set_noop_callback(tail);
+
+  rgb.set_output_texture(texture);
+  rgb.build();
+
+  ASSERT_EQ(get_schedule(rgp).size(), 2u);
+
+  Span<const VkImageMemoryBarrier2> barriers = get_texture_barriers(rgp, 0);
+  ASSERT_EQ(barriers.size(), 1u);
+  EXPECT_EQ(barriers[0].subresourceRange.baseMipLevel, 0u);
+  EXPECT_EQ(barriers[0].subresourceRange.levelCount, 2u);
+
+  // Mip level 1 stays in the general layout, so it only needs a memory
+  // barrier. Mip level 0 is not touched.
+  Span<const VkMemoryBarrier2> memory_barriers = get_memory_barriers(rgp, 1);
+  ASSERT_EQ(memory_barriers.size(), 1u);
+  EXPECT_EQ(memory_barriers[0].srcStageMask,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(memory_barriers[0].srcAccessMask,
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+  EXPECT_EQ(memory_barriers[0].dstStageMask,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+  EXPECT_EQ(memory_barriers[0].dstAccessMask,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+  barriers = get_texture_barriers(rgp, 1);
+  ASSERT_EQ(barriers.size(), 1u);
+  EXPECT_EQ(barriers[0].subresourceRange.baseMipLevel, 2u);
+  EXPECT_EQ(barriers[0].subresourceRange.levelCount, 2u);
+  EXPECT_EQ(barriers[0].oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+  EXPECT_EQ(barriers[0].newLayout, VK_IMAGE_LAYOUT_GENERAL);
+}
+
+TEST(RenderGraphSubresourceTest, CachesStorageDescriptorsOfWholeMipLevels) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  RgTextureId texture = rgp.create_texture({
+      .name = "texture",
+      .format = VK_FORMAT_R32_SFLOAT,
+      .width = 64,
+      .height = 64,
+      .num_mip_levels = 4,
+      .num_array_layers = 2,
+      .persistent = true,
+  });
+
+  auto build = [&] {
+    device.begin_frame();
+    RgBuilder rgb(rgp);
+    RgTextureId current = texture;
+
+    RgPassBuilder head = rgb.create_pass({.name = "head"});
+    std::tie(current, std::ignore) =
+        head.write_texture("texture#1", current, CS_WRITE_TEXTURE,
+                           {.first_mip_level = 0, .num_mip_levels = 2});
+    set_noop_callback(head);
+
+    RgPassBuilder tail = rgb.create_pass({.name = "tail"});
+    (void)tail.read_texture(current, CS_READ_TEXTURE,
+                            {.first_mip_level = 1, .num_mip_levels = 1});
+    std::tie(current, std::ignore) = tail.write_texture(
+        "texture#2", current, CS_WRITE_TEXTURE, {.first_mip_level = 2});
+    set_noop_callback(tail);
+
+    // Views of only some of the array layers are created every frame.
+    RgPassBuilder layer = rgb.create_pass({.name = "layer"});
+    std::tie(current, std::ignore) =
+        layer.write_texture("texture#3", current, CS_WRITE_TEXTURE,
+                            {
+                                .first_mip_level = 0,
+                                .num_mip_levels = 1,
+                                .first_array_layer = 1,
+                                .num_array_layers = 1,
+                            });
+    set_noop_callback(layer);
+
+    rgb.build();
+    ASSERT_EQ(get_schedule(rgp).size(), 3u);
+  };
+
+  build();
+  for (u32 frame : range(1, 3)) {
+    SCOPED_TRACE(frame);
+    u32 num_descriptors = device.get_statistics().num_allocated_descriptors;
+    build();
+    EXPECT_EQ(device.get_statistics().num_allocated_descriptors,
+              num_descriptors + 1);
+  }
+}
+
+TEST(RenderGraphAllocationTest, SteadyStateBuildDoesNotAllocate) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  rgp.set_pass_reordering(true);
+  RgTextureId color = create_texture(rgp, "color", false);
+  RgTextureId hi_z = rgp.create_texture({
+      .name = "hi-z",
+      .format = VK_FORMAT_R32_SFLOAT,
+      .width = 64,
+      .height = 64,
+      .num_mip_levels = 4,
+      .persistent = true,
+  });
+
+  auto build = [&] {
+    device.begin_frame();
+    RgBuilder rgb(rgp);
+    RgTextureId current_color = color;
+    RgUntypedBufferId data = rgb.create_buffer({.name = "data", .size = 256});
+    RgUntypedBufferId out = rgb.create_buffer({.name = "out", .size = 256});
+
+    RgPassBuilder upload = rgb.create_pass({.name = "upload"});
+    std::tie(data, std::ignore) =
+        upload.write_buffer("data#1", data, CS_WRITE_BUFFER);
+    set_noop_callback(upload);
+
+    RgPassBuilder draw = rgb.create_pass({.name = "draw"});
+    (void)draw.read_buffer(data, CS_READ_BUFFER);
+    std::tie(current_color, std::ignore) =
+        draw.write_texture("color#1", current_color, CS_WRITE_TEXTURE);
+    set_noop_callback(draw);
+
+    RgPassBuilder downsample = rgb.create_pass({.name = "downsample"});
+    (void)downsample.read_texture(current_color, CS_SAMPLE_TEXTURE);
+    (void)downsample.write_texture("hi-z#1", hi_z, CS_WRITE_TEXTURE,
+                                   {.first_mip_level = 0, .num_mip_levels = 2});
+    set_noop_callback(downsample);
+
+    RgPassBuilder post = rgb.create_pass({.name = "post"});
+    (void)post.read_texture(current_color, CS_SAMPLE_TEXTURE);
+    std::tie(out, std::ignore) =
+        post.write_buffer("out#1", out, CS_WRITE_BUFFER);
+    set_noop_callback(post);
+
+    rgb.set_output_buffer(out);
+    rgb.build();
+  };
+
+  // Textures are created and barriers are placed during the first frames.
+  build();
+  build();
+  usize num_allocations = get_num_allocations();
+  build();
+  EXPECT_EQ(get_num_allocations(), num_allocations);
+  EXPECT_EQ(get_schedule(rgp).size(), 4u);
+}
+
+TEST(RenderGraphAsyncComputeTest, OnlySharesTexturesUsedOnBothQueues) {
+  RgTestDevice device(true);
+  RgPersistent rgp(device);
+  RgTextureId shared = create_texture(rgp, "shared", false);
+  RgTextureId graphics = create_texture(rgp, "graphics", false);
+  RgTextureId async = create_texture(rgp, "async", false);
+  RgBuilder rgb(rgp);
+
+  RgUntypedBufferId out = rgb.create_buffer({.name = "out", .size = 256});
+
+  RgPassBuilder writer = rgb.create_pass({.name = "writer"});
+  std::tie(shared, std::ignore) =
+      writer.write_texture("shared#1", shared, CS_WRITE_TEXTURE);
+  std::tie(graphics, std::ignore) =
+      writer.write_texture("graphics#1", graphics, CS_WRITE_TEXTURE);
+  set_noop_callback(writer);
+
+  RgPassBuilder async_pass = rgb.create_pass({
+      .name = "async",
+      .queue = RgQueue::AsyncCompute,
+  });
+  (void)async_pass.read_texture(shared, CS_SAMPLE_TEXTURE);
+  std::tie(async, std::ignore) =
+      async_pass.write_texture("async#1", async, CS_WRITE_TEXTURE);
+  std::tie(out, std::ignore) =
+      async_pass.write_buffer("out#1", out, CS_WRITE_BUFFER);
+  set_noop_callback(async_pass);
+
+  RgUntypedBufferId graphics_out =
+      rgb.create_buffer({.name = "graphics-out", .size = 256});
+  RgPassBuilder reader = rgb.create_pass({.name = "reader"});
+  (void)reader.read_texture(graphics, CS_SAMPLE_TEXTURE);
+  std::tie(graphics_out, std::ignore) =
+      reader.write_buffer("graphics-out#1", graphics_out, CS_WRITE_BUFFER);
+  set_noop_callback(reader);
+
+  rgb.set_output_buffer(out);
+  rgb.set_output_buffer(graphics_out);
+  rgb.set_output_texture(async);
+  rgb.build();
+
+  ASSERT_EQ(get_schedule(rgp).size(), 3u);
+  EXPECT_EQ(device.get_statistics().num_created_textures, 3u);
+  EXPECT_EQ(device.get_statistics().num_created_concurrent_textures, 1u);
+}
+
+TEST(RenderGraphReorderingTest, ScheduleRespectsDependencies) {
+  for (u32 seed : range(100u)) {
+    std::mt19937 rng(seed);
+    constexpr u32 NUM_PASSES = 32;
+    Vector<SmallVector<u32>> dependencies(NUM_PASSES);
+    for (u32 pass : range<u32>(1, NUM_PASSES)) {
+      std::uniform_int_distribution<u32> dependency(0, pass - 1);
+      u32 num_dependencies = std::uniform_int_distribution<u32>(0, 3)(rng);
+      while (dependencies[pass].size() < num_dependencies) {
+        dependencies[pass].push_back(dependency(rng));
+      }
+      std::ranges::sort(dependencies[pass]);
+      auto [first, last] = std::ranges::unique(dependencies[pass]);
+      dependencies[pass].erase(first, last);
+    }
+
+    Vector<u32> schedule = schedule_passes(dependencies);
+    ASSERT_EQ(schedule.size(), NUM_PASSES);
+    Vector<u32> positions(NUM_PASSES, -1);
+    for (u32 i : range(NUM_PASSES)) {
+      ASSERT_EQ(positions[schedule[i]], u32(-1)) << "seed " << seed;
+      positions[schedule[i]] = i;
+    }
+    for (u32 pass : range(NUM_PASSES)) {
+      for (u32 dependency : dependencies[pass]) {
+        EXPECT_LT(positions[dependency], positions[pass]) << "seed " << seed;
+      }
+    }
+
+    // The original order is always a valid schedule, so reordering should
+    // never be estimated to stall more.
+    auto old_schedule = range(NUM_PASSES) | std::ranges::to<Vector<u32>>();
+    EXPECT_LE(count_barrier_stalls(dependencies, schedule),
+              count_barrier_stalls(dependencies, old_schedule))
+        << "seed " << seed;
+  }
+}
+
+TEST(RenderGraphReorderingTest, InterleavesIndependentPasses) {
+  RgTestDevice device;
+  RgPersistent rgp(device);
+  rgp.set_pass_reordering(true);
+  RgBuilder rgb(rgp);
+
+  // Three writers that are each directly followed by their reader.
+  constexpr u32 NUM_CHAINS = 3;
+  Vector<RgPassId> writers;
+  Vector<RgPassId> readers;
+  for (u32 i : range(NUM_CHAINS)) {
+    RgUntypedBufferId data = rgb.create_buffer(
+        {.name = fmt::format("data-{}", i), .size = 256});
+    RgUntypedBufferId out =
+        rgb.create_buffer({.name = fmt::format("out-{}", i), .size = 256});
+
+    RgPassBuilder writer =
+        rgb.create_pass({.name = fmt::format("writer-{}", i)});
+    std::tie(data, std::ignore) = writer.write_buffer(
+        fmt::format("data-{}#1", i), data, CS_WRITE_BUFFER);
+    set_noop_callback(writer);
+    writers.push_back(writer.get_id());
+
+    RgPassBuilder reader =
+        rgb.create_pass({.name = fmt::format("reader-{}", i)});
+    (void)reader.read_buffer(data, CS_READ_BUFFER);
+    std::tie(out, std::ignore) =
+        reader.write_buffer(fmt::format("out-{}#1", i), out, CS_WRITE_BUFFER);
+    set_noop_callback(reader);
+    readers.push_back(reader.get_id());
+
+    rgb.set_output_buffer(out);
+  }
+  rgb.build();
+
+  Vector<RgPassId> expected = writers;
+  expected.append(readers);
+  EXPECT_EQ(get_schedule(rgp), expected);
+
+  const RgPassReorderingStats &stats = rgp.get_pass_reordering_stats();
+  EXPECT_EQ(stats.num_barrier_stalls_before, NUM_CHAINS);
+  EXPECT_EQ(stats.num_barrier_stalls_after, 0u);
+}
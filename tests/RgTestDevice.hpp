@@ -0,0 +1,231 @@
+#pragma once
+#include "RgDevice.hpp"
+#include "Support/GenArray.hpp"
+#include "Support/HashSet.hpp"
+
+namespace ren {
+
+/// Render graph device that doesn't talk to a GPU. Resources only exist as
+/// records, and images and descriptors are distinct fake handles, so graphs can
+/// be built and their compiled passes and barriers inspected, but not executed.
+class RgTestDevice final : public IRgDevice {
+public:
+  struct Statistics {
+    u32 num_wait_idle = 0;
+    u32 num_created_textures = 0;
+    u32 num_created_concurrent_textures = 0;
+    u32 num_destroyed_textures = 0;
+    u32 num_created_buffers = 0;
+    u32 num_destroyed_buffers = 0;
+    u32 num_allocated_memory_blocks = 0;
+    u32 num_freed_memory_blocks = 0;
+    u32 num_allocated_descriptors = 0;
+    u32 num_freed_descriptors = 0;
+  };
+
+  explicit RgTestDevice(bool async_compute = false) {
+    m_async_compute = async_compute;
+  }
+
+  /// Frees buffers that were allocated for the previous frame.
+  void begin_frame() {
+    for (Handle<Buffer> buffer : m_frame_buffers) {
+      m_buffers.erase(buffer);
+    }
+    m_frame_buffers.clear();
+  }
+
+  auto get_statistics() const -> const Statistics & { return m_stats; }
+
+  auto get_num_live_textures() const -> usize { return m_textures.size(); }
+
+  auto get_num_live_memory_blocks() const -> usize { return m_memory.size(); }
+
+  auto has_async_compute() const -> bool override { return m_async_compute; }
+
+  void wait_idle() override { m_stats.num_wait_idle++; }
+
+  [[nodiscard]] auto create_semaphore(const SemaphoreCreateInfo &&)
+      -> Handle<Semaphore> override {
+    return m_semaphores.insert({});
+  }
+
+  void destroy(Handle<Semaphore> semaphore) override {
+    m_semaphores.erase(semaphore);
+  }
+
+  auto get_semaphore(Handle<Semaphore> semaphore) const
+      -> const Semaphore & override {
+    return m_semaphores[semaphore];
+  }
+
+  auto get_texture_memory_requirements(const TextureCreateInfo &create_info)
+      const -> VkMemoryRequirements override {
+    // Assume 16 bytes per texel and a full mip chain of at most twice the
+    // size of the first level.
+    usize size = usize(create_info.width) * create_info.height *
+                 create_info.depth * create_info.num_array_layers * 16;
+    if (create_info.num_mip_levels > 1) {
+      size *= 2;
+    }
+    return {
+        .size = size,
+        .alignment = 256,
+        .memoryTypeBits = 1,
+    };
+  }
+
+  [[nodiscard]] auto allocate_memory(const VkMemoryRequirements &)
+      -> VmaAllocation override {
+    m_stats.num_allocated_memory_blocks++;
+    auto allocation = (VmaAllocation)(uintptr_t)(++m_num_allocations);
+    m_memory.insert(allocation);
+    return allocation;
+  }
+
+  void free_memory(VmaAllocation allocation) override {
+    if (allocation) {
+      m_stats.num_freed_memory_blocks++;
+      usize num_erased = m_memory.erase(allocation);
+      ren_assert(num_erased == 1);
+    }
+  }
+
+  [[nodiscard]] auto create_texture(const TextureCreateInfo &&create_info)
+      -> Handle<Texture> override {
+    m_stats.num_created_textures++;
+    bool concurrent = create_info.concurrent and m_async_compute;
+    m_stats.num_created_concurrent_textures += concurrent;
+    return m_textures.emplace(Texture{
+        .image = (VkImage)(uintptr_t)(++m_num_images),
+        .allocation = create_info.alias_allocation,
+        .is_alias = create_info.alias_allocation != nullptr,
+        .type = create_info.type,
+        .format = create_info.format,
+        .usage = create_info.usage,
+        .width = create_info.width,
+        .height = create_info.height,
+        .depth = create_info.depth,
+        .num_mip_levels = create_info.num_mip_levels,
+        .num_array_layers = create_info.num_array_layers,
+        .concurrent = concurrent,
+    });
+  }
+
+  void destroy(Handle<Texture> texture) override {
+    if (texture) {
+      m_stats.num_destroyed_textures++;
+      m_textures.erase(texture);
+    }
+  }
+
+  auto get_texture(Handle<Texture> texture) const -> const Texture & override {
+    return m_textures[texture];
+  }
+
+  auto get_texture_view(Handle<Texture> handle) const -> TextureView override {
+    const Texture &texture = m_textures[handle];
+    VkImageViewType type = VK_IMAGE_VIEW_TYPE_2D;
+    if (texture.type == VK_IMAGE_TYPE_3D) {
+      type = VK_IMAGE_VIEW_TYPE_3D;
+    } else if (texture.num_array_layers > 1) {
+      type = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    }
+    return {
+        .texture = handle,
+        .type = type,
+        .format = texture.format,
+        .num_mip_levels = texture.num_mip_levels,
+        .num_array_layers = texture.num_array_layers,
+    };
+  }
+
+  [[nodiscard]] auto create_buffer(const BufferCreateInfo &&create_info)
+      -> Handle<Buffer> override {
+    m_stats.num_created_buffers++;
+    return m_buffers.insert({
+        .size = create_info.size,
+        .heap = create_info.heap,
+        .usage = create_info.usage,
+    });
+  }
+
+  void destroy(Handle<Buffer> buffer) override {
+    if (buffer) {
+      m_stats.num_destroyed_buffers++;
+      m_buffers.erase(buffer);
+    }
+  }
+
+  auto get_buffer(Handle<Buffer> buffer) const -> const Buffer & override {
+    return m_buffers[buffer];
+  }
+
+  auto allocate_buffer(BufferHeap heap, usize size) -> BufferView override {
+    Handle<Buffer> buffer = m_buffers.insert({
+        .size = size,
+        .heap = heap,
+    });
+    m_frame_buffers.push_back(buffer);
+    return {
+        .buffer = buffer,
+        .count = size,
+    };
+  }
+
+  auto allocate_texture(const TextureView &) -> glsl::Texture override {
+    return glsl::Texture(allocate_descriptor());
+  }
+
+  auto allocate_sampled_texture(const TextureView &, Handle<Sampler>)
+      -> glsl::SampledTexture override {
+    return glsl::SampledTexture(allocate_descriptor());
+  }
+
+  auto allocate_storage_texture(const TextureView &)
+      -> glsl::RWStorageTexture override {
+    return glsl::RWStorageTexture(allocate_descriptor());
+  }
+
+  auto allocate_persistent_texture(const TextureView &view)
+      -> glsl::Texture override {
+    return allocate_texture(view);
+  }
+
+  auto allocate_persistent_sampled_texture(const TextureView &view,
+                                           Handle<Sampler> sampler)
+      -> glsl::SampledTexture override {
+    return allocate_sampled_texture(view, sampler);
+  }
+
+  auto allocate_persistent_storage_texture(const TextureView &view)
+      -> glsl::RWStorageTexture override {
+    return allocate_storage_texture(view);
+  }
+
+  void free(glsl::Texture) override { m_stats.num_freed_descriptors++; }
+
+  void free(glsl::SampledTexture) override { m_stats.num_freed_descriptors++; }
+
+  void free(glsl::RWStorageTexture) override {
+    m_stats.num_freed_descriptors++;
+  }
+
+private:
+  auto allocate_descriptor() -> u32 {
+    return ++m_stats.num_allocated_descriptors;
+  }
+
+private:
+  bool m_async_compute = false;
+  Statistics m_stats;
+  GenArray<Semaphore> m_semaphores;
+  GenArray<Texture> m_textures;
+  GenArray<Buffer> m_buffers;
+  Vector<Handle<Buffer>> m_frame_buffers;
+  HashSet<VmaAllocation> m_memory;
+  usize m_num_allocations = 0;
+  usize m_num_images = 0;
+};
+
+} // namespace ren
@@ -0,0 +1,193 @@
+#include "Renderer.hpp"
+#include "Scene.hpp"
+#include "Support/Optional.hpp"
+#include "ren/ren.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace ren;
+
+namespace {
+
+struct TestScene {
+  std::unique_ptr<IRenderer> renderer;
+  std::unique_ptr<ISwapchain> swapchain;
+  std::unique_ptr<IScene> scene;
+};
+
+/// Creates a scene with a single quad in front of the camera, or returns None
+/// if there is no Vulkan driver to create a renderer with.
+auto create_test_scene() -> Optional<TestScene> {
+  TestScene ts;
+  auto renderer = create_renderer({});
+  if (!renderer) {
+    return None;
+  }
+  ts.renderer = std::move(*renderer);
+  auto swapchain = create_offscreen_swapchain(*ts.renderer,
+                                              {.width = 256, .height = 256});
+  EXPECT_TRUE(swapchain);
+  if (!swapchain) {
+    return None;
+  }
+  ts.swapchain = std::move(*swapchain);
+  auto scene = ts.renderer->create_scene(*ts.swapchain);
+  EXPECT_TRUE(scene);
+  if (!scene) {
+    return None;
+  }
+  ts.scene = std::move(*scene);
+  IScene &scene_ref = *ts.scene;
+
+  // Quad that faces the camera, which looks along the X axis.
+  std::array<glm::vec3, 4> positions = {{
+      {0.0f, -1.0f, -1.0f},
+      {0.0f, 1.0f, -1.0f},
+      {0.0f, 1.0f, 1.0f},
+      {0.0f, -1.0f, 1.0f},
+  }};
+  std::array<glm::vec3, 4> normals;
+  normals.fill({-1.0f, 0.0f, 0.0f});
+  std::array<unsigned, 6> indices = {0, 1, 2, 2, 3, 0};
+  expected<MeshId> mesh = scene_ref.create_mesh({
+      .positions = positions,
+      .normals = normals,
+      .indices = indices,
+  });
+  expected<MaterialId> material = scene_ref.create_material({});
+  EXPECT_TRUE(mesh and material);
+  if (!mesh or !material) {
+    return None;
+  }
+  EXPECT_TRUE(scene_ref.create_mesh_instance({
+      .mesh = *mesh,
+      .material = *material,
+  }));
+  EXPECT_TRUE(scene_ref.create_directional_light({}));
+  expected<CameraId> camera = scene_ref.create_camera();
+  EXPECT_TRUE(camera);
+  if (!camera) {
+    return None;
+  }
+  scene_ref.set_camera(*camera);
+  scene_ref.set_camera_perspective_projection(*camera, {});
+  scene_ref.set_camera_transform(*camera, {.position = {-2.0f, 0.0f, 0.0f}});
+
+  return ts;
+}
+
+/// Draws more frames than are in flight, so that resources are reused across
+/// frames, temporal resources rotate and timestamps are read back.
+constexpr u32 NUM_TEST_FRAMES = 8;
+
+struct SyncTestConfig {
+  const char *name;
+  bool async_compute = true;
+  bool reorder_passes = false;
+  i32 num_recording_threads = 1;
+};
+
+class VulkanSyncTest : public testing::TestWithParam<SyncTestConfig> {};
+
+} // namespace
+
+/// Draws a small scene with the synchronization validation layer enabled and
+/// fails on any error that it reports. Skipped if there is no Vulkan driver or
+/// ren was built without REN_VULKAN_VALIDATION.
+TEST_P(VulkanSyncTest, DrawsWithoutValidationErrors) {
+#if !REN_VULKAN_VALIDATION
+  GTEST_SKIP() << "Vulkan validation is disabled";
+#else
+  Optional<TestScene> ts = create_test_scene();
+  if (!ts) {
+    if (HasFailure()) {
+      return;
+    }
+    GTEST_SKIP() << "Failed to create renderer";
+  }
+  IScene &scene = *ts->scene;
+
+  const SyncTestConfig &config = GetParam();
+  SceneGraphicsSettings &settings = static_cast<Scene &>(scene).get_settings();
+  settings.async_compute = config.async_compute;
+  settings.reorder_passes = config.reorder_passes;
+  settings.num_recording_threads = config.num_recording_threads;
+
+  u32 num_errors = get_num_vulkan_validation_errors();
+  for (u32 i = 0; i < NUM_TEST_FRAMES; ++i) {
+    ASSERT_TRUE(scene.draw());
+  }
+  EXPECT_EQ(get_num_vulkan_validation_errors(), num_errors);
+#endif
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Settings, VulkanSyncTest,
+    testing::Values(SyncTestConfig{.name = "Default"},
+                    SyncTestConfig{.name = "NoAsyncCompute",
+                                   .async_compute = false},
+                    SyncTestConfig{.name = "ReorderPasses",
+                                   .reorder_passes = true},
+                    SyncTestConfig{.name = "RecordingThreads",
+                                   .num_recording_threads = 4}),
+    [](const testing::TestParamInfo<SyncTestConfig> &info) {
+      return info.param.name;
+    });
+
+/// Checks that pass timings are read back once frames complete, that every
+/// pass ends after it begins and that passes keep their names after the
+/// graph that they were built in is gone.
+TEST(VulkanTimestampTest, ReportsPassTimings) {
+  Optional<TestScene> ts = create_test_scene();
+  if (!ts) {
+    if (HasFailure()) {
+      return;
+    }
+    GTEST_SKIP() << "Failed to create renderer";
+  }
+  if (static_cast<Renderer &>(*ts->renderer).get_timestamp_period() == 0.0f) {
+    GTEST_SKIP() << "GPU timestamps are not supported";
+  }
+  IScene &scene = *ts->scene;
+
+  for (u32 i = 0; i < NUM_TEST_FRAMES; ++i) {
+    ASSERT_TRUE(scene.draw());
+  }
+
+  FrameStatistics stats = scene.get_frame_statistics();
+  ASSERT_FALSE(stats.passes.empty());
+  EXPECT_GT(stats.gpu_frame_time_ms, 0.0f);
+  for (const PassStatistics &pass : stats.passes) {
+    ASSERT_NE(pass.name, nullptr);
+#if REN_RG_DEBUG
+    EXPECT_STRNE(pass.name, "");
+#else
+    EXPECT_STREQ(pass.name, "");
+#endif
+    EXPECT_GE(pass.gpu_time_ms, 0.0f) << pass.name;
+    // A pass whose end timestamp was written before its begin timestamp
+    // would wrap around to a huge duration.
+    EXPECT_LE(pass.gpu_time_ms, stats.gpu_frame_time_ms) << pass.name;
+  }
+}
+
+TEST(VulkanSwapchainTest, SkipsFramesWhileOffscreenSwapchainIsEmpty) {
+  Optional<TestScene> ts = create_test_scene();
+  if (!ts) {
+    if (HasFailure()) {
+      return;
+    }
+    GTEST_SKIP() << "Failed to create renderer";
+  }
+  IScene &scene = *ts->scene;
+  ISwapchain &swapchain = *ts->swapchain;
+
+  ASSERT_TRUE(scene.draw());
+  ASSERT_TRUE(swapchain.set_size(0, 0));
+  for (u32 i = 0; i < NUM_TEST_FRAMES; ++i) {
+    ASSERT_TRUE(scene.draw());
+  }
+  ASSERT_TRUE(swapchain.set_size(128, 128));
+  ASSERT_TRUE(scene.draw());
+  EXPECT_EQ(swapchain.get_size(), glm::uvec2(128, 128));
+}